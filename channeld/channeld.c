@@ -582,42 +582,71 @@ static void handle_peer_announcement_signatures(struct peer *peer, const u8 *msg
 	channel_announcement_negotiate(peer);
 }
 
-static struct secret *get_shared_secret(const tal_t *ctx,
-					const struct htlc *htlc,
-					enum onion_type *why_bad,
-					struct sha256 *next_onion_sha)
+/* Checks the onion with this shared secret: returns NULL if it's bad. */
+static struct secret *check_onion(const tal_t *ctx,
+				  const struct htlc *htlc,
+				  const struct onionpacket *op,
+				  const struct secret *ss,
+				  enum onion_type *why_bad,
+				  struct sha256 *next_onion_sha)
 {
-	struct onionpacket *op;
-	struct secret *secret = tal(ctx, struct secret);
-	const u8 *msg;
 	struct route_step *rs;
 
-	/* We unwrap the onion now. */
-	op = parse_onionpacket(tmpctx, htlc->routing, TOTAL_PACKET_SIZE,
-			       why_bad);
-	if (!op)
-		return tal_free(secret);
-
-	/* Because wire takes struct pubkey. */
-	msg = hsm_req(tmpctx, towire_hsm_ecdh_req(tmpctx, &op->ephemeralkey));
-	if (!fromwire_hsm_ecdh_resp(msg, secret))
-		status_failed(STATUS_FAIL_HSM_IO, "Reading ecdh response");
-
 	/* We make sure we can parse onion packet, so we know if shared secret
 	 * is actually valid (this checks hmac). */
-	rs = process_onionpacket(tmpctx, op, secret->data,
+	rs = process_onionpacket(tmpctx, op, ss->data,
 				 htlc->rhash.u.u8,
 				 sizeof(htlc->rhash));
 	if (!rs) {
 		*why_bad = WIRE_INVALID_ONION_HMAC;
-		return tal_free(secret);
+		return NULL;
 	}
 
 	/* Calculate sha256 we'll hand to next peer, in case they complain. */
-	msg = serialize_onionpacket(tmpctx, rs->next);
-	sha256(next_onion_sha, msg, tal_bytelen(msg));
+	sha256_onionpacket(next_onion_sha, rs->next);
 
-	return secret;
+	return tal_dup(ctx, struct secret, ss);
+}
+
+/* We unwrap the onions of the HTLCs they offer once they've committed to
+ * them, so a burst of update_add_htlc costs one hsmd round trip rather than
+ * one each.  If an onion is bad, its shared_secret stays NULL, and we'll
+ * tell the master when it's confirmed. */
+static void get_shared_secrets(struct htlc **htlcs)
+{
+	struct onionpacket **ops;
+	struct pubkey *points;
+	struct secret *ss;
+	const u8 *msg;
+	size_t n;
+
+	ops = tal_arr(tmpctx, struct onionpacket *, tal_count(htlcs));
+	points = tal_arr(tmpctx, struct pubkey, 0);
+	for (size_t i = 0; i < tal_count(htlcs); i++) {
+		ops[i] = parse_onionpacket(tmpctx, htlcs[i]->routing,
+					   TOTAL_PACKET_SIZE,
+					   &htlcs[i]->why_bad_onion);
+		if (ops[i])
+			tal_arr_expand(&points, ops[i]->ephemeralkey);
+	}
+
+	if (tal_count(points) == 0)
+		return;
+
+	msg = hsm_req(tmpctx, take(towire_hsm_ecdh_batch_req(NULL, points)));
+	if (!fromwire_hsm_ecdh_batch_resp(tmpctx, msg, &ss)
+	    || tal_count(ss) != tal_count(points))
+		status_failed(STATUS_FAIL_HSM_IO, "Reading ecdh batch response");
+
+	n = 0;
+	for (size_t i = 0; i < tal_count(htlcs); i++) {
+		if (!ops[i])
+			continue;
+		htlcs[i]->shared_secret
+			= check_onion(htlcs[i], htlcs[i], ops[i], &ss[n++],
+				      &htlcs[i]->why_bad_onion,
+				      &htlcs[i]->next_onion_sha);
+	}
 }
 
 static void handle_peer_add_htlc(struct peer *peer, const u8 *msg)
@@ -647,11 +676,7 @@ static void handle_peer_add_htlc(struct peer *peer, const u8 *msg)
 			    "Bad peer_add_htlc: %s",
 			    channel_add_err_name(add_err));
 
-	/* If this is wrong, we don't complain yet; when it's confirmed we'll
-	 * send it to the master which handles all HTLC failures. */
-	htlc->shared_secret = get_shared_secret(htlc, htlc,
-						&htlc->why_bad_onion,
-						&htlc->next_onion_sha);
+	/* We unwrap the onion when they commit to it: see get_shared_secrets */
 }
 
 static void handle_peer_feechange(struct peer *peer, const u8 *msg)
@@ -982,20 +1007,42 @@ static secp256k1_ecdsa_signature *calc_commitsigs(const tal_t *ctx,
 	const struct htlc **htlc_map;
 	struct pubkey local_htlckey;
 	const u8 *msg;
+	const struct bitcoin_tx **htlc_txs;
+	struct hsm_htlc_input **htlc_inputs;
+	struct bitcoin_signature *sigs;
 	secp256k1_ecdsa_signature *htlc_sigs;
 
 	txs = channel_txs(tmpctx, peer->channel->chainparams, &htlc_map,
 			  &wscripts, peer->channel, &peer->remote_per_commit,
 			  commit_index, REMOTE);
 
-	msg = towire_hsm_sign_remote_commitment_tx(NULL, txs[0],
-						   &peer->channel->funding_pubkey[REMOTE],
-						   *txs[0]->input_amounts[0]);
+	/* We ask the HSM for all the signatures at once: with many HTLCs,
+	 * a round trip for each one adds up. */
+	htlc_txs = tal_arr(tmpctx, const struct bitcoin_tx *,
+			   tal_count(txs) - 1);
+	htlc_inputs = tal_arr(tmpctx, struct hsm_htlc_input *,
+			      tal_count(txs) - 1);
+	for (i = 0; i < tal_count(htlc_txs); i++) {
+		htlc_txs[i] = txs[i + 1];
+		htlc_inputs[i] = tal(htlc_inputs, struct hsm_htlc_input);
+		htlc_inputs[i]->wscript = cast_const(u8 *, wscripts[i + 1]);
+		htlc_inputs[i]->amount = *txs[i + 1]->input_amounts[0];
+	}
+
+	msg = towire_hsm_sign_remote_commitment_txs(NULL, txs[0],
+						    &peer->channel->funding_pubkey[REMOTE],
+						    *txs[0]->input_amounts[0],
+						    &peer->remote_per_commit,
+						    htlc_txs,
+						    cast_const2(const struct hsm_htlc_input **,
+								htlc_inputs));
 
 	msg = hsm_req(tmpctx, take(msg));
-	if (!fromwire_hsm_sign_tx_reply(msg, commit_sig))
+	if (!fromwire_hsm_sign_remote_commitment_txs_reply(tmpctx, msg,
+							   commit_sig, &sigs)
+	    || tal_count(sigs) != tal_count(htlc_txs))
 		status_failed(STATUS_FAIL_HSM_IO,
-			      "Reading sign_remote_commitment_tx reply: %s",
+			      "Reading sign_remote_commitment_txs reply: %s",
 			      tal_hex(tmpctx, msg));
 
 	status_trace("Creating commit_sig signature %"PRIu64" %s for tx %s wscript %s key %s",
@@ -1021,32 +1068,20 @@ static secp256k1_ecdsa_signature *calc_commitsigs(const tal_t *ctx,
 	 *  - MUST include one `htlc_signature` for every HTLC transaction
 	 *    corresponding to the ordering of the commitment transaction
 	 */
-	htlc_sigs = tal_arr(ctx, secp256k1_ecdsa_signature, tal_count(txs) - 1);
+	htlc_sigs = tal_arr(ctx, secp256k1_ecdsa_signature, tal_count(sigs));
 
 	for (i = 0; i < tal_count(htlc_sigs); i++) {
-		struct bitcoin_signature sig;
-		msg = towire_hsm_sign_remote_htlc_tx(NULL, txs[i + 1],
-						     wscripts[i + 1],
-						     *txs[i+1]->input_amounts[0],
-						     &peer->remote_per_commit);
-
-		msg = hsm_req(tmpctx, take(msg));
-		if (!fromwire_hsm_sign_tx_reply(msg, &sig))
-			status_failed(STATUS_FAIL_HSM_IO,
-				      "Bad sign_remote_htlc_tx reply: %s",
-				      tal_hex(tmpctx, msg));
-
-		htlc_sigs[i] = sig.s;
+		htlc_sigs[i] = sigs[i].s;
 		status_trace("Creating HTLC signature %s for tx %s wscript %s key %s",
 			     type_to_string(tmpctx, struct bitcoin_signature,
-					    &sig),
+					    &sigs[i]),
 			     type_to_string(tmpctx, struct bitcoin_tx, txs[1+i]),
 			     tal_hex(tmpctx, wscripts[1+i]),
 			     type_to_string(tmpctx, struct pubkey,
 					    &local_htlckey));
 		assert(check_tx_sig(txs[1+i], 0, NULL, wscripts[1+i],
 				    &local_htlckey,
-				    &sig));
+				    &sigs[i]));
 	}
 
 	return htlc_sigs;
@@ -1364,6 +1399,7 @@ static void handle_peer_commit_sig(struct peer *peer, const u8 *msg)
 	struct pubkey remote_htlckey;
 	struct bitcoin_tx **txs;
 	const struct htlc **htlc_map, **changed_htlcs;
+	struct htlc **added_htlcs;
 	const u8 **wscripts;
 	size_t i;
 
@@ -1483,6 +1519,17 @@ static void handle_peer_commit_sig(struct peer *peer, const u8 *msg)
 	status_trace("Received commit_sig with %zu htlc sigs",
 		     tal_count(htlc_sigs));
 
+	/* Now they're committed, unwrap the onions of any HTLCs they added. */
+	added_htlcs = tal_arr(tmpctx, struct htlc *, 0);
+	for (i = 0; i < tal_count(changed_htlcs); i++) {
+		if (changed_htlcs[i]->state != RCVD_ADD_COMMIT)
+			continue;
+		tal_arr_expand(&added_htlcs,
+			       channel_get_htlc(peer->channel, REMOTE,
+						changed_htlcs[i]->id));
+	}
+	get_shared_secrets(added_htlcs);
+
 	/* Tell master daemon, then wait for ack. */
 	msg = got_commitsig_msg(NULL, peer->next_index[LOCAL],
 				channel_feerate(peer->channel, LOCAL),
@@ -2821,18 +2868,17 @@ static void init_shared_secrets(struct channel *channel,
 				const struct added_htlc *htlcs,
 				const enum htlc_state *hstates)
 {
-	for (size_t i = 0; i < tal_count(htlcs); i++) {
-		struct htlc *htlc;
+	struct htlc **theirs = tal_arr(tmpctx, struct htlc *, 0);
 
+	for (size_t i = 0; i < tal_count(htlcs); i++) {
 		/* We only derive this for HTLCs *they* added. */
 		if (htlc_state_owner(hstates[i]) != REMOTE)
 			continue;
 
-		htlc = channel_get_htlc(channel, REMOTE, htlcs[i].id);
-		htlc->shared_secret = get_shared_secret(htlc, htlc,
-							&htlc->why_bad_onion,
-							&htlc->next_onion_sha);
+		tal_arr_expand(&theirs,
+			       channel_get_htlc(channel, REMOTE, htlcs[i].id));
 	}
+	get_shared_secrets(theirs);
 }
 
 /* We do this synchronously. */
@@ -0,0 +1,315 @@
+#define main hsmd_main
+int hsmd_main(int argc, char *argv[]);
+
+#include "../../hsmd/hsmd.c"
+#undef main
+#include "../../common/derive_basepoints.c"
+#include "../../common/node_id.c"
+#include "../../hsmd/gen_hsm_wire.c"
+#include <ccan/err/err.h>
+#include <ccan/time/time.h>
+#include <common/test/bench.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <wire/wire_sync.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for bigsize_get */
+size_t bigsize_get(const u8 *p UNNEEDED, size_t max UNNEEDED, bigsize_t *val UNNEEDED)
+{ fprintf(stderr, "bigsize_get called!\n"); abort(); }
+/* Generated stub for bigsize_put */
+size_t bigsize_put(u8 buf[BIGSIZE_MAX_LEN] UNNEEDED, bigsize_t v UNNEEDED)
+{ fprintf(stderr, "bigsize_put called!\n"); abort(); }
+/* Generated stub for daemon_shutdown */
+void daemon_shutdown(void)
+{ fprintf(stderr, "daemon_shutdown called!\n"); abort(); }
+/* Generated stub for dump_memleak */
+bool dump_memleak(struct htable *memtable UNNEEDED)
+{ fprintf(stderr, "dump_memleak called!\n"); abort(); }
+/* Generated stub for fromwire_ext_key */
+void fromwire_ext_key(const u8 **cursor UNNEEDED, size_t *max UNNEEDED, struct ext_key *bip32 UNNEEDED)
+{ fprintf(stderr, "fromwire_ext_key called!\n"); abort(); }
+/* Generated stub for fromwire_utxo */
+struct utxo *fromwire_utxo(const tal_t *ctx UNNEEDED, const u8 **ptr UNNEEDED, size_t *max UNNEEDED)
+{ fprintf(stderr, "fromwire_utxo called!\n"); abort(); }
+/* Generated stub for funding_tx */
+struct bitcoin_tx *funding_tx(const tal_t *ctx UNNEEDED,
+			      const struct chainparams *chainparams UNNEEDED,
+			      u16 *outnum UNNEEDED,
+			      const struct utxo **utxomap UNNEEDED,
+			      struct amount_sat funding UNNEEDED,
+			      const struct pubkey *local_fundingkey UNNEEDED,
+			      const struct pubkey *remote_fundingkey UNNEEDED,
+			      struct amount_sat change UNNEEDED,
+			      const struct pubkey *changekey UNNEEDED,
+			      const struct ext_key *bip32_base UNNEEDED)
+{ fprintf(stderr, "funding_tx called!\n"); abort(); }
+/* Generated stub for hash_u5 */
+void hash_u5(struct hash_u5 *hu5 UNNEEDED, const u5 *u5 UNNEEDED, size_t len UNNEEDED)
+{ fprintf(stderr, "hash_u5 called!\n"); abort(); }
+/* Generated stub for hash_u5_done */
+void hash_u5_done(struct hash_u5 *hu5 UNNEEDED, struct sha256 *res UNNEEDED)
+{ fprintf(stderr, "hash_u5_done called!\n"); abort(); }
+/* Generated stub for hash_u5_init */
+void hash_u5_init(struct hash_u5 *hu5 UNNEEDED, const char *hrp UNNEEDED)
+{ fprintf(stderr, "hash_u5_init called!\n"); abort(); }
+/* Generated stub for master_badmsg */
+void master_badmsg(u32 type_expected UNNEEDED, const u8 *msg)
+{ fprintf(stderr, "master_badmsg called!\n"); abort(); }
+/* Generated stub for memleak_enter_allocations */
+struct htable *memleak_enter_allocations(const tal_t *ctx UNNEEDED,
+					 const void *exclude1 UNNEEDED,
+					 const void *exclude2 UNNEEDED)
+{ fprintf(stderr, "memleak_enter_allocations called!\n"); abort(); }
+/* Generated stub for memleak_remove_intmap_ */
+void memleak_remove_intmap_(struct htable *memtable UNNEEDED, const struct intmap *m UNNEEDED)
+{ fprintf(stderr, "memleak_remove_intmap_ called!\n"); abort(); }
+/* Generated stub for memleak_remove_referenced */
+void memleak_remove_referenced(struct htable *memtable UNNEEDED, const void *root UNNEEDED)
+{ fprintf(stderr, "memleak_remove_referenced called!\n"); abort(); }
+/* Generated stub for memleak_scan_region */
+void memleak_scan_region(struct htable *memtable UNNEEDED,
+			 const void *p UNNEEDED, size_t bytelen UNNEEDED)
+{ fprintf(stderr, "memleak_scan_region called!\n"); abort(); }
+/* Generated stub for status_failed */
+void status_failed(enum status_failreason code UNNEEDED,
+		   const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "status_failed called!\n"); abort(); }
+/* Generated stub for status_setup_async */
+void status_setup_async(struct daemon_conn *master UNNEEDED)
+{ fprintf(stderr, "status_setup_async called!\n"); abort(); }
+/* Generated stub for subdaemon_setup */
+void subdaemon_setup(int argc UNNEEDED, char *argv[])
+{ fprintf(stderr, "subdaemon_setup called!\n"); abort(); }
+/* Generated stub for towire_ext_key */
+void towire_ext_key(u8 **pptr UNNEEDED, const struct ext_key *bip32 UNNEEDED)
+{ fprintf(stderr, "towire_ext_key called!\n"); abort(); }
+/* Generated stub for towire_utxo */
+void towire_utxo(u8 **pptr UNNEEDED, const struct utxo *utxo UNNEEDED)
+{ fprintf(stderr, "towire_utxo called!\n"); abort(); }
+/* Generated stub for withdraw_tx */
+struct bitcoin_tx *withdraw_tx(const tal_t *ctx UNNEEDED,
+			       const struct chainparams *chainparams UNNEEDED,
+			       const struct utxo **utxos UNNEEDED,
+			       struct bitcoin_tx_output **outputs UNNEEDED,
+			       const struct pubkey *changekey UNNEEDED,
+			       struct amount_sat change UNNEEDED,
+			       const struct ext_key *bip32_base UNNEEDED,
+			       int *change_outnum UNNEEDED)
+{ fprintf(stderr, "withdraw_tx called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+/* We don't care about these. */
+void status_fmt(enum log_level level UNNEEDED, const char *fmt UNNEEDED, ...)
+{
+}
+
+static struct amount_sat sats(u64 satoshis)
+{
+	struct amount_sat sat;
+
+	sat.satoshis = satoshis;
+	return sat;
+}
+
+static void hsmd_done(struct io_conn *conn UNUSED, void *unused UNUSED)
+{
+	exit(0);
+}
+
+/* Runs the real hsmd request handling, for one channeld client. */
+static void run_hsmd(int fd, struct node_id *id)
+{
+	struct client *c;
+
+	memset(&secretstuff.hsm_secret, 7, sizeof(secretstuff.hsm_secret));
+	uintmap_init(&clients);
+	c = new_client(NULL, chainparams_for_network("regtest"), id, 1,
+		       HSM_CAP_SIGN_REMOTE_TX, fd);
+	io_set_finish(c->conn, hsmd_done, NULL);
+	io_loop(NULL, NULL);
+	abort();
+}
+
+static const u8 *hsm_req(int fd, const u8 *req TAKES)
+{
+	if (!wire_sync_write(fd, req))
+		err(1, "Writing to hsmd");
+	return wire_sync_read(tmpctx, fd);
+}
+
+static void make_pubkey(struct pubkey *pubkey, u8 seed)
+{
+	struct privkey privkey;
+
+	memset(&privkey, seed, sizeof(privkey));
+	if (!pubkey_from_privkey(&privkey, pubkey))
+		abort();
+}
+
+/* Something shaped like a commitment tx, and its HTLC txs. */
+static struct bitcoin_tx *make_txs(const tal_t *ctx,
+				   const struct chainparams *chainparams,
+				   size_t num_htlcs,
+				   const struct bitcoin_tx ***htlc_txs,
+				   const struct hsm_htlc_input ***htlc_inputs)
+{
+	struct bitcoin_tx *tx;
+	struct bitcoin_txid txid;
+	u8 *script = tal_arrz(ctx, u8, 34);
+
+	memset(&txid, 1, sizeof(txid));
+	tx = bitcoin_tx(ctx, chainparams, 1, num_htlcs + 2);
+	bitcoin_tx_add_input(tx, &txid, 0, 0xFFFFFFFF,
+			     AMOUNT_SAT(100000000), NULL);
+	for (size_t i = 0; i < num_htlcs + 2; i++)
+		bitcoin_tx_add_output(tx, script, sats(1000 + i));
+
+	*htlc_txs = tal_arr(ctx, const struct bitcoin_tx *, num_htlcs);
+	*htlc_inputs = tal_arr(ctx, const struct hsm_htlc_input *, num_htlcs);
+	for (size_t i = 0; i < num_htlcs; i++) {
+		struct bitcoin_tx *htx = bitcoin_tx(ctx, chainparams, 1, 1);
+		struct hsm_htlc_input *in = tal(ctx, struct hsm_htlc_input);
+
+		txid.shad.sha.u.u8[0] = i;
+		txid.shad.sha.u.u8[1] = i >> 8;
+		bitcoin_tx_add_input(htx, &txid, i, 0,
+				     sats(1000 + i), NULL);
+		bitcoin_tx_add_output(htx, script, sats(500 + i));
+		/* About the size of an offered HTLC wscript */
+		in->wscript = tal_arr(in, u8, 133);
+		memset(in->wscript, i, tal_count(in->wscript));
+		in->amount = sats(1000 + i);
+		(*htlc_txs)[i] = htx;
+		(*htlc_inputs)[i] = in;
+	}
+	return tx;
+}
+
+/* What channeld used to do: one request for each signature. */
+static void sign_one_by_one(int fd, const struct bitcoin_tx *tx,
+			    const struct bitcoin_tx **htlc_txs,
+			    const struct hsm_htlc_input **htlc_inputs,
+			    const struct pubkey *remote_funding_pubkey,
+			    const struct pubkey *remote_per_commit,
+			    struct bitcoin_signature *commit_sig,
+			    struct bitcoin_signature *htlc_sigs)
+{
+	const u8 *msg;
+
+	msg = towire_hsm_sign_remote_commitment_tx(NULL, tx,
+						   remote_funding_pubkey,
+						   AMOUNT_SAT(100000000));
+	msg = hsm_req(fd, take(msg));
+	if (!fromwire_hsm_sign_tx_reply(msg, commit_sig))
+		errx(1, "Bad sign_remote_commitment_tx reply");
+
+	for (size_t i = 0; i < tal_count(htlc_txs); i++) {
+		msg = towire_hsm_sign_remote_htlc_tx(NULL, htlc_txs[i],
+						     htlc_inputs[i]->wscript,
+						     htlc_inputs[i]->amount,
+						     remote_per_commit);
+		msg = hsm_req(fd, take(msg));
+		if (!fromwire_hsm_sign_tx_reply(msg, &htlc_sigs[i]))
+			errx(1, "Bad sign_remote_htlc_tx reply");
+	}
+}
+
+static void sign_batched(int fd, const struct bitcoin_tx *tx,
+			 const struct bitcoin_tx **htlc_txs,
+			 const struct hsm_htlc_input **htlc_inputs,
+			 const struct pubkey *remote_funding_pubkey,
+			 const struct pubkey *remote_per_commit,
+			 struct bitcoin_signature *commit_sig,
+			 struct bitcoin_signature **htlc_sigs)
+{
+	const u8 *msg;
+
+	msg = towire_hsm_sign_remote_commitment_txs(NULL, tx,
+						    remote_funding_pubkey,
+						    AMOUNT_SAT(100000000),
+						    remote_per_commit,
+						    htlc_txs, htlc_inputs);
+	msg = hsm_req(fd, take(msg));
+	if (!fromwire_hsm_sign_remote_commitment_txs_reply(tmpctx, msg,
+							   commit_sig,
+							   htlc_sigs))
+		errx(1, "Bad sign_remote_commitment_txs reply");
+	assert(tal_count(*htlc_sigs) == tal_count(htlc_txs));
+}
+
+int main(int argc, char *argv[])
+{
+	const struct chainparams *chainparams;
+	struct pubkey remote_funding_pubkey, remote_per_commit, pk;
+	struct node_id id;
+	size_t htlc_counts[] = { 0, 10, 100, 483, 966 };
+	size_t iterations = 2, max_htlcs = 10;
+	int fd;
+	pid_t pid;
+
+	setup_locale();
+	setup_tmpctx();
+	secp256k1_ctx = secp256k1_context_create(SECP256K1_CONTEXT_VERIFY
+						 | SECP256K1_CONTEXT_SIGN);
+	chainparams = chainparams_for_network("regtest");
+
+	/* Try 5 966 to see it at max_accepted_htlcs both ways. */
+	bench_sizes(argc, argv, "[iterations [max_htlcs]]",
+		    &iterations, &max_htlcs);
+
+	make_pubkey(&remote_funding_pubkey, 1);
+	make_pubkey(&remote_per_commit, 2);
+	make_pubkey(&pk, 3);
+	node_id_from_pubkey(&id, &pk);
+
+	pid = bench_fork(&fd, run_hsmd, &id);
+
+	for (size_t c = 0; c < ARRAY_SIZE(htlc_counts); c++) {
+		const struct bitcoin_tx **htlc_txs;
+		const struct hsm_htlc_input **htlc_inputs;
+		struct bitcoin_tx *tx;
+		struct bitcoin_signature sig1, sig2, *sigs1, *sigs2;
+		struct timemono start;
+		u64 usec1, usec2;
+
+		if (htlc_counts[c] > max_htlcs)
+			break;
+
+		tx = make_txs(tmpctx, chainparams, htlc_counts[c],
+			      &htlc_txs, &htlc_inputs);
+		sigs1 = tal_arr(tmpctx, struct bitcoin_signature,
+				htlc_counts[c]);
+
+		start = time_mono();
+		for (size_t i = 0; i < iterations; i++)
+			sign_one_by_one(fd, tx, htlc_txs, htlc_inputs,
+					&remote_funding_pubkey,
+					&remote_per_commit, &sig1, sigs1);
+		usec1 = bench_usec_since(start);
+
+		start = time_mono();
+		for (size_t i = 0; i < iterations; i++)
+			sign_batched(fd, tx, htlc_txs, htlc_inputs,
+				     &remote_funding_pubkey,
+				     &remote_per_commit, &sig2, &sigs2);
+		usec2 = bench_usec_since(start);
+
+		/* Signatures are deterministic, so these must match. */
+		assert(memeq(&sig1, sizeof(sig1), &sig2, sizeof(sig2)));
+		assert(memeq(sigs1, tal_bytelen(sigs1),
+			     sigs2, tal_bytelen(sigs2)));
+
+		printf("%zu htlcs: %"PRIu64" usec one-by-one,"
+		       " %"PRIu64" usec batched (per commitment)\n",
+		       htlc_counts[c], usec1 / iterations, usec2 / iterations);
+		clean_tmpctx();
+	}
+
+	close(fd);
+	waitpid(pid, NULL, 0);
+
+	secp256k1_context_destroy(secp256k1_ctx);
+	tal_free(tmpctx);
+	return 0;
+}
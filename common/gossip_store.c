@@ -40,6 +40,7 @@ void gossip_setup_timestamp_filter(struct per_peer_state *pps,
 	 */
 
 	/* Restart just after header. */
+	pps->gsbuf = tal_free(pps->gsbuf);
 	lseek(pps->gossip_store_fd, 1, SEEK_SET);
 }
 
@@ -56,21 +57,46 @@ static bool timestamp_filter(const struct per_peer_state *pps, u32 timestamp)
 		&& timestamp <= pps->gs->timestamp_max;
 }
 
-static void undo_read(int fd, int len, size_t wanted)
+/* How much of the gossip_store we read at once: the initial sync with a new
+ * peer walks the whole thing, and this saves two syscalls per record. */
+#define GOSSIP_STORE_READAHEAD (64 * 1024)
+
+/* Offset in the store of what we're about to look at. */
+static u64 gossip_store_offset(const struct per_peer_state *pps)
 {
-	if (len < 0) {
-		/* Grab errno before lseek overrides it */
-		const char *err = strerror(errno);
-		status_failed(STATUS_FAIL_INTERNAL_ERROR,
-			      "gossip_store: failed read @%"PRIu64": %s",
-			      (u64)lseek(fd, 0, SEEK_CUR), err);
-	}
+	return lseek(pps->gossip_store_fd, 0, SEEK_CUR)
+		- (pps->gsbuf->len - pps->gsbuf->off);
+}
 
-	/* Shouldn't happen, but some filesystems are not as atomic as
-	 * they should be! */
-	status_unusual("gossip_store: short read %i of %zu @%"PRIu64,
-		       len, wanted, (u64)lseek(fd, 0, SEEK_CUR) - len);
-	lseek(fd, -len, SEEK_CUR);
+/* Make sure at least len bytes are buffered.  Returns false if the store
+ * doesn't have that many (yet: gossipd may be part-way through writing). */
+static bool gossip_store_fill(struct per_peer_state *pps, size_t len)
+{
+	struct gossip_store_buf *gsbuf = pps->gsbuf;
+
+	while (gsbuf->len - gsbuf->off < len) {
+		ssize_t r;
+
+		/* Move what's left to the front, and make room for the rest. */
+		memmove(gsbuf->buf, gsbuf->buf + gsbuf->off,
+			gsbuf->len - gsbuf->off);
+		gsbuf->len -= gsbuf->off;
+		gsbuf->off = 0;
+		if (tal_count(gsbuf->buf) < len)
+			tal_resize(&gsbuf->buf, len);
+
+		r = read(pps->gossip_store_fd, gsbuf->buf + gsbuf->len,
+			 tal_count(gsbuf->buf) - gsbuf->len);
+		if (r < 0)
+			status_failed(STATUS_FAIL_INTERNAL_ERROR,
+				      "gossip_store: failed read @%"PRIu64": %s",
+				      gossip_store_offset(pps),
+				      strerror(errno));
+		if (r == 0)
+			return false;
+		gsbuf->len += r;
+	}
+	return true;
 }
 
 u8 *gossip_store_next(const tal_t *ctx, struct per_peer_state *pps)
@@ -81,113 +107,118 @@ u8 *gossip_store_next(const tal_t *ctx, struct per_peer_state *pps)
 	if (!pps->gs)
 		return NULL;
 
+	if (!pps->gsbuf) {
+		pps->gsbuf = tal(pps, struct gossip_store_buf);
+		pps->gsbuf->buf = tal_arr(pps->gsbuf, u8,
+					  GOSSIP_STORE_READAHEAD);
+		pps->gsbuf->off = pps->gsbuf->len = 0;
+	}
+
 	while (!msg) {
+		struct gossip_store_buf *gsbuf = pps->gsbuf;
 		struct gossip_hdr hdr;
 		u32 msglen, checksum, timestamp;
-		int type, r;
-
-		r = read(pps->gossip_store_fd, &hdr, sizeof(hdr));
-		if (r != sizeof(hdr)) {
-			/* We expect a 0 read here at EOF */
-			if (r != 0)
-				undo_read(pps->gossip_store_fd, r, sizeof(hdr));
-			per_peer_state_reset_gossip_timer(pps);
-			return NULL;
-		}
+		const u8 *p, *cursor;
+		size_t max;
+		int type;
+
+		if (!gossip_store_fill(pps, sizeof(hdr)))
+			goto drained;
+		memcpy(&hdr, gsbuf->buf + gsbuf->off, sizeof(hdr));
+		msglen = be32_to_cpu(hdr.len);
 
 		/* Skip any deleted entries. */
-		if (be32_to_cpu(hdr.len) & GOSSIP_STORE_LEN_DELETED_BIT) {
-			/* Skip over it. */
-			lseek(pps->gossip_store_fd,
-			      be32_to_cpu(hdr.len) & ~GOSSIP_STORE_LEN_DELETED_BIT,
-			      SEEK_CUR);
+		if (msglen & GOSSIP_STORE_LEN_DELETED_BIT) {
+			size_t skip = sizeof(hdr)
+				+ (msglen & ~GOSSIP_STORE_LEN_DELETED_BIT);
+
+			if (gsbuf->len - gsbuf->off >= skip)
+				gsbuf->off += skip;
+			else {
+				/* No point reading it in: seek over the rest
+				 * (it's complete, or it wouldn't be deleted). */
+				lseek(pps->gossip_store_fd,
+				      skip - (gsbuf->len - gsbuf->off),
+				      SEEK_CUR);
+				gsbuf->off = gsbuf->len = 0;
+			}
 			continue;
 		}
 
-		msglen = be32_to_cpu(hdr.len);
+		if (!gossip_store_fill(pps, sizeof(hdr) + msglen))
+			goto drained;
+		p = gsbuf->buf + gsbuf->off + sizeof(hdr);
 		checksum = be32_to_cpu(hdr.crc);
 		timestamp = be32_to_cpu(hdr.timestamp);
-		msg = tal_arr(ctx, u8, msglen);
-		r = read(pps->gossip_store_fd, msg, msglen);
-		if (r != msglen) {
-			undo_read(pps->gossip_store_fd, r, msglen);
-			per_peer_state_reset_gossip_timer(pps);
-			return NULL;
+
+		/* Ignore gossipd internal messages. */
+		cursor = p;
+		max = msglen;
+		type = fromwire_u16(&cursor, &max);
+		if (!cursor
+		    || (type != WIRE_CHANNEL_ANNOUNCEMENT
+			&& type != WIRE_CHANNEL_UPDATE
+			&& type != WIRE_NODE_ANNOUNCEMENT)
+		    || !timestamp_filter(pps, timestamp)) {
+			gsbuf->off += sizeof(hdr) + msglen;
+			continue;
 		}
 
-		if (checksum != crc32c(be32_to_cpu(hdr.timestamp), msg, msglen))
+		if (checksum != crc32c(timestamp, p, msglen))
 			status_failed(STATUS_FAIL_INTERNAL_ERROR,
 				      "gossip_store: bad checksum offset %"
-				      PRIi64": %s",
-				      (s64)lseek(pps->gossip_store_fd,
-						 0, SEEK_CUR) - msglen,
-				      tal_hex(tmpctx, msg));
+				      PRIu64": %s",
+				      gossip_store_offset(pps),
+				      tal_hexstr(tmpctx, p, msglen));
 
-		/* Don't send back gossip they sent to us! */
-		if (gossip_rcvd_filter_del(pps->grf, msg)) {
-			msg = tal_free(msg);
-			continue;
-		}
+		msg = tal_dup_arr(ctx, u8, p, msglen, 0);
+		gsbuf->off += sizeof(hdr) + msglen;
 
-		/* Ignore gossipd internal messages. */
-		type = fromwire_peektype(msg);
-		if (type != WIRE_CHANNEL_ANNOUNCEMENT
-		    && type != WIRE_CHANNEL_UPDATE
-		    && type != WIRE_NODE_ANNOUNCEMENT)
-			msg = tal_free(msg);
-		else if (!timestamp_filter(pps, timestamp))
+		/* Don't send back gossip they sent to us! */
+		if (gossip_rcvd_filter_del(pps->grf, msg))
 			msg = tal_free(msg);
 	}
 
 	return msg;
+
+drained:
+	/* Leave the fd at any half-written record, and don't hold onto the
+	 * buffer while we wait for the next gossip flush. */
+	per_peer_state_unread_gossip_store(pps);
+	pps->gsbuf = tal_free(pps->gsbuf);
+	per_peer_state_reset_gossip_timer(pps);
+	return NULL;
 }
 
-/* newfd is at offset 1.  We need to adjust it to similar offset as our
- * current one. */
+/* newfd is at offset 1.  gossipd told us where some records went in the new
+ * store: we go to the last of those we've reached.  If we were right at one
+ * (eg. the old end, which is common), there's nothing to resend. */
 void gossip_store_switch_fd(struct per_peer_state *pps,
-			    int newfd, u64 offset_shorter)
+			    int newfd,
+			    const u64 *old_offsets, const u64 *new_offsets)
 {
-	u64 cur = lseek(pps->gossip_store_fd, SEEK_CUR, 0);
-
-	/* If we're already at end (common), we know where to go in new one. */
-	if (cur == lseek(pps->gossip_store_fd, SEEK_END, 0)) {
-		status_debug("gossip_store at end, new fd moved to %"PRIu64,
-			     cur - offset_shorter);
-		assert(cur > offset_shorter);
-		lseek(newfd, cur - offset_shorter, SEEK_SET);
-	} else if (cur > offset_shorter) {
-		/* We're part way through.  Worst case, we should move back by
-		 * offset_shorter (that's how much the *end* moved), but in
-		 * practice we'll probably end up retransmitting some stuff */
-		u64 target = cur - offset_shorter;
-		size_t num = 0;
-
-		status_debug("gossip_store new fd moving back %"PRIu64
-			     " to %"PRIu64,
-			     cur, target);
-		cur = 1;
-		while (cur < target) {
-			u32 msglen;
-			struct gossip_hdr hdr;
-
-			if (read(newfd, &hdr, sizeof(hdr)) != sizeof(hdr))
-				status_failed(STATUS_FAIL_INTERNAL_ERROR,
-					      "gossip_store: "
-					      "can't read hdr offset %"PRIu64
-					      " in new store target %"PRIu64,
-					      cur, target);
-			/* Skip over it. */
-			msglen = (be32_to_cpu(hdr.len)
-				  & ~GOSSIP_STORE_LEN_DELETED_BIT);
-			cur = lseek(newfd, msglen, SEEK_CUR);
-			num++;
+	u64 cur, target = 1;
+	size_t i;
+
+	/* Where we're really up to in the old one. */
+	per_peer_state_unread_gossip_store(pps);
+	cur = lseek(pps->gossip_store_fd, 0, SEEK_CUR);
+
+	for (i = tal_count(old_offsets); i > 0; i--) {
+		if (old_offsets[i-1] <= cur) {
+			target = new_offsets[i-1];
+			break;
 		}
-		status_debug("gossip_store: skipped %zu records to %"PRIu64,
-			     num, cur);
-	} else
-		status_debug("gossip_store new fd moving back %"PRIu64
-			     " to start (offset_shorter=%"PRIu64")",
-			     cur, offset_shorter);
+	}
+
+	status_debug("gossip_store new fd moving from %"PRIu64" to %"PRIu64
+		     " (resending %"PRIu64" bytes)",
+		     cur, target, i ? cur - old_offsets[i-1] : cur - 1);
+	if (lseek(newfd, target, SEEK_SET) != target)
+		status_failed(STATUS_FAIL_INTERNAL_ERROR,
+			      "gossip_store: can't seek to %"PRIu64
+			      " in new store: %s",
+			      target, strerror(errno));
 
 	close(pps->gossip_store_fd);
 	pps->gossip_store_fd = newfd;
@@ -36,9 +36,11 @@ u8 *gossip_store_next(const tal_t *ctx, struct per_peer_state *pps);
 
 /**
  * Switches the gossip store fd, and gets to the correct offset.
+ * @old_offsets/@new_offsets: where records in the old store are in @newfd.
  */
 void gossip_store_switch_fd(struct per_peer_state *pps,
-			    int newfd, u64 offset_shorter);
+			    int newfd,
+			    const u64 *old_offsets, const u64 *new_offsets);
 
 /**
  * Sets up the tiemstamp filter once they told us to set it.(
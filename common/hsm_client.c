@@ -0,0 +1,103 @@
+#include <ccan/list/list.h>
+#include <common/daemon_conn.h>
+#include <common/hsm_client.h>
+#include <common/memleak.h>
+#include <common/status.h>
+#include <common/utils.h>
+
+struct hsm_client {
+	struct daemon_conn *dc;
+
+	/* Requests we've sent, in order, awaiting replies. */
+	struct list_head reqs;
+	size_t num_pending;
+};
+
+struct hsm_client_req {
+	struct list_node list;
+	struct hsm_client *hsmc;
+
+	void (*cb)(const u8 *reply, void *arg);
+	void *arg;
+
+	/* If non-NULL, this is here to disable cb */
+	void *disabler;
+};
+
+static void destroy_hsm_client_req(struct hsm_client_req *req)
+{
+	list_del(&req->list);
+	req->hsmc->num_pending--;
+	/* Don't disable once we're freed! */
+	if (req->disabler)
+		tal_free(req->disabler);
+}
+
+static void disable_cb(void *disabler UNUSED, struct hsm_client_req *req)
+{
+	req->cb = NULL;
+	req->disabler = NULL;
+}
+
+static struct io_plan *hsm_reply(struct io_conn *conn, const u8 *msg,
+				 struct hsm_client *hsmc)
+{
+	struct hsm_client_req *req;
+
+	/* hsmd handles requests in order, so this is the one it answered. */
+	req = list_top(&hsmc->reqs, struct hsm_client_req, list);
+	if (!req)
+		status_failed(STATUS_FAIL_HSM_IO,
+			      "Unexpected reply from hsmd: %s",
+			      tal_hex(tmpctx, msg));
+
+	if (req->cb)
+		req->cb(msg, req->arg);
+	tal_free(req);
+	return daemon_conn_read_next(conn, hsmc->dc);
+}
+
+static void hsmd_gone(struct daemon_conn *dc UNUSED)
+{
+	status_failed(STATUS_FAIL_HSM_IO, "hsmd hung up");
+}
+
+struct hsm_client *hsm_client_new(const tal_t *ctx, int fd)
+{
+	struct hsm_client *hsmc = tal(ctx, struct hsm_client);
+
+	list_head_init(&hsmc->reqs);
+	hsmc->num_pending = 0;
+	hsmc->dc = daemon_conn_new(hsmc, fd, hsm_reply, NULL, hsmc);
+	tal_add_destructor(hsmc->dc, hsmd_gone);
+	return hsmc;
+}
+
+void hsm_req_(const tal_t *ctx, struct hsm_client *hsmc, const u8 *msg TAKES,
+	      void (*cb)(const u8 *reply, void *arg), void *arg)
+{
+	struct hsm_client_req *req = tal(hsmc, struct hsm_client_req);
+
+	req->hsmc = hsmc;
+	req->cb = cb;
+	req->arg = arg;
+
+	/* We don't allocate req off ctx, because we still have to consume
+	 * the reply if ctx is freed between request and reply. */
+	if (ctx) {
+		req->disabler = notleak(tal(ctx, char));
+		tal_add_destructor2(req->disabler, disable_cb, req);
+	} else
+		req->disabler = NULL;
+
+	list_add_tail(&hsmc->reqs, &req->list);
+	hsmc->num_pending++;
+	tal_add_destructor(req, destroy_hsm_client_req);
+
+	daemon_conn_send(hsmc->dc, msg);
+}
+
+size_t hsm_client_pending(const struct hsm_client *hsmc)
+{
+	return hsmc->num_pending;
+}
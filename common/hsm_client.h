@@ -0,0 +1,47 @@
+#ifndef LIGHTNING_COMMON_HSM_CLIENT_H
+#define LIGHTNING_COMMON_HSM_CLIENT_H
+#include "config.h"
+#include <ccan/short_types/short_types.h>
+#include <ccan/take/take.h>
+#include <ccan/tal/tal.h>
+#include <ccan/typesafe_cb/typesafe_cb.h>
+
+struct hsm_client;
+
+/**
+ * hsm_client_new - wrap our fd to hsmd for asynchronous requests.
+ * @ctx: context to allocate from.
+ * @fd: our connection to hsmd (which must not be used synchronously).
+ *
+ * If hsmd hangs up, we status_failed().
+ */
+struct hsm_client *hsm_client_new(const tal_t *ctx, int fd);
+
+/**
+ * hsm_req - send a request to hsmd, and call @cb with the reply.
+ * @ctx: if this is freed before the reply, @cb isn't called.
+ * @hsmc: the hsm_client.
+ * @msg: the request.
+ * @cb: the callback: the reply is only valid until it returns.
+ * @arg: argument for @cb.
+ *
+ * This doesn't wait, so any number of requests can be in flight at once:
+ * hsmd handles each client's requests in order, so replies are matched to
+ * requests by order, too.
+ */
+#define hsm_req(ctx, hsmc, msg, cb, arg)				\
+	hsm_req_((ctx), (hsmc), (msg),					\
+		 typesafe_cb_preargs(void, void *, (cb), (arg),		\
+				     const u8 *),			\
+		 (arg))
+
+void hsm_req_(const tal_t *ctx, struct hsm_client *hsmc, const u8 *msg TAKES,
+	      void (*cb)(const u8 *reply, void *arg), void *arg);
+
+/**
+ * hsm_client_pending - how many requests are awaiting replies?
+ * @hsmc: the hsm_client.
+ */
+size_t hsm_client_pending(const struct hsm_client *hsmc);
+
+#endif /* LIGHTNING_COMMON_HSM_CLIENT_H */
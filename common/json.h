@@ -65,6 +65,20 @@ const jsmntok_t *json_get_arr(const jsmntok_t tok[], size_t index);
 jsmntok_t *json_parse_input(const tal_t *ctx,
 			    const char *input, int len, bool *valid);
 
+/* Allocate a starter array of tokens for json_parse_input_incr. */
+jsmntok_t *toks_alloc(const tal_t *ctx);
+
+/* Reuse a token array for the next json_parse_input_incr (after jsmn_init). */
+void toks_reset(jsmntok_t *toks);
+
+/* Continue parsing input, of which parser has already seen a prefix: returns
+ * false if input is invalid.  Otherwise sets *complete once the first root
+ * element is finished, and *toks is cut to cover just that element.  input
+ * may be moved or reallocated between calls, as long as the bytes already
+ * parsed don't change. */
+bool json_parse_input_incr(jsmn_parser *parser, jsmntok_t **toks,
+			   const char *input, int len, bool *complete);
+
 /* Convert a jsmntype_t enum to a human readable string. */
 const char *jsmntype_to_string(jsmntype_t t);
 
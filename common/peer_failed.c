@@ -5,18 +5,20 @@
 #include <common/gen_status_wire.h>
 #include <common/peer_billboard.h>
 #include <common/peer_failed.h>
+#include <common/per_peer_state.h>
 #include <common/status.h>
 #include <common/wire_error.h>
 #include <stdarg.h>
 
 /* Fatal error here, return peer control to lightningd */
 static void NORETURN
-peer_fatal_continue(const u8 *msg TAKES, const struct per_peer_state *pps)
+peer_fatal_continue(const u8 *msg TAKES, struct per_peer_state *pps)
 {
  	int reason = fromwire_peektype(msg);
  	breakpoint();
  	status_send(msg);
 
+	per_peer_state_unread_gossip_store(pps);
 	status_send_fd(pps->peer_fd);
 	status_send_fd(pps->gossip_fd);
 	status_send_fd(pps->gossip_store_fd);
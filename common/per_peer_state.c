@@ -23,6 +23,7 @@ struct per_peer_state *new_per_peer_state(const tal_t *ctx,
 	pps->cs = *cs;
 	pps->gs = NULL;
 	pps->peer_fd = pps->gossip_fd = pps->gossip_store_fd = -1;
+	pps->gsbuf = NULL;
 	pps->grf = new_gossip_rcvd_filter(pps);
 	tal_add_destructor(pps, destroy_per_peer_state);
 	return pps;
@@ -75,11 +76,22 @@ void towire_per_peer_state(u8 **pptr, const struct per_peer_state *pps)
 	/* We don't pass the gossip_rcvd_filter: it's merely an optimization */
 }
 
-void per_peer_state_fdpass_send(int fd, const struct per_peer_state *pps)
+void per_peer_state_unread_gossip_store(struct per_peer_state *pps)
+{
+	if (!pps->gsbuf || pps->gsbuf->off == pps->gsbuf->len)
+		return;
+
+	lseek(pps->gossip_store_fd,
+	      -(off_t)(pps->gsbuf->len - pps->gsbuf->off), SEEK_CUR);
+	pps->gsbuf->off = pps->gsbuf->len = 0;
+}
+
+void per_peer_state_fdpass_send(int fd, struct per_peer_state *pps)
 {
 	assert(pps->peer_fd != -1);
 	assert(pps->gossip_fd != -1);
 	assert(pps->gossip_store_fd != -1);
+	per_peer_state_unread_gossip_store(pps);
 	fdpass_send(fd, pps->peer_fd);
 	fdpass_send(fd, pps->gossip_fd);
 	fdpass_send(fd, pps->gossip_store_fd);
@@ -13,6 +13,14 @@ struct gossip_state {
 	u32 timestamp_min, timestamp_max;
 };
 
+/* gossip_store_next() reads the gossip_store in big chunks: this is what
+ * it has read from gossip_store_fd, but not used yet. */
+struct gossip_store_buf {
+	u8 *buf;
+	/* buf[off] up to buf[len] is still to be used. */
+	size_t off, len;
+};
+
 /* Things we hand between daemons to talk to peers. */
 struct per_peer_state {
 	/* Cryptographic state needed to exchange messages with the peer (as
@@ -28,6 +36,8 @@ struct per_peer_state {
 #endif /* DEVELOPER */
 	/* If not -1, closed on freeing */
 	int peer_fd, gossip_fd, gossip_store_fd;
+	/* NULL if we're not part-way through the gossip_store */
+	struct gossip_store_buf *gsbuf;
 };
 
 /* Allocate a new per-peer state and add destructor to close fds if set;
@@ -42,10 +52,14 @@ void per_peer_state_set_fds(struct per_peer_state *pps,
 /* Array version of above: tal_count(fds) must be 3 */
 void per_peer_state_set_fds_arr(struct per_peer_state *pps, const int *fds);
 
+/* Seek gossip_store_fd back over anything we read ahead: the next daemon
+ * which gets the fd continues from its offset. */
+void per_peer_state_unread_gossip_store(struct per_peer_state *pps);
+
 /* These routines do *part* of the work: you need to per_peer_state_fdpass_send
  * or receive the three fds afterwards! */
 void towire_per_peer_state(u8 **pptr, const struct per_peer_state *pps);
-void per_peer_state_fdpass_send(int fd, const struct per_peer_state *pps);
+void per_peer_state_fdpass_send(int fd, struct per_peer_state *pps);
 
 struct per_peer_state *fromwire_per_peer_state(const tal_t *ctx,
 					       const u8 **cursor, size_t *max);
@@ -107,11 +107,12 @@ bool is_wrong_channel(const u8 *msg, const struct channel_id *expected,
 void handle_gossip_msg(struct per_peer_state *pps, const u8 *msg TAKES)
 {
 	u8 *gossip;
-	u64 offset_shorter;
+	u64 *old_offsets, *new_offsets;
 
-	if (fromwire_gossipd_new_store_fd(msg, &offset_shorter)) {
+	if (fromwire_gossipd_new_store_fd(tmpctx, msg,
+					  &old_offsets, &new_offsets)) {
 		gossip_store_switch_fd(pps, fdpass_recv(pps->gossip_fd),
-				       offset_shorter);
+				       old_offsets, new_offsets);
 		goto out;
 	} else
 		/* It's a raw gossip msg: this copies or takes() */
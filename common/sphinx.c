@@ -2,7 +2,6 @@
 
 #include <ccan/array_size/array_size.h>
 #include <ccan/crypto/ripemd160/ripemd160.h>
-#include <ccan/crypto/sha256/sha256.h>
 #include <ccan/mem/mem.h>
 #include <common/node_id.h>
 #include <common/sphinx.h>
@@ -184,6 +183,20 @@ u8 *serialize_onionpacket(
 	return dst;
 }
 
+void sha256_onionpacket(struct sha256 *sha, const struct onionpacket *m)
+{
+	struct sha256_ctx shactx = SHA256_INIT;
+	u8 der[PUBKEY_CMPR_LEN];
+
+	/* Same fields, in the same order, as serialize_onionpacket. */
+	pubkey_to_der(der, &m->ephemeralkey);
+	sha256_update(&shactx, &m->version, 1);
+	sha256_update(&shactx, der, sizeof(der));
+	sha256_update(&shactx, m->routinginfo, ROUTING_INFO_SIZE);
+	sha256_update(&shactx, m->mac, sizeof(m->mac));
+	sha256_done(&shactx, sha);
+}
+
 struct onionpacket *parse_onionpacket(const tal_t *ctx,
 				      const void *src,
 				      const size_t srclen,
@@ -5,6 +5,7 @@
 #include "bitcoin/privkey.h"
 #include "bitcoin/pubkey.h"
 
+#include <ccan/crypto/sha256/sha256.h>
 #include <ccan/short_types/short_types.h>
 #include <ccan/tal/tal.h>
 #include <secp256k1.h>
@@ -146,6 +147,16 @@ u8 *serialize_onionpacket(
 	const tal_t *ctx,
 	const struct onionpacket *packet);
 
+/**
+ * sha256_onionpacket - SHA256 of an onionpacket, as serialized.
+ *
+ * @sha: the hash
+ * @packet: the packet to hash
+ *
+ * Equivalent to sha256() of serialize_onionpacket(), without the copy.
+ */
+void sha256_onionpacket(struct sha256 *sha, const struct onionpacket *packet);
+
 /**
  * parse_onionpacket - Parse an onionpacket from a buffer.
  *
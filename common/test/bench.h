@@ -0,0 +1,107 @@
+#ifndef LIGHTNING_COMMON_TEST_BENCH_H
+#define LIGHTNING_COMMON_TEST_BENCH_H
+/* Scaffolding shared by the run-bench-* tests.
+ *
+ * make check-units runs these like any other unit test: with no arguments,
+ * and under valgrind.  So with no arguments each is a smoke test of a few
+ * dozen iterations; give it sizes on the command line to get numbers worth
+ * reading, eg:
+ *
+ *	lightningd/test/run-bench-peer-lookup 5000 100000
+ */
+#include "config.h"
+#include <ccan/err/err.h>
+#include <ccan/short_types/short_types.h>
+#include <ccan/time/time.h>
+#include <ccan/typesafe_cb/typesafe_cb.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/* Set each size_t to the next argument, if there is one: exits with usage
+ * if an argument isn't a number, or there are too many of them. */
+#define bench_sizes(argc, argv, usage, ...)				\
+	bench_sizes_((argc), (argv), (usage), __VA_ARGS__, NULL)
+
+static inline void bench_sizes_(int argc, char *argv[],
+				const char *usage, ...)
+{
+	va_list ap;
+	size_t *size;
+	int i = 1;
+
+	va_start(ap, usage);
+	while (i < argc && (size = va_arg(ap, size_t *)) != NULL) {
+		char *end;
+
+		*size = strtoul(argv[i], &end, 10);
+		if (end == argv[i] || *end)
+			errx(1, "Usage: %s %s", argv[0], usage);
+		i++;
+	}
+	va_end(ap);
+
+	if (i < argc)
+		errx(1, "Usage: %s %s", argv[0], usage);
+}
+
+static inline u64 bench_usec_since(struct timemono start)
+{
+	return time_to_usec(timemono_since(start));
+}
+
+/* CPU time used by this thread, so we don't count helper threads. */
+static inline struct timespec bench_cpu_now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+		err(1, "clock_gettime");
+	return ts;
+}
+
+static inline u64 bench_cpu_usec_since(struct timespec start)
+{
+	struct timespec now = bench_cpu_now();
+
+	return (now.tv_sec - start.tv_sec) * 1000000
+		+ (now.tv_nsec - start.tv_nsec) / 1000;
+}
+
+/* Rate per second, for when the whole thing took under a microsecond. */
+static inline double bench_per_sec(size_t num, u64 usec)
+{
+	return num * 1000000.0 / (usec ? usec : 1);
+}
+
+/* Run child(fd, arg) in a new process, talking to us over a socketpair:
+ * we get the other end in *fd.  The child exits when child() returns. */
+#define bench_fork(fd, child, arg)					\
+	bench_fork_((fd),						\
+		    typesafe_cb_preargs(void, void *, (child), (arg), int), \
+		    (arg))
+
+static inline pid_t bench_fork_(int *fd,
+				void (*child)(int fd, void *arg), void *arg)
+{
+	int fds[2];
+	pid_t pid;
+
+	if (socketpair(AF_LOCAL, SOCK_STREAM, 0, fds) != 0)
+		err(1, "socketpair");
+
+	pid = fork();
+	if (pid < 0)
+		err(1, "fork");
+	if (pid == 0) {
+		close(fds[0]);
+		child(fds[1], arg);
+		exit(0);
+	}
+	close(fds[1]);
+	*fd = fds[0];
+	return pid;
+}
+#endif /* LIGHTNING_COMMON_TEST_BENCH_H */
@@ -0,0 +1,161 @@
+/* How much does each io_loop() wakeup cost with many idle connections?
+ *
+ * Usage: run-bench-io_loop [conns [wakeups]]
+ *
+ * Every idle connection is waiting to read, like a quiet peer; one pair of
+ * connections ping-pongs a byte to keep waking the loop, which goes through
+ * daemon_poll() just as our daemons do.  Compare builds configured with
+ * --enable-epoll and --disable-epoll. */
+#include "../daemon.c"
+#include <assert.h>
+#include <ccan/err/err.h>
+#include <ccan/io/io.h>
+#include <ccan/time/time.h>
+#include <common/test/bench.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <wire/wire.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for fromwire_fail */
+const void *fromwire_fail(const u8 **cursor UNNEEDED, size_t *max UNNEEDED)
+{ fprintf(stderr, "fromwire_fail called!\n"); abort(); }
+/* Generated stub for memleak_init */
+void memleak_init(void)
+{ fprintf(stderr, "memleak_init called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+static size_t num_polls;
+
+static int bench_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+	num_polls++;
+	return daemon_poll(fds, nfds, timeout);
+}
+
+static struct io_plan *idle_read(struct io_conn *conn, char *buf)
+{
+	/* Nobody ever writes to these. */
+	return io_read(conn, buf, 1, io_never, NULL);
+}
+
+struct pinger {
+	char c, echo_c;
+	size_t rounds;
+	/* Bytes which came back, and which the echoer saw. */
+	size_t received, echoed;
+};
+
+static struct io_plan *ping(struct io_conn *conn, struct pinger *p);
+
+static struct io_plan *ping_done(struct io_conn *conn, struct pinger *p)
+{
+	assert(p->c == 'x');
+	p->received++;
+	if (--p->rounds == 0) {
+		io_break(p);
+		return io_wait(conn, p, io_never, NULL);
+	}
+	return ping(conn, p);
+}
+
+static struct io_plan *ping_read(struct io_conn *conn, struct pinger *p)
+{
+	return io_read(conn, &p->c, 1, ping_done, p);
+}
+
+static struct io_plan *ping(struct io_conn *conn, struct pinger *p)
+{
+	return io_write(conn, &p->c, 1, ping_read, p);
+}
+
+static struct io_plan *echo(struct io_conn *conn, struct pinger *p);
+
+static struct io_plan *echo_write(struct io_conn *conn, struct pinger *p)
+{
+	p->echoed++;
+	return io_write(conn, &p->echo_c, 1, echo, p);
+}
+
+static struct io_plan *echo(struct io_conn *conn, struct pinger *p)
+{
+	return io_read(conn, &p->echo_c, 1, echo_write, p);
+}
+
+static void socketpair_or_die(int fds[2])
+{
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+		err(1, "socketpair");
+}
+
+int main(int argc, char *argv[])
+{
+	const tal_t *ctx;
+	struct pinger *p;
+	struct rlimit lim;
+	struct timemono start;
+	struct timespec cpu_start, cpu_end;
+	size_t num_conns = 20, num_wakeups = 100, rounds;
+	char *idlebuf;
+	int fds[2];
+	u64 cpu_usec, wall_usec;
+
+	/* Try 1000 10000. */
+	bench_sizes(argc, argv, "[conns [wakeups]]", &num_conns, &num_wakeups);
+
+	setup_locale();
+	setup_tmpctx();
+	io_poll_override(bench_poll);
+
+	/* Two fds per pair of idle connections, plus a few. */
+	if (getrlimit(RLIMIT_NOFILE, &lim) == 0
+	    && lim.rlim_cur < num_conns + 16) {
+		lim.rlim_cur = lim.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &lim);
+	}
+
+	ctx = tal(NULL, char);
+	idlebuf = tal_arr(ctx, char, 1);
+	for (size_t i = 0; i < num_conns; i += 2) {
+		socketpair_or_die(fds);
+		io_new_conn(ctx, fds[0], idle_read, idlebuf);
+		io_new_conn(ctx, fds[1], idle_read, idlebuf);
+	}
+
+	p = tal(ctx, struct pinger);
+	p->c = 'x';
+	/* Each round trip wakes us to write, read, write back and read back. */
+	rounds = p->rounds = num_wakeups / 4 + 1;
+	p->received = p->echoed = 0;
+	socketpair_or_die(fds);
+	io_new_conn(ctx, fds[0], ping, p);
+	io_new_conn(ctx, fds[1], echo, p);
+
+	start = time_mono();
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+	if (io_loop(NULL, NULL) != p)
+		errx(1, "io_loop exited early");
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+	wall_usec = bench_usec_since(start);
+
+	/* Every byte made it there and back, and each of those reads needed
+	 * the loop to wake (an idle connection waking would have aborted in
+	 * io_never). */
+	assert(p->echoed == rounds);
+	assert(p->received == rounds);
+	assert(num_polls >= 2 * rounds);
+
+	cpu_usec = (cpu_end.tv_sec - cpu_start.tv_sec) * 1000000
+		+ (cpu_end.tv_nsec - cpu_start.tv_nsec) / 1000;
+	printf("%s: %zu conns, %zu wakeups: %"PRIu64" usec cpu"
+	       " (%.2f usec/wakeup), %"PRIu64" usec wall\n",
+	       IO_EPOLL ? "epoll" : "poll",
+	       num_conns, num_polls, cpu_usec,
+	       (double)cpu_usec / num_polls, wall_usec);
+
+	tal_free(ctx);
+	tal_free(tmpctx);
+	return 0;
+}
@@ -0,0 +1,255 @@
+#include "../gossip_store.c"
+#include "../per_peer_state.c"
+#include "../../wire/fromwire.c"
+#include "../../wire/towire.c"
+#include <ccan/array_size/array_size.h>
+#include <ccan/read_write_all/read_write_all.h>
+#include <common/utils.h>
+#include <fcntl.h>
+#include <stdio.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for bigsize_get */
+size_t bigsize_get(const u8 *p UNNEEDED, size_t max UNNEEDED, bigsize_t *val UNNEEDED)
+{ fprintf(stderr, "bigsize_get called!\n"); abort(); }
+/* Generated stub for bigsize_put */
+size_t bigsize_put(u8 buf[BIGSIZE_MAX_LEN] UNNEEDED, bigsize_t v UNNEEDED)
+{ fprintf(stderr, "bigsize_put called!\n"); abort(); }
+/* Generated stub for fromwire_crypto_state */
+void fromwire_crypto_state(const u8 **ptr UNNEEDED, size_t *max UNNEEDED, struct crypto_state *cs UNNEEDED)
+{ fprintf(stderr, "fromwire_crypto_state called!\n"); abort(); }
+/* Generated stub for towire_crypto_state */
+void towire_crypto_state(u8 **pptr UNNEEDED, const struct crypto_state *cs UNNEEDED)
+{ fprintf(stderr, "towire_crypto_state called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+/* We don't test the filter here: say we never got anything from them. */
+bool gossip_rcvd_filter_del(struct gossip_rcvd_filter *f UNNEEDED,
+			    const u8 *msg UNNEEDED)
+{
+	return false;
+}
+
+void gossip_rcvd_filter_age(struct gossip_rcvd_filter *f UNNEEDED)
+{
+}
+
+struct gossip_rcvd_filter *new_gossip_rcvd_filter(const tal_t *ctx)
+{
+	return (struct gossip_rcvd_filter *)tal(ctx, char);
+}
+
+void status_failed(enum status_failreason code UNNEEDED,
+		   const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	fprintf(stderr, "\n");
+	va_end(ap);
+	abort();
+}
+
+void status_fmt(enum log_level level UNNEEDED, const char *fmt UNNEEDED, ...)
+{
+}
+
+/* Gossip-looking message of len bytes, with n in it so we can tell them
+ * apart. */
+static u8 *mkmsg(const tal_t *ctx, enum wire_type type, size_t len, u32 n)
+{
+	u8 *msg = tal_arr(ctx, u8, 0);
+
+	towire_u16(&msg, type);
+	towire_u32(&msg, n);
+	while (tal_count(msg) < len)
+		towire_u8(&msg, n);
+	return msg;
+}
+
+static u32 msg_n(const u8 *msg)
+{
+	const u8 *cursor = msg + 2;
+	size_t max = tal_count(msg) - 2;
+
+	return fromwire_u32(&cursor, &max);
+}
+
+static void append(int fd, const u8 *msg, u32 timestamp, bool deleted)
+{
+	struct gossip_hdr hdr;
+
+	hdr.len = cpu_to_be32(tal_count(msg)
+			      | (deleted ? GOSSIP_STORE_LEN_DELETED_BIT : 0));
+	hdr.crc = cpu_to_be32(crc32c(timestamp, msg, tal_count(msg)));
+	hdr.timestamp = cpu_to_be32(timestamp);
+	if (!write_all(fd, &hdr, sizeof(hdr))
+	    || !write_all(fd, msg, tal_count(msg)))
+		abort();
+}
+
+int main(void)
+{
+	char fname[] = "/tmp/run-gossip_store.XXXXXX";
+	char nfname[] = "/tmp/run-gossip_store-new.XXXXXX";
+	struct per_peer_state *pps;
+	struct crypto_state cs;
+	int wfd, nfd, n;
+	u64 old_off[20], new_off[20], *old_offsets, *new_offsets;
+	u8 *msg, *partial;
+	off_t partial_off;
+	const u8 version = GOSSIP_STORE_VERSION;
+
+	setup_locale();
+	setup_tmpctx();
+
+	wfd = mkstemp(fname);
+	assert(wfd >= 0);
+	assert(write(wfd, &version, 1) == 1);
+
+	/* Enough to go through the readahead buffer a few times, with
+	 * things we should skip mixed in.  Timestamps are n+1, as we filter
+	 * out 0. */
+	for (n = 0; n < 5000; n++) {
+		if (n < ARRAY_SIZE(old_off))
+			old_off[n] = lseek(wfd, 0, SEEK_CUR);
+		switch (n % 5) {
+		case 0:
+			append(wfd, mkmsg(tmpctx, WIRE_CHANNEL_UPDATE, 136, n),
+			       n + 1, false);
+			break;
+		case 1:
+			/* Deleted */
+			append(wfd, mkmsg(tmpctx, WIRE_CHANNEL_UPDATE, 136, n),
+			       n + 1, true);
+			break;
+		case 2:
+			/* Not gossip (like gossipd's internal ones) */
+			append(wfd, mkmsg(tmpctx, WIRE_PING, 10, n), n + 1,
+			       false);
+			break;
+		case 3:
+			/* Too old for the filter */
+			append(wfd, mkmsg(tmpctx, WIRE_NODE_ANNOUNCEMENT, 200, n),
+			       0, false);
+			break;
+		case 4:
+			append(wfd, mkmsg(tmpctx, WIRE_CHANNEL_ANNOUNCEMENT,
+					  430, n), n + 1, false);
+			break;
+		}
+	}
+	/* Bigger than the whole buffer, and a deleted one too. */
+	append(wfd, mkmsg(tmpctx, WIRE_NODE_ANNOUNCEMENT, 100000, 5000),
+	       5000, true);
+	append(wfd, mkmsg(tmpctx, WIRE_NODE_ANNOUNCEMENT, 100000, 5001),
+	       5001, false);
+
+	memset(&cs, 0, sizeof(cs));
+	pps = new_per_peer_state(tmpctx, &cs);
+#if DEVELOPER
+	pps->dev_gossip_broadcast_msec = 60000;
+#endif
+	/* Not dup(): that would share wfd's offset. */
+	pps->gossip_store_fd = open(fname, O_RDONLY);
+	assert(pps->gossip_store_fd >= 0);
+	unlink(fname);
+
+	/* Nothing until they ask. */
+	assert(!gossip_store_next(tmpctx, pps));
+	gossip_setup_timestamp_filter(pps, 1, UINT32_MAX - 1);
+
+	for (n = 0; n < 5000; n++) {
+		if (n % 5 != 0 && n % 5 != 4)
+			continue;
+		msg = gossip_store_next(tmpctx, pps);
+		assert(msg);
+		assert(msg_n(msg) == n);
+		assert(tal_count(msg) == (n % 5 == 0 ? 136 : 430));
+		tal_free(msg);
+
+		/* Handing off the fd halfway leaves it where we're up to:
+		 * whoever gets it next continues with the next one. */
+		if (n == 2500) {
+			per_peer_state_unread_gossip_store(pps);
+			assert(pps->gsbuf->off == pps->gsbuf->len);
+		}
+	}
+	msg = gossip_store_next(tmpctx, pps);
+	assert(tal_count(msg) == 100000);
+	assert(msg_n(msg) == 5001);
+	assert(!gossip_store_next(tmpctx, pps));
+	assert(!pps->gsbuf);
+
+	/* gossipd is half-way through writing one. */
+	partial_off = lseek(wfd, 0, SEEK_END);
+	partial = mkmsg(tmpctx, WIRE_CHANNEL_UPDATE, 136, 6000);
+	append(wfd, partial, 6000, false);
+	assert(ftruncate(wfd, partial_off + sizeof(struct gossip_hdr) + 50)
+	       == 0);
+	assert(!gossip_store_next(tmpctx, pps));
+	assert(lseek(pps->gossip_store_fd, 0, SEEK_CUR) == partial_off);
+
+	/* Now it's finished. */
+	lseek(wfd, partial_off, SEEK_SET);
+	append(wfd, partial, 6000, false);
+	msg = gossip_store_next(tmpctx, pps);
+	assert(msg_n(msg) == 6000);
+	assert(!gossip_store_next(tmpctx, pps));
+
+	/* Restarting the filter goes back to the start. */
+	gossip_setup_timestamp_filter(pps, 1, UINT32_MAX - 1);
+	msg = gossip_store_next(tmpctx, pps);
+	assert(msg_n(msg) == 0);
+
+	/* gossipd compacts it: only the ones we send are left. */
+	nfd = mkstemp(nfname);
+	assert(nfd >= 0);
+	assert(write(nfd, &version, 1) == 1);
+	for (n = 0; n < 20; n++) {
+		if (n % 5 != 0 && n % 5 != 4)
+			continue;
+		new_off[n] = lseek(nfd, 0, SEEK_CUR);
+		append(nfd, mkmsg(tmpctx, n % 5 ? WIRE_CHANNEL_ANNOUNCEMENT
+				  : WIRE_CHANNEL_UPDATE,
+				  n % 5 ? 430 : 136, n),
+		       n + 1, false);
+	}
+
+	/* Read up to 14: the next one is 15. */
+	while (msg_n(msg) != 14)
+		msg = gossip_store_next(tmpctx, pps);
+
+	/* We're right where 15 was: nothing to resend. */
+	old_offsets = tal_arr(tmpctx, u64, 0);
+	new_offsets = tal_arr(tmpctx, u64, 0);
+	tal_arr_expand(&old_offsets, 1);
+	tal_arr_expand(&new_offsets, 1);
+	tal_arr_expand(&old_offsets, old_off[15]);
+	tal_arr_expand(&new_offsets, new_off[15]);
+	tal_arr_expand(&old_offsets, lseek(wfd, 0, SEEK_END));
+	tal_arr_expand(&new_offsets, lseek(nfd, 0, SEEK_END));
+	gossip_store_switch_fd(pps, open(nfname, O_RDONLY),
+			       old_offsets, new_offsets);
+	msg = gossip_store_next(tmpctx, pps);
+	assert(msg_n(msg) == 15);
+
+	/* Compacting again (to the same thing): we're past 15 now, so we go
+	 * back to it and resend. */
+	old_offsets[1] = new_offsets[1];
+	old_offsets[2] = new_offsets[2];
+	gossip_store_switch_fd(pps, open(nfname, O_RDONLY),
+			       old_offsets, new_offsets);
+	msg = gossip_store_next(tmpctx, pps);
+	assert(msg_n(msg) == 15);
+	msg = gossip_store_next(tmpctx, pps);
+	assert(msg_n(msg) == 19);
+	assert(!gossip_store_next(tmpctx, pps));
+
+	unlink(nfname);
+	close(nfd);
+	close(wfd);
+	tal_free(tmpctx);
+	return 0;
+}
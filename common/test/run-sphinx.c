@@ -1,4 +1,7 @@
 #include "../sphinx.c"
+#include "../../wire/fromwire.c"
+#include "../../wire/towire.c"
+#include <ccan/time/time.h>
 #include <secp256k1.h>
 #include <ccan/opt/opt.h>
 #include <ccan/short_types/short_types.h>
@@ -18,47 +21,6 @@ size_t bigsize_get(const u8 *p UNNEEDED, size_t max UNNEEDED, bigsize_t *val UNN
 /* Generated stub for bigsize_put */
 size_t bigsize_put(u8 buf[BIGSIZE_MAX_LEN] UNNEEDED, bigsize_t v UNNEEDED)
 { fprintf(stderr, "bigsize_put called!\n"); abort(); }
-/* Generated stub for fromwire */
-const u8 *fromwire(const u8 **cursor UNNEEDED, size_t *max UNNEEDED, void *copy UNNEEDED, size_t n UNNEEDED)
-{ fprintf(stderr, "fromwire called!\n"); abort(); }
-/* Generated stub for fromwire_amount_msat */
-struct amount_msat fromwire_amount_msat(const u8 **cursor UNNEEDED, size_t *max UNNEEDED)
-{ fprintf(stderr, "fromwire_amount_msat called!\n"); abort(); }
-/* Generated stub for fromwire_fail */
-const void *fromwire_fail(const u8 **cursor UNNEEDED, size_t *max UNNEEDED)
-{ fprintf(stderr, "fromwire_fail called!\n"); abort(); }
-/* Generated stub for fromwire_short_channel_id */
-void fromwire_short_channel_id(const u8 **cursor UNNEEDED, size_t *max UNNEEDED,
-			       struct short_channel_id *short_channel_id UNNEEDED)
-{ fprintf(stderr, "fromwire_short_channel_id called!\n"); abort(); }
-/* Generated stub for fromwire_u16 */
-u16 fromwire_u16(const u8 **cursor UNNEEDED, size_t *max UNNEEDED)
-{ fprintf(stderr, "fromwire_u16 called!\n"); abort(); }
-/* Generated stub for fromwire_u32 */
-u32 fromwire_u32(const u8 **cursor UNNEEDED, size_t *max UNNEEDED)
-{ fprintf(stderr, "fromwire_u32 called!\n"); abort(); }
-/* Generated stub for fromwire_u8 */
-u8 fromwire_u8(const u8 **cursor UNNEEDED, size_t *max UNNEEDED)
-{ fprintf(stderr, "fromwire_u8 called!\n"); abort(); }
-/* Generated stub for towire */
-void towire(u8 **pptr UNNEEDED, const void *data UNNEEDED, size_t len UNNEEDED)
-{ fprintf(stderr, "towire called!\n"); abort(); }
-/* Generated stub for towire_pad */
-void towire_pad(u8 **pptr UNNEEDED, size_t num UNNEEDED)
-{ fprintf(stderr, "towire_pad called!\n"); abort(); }
-/* Generated stub for towire_short_channel_id */
-void towire_short_channel_id(u8 **pptr UNNEEDED,
-			     const struct short_channel_id *short_channel_id UNNEEDED)
-{ fprintf(stderr, "towire_short_channel_id called!\n"); abort(); }
-/* Generated stub for towire_u16 */
-void towire_u16(u8 **pptr UNNEEDED, u16 v UNNEEDED)
-{ fprintf(stderr, "towire_u16 called!\n"); abort(); }
-/* Generated stub for towire_u32 */
-void towire_u32(u8 **pptr UNNEEDED, u32 v UNNEEDED)
-{ fprintf(stderr, "towire_u32 called!\n"); abort(); }
-/* Generated stub for towire_u64 */
-void towire_u64(u8 **pptr UNNEEDED, u64 v UNNEEDED)
-{ fprintf(stderr, "towire_u64 called!\n"); abort(); }
 /* AUTOGENERATED MOCKS END */
 
 secp256k1_context *secp256k1_ctx;
@@ -159,11 +121,80 @@ static void run_unit_tests(void)
 	assert(memcmp(raw, oreply->msg, tal_bytelen(raw)) == 0);
 }
 
+/* Unwrap an onion, as the first hop, @num times, timing each step. */
+static void run_bench(size_t num)
+{
+	struct secret session_key, ss, *path_secrets;
+	struct privkey privkey;
+	struct pubkey pubkey;
+	struct sphinx_path *sp;
+	struct onionpacket *packet;
+	/* We clean tmpctx as we go, so keep these elsewhere. */
+	u8 *assocdata = tal_arrz(NULL, u8, 32);
+	u8 *payload = tal_arrz(assocdata, u8, 32);
+	u8 *onion;
+	u64 usec[5] = { 0, 0, 0, 0, 0 };
+	const char *what[5] = { "parse", "ecdh", "process",
+				"serialize+sha256", "sha256_onionpacket" };
+
+	memset(&session_key, 0x41, sizeof(session_key));
+	sp = sphinx_path_new_with_key(assocdata, assocdata, &session_key);
+	for (size_t i = 0; i < 5; i++) {
+		memset(&privkey, i + 1, sizeof(privkey));
+		if (!pubkey_from_privkey(&privkey, &pubkey))
+			abort();
+		sphinx_add_raw_hop(sp, &pubkey, SPHINX_V0_PAYLOAD, payload);
+	}
+	packet = create_onionpacket(assocdata, sp, &path_secrets);
+	onion = serialize_onionpacket(assocdata, packet);
+
+	/* We're the first hop. */
+	memset(&privkey, 1, sizeof(privkey));
+	for (size_t i = 0; i < num; i++) {
+		struct onionpacket *op;
+		struct route_step *rs;
+		struct sha256 sha1, sha2;
+		struct timemono t[6];
+
+		t[0] = time_mono();
+		op = parse_onionpacket(tmpctx, onion, tal_bytelen(onion), NULL);
+		t[1] = time_mono();
+		if (!onion_shared_secret(ss.data, op, &privkey))
+			abort();
+		t[2] = time_mono();
+		rs = process_onionpacket(tmpctx, op, ss.data,
+					 assocdata, tal_bytelen(assocdata));
+		t[3] = time_mono();
+		sha256(&sha1, serialize_onionpacket(tmpctx, rs->next),
+		       TOTAL_PACKET_SIZE);
+		t[4] = time_mono();
+		sha256_onionpacket(&sha2, rs->next);
+		t[5] = time_mono();
+
+		assert(secret_eq_consttime(&ss, &path_secrets[0]));
+		assert(sha256_eq(&sha1, &sha2));
+		for (size_t j = 0; j < 5; j++)
+			usec[j] += time_to_usec(timemono_between(t[j+1], t[j]));
+		clean_tmpctx();
+	}
+
+	for (size_t j = 0; j < 5; j++)
+		printf("%s: %.2f usec/onion\n", what[j], (double)usec[j] / num);
+	printf("%zu onions at %.0f onions/sec"
+	       " (%.0f onions/sec without ecdh)\n",
+	       num, num * 1000000.0 / (usec[0] + usec[1] + usec[2] + usec[4]),
+	       num * 1000000.0 / (usec[0] + usec[2] + usec[4]));
+	tal_free(assocdata);
+}
+
 int main(int argc, char **argv)
 {
 	setup_locale();
 
 	bool unit = false;
+	/* Only 10 by default, as check-units runs this under valgrind: try
+	 * --bench=1000. */
+	unsigned int bench = 10;
 
 	secp256k1_ctx = secp256k1_context_create(
 		SECP256K1_CONTEXT_VERIFY | SECP256K1_CONTEXT_SIGN);
@@ -176,12 +207,16 @@ int main(int argc, char **argv)
 	opt_register_noarg("--unit",
 			   opt_set_bool, &unit,
 			   "Run unit tests against test vectors");
+	opt_register_arg("--bench", opt_set_uintval, opt_show_uintval, &bench,
+			 "Time unwrapping this many onions (0 to skip)");
 
 	opt_parse(&argc, argv, opt_log_stderr_exit);
 
 	if (unit) {
 		run_unit_tests();
 	}
+	if (bench)
+		run_bench(bench);
 	secp256k1_context_destroy(secp256k1_ctx);
 	opt_free_table();
 	tal_free(tmpctx);
@@ -30,6 +30,7 @@
 #include <common/daemon_conn.h>
 #include <common/decode_short_channel_ids.h>
 #include <common/features.h>
+#include <common/hsm_client.h>
 #include <common/memleak.h>
 #include <common/ping.h>
 #include <common/pseudorand.h>
@@ -1499,25 +1500,63 @@ static struct io_plan *recv_req(struct io_conn *conn,
  * secret.  It's here because it's nicer then giving the handshake code
  * knowledge of the HSM, but also at one stage I made a hacky gossip vampire
  * tool which used the handshake code, so it's nice to keep that
- * standalone. */
-struct secret *hsm_do_ecdh(const tal_t *ctx, const struct pubkey *point)
-{
-	u8 *req = towire_hsm_ecdh_req(tmpctx, point), *resp;
-	struct secret *secret = tal(ctx, struct secret);
+ * standalone.
+ *
+ * We used to block waiting for hsmd here, which meant every other peer
+ * waited too: now the connection waits, and many handshakes can have
+ * their ECDH requests in flight to hsmd at once. */
+static struct hsm_client *hsm;
+
+struct ecdh_wait {
+	const tal_t *ctx;
+	struct secret *ss;
+	struct io_plan *(*next)(struct io_conn *, struct secret *, void *);
+	void *arg;
+};
 
-	if (!wire_sync_write(HSM_FD, req))
-		return tal_free(secret);
-	resp = wire_sync_read(req, HSM_FD);
-	if (!resp)
-		return tal_free(secret);
+static void ecdh_reply(const u8 *msg, struct ecdh_wait *ew)
+{
+	ew->ss = tal(ew->ctx, struct secret);
 
 	/* Note: hsmd will actually hang up on us if it can't ECDH: that implies
 	 * that our node private key is invalid, and we shouldn't have made
 	 * it this far.  */
-	if (!fromwire_hsm_ecdh_resp(resp, secret))
-		return tal_free(secret);
+	if (!fromwire_hsm_ecdh_resp(msg, ew->ss))
+		ew->ss = tal_free(ew->ss);
+
+	/*~ This wakes up the io_wait() below. */
+	io_wake(ew);
+}
 
-	return secret;
+static struct io_plan *ecdh_done(struct io_conn *conn, struct ecdh_wait *ew)
+{
+	struct secret *ss = ew->ss;
+	struct io_plan *(*next)(struct io_conn *, struct secret *, void *)
+		= ew->next;
+	void *arg = ew->arg;
+
+	tal_free(ew);
+	return next(conn, ss, arg);
+}
+
+struct io_plan *hsm_do_ecdh_(struct io_conn *conn,
+			     const tal_t *ctx,
+			     const struct pubkey *point,
+			     struct io_plan *(*next)(struct io_conn *,
+						     struct secret *,
+						     void *),
+			     void *arg)
+{
+	/* If conn dies while we're waiting, this (and the reply) is freed */
+	struct ecdh_wait *ew = tal(conn, struct ecdh_wait);
+
+	ew->ctx = ctx;
+	ew->ss = NULL;
+	ew->next = next;
+	ew->arg = arg;
+	hsm_req(ew, hsm, take(towire_hsm_ecdh_req(NULL, point)),
+		ecdh_reply, ew);
+	return io_wait(conn, ew, ecdh_done, ew);
 }
 
 /*~ UNUSED is defined to an __attribute__ for GCC; at one stage we tried to use
@@ -1565,6 +1604,9 @@ int main(int argc, char *argv[])
 	 * our status_ and failed messages. */
 	status_setup_async(daemon->master);
 
+	/* The handshake code asks hsmd for ECDH through this. */
+	hsm = hsm_client_new(daemon, HSM_FD);
+
 	/* Should never exit. */
 	io_loop(NULL, NULL);
 	abort();
@@ -8,6 +8,7 @@ struct crypto_state;
 struct io_conn;
 struct wireaddr_internal;
 struct pubkey;
+struct secret;
 
 #define initiator_handshake(conn, my_id, their_id, addr, cb, cbarg)	\
 	initiator_handshake_((conn), (my_id), (their_id), (addr),	\
@@ -52,6 +53,21 @@ struct io_plan *responder_handshake_(struct io_conn *conn,
 							   void *cbarg),
 				     void *cbarg);
 
-/* helper which is defined in connect.c */
-struct secret *hsm_do_ecdh(const tal_t *ctx, const struct pubkey *point);
+/* helper which is defined in connect.c: ECDH of our node key with @point,
+ * then @next is called with the secret (allocated off @ctx), or NULL. */
+#define hsm_do_ecdh(conn, ctx, point, next, arg)			\
+	hsm_do_ecdh_((conn), (ctx), (point),				\
+		     typesafe_cb_preargs(struct io_plan *, void *,	\
+					 (next), (arg),			\
+					 struct io_conn *,		\
+					 struct secret *),		\
+		     (arg))
+
+struct io_plan *hsm_do_ecdh_(struct io_conn *conn,
+			     const tal_t *ctx,
+			     const struct pubkey *point,
+			     struct io_plan *(*next)(struct io_conn *,
+						     struct secret *,
+						     void *),
+			     void *arg);
 #endif /* LIGHTNING_CONNECTD_HANDSHAKE_H */
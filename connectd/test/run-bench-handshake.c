@@ -0,0 +1,447 @@
+/* We replace connectd's hsm_do_ecdh_ so we can compare it with blocking. */
+#define main connectd_main
+int connectd_main(int argc, char *argv[]);
+#define hsm_do_ecdh_ connectd_hsm_do_ecdh_
+#include "../connectd.c"
+#undef main
+#undef hsm_do_ecdh_
+
+struct io_plan *hsm_do_ecdh_(struct io_conn *conn,
+			     const tal_t *ctx,
+			     const struct pubkey *point,
+			     struct io_plan *(*next)(struct io_conn *,
+						     struct secret *,
+						     void *),
+			     void *arg);
+
+#include "../handshake.c"
+#include "../../common/daemon_conn.c"
+#include "../../common/hsm_client.c"
+#include "../../common/msg_queue.c"
+#include "../../hsmd/gen_hsm_wire.c"
+#include "../../wire/fromwire.c"
+#include "../../wire/towire.c"
+#include "../../wire/wire_io.c"
+#include "../../wire/wire_sync.c"
+#include <ccan/err/err.h>
+#include <ccan/opt/opt.h>
+#include <ccan/read_write_all/read_write_all.h>
+#include <ccan/time/time.h>
+#include <common/test/bench.h>
+#include <stdio.h>
+#include <sys/wait.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for address_routable */
+bool address_routable(const struct wireaddr *wireaddr UNNEEDED,
+		      bool allow_localhost UNNEEDED)
+{ fprintf(stderr, "address_routable called!\n"); abort(); }
+/* Generated stub for bech32_encode */
+int bech32_encode(
+    char *output UNNEEDED,
+    const char *hrp UNNEEDED,
+    const uint8_t *data UNNEEDED,
+    size_t data_len UNNEEDED,
+    size_t max_input_len
+)
+{ fprintf(stderr, "bech32_encode called!\n"); abort(); }
+/* Generated stub for bech32_push_bits */
+void bech32_push_bits(u5 **data UNNEEDED, const void *src UNNEEDED, size_t nbits UNNEEDED)
+{ fprintf(stderr, "bech32_push_bits called!\n"); abort(); }
+/* Generated stub for bigsize_get */
+size_t bigsize_get(const u8 *p UNNEEDED, size_t max UNNEEDED, bigsize_t *val UNNEEDED)
+{ fprintf(stderr, "bigsize_get called!\n"); abort(); }
+/* Generated stub for bigsize_put */
+size_t bigsize_put(u8 buf[BIGSIZE_MAX_LEN] UNNEEDED, bigsize_t v UNNEEDED)
+{ fprintf(stderr, "bigsize_put called!\n"); abort(); }
+/* Generated stub for dump_memleak */
+bool dump_memleak(struct htable *memtable UNNEEDED)
+{ fprintf(stderr, "dump_memleak called!\n"); abort(); }
+/* Generated stub for fmt_wireaddr */
+char *fmt_wireaddr(const tal_t *ctx UNNEEDED, const struct wireaddr *a UNNEEDED)
+{ fprintf(stderr, "fmt_wireaddr called!\n"); abort(); }
+/* Generated stub for fmt_wireaddr_without_port */
+char *fmt_wireaddr_without_port(const tal_t *ctx UNNEEDED, const struct wireaddr *a UNNEEDED)
+{ fprintf(stderr, "fmt_wireaddr_without_port called!\n"); abort(); }
+/* Generated stub for fromwire_basepoints */
+void fromwire_basepoints(const u8 **ptr UNNEEDED, size_t *max UNNEEDED,
+			 struct basepoints *b UNNEEDED)
+{ fprintf(stderr, "fromwire_basepoints called!\n"); abort(); }
+/* Generated stub for fromwire_connectctl_activate */
+bool fromwire_connectctl_activate(const void *p UNNEEDED, bool *listen UNNEEDED)
+{ fprintf(stderr, "fromwire_connectctl_activate called!\n"); abort(); }
+/* Generated stub for fromwire_connectctl_connect_to_peer */
+bool fromwire_connectctl_connect_to_peer(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id *id UNNEEDED, u32 *seconds_waited UNNEEDED, struct wireaddr_internal **addrhint UNNEEDED)
+{ fprintf(stderr, "fromwire_connectctl_connect_to_peer called!\n"); abort(); }
+/* Generated stub for fromwire_connectctl_init */
+bool fromwire_connectctl_init(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id *id UNNEEDED, struct wireaddr_internal **wireaddrs UNNEEDED, enum addr_listen_announce **listen_announce UNNEEDED, struct wireaddr **tor_proxyaddr UNNEEDED, bool *use_tor_proxy_always UNNEEDED, bool *dev_allow_localhost UNNEEDED, bool *use_dns UNNEEDED, wirestring **tor_password UNNEEDED)
+{ fprintf(stderr, "fromwire_connectctl_init called!\n"); abort(); }
+/* Generated stub for fromwire_connectctl_peer_disconnected */
+bool fromwire_connectctl_peer_disconnected(const void *p UNNEEDED, struct node_id *id UNNEEDED)
+{ fprintf(stderr, "fromwire_connectctl_peer_disconnected called!\n"); abort(); }
+/* Generated stub for fromwire_ext_key */
+void fromwire_ext_key(const u8 **cursor UNNEEDED, size_t *max UNNEEDED, struct ext_key *bip32 UNNEEDED)
+{ fprintf(stderr, "fromwire_ext_key called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_get_addrs_reply */
+bool fromwire_gossip_get_addrs_reply(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct wireaddr **addrs UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_get_addrs_reply called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_new_peer_reply */
+bool fromwire_gossip_new_peer_reply(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, bool *success UNNEEDED, struct gossip_state **gs UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_new_peer_reply called!\n"); abort(); }
+/* Generated stub for fromwire_secrets */
+void fromwire_secrets(const u8 **ptr UNNEEDED, size_t *max UNNEEDED, struct secrets *s UNNEEDED)
+{ fprintf(stderr, "fromwire_secrets called!\n"); abort(); }
+/* Generated stub for fromwire_utxo */
+struct utxo *fromwire_utxo(const tal_t *ctx UNNEEDED, const u8 **ptr UNNEEDED, size_t *max UNNEEDED)
+{ fprintf(stderr, "fromwire_utxo called!\n"); abort(); }
+/* Generated stub for guess_address */
+bool guess_address(struct wireaddr *wireaddr UNNEEDED)
+{ fprintf(stderr, "guess_address called!\n"); abort(); }
+/* Generated stub for io_tor_connect */
+struct io_plan *io_tor_connect(struct io_conn *conn UNNEEDED,
+			       const struct addrinfo *tor_proxyaddr UNNEEDED,
+			       const char *host UNNEEDED, u16 port UNNEEDED,
+			       struct connecting *connect UNNEEDED)
+{ fprintf(stderr, "io_tor_connect called!\n"); abort(); }
+/* Generated stub for master_badmsg */
+void master_badmsg(u32 type_expected UNNEEDED, const u8 *msg)
+{ fprintf(stderr, "master_badmsg called!\n"); abort(); }
+/* Generated stub for memleak_add_helper_ */
+void memleak_add_helper_(const tal_t *p UNNEEDED, void (*cb)(struct htable *memtable UNNEEDED,
+						    const tal_t *)){ }
+/* Generated stub for memleak_enter_allocations */
+struct htable *memleak_enter_allocations(const tal_t *ctx UNNEEDED,
+					 const void *exclude1 UNNEEDED,
+					 const void *exclude2 UNNEEDED)
+{ fprintf(stderr, "memleak_enter_allocations called!\n"); abort(); }
+/* Generated stub for memleak_remove_htable */
+void memleak_remove_htable(struct htable *memtable UNNEEDED, const struct htable *ht UNNEEDED)
+{ fprintf(stderr, "memleak_remove_htable called!\n"); abort(); }
+/* Generated stub for memleak_remove_referenced */
+void memleak_remove_referenced(struct htable *memtable UNNEEDED, const void *root UNNEEDED)
+{ fprintf(stderr, "memleak_remove_referenced called!\n"); abort(); }
+/* Generated stub for new_per_peer_state */
+struct per_peer_state *new_per_peer_state(const tal_t *ctx UNNEEDED,
+					  const struct crypto_state *cs UNNEEDED)
+{ fprintf(stderr, "new_per_peer_state called!\n"); abort(); }
+/* Generated stub for node_id_from_pubkey */
+void node_id_from_pubkey(struct node_id *id UNNEEDED, const struct pubkey *key UNNEEDED)
+{ fprintf(stderr, "node_id_from_pubkey called!\n"); abort(); }
+/* Generated stub for peer_exchange_initmsg */
+struct io_plan *peer_exchange_initmsg(struct io_conn *conn UNNEEDED,
+				      struct daemon *daemon UNNEEDED,
+				      const struct crypto_state *cs UNNEEDED,
+				      const struct node_id *id UNNEEDED,
+				      const struct wireaddr_internal *addr UNNEEDED)
+{ fprintf(stderr, "peer_exchange_initmsg called!\n"); abort(); }
+/* Generated stub for pubkey_from_node_id */
+bool pubkey_from_node_id(struct pubkey *key UNNEEDED, const struct node_id *id UNNEEDED)
+{ fprintf(stderr, "pubkey_from_node_id called!\n"); abort(); }
+/* Generated stub for status_failed */
+void status_failed(enum status_failreason code UNNEEDED,
+		   const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "status_failed called!\n"); abort(); }
+/* Generated stub for status_setup_async */
+void status_setup_async(struct daemon_conn *master UNNEEDED)
+{ fprintf(stderr, "status_setup_async called!\n"); abort(); }
+/* Generated stub for subdaemon_setup */
+void subdaemon_setup(int argc UNNEEDED, char *argv[])
+{ fprintf(stderr, "subdaemon_setup called!\n"); abort(); }
+/* Generated stub for tor_autoservice */
+struct wireaddr *tor_autoservice(const tal_t *ctx UNNEEDED,
+				 const struct wireaddr *tor_serviceaddr UNNEEDED,
+				 const char *tor_password UNNEEDED,
+				 const struct wireaddr_internal *bindings UNNEEDED)
+{ fprintf(stderr, "tor_autoservice called!\n"); abort(); }
+/* Generated stub for towire_basepoints */
+void towire_basepoints(u8 **pptr UNNEEDED, const struct basepoints *b UNNEEDED)
+{ fprintf(stderr, "towire_basepoints called!\n"); abort(); }
+/* Generated stub for towire_connect_dev_memleak_reply */
+u8 *towire_connect_dev_memleak_reply(const tal_t *ctx UNNEEDED, bool leak UNNEEDED)
+{ fprintf(stderr, "towire_connect_dev_memleak_reply called!\n"); abort(); }
+/* Generated stub for towire_connect_peer_connected */
+u8 *towire_connect_peer_connected(const tal_t *ctx UNNEEDED, const struct node_id *id UNNEEDED, const struct wireaddr_internal *addr UNNEEDED, const struct per_peer_state *pps UNNEEDED, const u8 *globalfeatures UNNEEDED, const u8 *localfeatures UNNEEDED)
+{ fprintf(stderr, "towire_connect_peer_connected called!\n"); abort(); }
+/* Generated stub for towire_connect_reconnected */
+u8 *towire_connect_reconnected(const tal_t *ctx UNNEEDED, const struct node_id *id UNNEEDED)
+{ fprintf(stderr, "towire_connect_reconnected called!\n"); abort(); }
+/* Generated stub for towire_connectctl_activate_reply */
+u8 *towire_connectctl_activate_reply(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_connectctl_activate_reply called!\n"); abort(); }
+/* Generated stub for towire_connectctl_connect_failed */
+u8 *towire_connectctl_connect_failed(const tal_t *ctx UNNEEDED, const struct node_id *id UNNEEDED, const wirestring *failreason UNNEEDED, u32 seconds_to_delay UNNEEDED, const struct wireaddr_internal *addrhint UNNEEDED)
+{ fprintf(stderr, "towire_connectctl_connect_failed called!\n"); abort(); }
+/* Generated stub for towire_connectctl_init_reply */
+u8 *towire_connectctl_init_reply(const tal_t *ctx UNNEEDED, const struct wireaddr_internal *bindings UNNEEDED, const struct wireaddr *announcable UNNEEDED)
+{ fprintf(stderr, "towire_connectctl_init_reply called!\n"); abort(); }
+/* Generated stub for towire_ext_key */
+void towire_ext_key(u8 **pptr UNNEEDED, const struct ext_key *bip32 UNNEEDED)
+{ fprintf(stderr, "towire_ext_key called!\n"); abort(); }
+/* Generated stub for towire_gossip_get_addrs */
+u8 *towire_gossip_get_addrs(const tal_t *ctx UNNEEDED, const struct node_id *id UNNEEDED)
+{ fprintf(stderr, "towire_gossip_get_addrs called!\n"); abort(); }
+/* Generated stub for towire_gossip_new_peer */
+u8 *towire_gossip_new_peer(const tal_t *ctx UNNEEDED, const struct node_id *id UNNEEDED, bool gossip_queries_feature UNNEEDED, bool initial_routing_sync UNNEEDED)
+{ fprintf(stderr, "towire_gossip_new_peer called!\n"); abort(); }
+/* Generated stub for towire_secrets */
+void towire_secrets(u8 **pptr UNNEEDED, const struct secrets *s UNNEEDED)
+{ fprintf(stderr, "towire_secrets called!\n"); abort(); }
+/* Generated stub for towire_utxo */
+void towire_utxo(u8 **pptr UNNEEDED, const struct utxo *utxo UNNEEDED)
+{ fprintf(stderr, "towire_utxo called!\n"); abort(); }
+/* Generated stub for wireaddr_from_hostname */
+bool wireaddr_from_hostname(struct wireaddr *addr UNNEEDED, const char *hostname UNNEEDED,
+			    const u16 port UNNEEDED, bool *no_dns UNNEEDED,
+			    struct sockaddr *broken_reply UNNEEDED,
+			    const char **err_msg UNNEEDED)
+{ fprintf(stderr, "wireaddr_from_hostname called!\n"); abort(); }
+/* Generated stub for wireaddr_from_ipv4 */
+void wireaddr_from_ipv4(struct wireaddr *addr UNNEEDED,
+			const struct in_addr *ip4 UNNEEDED,
+			const u16 port UNNEEDED)
+{ fprintf(stderr, "wireaddr_from_ipv4 called!\n"); abort(); }
+/* Generated stub for wireaddr_from_ipv6 */
+void wireaddr_from_ipv6(struct wireaddr *addr UNNEEDED,
+			const struct in6_addr *ip6 UNNEEDED,
+			const u16 port UNNEEDED)
+{ fprintf(stderr, "wireaddr_from_ipv6 called!\n"); abort(); }
+/* Generated stub for wireaddr_from_unresolved */
+bool wireaddr_from_unresolved(struct wireaddr_internal *addr UNNEEDED,
+			      const char *name UNNEEDED, u16 port UNNEEDED)
+{ fprintf(stderr, "wireaddr_from_unresolved called!\n"); abort(); }
+/* Generated stub for wireaddr_internal_to_addrinfo */
+struct addrinfo *wireaddr_internal_to_addrinfo(const tal_t *ctx UNNEEDED,
+					       const struct wireaddr_internal *wireaddr UNNEEDED)
+{ fprintf(stderr, "wireaddr_internal_to_addrinfo called!\n"); abort(); }
+/* Generated stub for wireaddr_is_wildcard */
+bool wireaddr_is_wildcard(const struct wireaddr *addr UNNEEDED)
+{ fprintf(stderr, "wireaddr_is_wildcard called!\n"); abort(); }
+/* Generated stub for wireaddr_to_addrinfo */
+struct addrinfo *wireaddr_to_addrinfo(const tal_t *ctx UNNEEDED,
+				      const struct wireaddr *wireaddr UNNEEDED)
+{ fprintf(stderr, "wireaddr_to_addrinfo called!\n"); abort(); }
+/* Generated stub for wireaddr_to_ipv4 */
+bool wireaddr_to_ipv4(const struct wireaddr *addr UNNEEDED, struct sockaddr_in *s4 UNNEEDED)
+{ fprintf(stderr, "wireaddr_to_ipv4 called!\n"); abort(); }
+/* Generated stub for wireaddr_to_ipv6 */
+bool wireaddr_to_ipv6(const struct wireaddr *addr UNNEEDED, struct sockaddr_in6 *s6 UNNEEDED)
+{ fprintf(stderr, "wireaddr_to_ipv6 called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+/* We don't care about these. */
+void status_fmt(enum log_level level UNNEEDED, const char *fmt UNNEEDED, ...)
+{
+}
+
+void *notleak_(const void *ptr, bool plus_children UNNEEDED)
+{
+	return cast_const(void *, ptr);
+}
+
+static enum ecdh_mode {
+	/* The initiators just do it themselves. */
+	ECDH_LOCAL,
+	/* What connectd used to do: block waiting for hsmd. */
+	ECDH_SYNC,
+	/* connectd's hsm_do_ecdh_ */
+	ECDH_ASYNC,
+} ecdh_mode;
+
+static struct privkey initiator_priv, responder_priv;
+static struct pubkey initiator_pub, responder_pub;
+static int hsm_fd;
+static unsigned int hsm_delay_usec;
+static u64 hsm_blocked_usec;
+static size_t num_done, num_expected;
+
+struct io_plan *hsm_do_ecdh_(struct io_conn *conn,
+			     const tal_t *ctx,
+			     const struct pubkey *point,
+			     struct io_plan *(*next)(struct io_conn *,
+						     struct secret *,
+						     void *),
+			     void *arg)
+{
+	struct secret *ss;
+	struct timemono start;
+	const u8 *msg;
+
+	switch (ecdh_mode) {
+	case ECDH_ASYNC:
+		return connectd_hsm_do_ecdh_(conn, ctx, point, next, arg);
+	case ECDH_SYNC:
+		ss = tal(ctx, struct secret);
+		start = time_mono();
+		if (!wire_sync_write(hsm_fd,
+				     take(towire_hsm_ecdh_req(NULL, point))))
+			err(1, "Writing to hsmd");
+		msg = wire_sync_read(tmpctx, hsm_fd);
+		if (!msg || !fromwire_hsm_ecdh_resp(msg, ss))
+			ss = tal_free(ss);
+		hsm_blocked_usec += time_to_usec(timemono_since(start));
+		return next(conn, ss, arg);
+	case ECDH_LOCAL:
+		ss = tal(ctx, struct secret);
+		if (secp256k1_ecdh(secp256k1_ctx, ss->data, &point->pubkey,
+				   initiator_priv.secret.data, NULL, NULL) != 1)
+			ss = tal_free(ss);
+		return next(conn, ss, arg);
+	}
+	abort();
+}
+
+/* Does what hsmd's handle_ecdh does, one request at a time. */
+static void stub_hsmd(int fd, void *unused UNUSED)
+{
+	const u8 *msg;
+
+	while ((msg = wire_sync_read(tmpctx, fd)) != NULL) {
+		struct pubkey point;
+		struct secret ss;
+
+		if (!fromwire_hsm_ecdh_req(msg, &point))
+			errx(1, "stub hsmd: bad request %s",
+			     tal_hex(tmpctx, msg));
+		if (secp256k1_ecdh(secp256k1_ctx, ss.data, &point.pubkey,
+				   responder_priv.secret.data, NULL, NULL) != 1)
+			errx(1, "stub hsmd: bad ECDH");
+		usleep(hsm_delay_usec);
+		if (!wire_sync_write(fd, take(towire_hsm_ecdh_resp(NULL, &ss))))
+			err(1, "stub hsmd: writing");
+		clean_tmpctx();
+	}
+}
+
+static struct io_plan *handshake_done(struct io_conn *conn,
+				      const struct pubkey *them UNUSED,
+				      const struct wireaddr_internal *addr UNUSED,
+				      const struct crypto_state *cs UNUSED,
+				      void *unused UNUSED)
+{
+	if (++num_done == num_expected)
+		io_break(&num_done);
+	return io_close(conn);
+}
+
+static struct io_plan *initiator_start(struct io_conn *conn, void *unused)
+{
+	struct wireaddr_internal addr;
+
+	addr.itype = ADDR_INTERNAL_WIREADDR;
+	addr.u.wireaddr.addrlen = 0;
+	return initiator_handshake(conn, &initiator_pub, &responder_pub,
+				   &addr, handshake_done, NULL);
+}
+
+static struct io_plan *responder_start(struct io_conn *conn, void *unused)
+{
+	struct wireaddr_internal addr;
+
+	addr.itype = ADDR_INTERNAL_WIREADDR;
+	addr.u.wireaddr.addrlen = 0;
+	return responder_handshake(conn, &responder_pub, &addr,
+				   handshake_done, NULL);
+}
+
+/* The peers connecting to us: we hand them one end of each socketpair. */
+static void initiators(int ctlfd, void *unused UNUSED)
+{
+	close(hsm_fd);
+	ecdh_mode = ECDH_LOCAL;
+	while (read_all(ctlfd, &num_expected, sizeof(num_expected))) {
+		for (size_t i = 0; i < num_expected; i++) {
+			int fd = fdpass_recv(ctlfd);
+			if (fd < 0)
+				err(1, "fdpass_recv");
+			io_new_conn(tmpctx, fd, initiator_start, NULL);
+		}
+		num_done = 0;
+		io_loop(NULL, NULL);
+		clean_tmpctx();
+	}
+}
+
+static void handshakes(int ctlfd, size_t num, size_t concurrent,
+		       const char *what)
+{
+	struct timemono start = time_mono();
+	u64 usec;
+
+	hsm_blocked_usec = 0;
+	for (size_t i = 0; i < num; i += num_expected) {
+		num_expected = concurrent;
+		if (num_expected > num - i)
+			num_expected = num - i;
+
+		if (!write_all(ctlfd, &num_expected, sizeof(num_expected)))
+			err(1, "write to initiators");
+		for (size_t j = 0; j < num_expected; j++) {
+			int fds[2];
+
+			if (socketpair(AF_LOCAL, SOCK_STREAM, 0, fds) != 0)
+				err(1, "socketpair");
+			if (!fdpass_send(ctlfd, fds[1]))
+				err(1, "fdpass_send");
+			close(fds[1]);
+			io_new_conn(tmpctx, fds[0], responder_start, NULL);
+		}
+		num_done = 0;
+		io_loop(NULL, NULL);
+		assert(num_done == num_expected);
+		clean_tmpctx();
+	}
+
+	usec = bench_usec_since(start);
+	printf("%s: %zu handshakes, %zu at once, in %"PRIu64" msec"
+	       " (%.0f handshakes/sec), %"PRIu64" msec blocked on hsmd\n",
+	       what, num, concurrent, usec / 1000, bench_per_sec(num, usec),
+	       hsm_blocked_usec / 1000);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t num = 20, concurrent = 10;
+	int ctlfd;
+	pid_t initiator_pid;
+
+	setup_locale();
+	setup_tmpctx();
+	secp256k1_ctx = secp256k1_context_create(SECP256K1_CONTEXT_VERIFY
+						 | SECP256K1_CONTEXT_SIGN);
+
+	opt_register_arg("--hsm-delay", opt_set_uintval, opt_show_uintval,
+			 &hsm_delay_usec,
+			 "Extra microseconds hsmd takes per request");
+	opt_parse(&argc, argv, opt_log_stderr_exit);
+	/* Try 1000 100 for a busy node. */
+	bench_sizes(argc, argv, "[num_handshakes [concurrent]]",
+		    &num, &concurrent);
+
+	memset(&initiator_priv, 0x11, sizeof(initiator_priv));
+	memset(&responder_priv, 0x21, sizeof(responder_priv));
+	if (!pubkey_from_privkey(&initiator_priv, &initiator_pub)
+	    || !pubkey_from_privkey(&responder_priv, &responder_pub))
+		abort();
+
+	/* Fork these before we have any io_conns of our own. */
+	bench_fork(&hsm_fd, stub_hsmd, NULL);
+	initiator_pid = bench_fork(&ctlfd, initiators, NULL);
+
+	ecdh_mode = ECDH_SYNC;
+	handshakes(ctlfd, num, concurrent, "Blocking");
+
+	/* Now hsm_fd belongs to the hsm_client. */
+	ecdh_mode = ECDH_ASYNC;
+	hsm = hsm_client_new(NULL, hsm_fd);
+	handshakes(ctlfd, num, concurrent, "Pipelined");
+	assert(hsm_client_pending(hsm) == 0);
+
+	close(ctlfd);
+	waitpid(initiator_pid, NULL, 0);
+
+	secp256k1_context_destroy(secp256k1_ctx);
+	tal_free(tmpctx);
+	opt_free_table();
+	/* Exiting closes hsm_fd, and the stub hsmd exits. */
+	return 0;
+}
@@ -611,6 +611,24 @@ class LightningRpc(UnixDomainSocketRpc):
         }
         return self.call("getroute", payload)
 
+    def getroutes(self, destinations, riskfactor, cltv=9, fromid=None, fuzzpercent=None, exclude=[], maxhops=20):
+        """
+        Show routes to each of {destinations} (a list of {id, msatoshi}),
+        using {riskfactor} and optional {cltv} (default 9), sharing the
+        search. {fromid}, {fuzzpercent}, {exclude} and {maxhops} are as
+        for getroute.
+        """
+        payload = {
+            "destinations": destinations,
+            "riskfactor": riskfactor,
+            "cltv": cltv,
+            "fromid": fromid,
+            "fuzzpercent": fuzzpercent,
+            "exclude": exclude,
+            "maxhops": maxhops
+        }
+        return self.call("getroutes", payload)
+
     def help(self, command=None):
         """
         Show available commands, or just {command} if supplied.
@@ -78,13 +78,19 @@ void peer_failed_connection_lost(void)
 	exit(0);
 }
 
-struct secret *hsm_do_ecdh(const tal_t *ctx, const struct pubkey *point)
+struct io_plan *hsm_do_ecdh_(struct io_conn *conn,
+			     const tal_t *ctx,
+			     const struct pubkey *point,
+			     struct io_plan *(*next)(struct io_conn *,
+						     struct secret *,
+						     void *),
+			     void *arg)
 {
 	struct secret *ss = tal(ctx, struct secret);
 	if (secp256k1_ecdh(secp256k1_ctx, ss->data, &point->pubkey,
 			   notsosecret.data, NULL, NULL) != 1)
-		return tal_free(ss);
-	return ss;
+		ss = tal_free(ss);
+	return next(conn, ss, arg);
 }
 
 /* We don't want to discard *any* messages. */
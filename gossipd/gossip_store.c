@@ -6,6 +6,7 @@
 #include <ccan/noerr/noerr.h>
 #include <ccan/read_write_all/read_write_all.h>
 #include <ccan/tal/str/str.h>
+#include <ccan/time/time.h>
 #include <common/gossip_store.h>
 #include <common/status.h>
 #include <common/utils.h>
@@ -14,7 +15,10 @@
 #include <gossipd/gen_gossip_peerd_wire.h>
 #include <gossipd/gen_gossip_store.h>
 #include <gossipd/gen_gossip_wire.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/uio.h>
 #include <unistd.h>
 #include <wire/gen_peer_wire.h>
@@ -48,6 +52,21 @@ struct gossip_store {
 	/* Disable compaction if we encounter an error during a prior
 	 * compaction */
 	bool disable_compaction;
+
+	/* Read-only mapping of the store: we read everything through this. */
+	struct store_map *map;
+
+	/* Entries before this offset have had their checksums verified. */
+	u64 verified;
+
+	/* Non-NULL while we're compacting in the background. */
+	struct store_compaction *compaction;
+};
+
+/* We map more than the file length, so appends rarely need a remap. */
+struct store_map {
+	u8 *p;
+	size_t len;
 };
 
 static void gossip_store_destroy(struct gossip_store *gs)
@@ -55,6 +74,43 @@ static void gossip_store_destroy(struct gossip_store *gs)
 	close(gs->fd);
 }
 
+static void destroy_store_map(struct store_map *map)
+{
+	munmap(map->p, map->len);
+}
+
+/* The old mapping is kept until tmpctx is freed, so views handed out
+ * earlier remain valid until then. */
+static void remap_store(struct gossip_store *gs, u64 end)
+{
+	struct store_map *map = tal(gs, struct store_map);
+
+	map->len = end + end / 2 + 65536;
+	map->p = mmap(NULL, map->len, PROT_READ, MAP_SHARED, gs->fd, 0);
+	if (map->p == MAP_FAILED)
+		status_failed(STATUS_FAIL_INTERNAL_ERROR,
+			      "gossip_store: mapping %zu bytes: %s",
+			      map->len, strerror(errno));
+	tal_add_destructor(map, destroy_store_map);
+
+	tal_steal(tmpctx, gs->map);
+	gs->map = map;
+}
+
+/* Returns a mapping of (at least) the first end bytes of the store. */
+static const u8 *store_map(struct gossip_store *gs, u64 end)
+{
+	if (!gs->map || end > gs->map->len)
+		remap_store(gs, end);
+	return gs->map->p;
+}
+
+/* Store entries aren't aligned, so we copy the header out. */
+static void store_hdr(const u8 *map, u64 offset, struct gossip_hdr *hdr)
+{
+	memcpy(hdr, map + offset, sizeof(*hdr));
+}
+
 static bool append_msg(int fd, const u8 *msg, u32 timestamp, u64 *len)
 {
 	struct gossip_hdr hdr;
@@ -175,6 +231,9 @@ struct gossip_store *gossip_store_new(struct routing_state *rstate,
 	gs->disable_compaction = false;
 	gs->len = sizeof(gs->version);
 	gs->peers = peers;
+	gs->map = NULL;
+	gs->verified = gs->len;
+	gs->compaction = NULL;
 
 	tal_add_destructor(gs, gossip_store_destroy);
 
@@ -202,24 +261,17 @@ struct gossip_store *gossip_store_new(struct routing_state *rstate,
 }
 
 /* Returns bytes transferred, or 0 on error */
-static size_t transfer_store_msg(int from_fd, size_t from_off,
+static size_t transfer_store_msg(const u8 *map, size_t from_off,
 				 int to_fd, size_t to_off,
 				 int *type)
 {
 	struct gossip_hdr hdr;
 	u32 msglen;
-	u8 *msg;
 	const u8 *p;
 	size_t tmplen;
 
 	*type = -1;
-	if (pread(from_fd, &hdr, sizeof(hdr), from_off) != sizeof(hdr)) {
-		status_broken("Failed reading header from to gossip store @%zu"
-			      ": %s",
-			      from_off, strerror(errno));
-		return 0;
-	}
-
+	store_hdr(map, from_off, &hdr);
 	msglen = be32_to_cpu(hdr.len);
 	if (msglen & GOSSIP_STORE_LEN_DELETED_BIT) {
 		status_broken("Can't transfer deleted msg from gossip store @%zu",
@@ -227,18 +279,8 @@ static size_t transfer_store_msg(int from_fd, size_t from_off,
 		return 0;
 	}
 
-	/* FIXME: Reuse buffer? */
-	msg = tal_arr(tmpctx, u8, sizeof(hdr) + msglen);
-	memcpy(msg, &hdr, sizeof(hdr));
-	if (pread(from_fd, msg + sizeof(hdr), msglen, from_off + sizeof(hdr))
-	    != msglen) {
-		status_broken("Failed reading %u from to gossip store @%zu"
-			      ": %s",
-			      msglen, from_off, strerror(errno));
-		return 0;
-	}
-
-	if (pwrite(to_fd, msg, msglen + sizeof(hdr), to_off)
+	/* Straight from the mapping, header and all. */
+	if (pwrite(to_fd, map + from_off, msglen + sizeof(hdr), to_off)
 	    != msglen + sizeof(hdr)) {
 		status_broken("Failed writing to gossip store: %s",
 			      strerror(errno));
@@ -246,39 +288,192 @@ static size_t transfer_store_msg(int from_fd, size_t from_off,
 	}
 
 	/* Can't use peektype here, since we have header on front */
-	p = msg + sizeof(hdr);
+	p = map + from_off + sizeof(hdr);
 	tmplen = msglen;
 	*type = fromwire_u16(&p, &tmplen);
 	if (!p)
 		*type = -1;
-	tal_free(msg);
 	return sizeof(hdr) + msglen;
 }
 
-/* We keep a htable map of old gossip_store offsets to new ones. */
+/* Where a record went in the new store. */
 struct offset_map {
-	size_t from, to;
+	u64 from, to;
 };
 
-static size_t offset_map_key(const struct offset_map *omap)
+/*~ Rewriting a big store takes seconds, and we don't want to stop
+ * answering peers and lightningd for that long.  So a thread copies
+ * everything which was live when we started into the new file, one slice
+ * at a time; meanwhile we keep appending to and deleting from the old one.
+ * Once it's done, we copy what we appended since, mark what we deleted
+ * since, and swap the new file in: that's quick.
+ *
+ * Like the load threads below, the thread doesn't allocate anything: the
+ * buffers and the offset array are set up before it starts, and we don't
+ * touch them until it's finished. */
+#define COMPACT_SLICE (1024 * 1024)
+/* We index offs by where they came from in blocks this big. */
+#define COMPACT_BUCKET 4096
+
+struct store_compaction {
+	struct gossip_store *gs;
+	pthread_t thread;
+	bool joined;
+
+	/* Protects finished and stop. */
+	pthread_mutex_t lock;
+	bool finished, stop;
+
+	/* Owned by the thread until finished. */
+	int in_fd, out_fd;
+	/* Length of the old store when we started, and the new one so far */
+	u64 end, len;
+	/* One for each record we copied, in order. */
+	struct offset_map *offs;
+	size_t num_offs;
+	/* bucket[i] is the first of offs from at or after i * COMPACT_BUCKET:
+	 * updating every broadcast index is a lot of lookups! */
+	size_t *bucket, num_bucket;
+	u8 *inbuf, *outbuf;
+	/* Set if the thread failed. */
+	const char *error;
+	int errnum;
+
+	/* Owned by the main thread: records deleted since we started. */
+	u64 *deleted;
+};
+
+static bool compaction_stopping(struct store_compaction *c)
+{
+	bool stop;
+
+	pthread_mutex_lock(&c->lock);
+	stop = c->stop;
+	pthread_mutex_unlock(&c->lock);
+	return stop;
+}
+
+static void compaction_failed(struct store_compaction *c, const char *error)
+{
+	c->error = error;
+	c->errnum = errno;
+}
+
+static void *compact_thread(void *arg)
+{
+	struct store_compaction *c = arg;
+	u64 off = sizeof(c->gs->version);
+
+	while (off < c->end && !compaction_stopping(c)) {
+		size_t inlen = COMPACT_SLICE, pos = 0, outlen = 0;
+		struct gossip_hdr hdr;
+
+		if (inlen > c->end - off)
+			inlen = c->end - off;
+		if (pread(c->in_fd, c->inbuf, inlen, off) != inlen) {
+			compaction_failed(c, "reading old store");
+			break;
+		}
+
+		/* Copy every whole record in this slice which isn't deleted. */
+		while (pos + sizeof(hdr) <= inlen) {
+			u32 msglen;
+
+			memcpy(&hdr, c->inbuf + pos, sizeof(hdr));
+			msglen = be32_to_cpu(hdr.len)
+				& ~GOSSIP_STORE_LEN_DELETED_BIT;
+			if (pos + sizeof(hdr) + msglen > inlen)
+				break;
+
+			if (!(be32_to_cpu(hdr.len)
+			      & GOSSIP_STORE_LEN_DELETED_BIT)) {
+				if (c->num_offs == tal_count(c->offs)) {
+					compaction_failed(c, "too many records");
+					goto out;
+				}
+				while (c->num_bucket * COMPACT_BUCKET
+				       <= off + pos)
+					c->bucket[c->num_bucket++]
+						= c->num_offs;
+				c->offs[c->num_offs].from = off + pos;
+				c->offs[c->num_offs].to = c->len + outlen;
+				c->num_offs++;
+				memcpy(c->outbuf + outlen, c->inbuf + pos,
+				       sizeof(hdr) + msglen);
+				outlen += sizeof(hdr) + msglen;
+			}
+			pos += sizeof(hdr) + msglen;
+		}
+
+		/* A record bigger than a slice, or a truncated one. */
+		if (pos == 0) {
+			errno = 0;
+			compaction_failed(c, "bad record length");
+			break;
+		}
+
+		if (pwrite(c->out_fd, c->outbuf, outlen, c->len) != outlen) {
+			compaction_failed(c, "writing new store");
+			break;
+		}
+		c->len += outlen;
+		off += pos;
+	}
+
+out:
+	while (c->num_bucket < tal_count(c->bucket))
+		c->bucket[c->num_bucket++] = c->num_offs;
+	pthread_mutex_lock(&c->lock);
+	c->finished = true;
+	pthread_mutex_unlock(&c->lock);
+	return NULL;
+}
+
+static void destroy_store_compaction(struct store_compaction *c)
 {
-	return omap->from;
+	if (!c->joined) {
+		pthread_mutex_lock(&c->lock);
+		c->stop = true;
+		pthread_mutex_unlock(&c->lock);
+		pthread_join(c->thread, NULL);
+	}
+	pthread_mutex_destroy(&c->lock);
+	close(c->in_fd);
+	/* If we didn't swap it in, we don't want it. */
+	if (c->out_fd != -1) {
+		close(c->out_fd);
+		unlink(GOSSIP_STORE_TEMP_FILENAME);
+	}
+	c->gs->compaction = NULL;
 }
 
-static size_t hash_offset(size_t from)
+static int offset_map_cmp(const void *key, const void *elem)
 {
-	/* Crappy fast hash is "good enough" */
-	return (from >> 5) ^ from;
+	const u64 *from = key;
+	const struct offset_map *omap = elem;
+
+	if (*from < omap->from)
+		return -1;
+	return *from > omap->from;
 }
 
-static bool offset_map_eq(const struct offset_map *omap, const size_t from)
+static struct offset_map *find_offset(struct store_compaction *c, u64 from)
 {
-	return omap->from == from;
+	size_t start, end;
+
+	/* Past the end of the buckets are the ones we added after. */
+	if (from >= c->end) {
+		start = c->bucket[tal_count(c->bucket) - 1];
+		end = c->num_offs;
+	} else {
+		start = c->bucket[from / COMPACT_BUCKET];
+		end = c->bucket[from / COMPACT_BUCKET + 1];
+	}
+	return bsearch(&from, c->offs + start, end - start, sizeof(c->offs[0]),
+		       offset_map_cmp);
 }
-HTABLE_DEFINE_TYPE(struct offset_map,
-		   offset_map_key, hash_offset, offset_map_eq, offmap);
 
-static void move_broadcast(struct offmap *offmap,
+static void move_broadcast(struct store_compaction *c,
 			   struct broadcastable *bcast,
 			   const char *what)
 {
@@ -287,38 +482,53 @@ static void move_broadcast(struct offmap *offmap,
 	if (!bcast->index)
 		return;
 
-	omap = offmap_get(offmap, bcast->index);
+	omap = find_offset(c, bcast->index);
 	if (!omap)
 		status_failed(STATUS_FAIL_INTERNAL_ERROR,
 			      "Could not relocate %s at offset %u",
 			      what, bcast->index);
 	bcast->index = omap->to;
-	offmap_del(offmap, omap);
 }
 
-static void destroy_offmap(struct offmap *offmap)
+/* Peers only need to know roughly where things went: they resend from the
+ * last one of these they've passed.  The last is the old end, where most
+ * of them will be. */
+static void peer_offsets(const tal_t *ctx, struct store_compaction *c,
+			 u64 old_len, u64 new_len,
+			 u64 **old_offsets, u64 **new_offsets)
 {
-	offmap_clear(offmap);
+	/* Every 256k, but no more than about a thousand. */
+	u64 gap = old_len / 1000 > 256 * 1024 ? old_len / 1000 : 256 * 1024;
+	u64 next = sizeof(c->gs->version) + gap;
+
+	*old_offsets = tal_arr(ctx, u64, 0);
+	*new_offsets = tal_arr(ctx, u64, 0);
+	tal_arr_expand(old_offsets, sizeof(c->gs->version));
+	tal_arr_expand(new_offsets, sizeof(c->gs->version));
+	for (size_t i = 0; i < c->num_offs; i++) {
+		if (c->offs[i].from < next)
+			continue;
+		tal_arr_expand(old_offsets, c->offs[i].from);
+		tal_arr_expand(new_offsets, c->offs[i].to);
+		next = c->offs[i].from + gap;
+	}
+	tal_arr_expand(old_offsets, old_len);
+	tal_arr_expand(new_offsets, new_len);
 }
 
 /**
  * Rewrite the on-disk gossip store, compacting it along the way
  *
- * Creates a new file, writes all the updates from the `broadcast_state`, and
- * then atomically swaps the files.
+ * Creates a new file, and starts a thread to write everything that isn't
+ * deleted into it.  gossip_store_compact_done() swaps the files once it's
+ * finished.
  */
 bool gossip_store_compact(struct gossip_store *gs)
 {
-	size_t count = 0, deleted = 0;
+	struct store_compaction *c;
 	int fd;
-	u64 off, len = sizeof(gs->version), idx;
-	struct offmap *offmap;
-	struct gossip_hdr hdr;
-	struct offmap_iter oit;
-	struct node_map_iter nit;
-	struct offset_map *omap;
 
-	if (gs->disable_compaction)
+	if (gs->disable_compaction || gs->compaction)
 		return false;
 
 	status_trace(
@@ -339,79 +549,144 @@ bool gossip_store_compact(struct gossip_store *gs)
 		goto unlink_disable;
 	}
 
-	/* Walk old file, copy everything and remember new offsets. */
-	offmap = tal(tmpctx, struct offmap);
-	offmap_init_sized(offmap, gs->count);
-	tal_add_destructor(offmap, destroy_offmap);
+	c = tal(gs, struct store_compaction);
+	c->gs = gs;
+	c->joined = false;
+	c->finished = c->stop = false;
+	c->in_fd = dup(gs->fd);
+	c->out_fd = fd;
+	c->end = gs->len;
+	c->len = sizeof(gs->version);
+	/* There can't be more live records than records. */
+	c->offs = tal_arr(c, struct offset_map, gs->count);
+	c->num_offs = 0;
+	c->bucket = tal_arr(c, size_t, c->end / COMPACT_BUCKET + 2);
+	c->num_bucket = 0;
+	c->inbuf = tal_arr(c, u8, COMPACT_SLICE);
+	c->outbuf = tal_arr(c, u8, COMPACT_SLICE);
+	c->error = NULL;
+	c->deleted = tal_arr(c, u64, 0);
+	pthread_mutex_init(&c->lock, NULL);
+	tal_add_destructor(c, destroy_store_compaction);
+	gs->compaction = c;
+
+	if (c->in_fd < 0 || pthread_create(&c->thread, NULL, compact_thread, c)) {
+		status_broken("Could not start gossip_store compaction: %s",
+			      strerror(errno));
+		/* This cleans up. */
+		c->joined = true;
+		tal_free(c);
+		goto disable;
+	}
+	return true;
+
+unlink_disable:
+	close(fd);
+	unlink(GOSSIP_STORE_TEMP_FILENAME);
+disable:
+	status_trace("Encountered an error while compacting, disabling "
+		     "future compactions.");
+	gs->disable_compaction = true;
+	return false;
+}
+
+bool gossip_store_compact_done(struct gossip_store *gs, bool *ok)
+{
+	struct store_compaction *c = gs->compaction;
+	u64 off, old_len, *old_offsets, *new_offsets;
+	size_t marked = 0;
+	struct node_map_iter nit;
+	struct gossip_hdr hdr;
+	const u8 *map;
+	struct timemono start;
+	bool finished;
+
+	pthread_mutex_lock(&c->lock);
+	finished = c->finished;
+	pthread_mutex_unlock(&c->lock);
+	if (!finished)
+		return false;
+
+	start = time_mono();
+	pthread_join(c->thread, NULL);
+	c->joined = true;
+	if (c->error) {
+		status_broken("gossip_store compaction failed %s: %s",
+			      c->error, c->errnum ? strerror(c->errnum) : "");
+		goto disable;
+	}
 
-	/* Start by writing all channel announcements and updates. */
-	off = 1;
-	while (pread(gs->fd, &hdr, sizeof(hdr), off) == sizeof(hdr)) {
-		u32 msglen, wlen;
+	/* Copy across anything we've added since. */
+	map = store_map(gs, gs->len);
+	tal_resize(&c->offs, c->num_offs);
+	for (off = c->end; off + sizeof(hdr) <= gs->len; ) {
+		struct offset_map omap;
+		u32 msglen;
 		int msgtype;
 
-		msglen = (be32_to_cpu(hdr.len) & ~GOSSIP_STORE_LEN_DELETED_BIT);
+		store_hdr(map, off, &hdr);
+		msglen = be32_to_cpu(hdr.len) & ~GOSSIP_STORE_LEN_DELETED_BIT;
 		if (be32_to_cpu(hdr.len) & GOSSIP_STORE_LEN_DELETED_BIT) {
 			off += sizeof(hdr) + msglen;
-			deleted++;
 			continue;
 		}
-
-		count++;
-		wlen = transfer_store_msg(gs->fd, off, fd, len, &msgtype);
-		if (wlen == 0)
-			goto unlink_disable;
-
-		/* We track location of all these message types. */
-		if (msgtype == WIRE_GOSSIPD_LOCAL_ADD_CHANNEL
-		    || msgtype == WIRE_GOSSIP_STORE_PRIVATE_UPDATE
-		    || msgtype == WIRE_CHANNEL_ANNOUNCEMENT
-		    || msgtype == WIRE_CHANNEL_UPDATE
-		    || msgtype == WIRE_NODE_ANNOUNCEMENT) {
-			omap = tal(offmap, struct offset_map);
-			omap->from = off;
-			omap->to = len;
-			offmap_add(offmap, omap);
-		}
-		len += wlen;
-		off += wlen;
+		if (!transfer_store_msg(map, off, c->out_fd, c->len, &msgtype))
+			goto disable;
+		omap.from = off;
+		omap.to = c->len;
+		tal_arr_expand(&c->offs, omap);
+		c->len += sizeof(hdr) + msglen;
+		off += sizeof(hdr) + msglen;
 	}
+	c->num_offs = tal_count(c->offs);
 
-	/* OK, now we've written file successfully, we can move broadcasts. */
-	/* Remap node announcements. */
-	for (struct node *n = node_map_first(gs->rstate->nodes, &nit);
-	     n;
-	     n = node_map_next(gs->rstate->nodes, &nit)) {
-		move_broadcast(offmap, &n->bcast, "node_announce");
-	}
+	/* And delete anything we've deleted since (if it was copied: the
+	 * thread may have seen it was deleted already). */
+	for (size_t i = 0; i < tal_count(c->deleted); i++) {
+		struct offset_map *omap = find_offset(c, c->deleted[i]);
+		beint32_t belen;
 
-	/* Remap channel announcements and updates */
-	for (struct chan *c = uintmap_first(&gs->rstate->chanmap, &idx);
-	     c;
-	     c = uintmap_after(&gs->rstate->chanmap, &idx)) {
-		move_broadcast(offmap, &c->bcast, "channel_announce");
-		move_broadcast(offmap, &c->half[0].bcast, "channel_update");
-		move_broadcast(offmap, &c->half[1].bcast, "channel_update");
+		if (!omap)
+			continue;
+		if (pread(c->out_fd, &belen, sizeof(belen), omap->to)
+		    != sizeof(belen))
+			goto disable;
+		belen |= cpu_to_be32(GOSSIP_STORE_LEN_DELETED_BIT);
+		if (pwrite(c->out_fd, &belen, sizeof(belen), omap->to)
+		    != sizeof(belen))
+			goto disable;
+		marked++;
 	}
 
-	/* That should be everything. */
-	omap = offmap_first(offmap, &oit);
-	if (omap)
-		status_failed(STATUS_FAIL_INTERNAL_ERROR,
-			      "gossip_store: Entry at %zu->%zu not updated?",
-			      omap->from, omap->to);
-
-	if (count != gs->count - gs->deleted)
+	if (c->num_offs - marked != gs->count - gs->deleted)
 		status_failed(STATUS_FAIL_INTERNAL_ERROR,
 			      "gossip_store: Expected %zu msgs in new"
 			      " gossip store, got %zu",
-			      gs->count - gs->deleted, count);
+			      gs->count - gs->deleted, c->num_offs - marked);
 
-	if (deleted != gs->deleted)
-		status_failed(STATUS_FAIL_INTERNAL_ERROR,
-			      "gossip_store: Expected %zu deleted msgs in old"
-			      " gossip store, got %zu",
-			      gs->deleted, deleted);
+	/* OK, now we've written file successfully, we can move broadcasts. */
+	for (struct node *n = node_map_first(gs->rstate->nodes, &nit);
+	     n;
+	     n = node_map_next(gs->rstate->nodes, &nit)) {
+		struct chan_map_iter cit;
+
+		/* Remap node announcements. */
+		move_broadcast(c, &n->bcast, "node_announce");
+
+		/* Remap channel announcements and updates, once each: this
+		 * is much faster than walking rstate->chanmap. */
+		for (struct chan *chan = first_chan(n, &cit);
+		     chan;
+		     chan = next_chan(n, &cit)) {
+			if (chan->nodes[0] != n)
+				continue;
+			move_broadcast(c, &chan->bcast, "channel_announce");
+			move_broadcast(c, &chan->half[0].bcast,
+				       "channel_update");
+			move_broadcast(c, &chan->half[1].bcast,
+				       "channel_update");
+		}
+	}
 
 	if (rename(GOSSIP_STORE_TEMP_FILENAME, GOSSIP_STORE_FILENAME) == -1)
 		status_failed(STATUS_FAIL_INTERNAL_ERROR,
@@ -420,25 +695,34 @@ bool gossip_store_compact(struct gossip_store *gs)
 			      strerror(errno));
 
 	status_trace(
-	    "Compaction completed: dropped %zu messages, new count %zu, len %"PRIu64,
-	    deleted, count, len);
-	gs->count = count;
-	gs->deleted = 0;
-	off = gs->len - len;
-	gs->len = len;
+	    "Compaction completed: dropped %zu messages, new count %zu, len %"PRIu64
+	    " (%"PRIu64" usec to finish)",
+	    gs->count - c->num_offs, c->num_offs, c->len,
+	    time_to_usec(timemono_since(start)));
+	old_len = gs->len;
+	gs->count = c->num_offs;
+	gs->deleted = marked;
+	gs->len = c->len;
 	close(gs->fd);
-	gs->fd = fd;
-
-	update_peers_broadcast_index(gs->peers, off);
+	gs->fd = c->out_fd;
+	c->out_fd = -1;
+	/* We only copied verified entries. */
+	gs->verified = gs->len;
+	remap_store(gs, gs->len);
+
+	peer_offsets(tmpctx, c, old_len, gs->len, &old_offsets, &new_offsets);
+	tal_free(c);
+	update_peers_broadcast_index(gs->peers, old_offsets, new_offsets);
+	*ok = true;
 	return true;
 
-unlink_disable:
-	unlink(GOSSIP_STORE_TEMP_FILENAME);
 disable:
+	tal_free(c);
 	status_trace("Encountered an error while compacting, disabling "
 		     "future compactions.");
 	gs->disable_compaction = true;
-	return false;
+	*ok = false;
+	return true;
 }
 
 u64 gossip_store_add(struct gossip_store *gs, const u8 *gossip_msg,
@@ -500,6 +784,9 @@ static u32 delete_by_index(struct gossip_store *gs, u32 index, int type)
 			      "Failed writing len to delete @%u: %s",
 			      index, strerror(errno));
 	gs->deleted++;
+	/* The compaction thread may have copied it already. */
+	if (gs->compaction)
+		tal_arr_expand(&gs->compaction->deleted, index);
 
 	return index + sizeof(struct gossip_hdr)
 		+ (be32_to_cpu(belen) & ~GOSSIP_STORE_LEN_DELETED_BIT);
@@ -525,45 +812,58 @@ void gossip_store_delete(struct gossip_store *gs,
 				WIRE_GOSSIP_STORE_CHANNEL_AMOUNT);
 }
 
-const u8 *gossip_store_get(const tal_t *ctx,
-			   struct gossip_store *gs,
-			   u64 offset)
+const u8 *gossip_store_view(struct gossip_store *gs, u64 offset,
+			    size_t *len)
 {
 	struct gossip_hdr hdr;
-	u32 msglen, checksum;
-	u8 *msg;
+	const u8 *map;
 
-	if (offset == 0)
+	if (offset == 0 || offset + sizeof(hdr) > gs->len)
 		status_failed(STATUS_FAIL_INTERNAL_ERROR,
-			      "gossip_store: can't access offset %"PRIu64,
-			      offset);
-	if (pread(gs->fd, &hdr, sizeof(hdr), offset) != sizeof(hdr)) {
-		status_failed(STATUS_FAIL_INTERNAL_ERROR,
-			      "gossip_store: can't read hdr offset %"PRIu64
-			      "/%"PRIu64": %s",
-			      offset, gs->len, strerror(errno));
+			      "gossip_store: can't access offset %"PRIu64
+			      "/%"PRIu64,
+			      offset, gs->len);
+
+	map = store_map(gs, gs->len);
+
+	/* Check everything up to here which we haven't checked yet. */
+	while (gs->verified <= offset) {
+		u32 msglen;
+
+		store_hdr(map, gs->verified, &hdr);
+		msglen = be32_to_cpu(hdr.len) & ~GOSSIP_STORE_LEN_DELETED_BIT;
+		if (be32_to_cpu(hdr.crc)
+		    != crc32c(be32_to_cpu(hdr.timestamp),
+			      map + gs->verified + sizeof(hdr), msglen))
+			status_failed(STATUS_FAIL_INTERNAL_ERROR,
+				      "gossip_store: bad checksum offset %"PRIu64
+				      ": %s",
+				      gs->verified,
+				      tal_hexstr(tmpctx,
+						 map + gs->verified + sizeof(hdr),
+						 msglen));
+		gs->verified += sizeof(hdr) + msglen;
 	}
 
+	store_hdr(map, offset, &hdr);
 	if (be32_to_cpu(hdr.len) & GOSSIP_STORE_LEN_DELETED_BIT)
 		status_failed(STATUS_FAIL_INTERNAL_ERROR,
 			      "gossip_store: get delete entry offset %"PRIu64
 			      "/%"PRIu64"",
 			      offset, gs->len);
 
-	msglen = be32_to_cpu(hdr.len);
-	checksum = be32_to_cpu(hdr.crc);
-	msg = tal_arr(ctx, u8, msglen);
-	if (pread(gs->fd, msg, msglen, offset + sizeof(hdr)) != msglen)
-		status_failed(STATUS_FAIL_INTERNAL_ERROR,
-			      "gossip_store: can't read len %u offset %"PRIu64
-			      "/%"PRIu64, msglen, offset, gs->len);
+	*len = be32_to_cpu(hdr.len);
+	return map + offset + sizeof(hdr);
+}
 
-	if (checksum != crc32c(be32_to_cpu(hdr.timestamp), msg, msglen))
-		status_failed(STATUS_FAIL_INTERNAL_ERROR,
-			      "gossip_store: bad checksum offset %"PRIu64": %s",
-			      offset, tal_hex(tmpctx, msg));
+const u8 *gossip_store_get(const tal_t *ctx,
+			   struct gossip_store *gs,
+			   u64 offset)
+{
+	size_t msglen;
+	const u8 *view = gossip_store_view(gs, offset, &msglen);
 
-	return msg;
+	return tal_dup_arr(ctx, u8, view, msglen, 0);
 }
 
 const u8 *gossip_store_get_private_update(const tal_t *ctx,
@@ -592,10 +892,136 @@ int gossip_store_readonly_fd(struct gossip_store *gs)
 	return fd;
 }
 
+/*~ Loading a large store is dominated by checksumming every record and
+ * parsing the bitcoin keys of every channel_announcement, and neither needs
+ * the routing_state.  So we split the records into one chunk per CPU, and
+ * have threads check them; the main thread then adds everything in order.
+ *
+ * The threads don't allocate anything: each one only writes its own part of
+ * the status array. */
+enum record_status {
+	RECORD_OK,
+	RECORD_BAD_CHECKSUM,
+	RECORD_BAD_ANNOUNCEMENT,
+};
+
+struct load_chunk {
+	pthread_t thread;
+	const u8 *map;
+	/* Offset of our first record, and the end of our last one. */
+	u64 start, end;
+	/* Index of our first record in the status array. */
+	size_t first;
+	u8 *status;
+};
+
+static void *check_chunk(void *arg)
+{
+	struct load_chunk *chunk = arg;
+	u8 *status = chunk->status + chunk->first;
+
+	for (u64 off = chunk->start; off < chunk->end; status++) {
+		struct gossip_hdr hdr;
+		u32 msglen;
+		const u8 *msg, *cursor;
+		size_t max;
+		struct short_channel_id scid;
+		struct node_id id1, id2;
+
+		store_hdr(chunk->map, off, &hdr);
+		msglen = be32_to_cpu(hdr.len) & ~GOSSIP_STORE_LEN_DELETED_BIT;
+		msg = chunk->map + off + sizeof(hdr);
+		off += sizeof(hdr) + msglen;
+
+		*status = RECORD_OK;
+		if (be32_to_cpu(hdr.crc)
+		    != crc32c(be32_to_cpu(hdr.timestamp), msg, msglen)) {
+			*status = RECORD_BAD_CHECKSUM;
+			continue;
+		}
+		if (be32_to_cpu(hdr.len) & GOSSIP_STORE_LEN_DELETED_BIT)
+			continue;
+
+		/* Can't use peektype: this isn't a tal object */
+		cursor = msg;
+		max = msglen;
+		if (fromwire_u16(&cursor, &max) == WIRE_CHANNEL_ANNOUNCEMENT
+		    && !decode_channel_announcement_ids(msg, msglen, true,
+							&scid, &id1, &id2))
+			*status = RECORD_BAD_ANNOUNCEMENT;
+	}
+	return NULL;
+}
+
+/* Returns a record_status for every complete record from start, and sets
+ * *end to the end of the last one. */
+static u8 *check_records(const tal_t *ctx, const u8 *map,
+			 u64 start, u64 filelen, u64 *end)
+{
+	struct load_chunk *chunks = tal_arr(tmpctx, struct load_chunk, 0);
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	struct timemono start_time = time_mono();
+	u64 chunklen, off;
+	size_t num = 0;
+	u8 *status;
+
+	if (ncpus < 1)
+		ncpus = 1;
+	chunklen = (filelen - start) / ncpus + 1;
+
+	/* Walking the headers is cheap: divide into roughly equal chunks. */
+	for (off = start; off + sizeof(struct gossip_hdr) <= filelen; num++) {
+		struct gossip_hdr hdr;
+		u64 next;
+
+		store_hdr(map, off, &hdr);
+		next = off + sizeof(hdr)
+			+ (be32_to_cpu(hdr.len) & ~GOSSIP_STORE_LEN_DELETED_BIT);
+		if (next > filelen)
+			break;
+
+		if (tal_count(chunks) == 0
+		    || off - chunks[tal_count(chunks)-1].start >= chunklen) {
+			struct load_chunk chunk;
+			chunk.map = map;
+			chunk.start = off;
+			chunk.first = num;
+			tal_arr_expand(&chunks, chunk);
+		}
+		chunks[tal_count(chunks)-1].end = off = next;
+	}
+	*end = off;
+
+	status = tal_arr(ctx, u8, num);
+	for (size_t i = 0; i < tal_count(chunks); i++) {
+		chunks[i].status = status;
+		/* We do the first one ourselves (or any which fail). */
+		if (i == 0
+		    || pthread_create(&chunks[i].thread, NULL,
+				      check_chunk, &chunks[i]) != 0)
+			chunks[i].thread = pthread_self();
+	}
+
+	if (tal_count(chunks))
+		check_chunk(&chunks[0]);
+	for (size_t i = 1; i < tal_count(chunks); i++) {
+		if (pthread_equal(chunks[i].thread, pthread_self()))
+			check_chunk(&chunks[i]);
+		else
+			pthread_join(chunks[i].thread, NULL);
+	}
+	status_trace("gossip_store: checked %zu records in %zu chunks"
+		     " in %"PRIu64" msec",
+		     num, tal_count(chunks),
+		     time_to_msec(timemono_since(start_time)));
+	tal_free(chunks);
+	return status;
+}
+
 bool gossip_store_load(struct routing_state *rstate, struct gossip_store *gs)
 {
 	struct gossip_hdr hdr;
-	u32 msglen, checksum;
+	u32 msglen;
 	u8 *msg;
 	struct amount_sat satoshis;
 	const char *bad;
@@ -605,19 +1031,27 @@ bool gossip_store_load(struct routing_state *rstate, struct gossip_store *gs)
 	bool contents_ok;
 	u32 last_timestamp = 0;
 	u64 chan_ann_off = 0; /* Spurious gcc-9 (Ubuntu 9-20190402-1ubuntu1) 9.0.1 20190402 (experimental) warning */
+	struct stat st;
+	const u8 *map;
+	u8 *status;
+	u64 end;
+
+	if (fstat(gs->fd, &st) != 0)
+		status_failed(STATUS_FAIL_INTERNAL_ERROR,
+			      "gossip_store: stat failed: %s", strerror(errno));
+	map = store_map(gs, st.st_size);
+	status = check_records(NULL, map, gs->len, st.st_size, &end);
 
 	gs->writable = false;
-	while (pread(gs->fd, &hdr, sizeof(hdr), gs->len) == sizeof(hdr)) {
-		msglen = be32_to_cpu(hdr.len) & ~GOSSIP_STORE_LEN_DELETED_BIT;
-		checksum = be32_to_cpu(hdr.crc);
-		msg = tal_arr(tmpctx, u8, msglen);
+	for (size_t i = 0; gs->len < end; i++) {
+		const u8 *view;
 
-		if (pread(gs->fd, msg, msglen, gs->len+sizeof(hdr)) != msglen) {
-			bad = "gossip_store: truncated file?";
-			goto corrupt;
-		}
+		store_hdr(map, gs->len, &hdr);
+		msglen = be32_to_cpu(hdr.len) & ~GOSSIP_STORE_LEN_DELETED_BIT;
 
-		if (checksum != crc32c(be32_to_cpu(hdr.timestamp), msg, msglen)) {
+		view = map + gs->len + sizeof(hdr);
+		if (status[i] == RECORD_BAD_CHECKSUM) {
+			msg = tal_dup_arr(tmpctx, u8, view, msglen, 0);
 			bad = "Checksum verification failed";
 			goto badmsg;
 		}
@@ -630,6 +1064,9 @@ bool gossip_store_load(struct routing_state *rstate, struct gossip_store *gs)
 			goto next;
 		}
 
+		/* The routing code wants to own (and tal_count) messages. */
+		msg = tal_dup_arr(tmpctx, u8, view, msglen, 0);
+
 		switch (fromwire_peektype(msg)) {
 		case WIRE_GOSSIP_STORE_CHANNEL_AMOUNT:
 			if (!fromwire_gossip_store_channel_amount(msg,
@@ -640,7 +1077,7 @@ bool gossip_store_load(struct routing_state *rstate, struct gossip_store *gs)
 			/* Previous channel_announcement may have been deleted */
 			if (!chan_ann)
 				break;
-			if (!routing_add_channel_announcement(rstate,
+			if (!routing_add_checked_channel_announcement(rstate,
 							      take(chan_ann),
 							      satoshis,
 							      chan_ann_off)) {
@@ -651,6 +1088,10 @@ bool gossip_store_load(struct routing_state *rstate, struct gossip_store *gs)
 			stats[0]++;
 			break;
 		case WIRE_CHANNEL_ANNOUNCEMENT:
+			if (status[i] == RECORD_BAD_ANNOUNCEMENT) {
+				bad = "Bad channel_announcement";
+				goto badmsg;
+			}
 			if (chan_ann) {
 				bad = "channel_announcement without amount";
 				goto badmsg;
@@ -701,6 +1142,12 @@ bool gossip_store_load(struct routing_state *rstate, struct gossip_store *gs)
 		clean_tmpctx();
 	}
 
+	/* Partial record on the end? */
+	if (end + sizeof(hdr) <= st.st_size) {
+		bad = "gossip_store: truncated file?";
+		goto corrupt;
+	}
+
 	if (chan_ann) {
 		bad = "dangling channel_announcement";
 		goto corrupt;
@@ -710,6 +1157,9 @@ bool gossip_store_load(struct routing_state *rstate, struct gossip_store *gs)
 	if (bad)
 		goto corrupt;
 
+	/* We checked everything as we went. */
+	gs->verified = gs->len;
+
 	/* If last timestamp is within 24 hours, say we're OK. */
 	contents_ok = (last_timestamp >= time_now().ts.tv_sec - 24*3600);
 	goto out;
@@ -730,9 +1180,11 @@ corrupt:
 			      "Truncating new store file: %s", strerror(errno));
 	remove_all_gossip(rstate);
 	gs->count = gs->deleted = 0;
-	gs->len = 1;
+	gs->len = gs->verified = 1;
+	remap_store(gs, gs->len);
 	contents_ok = false;
 out:
+	tal_free(status);
 	gs->writable = true;
 	status_trace("total store load time: %"PRIu64" msec",
 		     time_to_msec(time_between(time_now(), start)));
@@ -49,6 +49,16 @@ void gossip_store_delete(struct gossip_store *gs,
 			 struct broadcastable *bcast,
 			 int type);
 
+/**
+ * Direct store accessor: view of gossip msg in store, without copying.
+ *
+ * Caller must ensure offset != 0.  Never returns NULL.  The result is
+ * only valid until tmpctx is freed, and isn't a tal object: @len is set
+ * to its length.
+ */
+const u8 *gossip_store_view(struct gossip_store *gs, u64 offset,
+			    size_t *len);
+
 /**
  * Direct store accessor: loads gossip msg back from store.
  *
@@ -67,9 +77,19 @@ const u8 *gossip_store_get_private_update(const tal_t *ctx,
 					  struct gossip_store *gs,
 					  u64 offset);
 
-/* Exposed for dev-compact-gossip-store to force compaction. */
+/* Exposed for dev-compact-gossip-store to force compaction.  This only starts
+ * it: returns false if it can't (or it's already going). */
 bool gossip_store_compact(struct gossip_store *gs);
 
+/**
+ * Has the compaction started by gossip_store_compact() finished?
+ * @gs: the gossip_store
+ * @ok: set to whether it worked, if it's finished.
+ *
+ * If it has, this swaps the new store in (and tells the peers) first.
+ */
+bool gossip_store_compact_done(struct gossip_store *gs, bool *ok);
+
 /**
  * Get a readonly fd for the gossip_store.
  * @gs: the gossip store.
@@ -78,7 +98,10 @@ bool gossip_store_compact(struct gossip_store *gs);
  */
 int gossip_store_readonly_fd(struct gossip_store *gs);
 
-/* Callback inside gossipd when store is compacted */
-void update_peers_broadcast_index(struct list_head *peers, u32 offset);
+/* Callback inside gossipd when store is compacted: records at @old_offsets
+ * are now at @new_offsets. */
+void update_peers_broadcast_index(struct list_head *peers,
+				  const u64 *old_offsets,
+				  const u64 *new_offsets);
 
 #endif /* LIGHTNING_GOSSIPD_GOSSIP_STORE_H */
@@ -17,7 +17,6 @@
 #include <ccan/build_assert/build_assert.h>
 #include <ccan/cast/cast.h>
 #include <ccan/container_of/container_of.h>
-#include <ccan/crc32c/crc32c.h>
 #include <ccan/crypto/hkdf_sha256/hkdf_sha256.h>
 #include <ccan/crypto/siphash24/siphash24.h>
 #include <ccan/endian/endian.h>
@@ -54,6 +53,7 @@
 #include <gossipd/gen_gossip_peerd_wire.h>
 #include <gossipd/gen_gossip_wire.h>
 #include <gossipd/routing.h>
+#include <gossipd/sigcheck.h>
 #include <hsmd/gen_hsm_wire.h>
 #include <inttypes.h>
 #include <lightningd/gossip_msg.h>
@@ -148,8 +148,33 @@ struct daemon {
 
 	/* Channels we've heard about, but don't know. */
 	struct short_channel_id *unknown_scids;
+
+	/* Gossip from peers waiting for its signatures to be checked, and
+	 * the timer to make sure we get to it. */
+	struct queued_gossip *gossip_queue;
+	struct oneshot *gossip_queue_timer;
+
+	/* Worker threads to check the signatures. */
+	struct sigcheck_pool *sigcheck;
+};
+
+/*~ Checking signatures is almost all the work of accepting gossip, and in
+ * initial sync with a few peers it's all we do.  So we don't handle gossip
+ * as it arrives: we queue it, check the signatures of a whole batch at once
+ * on all our CPUs (see sigcheck.c), then handle it in the order it arrived.
+ * Gossip isn't urgent, and this way we don't fall behind on everything else
+ * either. */
+struct queued_gossip {
+	/* Who sent it: NULL if they've gone since. */
+	struct peer *peer;
+	const u8 *msg;
 };
 
+/* Handle them once we have this many... */
+#define GOSSIP_QUEUE_MAX 256
+/* ...or they've been waiting this long. */
+#define GOSSIP_QUEUE_MSEC 5
+
 /*~ How gossipy do we ask a peer to be? */
 enum gossip_level {
 	/* Give us everything since epoch */
@@ -209,6 +234,9 @@ struct peer {
 	/* Are we asking this peer to give us lot of gossip? */
 	enum gossip_level gossip_level;
 
+	/* How many of daemon->gossip_queue are from this peer? */
+	size_t num_queued_gossip;
+
 	/* The daemon_conn used to queue messages to/from the peer. */
 	struct daemon_conn *dc;
 };
@@ -245,6 +273,14 @@ static void destroy_peer(struct peer *peer)
 	/* Remove it from the peers list */
 	list_del_from(&peer->daemon->peers, &peer->list);
 
+	/* We still handle its queued gossip, we just can't reply. */
+	for (size_t i = 0; peer->num_queued_gossip; i++) {
+		if (peer->daemon->gossip_queue[i].peer == peer) {
+			peer->daemon->gossip_queue[i].peer = NULL;
+			peer->num_queued_gossip--;
+		}
+	}
+
 	/* If we have a channel with this peer, disable it. */
 	node = get_node(peer->daemon->rstate, &peer->id);
 	if (node)
@@ -514,7 +550,7 @@ static void send_node_announcement(struct daemon *daemon)
 
 	/* This injects it into the routing code in routing.c; it should not
 	 * reject it! */
-	err = handle_node_announcement(daemon->rstate, take(nannounce));
+	err = handle_node_announcement(daemon->rstate, take(nannounce), false);
 	if (err)
 		status_failed(STATUS_FAIL_INTERNAL_ERROR,
 			      "rejected own node announcement: %s",
@@ -739,36 +775,42 @@ static void query_unknown_channel(struct daemon *daemon,
  * message, and puts the announcemnt on an internal 'pending'
  * queue.  We'll send a request to lightningd to look it up, and continue
  * processing in `handle_txout_reply`. */
-static const u8 *handle_channel_announcement_msg(struct peer *peer,
-						 const u8 *msg)
+static u8 *handle_channel_announcement_msg(struct daemon *daemon,
+					   const u8 *msg,
+					   bool sigs_checked)
 {
 	const struct short_channel_id *scid;
-	const u8 *err;
+	u8 *err;
 
 	/* If it's OK, tells us the short_channel_id to lookup; it notes
 	 * if this is the unknown channel the peer was looking for (in
 	 * which case, it frees and NULLs that ptr) */
-	err = handle_channel_announcement(peer->daemon->rstate, msg, &scid);
+	err = handle_channel_announcement(daemon->rstate, msg, sigs_checked,
+					  &scid);
 	if (err)
 		return err;
 	else if (scid)
-		daemon_conn_send(peer->daemon->master,
+		daemon_conn_send(daemon->master,
 				 take(towire_gossip_get_txout(NULL, scid)));
 	return NULL;
 }
 
-static u8 *handle_channel_update_msg(struct peer *peer, const u8 *msg)
+/* peer is NULL if they've gone away since sending it. */
+static u8 *handle_channel_update_msg(struct daemon *daemon,
+				     struct peer *peer,
+				     const u8 *msg,
+				     const struct node_id *signed_by)
 {
 	struct short_channel_id unknown_scid;
 	/* Hand the channel_update to the routing code */
 	u8 *err;
 
 	unknown_scid.u64 = 0;
-	err = handle_channel_update(peer->daemon->rstate, msg, "subdaemon",
-				    &unknown_scid);
+	err = handle_channel_update(daemon->rstate, msg, signed_by,
+				    "subdaemon", &unknown_scid);
 	if (err) {
-		if (unknown_scid.u64 != 0)
-			query_unknown_channel(peer->daemon, peer, &unknown_scid);
+		if (unknown_scid.u64 != 0 && peer)
+			query_unknown_channel(daemon, peer, &unknown_scid);
 		return err;
 	}
 
@@ -777,10 +819,163 @@ static u8 *handle_channel_update_msg(struct peer *peer, const u8 *msg)
 	 * routing until you have both anyway.  For this reason, we might have
 	 * just sent out our own channel_announce, so we check if it's time to
 	 * send a node_announcement too. */
-	maybe_send_own_node_announce(peer->daemon);
+	maybe_send_own_node_announce(daemon);
 	return NULL;
 }
 
+/* The short_channel_id and node_ids of a channel_announcement */
+struct announced_ids {
+	struct short_channel_id scid;
+	struct node_id id[2];
+};
+
+/* Who should have signed this channel_update?  If we don't know the channel
+ * yet, it may be announced earlier in this batch. */
+static bool find_update_signer(struct routing_state *rstate,
+			       const struct announced_ids *announced,
+			       const u8 *msg,
+			       struct node_id *signer)
+{
+	const u8 *cursor = msg;
+	size_t max = tal_bytelen(msg);
+	struct short_channel_id scid;
+	const struct node_id *id;
+	int direction;
+
+	/* BOLT #7:
+	 *
+	 * 1. type: 258 (`channel_update`)
+	 * 2. data:
+	 *     * [`signature`:`signature`]
+	 *     * [`chain_hash`:`chain_hash`]
+	 *     * [`short_channel_id`:`short_channel_id`]
+	 *     * [`u32`:`timestamp`]
+	 *     * [`byte`:`message_flags`]
+	 *     * [`byte`:`channel_flags`]
+	 */
+	fromwire_pad(&cursor, &max, 2 + 64 + sizeof(struct bitcoin_blkid));
+	fromwire_short_channel_id(&cursor, &max, &scid);
+	fromwire_pad(&cursor, &max, 4 + 1);
+	direction = fromwire_u8(&cursor, &max) & ROUTING_FLAGS_DIRECTION;
+	if (!cursor)
+		return false;
+
+	id = channel_update_signer(rstate, &scid, direction);
+	for (size_t i = tal_count(announced); !id && i > 0; i--) {
+		if (short_channel_id_eq(&announced[i-1].scid, &scid))
+			id = &announced[i-1].id[direction];
+	}
+	if (!id)
+		return false;
+
+	*signer = *id;
+	return true;
+}
+
+static void handle_gossip_queue(struct daemon *daemon)
+{
+	struct queued_gossip *queue = daemon->gossip_queue;
+	size_t num = tal_count(queue);
+	struct sigcheck_job *jobs = tal_arr(tmpctx, struct sigcheck_job, num);
+	struct announced_ids *announced
+		= tal_arr(tmpctx, struct announced_ids, 0);
+
+	daemon->gossip_queue_timer = tal_free(daemon->gossip_queue_timer);
+
+	for (size_t i = 0; i < num; i++) {
+		jobs[i].msg = queue[i].msg;
+		jobs[i].len = tal_bytelen(queue[i].msg);
+		jobs[i].have_signer = false;
+
+		if (fromwire_peektype(queue[i].msg) == WIRE_CHANNEL_ANNOUNCEMENT) {
+			struct announced_ids a;
+			if (decode_channel_announcement_ids(jobs[i].msg,
+							    jobs[i].len, false,
+							    &a.scid,
+							    &a.id[0], &a.id[1]))
+				tal_arr_expand(&announced, a);
+		} else if (fromwire_peektype(queue[i].msg) == WIRE_CHANNEL_UPDATE)
+			jobs[i].have_signer
+				= find_update_signer(daemon->rstate, announced,
+						     queue[i].msg,
+						     &jobs[i].signer);
+	}
+
+	sigcheck_run(daemon->sigcheck, jobs, num);
+
+	/* Now handle them in order, as if they'd only just arrived. */
+	for (size_t i = 0; i < num; i++) {
+		struct peer *peer = queue[i].peer;
+		bool good = (jobs[i].result == SIGCHECK_GOOD);
+		u8 *err;
+
+		if (peer) {
+			peer->num_queued_gossip--;
+			queue[i].peer = NULL;
+		}
+
+		switch (fromwire_peektype(queue[i].msg)) {
+		case WIRE_CHANNEL_ANNOUNCEMENT:
+			err = handle_channel_announcement_msg(daemon,
+							      queue[i].msg,
+							      good);
+			break;
+		case WIRE_CHANNEL_UPDATE:
+			err = handle_channel_update_msg(daemon, peer,
+							queue[i].msg,
+							good
+							? &jobs[i].signer
+							: NULL);
+			break;
+		case WIRE_NODE_ANNOUNCEMENT:
+			err = handle_node_announcement(daemon->rstate,
+						       queue[i].msg, good);
+			break;
+		default:
+			abort();
+		}
+
+		/* The per-peer daemon will forward the error to the peer. */
+		if (err) {
+			if (peer)
+				queue_peer_msg(peer, take(err));
+			else
+				tal_free(err);
+		}
+	}
+
+	/* This frees the messages, too. */
+	tal_free(daemon->gossip_queue);
+	daemon->gossip_queue = tal_arr(daemon, struct queued_gossip, 0);
+}
+
+/* One thread per CPU: we do our share in sigcheck_run(), too. */
+static size_t sigcheck_threads(void)
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return ncpus > 1 ? ncpus - 1 : 0;
+}
+
+static void queue_gossip(struct peer *peer, const u8 *msg)
+{
+	struct daemon *daemon = peer->daemon;
+	struct queued_gossip qg;
+
+	qg.peer = peer;
+	qg.msg = tal_dup_arr(daemon->gossip_queue, u8, msg, tal_count(msg), 0);
+	tal_arr_expand(&daemon->gossip_queue, qg);
+	peer->num_queued_gossip++;
+
+	if (tal_count(daemon->gossip_queue) >= GOSSIP_QUEUE_MAX)
+		handle_gossip_queue(daemon);
+	else if (!daemon->gossip_queue_timer)
+		daemon->gossip_queue_timer
+			= new_reltimer(&daemon->timers, daemon,
+				       time_from_msec(GOSSIP_QUEUE_MSEC),
+				       handle_gossip_queue, daemon);
+}
+
 /*~ The peer can ask about an array of short channel ids: we don't assemble the
  * reply immediately but process them one at a time in dump_gossip which is
  * called when there's nothing more important to send. */
@@ -884,17 +1079,19 @@ static const u8 *handle_query_short_channel_ids(struct peer *peer, const u8 *msg
 }
 
 /*~ When we compact the gossip store, all the broadcast indexs move.
- * We simply offset everyone, which means in theory they could retransmit
- * some, but that's a lesser evil than skipping some. */
-void update_peers_broadcast_index(struct list_head *peers, u32 offset)
+ * We tell everyone where some of them went, which means they could
+ * retransmit some, but that's a lesser evil than skipping some. */
+void update_peers_broadcast_index(struct list_head *peers,
+				  const u64 *old_offsets,
+				  const u64 *new_offsets)
 {
 	struct peer *peer, *next;
 
 	list_for_each_safe(peers, peer, next, list) {
 		int gs_fd;
 		/*~ Since store has been compacted, they need a new fd for the
-		 * new store.  We also tell them how much this is shrunk, so
-		 * they can (approximately) tell where to start in the new store.
+		 * new store.  We also tell them where things moved to, so
+		 * they can tell where to start in the new store.
 		 */
 		gs_fd = gossip_store_readonly_fd(peer->daemon->rstate->gs);
 		if (gs_fd < 0) {
@@ -902,7 +1099,9 @@ void update_peers_broadcast_index(struct list_head *peers, u32 offset)
 				      " killing peer");
 			tal_free(peer);
 		} else {
-			u8 *msg = towire_gossipd_new_store_fd(NULL, offset);
+			u8 *msg = towire_gossipd_new_store_fd(NULL,
+							      old_offsets,
+							      new_offsets);
 			daemon_conn_send(peer->dc, take(msg));
 			daemon_conn_send_fd(peer->dc, gs_fd);
 		}
@@ -968,37 +1167,7 @@ enum query_option_flags {
 	QUERY_ADD_CHECKSUMS = 0x2,
 };
 
-/* BOLT-61a1365a45cc8b463ddbbe3429d350f8eac787dd #7:
- *
- * The checksum of a `channel_update` is the CRC32C checksum as specified in
- * [RFC3720](https://tools.ietf.org/html/rfc3720#appendix-B.4) of this
- * `channel_update` without its `signature` and `timestamp` fields.
- */
-static u32 crc32_of_update(const u8 *channel_update)
-{
-	u32 sum;
-
-	/* BOLT #7:
-	 *
-	 * 1. type: 258 (`channel_update`)
-	 * 2. data:
-	 *    * [`signature`:`signature`]
-	 *    * [`chain_hash`:`chain_hash`]
-	 *    * [`short_channel_id`:`short_channel_id`]
-	 *    * [`u32`:`timestamp`]
-	 *...
-	 */
-	/* Note: 2 bytes for `type` field */
-	/* We already checked it's valid before accepting */
-	assert(tal_count(channel_update) > 2 + 64 + 32 + 8 + 4);
-	sum = crc32c(0, channel_update + 2 + 64, 32 + 8);
-	sum = crc32c(sum, channel_update + 2 + 64 + 32 + 8 + 4,
-		     tal_count(channel_update) - (64 + 2 + 32 + 8 + 4));
-	return sum;
-}
-
-static void get_checksum_and_timestamp(struct routing_state *rstate,
-				       const struct chan *chan,
+static void get_checksum_and_timestamp(const struct chan *chan,
 				       int direction,
 				       u32 *tstamp, u32 *csum)
 {
@@ -1007,10 +1176,8 @@ static void get_checksum_and_timestamp(struct routing_state *rstate,
 	if (!is_chan_public(chan) || !is_halfchan_defined(hc)) {
 		*tstamp = *csum = 0;
 	} else {
-		const u8 *update = gossip_store_get(tmpctx, rstate->gs,
-						    hc->bcast.index);
 		*tstamp = hc->bcast.timestamp;
-		*csum = crc32_of_update(update);
+		*csum = hc->csum;
 	}
 }
 
@@ -1095,12 +1262,11 @@ static bool queue_channel_ranges(struct peer *peer,
 
 		encoding_add_short_channel_id(&encoded_scids, &scid);
 
-		/* FIXME: Store csum in header. */
 		chan = get_channel(rstate, &scid);
-		get_checksum_and_timestamp(rstate, chan, 0,
+		get_checksum_and_timestamp(chan, 0,
 					   &ts.timestamp_node_id_1,
 					   &cs.checksum_node_id_1);
-		get_checksum_and_timestamp(rstate, chan, 1,
+		get_checksum_and_timestamp(chan, 1,
 					   &ts.timestamp_node_id_2,
 					   &cs.checksum_node_id_2);
 
@@ -1728,7 +1894,8 @@ static void update_local_channel(struct daemon *daemon,
 	/* We feed it into routing.c like any other channel_update; it may
 	 * discard it (eg. non-public channel), but it should not complain
 	 * about it being invalid! */
-	msg = handle_channel_update(daemon->rstate, take(update), caller, NULL);
+	msg = handle_channel_update(daemon->rstate, take(update), NULL, caller,
+				    NULL);
 	if (msg)
 		status_failed(STATUS_FAIL_INTERNAL_ERROR,
 			      "%s: rejected local channel update %s: %s",
@@ -1955,18 +2122,22 @@ static struct io_plan *peer_msg_in(struct io_conn *conn,
 {
 	const u8 *err;
 	bool ok;
+	int type = fromwire_peektype(msg);
+
+	/* Anything else from them has to come after their queued gossip. */
+	if (peer->num_queued_gossip
+	    && type != WIRE_CHANNEL_ANNOUNCEMENT
+	    && type != WIRE_CHANNEL_UPDATE
+	    && type != WIRE_NODE_ANNOUNCEMENT)
+		handle_gossip_queue(peer->daemon);
 
 	/* These are messages relayed from peer */
-	switch ((enum wire_type)fromwire_peektype(msg)) {
+	switch ((enum wire_type)type) {
 	case WIRE_CHANNEL_ANNOUNCEMENT:
-		err = handle_channel_announcement_msg(peer, msg);
-		goto handled_relay;
 	case WIRE_CHANNEL_UPDATE:
-		err = handle_channel_update_msg(peer, msg);
-		goto handled_relay;
 	case WIRE_NODE_ANNOUNCEMENT:
-		err = handle_node_announcement(peer->daemon->rstate, msg);
-		goto handled_relay;
+		queue_gossip(peer, msg);
+		goto done;
 	case WIRE_QUERY_CHANNEL_RANGE:
 		err = handle_query_channel_range(peer, msg);
 		goto handled_relay;
@@ -2135,6 +2306,7 @@ static struct io_plan *connectd_new_peer(struct io_conn *conn,
 	peer->scid_query_outstanding = false;
 	peer->query_channel_blocks = NULL;
 	peer->num_pings_outstanding = 0;
+	peer->num_queued_gossip = 0;
 	peer->gossip_level = peer_gossip_level(daemon,
 					       peer->gossip_queries_feature);
 
@@ -2513,6 +2685,55 @@ static struct io_plan *getroute_req(struct io_conn *conn, struct daemon *daemon,
 	return daemon_conn_read_next(conn, daemon->master);
 }
 
+/*~ Batch version of the above: routes from one source to many destinations,
+ * for rebalancing sweeps and the like, which share the search. */
+static struct io_plan *getroutes_req(struct io_conn *conn,
+				     struct daemon *daemon,
+				     const u8 *msg)
+{
+	struct node_id *source, *destinations;
+	struct amount_msat *msats;
+	u32 final_cltv;
+	u64 riskfactor_by_million;
+	u32 max_hops;
+	u8 *out;
+	struct route_hop **routes, *hops;
+	u16 *route_lens;
+	double fuzz;
+	struct short_channel_id_dir *excluded;
+
+	if (!fromwire_gossip_getroutes_request(msg, msg,
+					       &source, &destinations,
+					       &msats, &riskfactor_by_million,
+					       &final_cltv, &fuzz,
+					       &excluded,
+					       &max_hops))
+		master_badmsg(WIRE_GOSSIP_GETROUTES_REQUEST, msg);
+
+	status_trace("Trying to find routes from %s to %zu destinations",
+		     source
+		     ? type_to_string(tmpctx, struct node_id, source) : "(me)",
+		     tal_count(destinations));
+
+	routes = get_routes(tmpctx, daemon->rstate, source, destinations,
+			    msats, riskfactor_by_million / 1000000.0,
+			    final_cltv, fuzz, pseudorand_u64(),
+			    excluded, max_hops);
+
+	/* Flatten them for the wire: lightningd splits them up again. */
+	route_lens = tal_arr(tmpctx, u16, tal_count(routes));
+	hops = tal_arr(tmpctx, struct route_hop, 0);
+	for (size_t i = 0; i < tal_count(routes); i++) {
+		route_lens[i] = tal_count(routes[i]);
+		for (size_t j = 0; j < tal_count(routes[i]); j++)
+			tal_arr_expand(&hops, routes[i][j]);
+	}
+
+	out = towire_gossip_getroutes_reply(NULL, route_lens, hops);
+	daemon_conn_send(daemon->master, take(out));
+	return daemon_conn_read_next(conn, daemon->master);
+}
+
 /*~ When someone asks lightningd to `listchannels`, gossipd does the work:
  * marshalling the channel information for all channels into an array of
  * gossip_getchannels_entry, which lightningd converts to JSON.  Each channel
@@ -3042,15 +3263,47 @@ static struct io_plan *dev_gossip_memleak(struct io_conn *conn,
 	return daemon_conn_read_next(conn, daemon->master);
 }
 
+/* Compaction happens in the background: we check for it finishing. */
+static void dev_compact_store_poll(struct daemon *daemon)
+{
+	bool done;
+
+	if (!gossip_store_compact_done(daemon->rstate->gs, &done)) {
+		new_reltimer(&daemon->timers, daemon, time_from_msec(10),
+			     dev_compact_store_poll, daemon);
+		return;
+	}
+
+	daemon_conn_send(daemon->master,
+			 take(towire_gossip_dev_compact_store_reply(NULL,
+								    done)));
+}
+
 static struct io_plan *dev_compact_store(struct io_conn *conn,
 					 struct daemon *daemon,
 					 const u8 *msg)
 {
-	bool done = gossip_store_compact(daemon->rstate->gs);
+	if (gossip_store_compact(daemon->rstate->gs))
+		dev_compact_store_poll(daemon);
+	else
+		daemon_conn_send(daemon->master,
+				 take(towire_gossip_dev_compact_store_reply(NULL,
+									    false)));
+	return daemon_conn_read_next(conn, daemon->master);
+}
+
+static struct io_plan *dev_route_cache(struct io_conn *conn,
+				       struct daemon *daemon,
+				       const u8 *msg)
+{
+	const struct route_cache *cache = &daemon->rstate->route_cache;
 
 	daemon_conn_send(daemon->master,
-			 take(towire_gossip_dev_compact_store_reply(NULL,
-								    done)));
+			 take(towire_gossip_dev_route_cache_reply(NULL,
+								  cache->num,
+								  cache->hits,
+								  cache->misses,
+								  cache->invalidated)));
 	return daemon_conn_read_next(conn, daemon->master);
 }
 #endif /* DEVELOPER */
@@ -3285,6 +3538,9 @@ static struct io_plan *recv_req(struct io_conn *conn,
 	case WIRE_GOSSIP_GETROUTE_REQUEST:
 		return getroute_req(conn, daemon, msg);
 
+	case WIRE_GOSSIP_GETROUTES_REQUEST:
+		return getroutes_req(conn, daemon, msg);
+
 	case WIRE_GOSSIP_GETCHANNELS_REQUEST:
 		return getchannels_req(conn, daemon, msg);
 
@@ -3327,6 +3583,8 @@ static struct io_plan *recv_req(struct io_conn *conn,
 		return dev_gossip_memleak(conn, daemon, msg);
 	case WIRE_GOSSIP_DEV_COMPACT_STORE:
 		return dev_compact_store(conn, daemon, msg);
+	case WIRE_GOSSIP_DEV_ROUTE_CACHE:
+		return dev_route_cache(conn, daemon, msg);
 #else
 	case WIRE_GOSSIP_QUERY_SCIDS:
 	case WIRE_GOSSIP_SEND_TIMESTAMP_FILTER:
@@ -3335,12 +3593,14 @@ static struct io_plan *recv_req(struct io_conn *conn,
 	case WIRE_GOSSIP_DEV_SUPPRESS:
 	case WIRE_GOSSIP_DEV_MEMLEAK:
 	case WIRE_GOSSIP_DEV_COMPACT_STORE:
+	case WIRE_GOSSIP_DEV_ROUTE_CACHE:
 		break;
 #endif /* !DEVELOPER */
 
 	/* We send these, we don't receive them */
 	case WIRE_GOSSIP_GETNODES_REPLY:
 	case WIRE_GOSSIP_GETROUTE_REPLY:
+	case WIRE_GOSSIP_GETROUTES_REPLY:
 	case WIRE_GOSSIP_GETCHANNELS_REPLY:
 	case WIRE_GOSSIP_PING_REPLY:
 	case WIRE_GOSSIP_SCIDS_REPLY:
@@ -3350,6 +3610,7 @@ static struct io_plan *recv_req(struct io_conn *conn,
 	case WIRE_GOSSIP_GET_TXOUT:
 	case WIRE_GOSSIP_DEV_MEMLEAK_REPLY:
 	case WIRE_GOSSIP_DEV_COMPACT_STORE_REPLY:
+	case WIRE_GOSSIP_DEV_ROUTE_CACHE_REPLY:
 		break;
 	}
 
@@ -3379,6 +3640,9 @@ int main(int argc, char *argv[])
 	list_head_init(&daemon->peers);
 	daemon->unknown_scids = tal_arr(daemon, struct short_channel_id, 0);
 	daemon->gossip_missing = NULL;
+	daemon->gossip_queue = tal_arr(daemon, struct queued_gossip, 0);
+	daemon->gossip_queue_timer = NULL;
+	daemon->sigcheck = new_sigcheck_pool(daemon, sigcheck_threads());
 
 	/* Note the use of time_mono() here.  That's a monotonic clock, which
 	 * is really useful: it can only be used to measure relative events
@@ -3,7 +3,9 @@
 #include <bitcoin/block.h>
 #include <bitcoin/script.h>
 #include <ccan/array_size/array_size.h>
+#include <ccan/crc32c/crc32c.h>
 #include <ccan/endian/endian.h>
+#include <ccan/ilog/ilog.h>
 #include <ccan/mem/mem.h>
 #include <ccan/tal/str/str.h>
 #include <common/features.h>
@@ -194,6 +196,13 @@ struct routing_state *new_routing_state(const tal_t *ctx,
 {
 	struct routing_state *rstate = tal(ctx, struct routing_state);
 	rstate->nodes = new_node_map(rstate);
+	rstate->node_arr = tal_arr(rstate, struct node *, 0);
+	rstate->dijkstra = tal_arr(rstate, struct dijkstra, 0);
+	rstate->unvisited_heap = tal_arr(rstate, u32, 0);
+	rstate->dijkstra_gen = 0;
+	rstate->edges = tal_arr(rstate, struct route_edge, 0);
+	rstate->edge_ranges = tal_arr(rstate, struct edge_range, 0);
+	rstate->edges_wasted = 0;
 	rstate->gs = gossip_store_new(rstate, peers);
 	rstate->chainparams = chainparams;
 	rstate->local_id = *local_id;
@@ -206,6 +215,11 @@ struct routing_state *new_routing_state(const tal_t *ctx,
 	uintmap_init(&rstate->unupdated_chanmap);
 	chan_map_init(&rstate->local_disabled_map);
 	uintmap_init(&rstate->txout_failures);
+	list_head_init(&rstate->route_cache.entries);
+	rstate->route_cache.num = 0;
+	rstate->route_cache.gen = 0;
+	rstate->route_cache.hits = rstate->route_cache.misses = 0;
+	rstate->route_cache.invalidated = 0;
 
 	rstate->pending_node_map = tal(ctx, struct pending_node_map);
 	pending_node_map_init(rstate->pending_node_map);
@@ -241,10 +255,125 @@ bool node_map_node_eq(const struct node *n, const struct node_id *pc)
 }
 
 
+/* Copy what routefinding needs from chan->half[dir] into its edge. */
+static void update_route_edge(struct routing_state *rstate,
+			      const struct chan *chan, int dir)
+{
+	const struct half_chan *hc = &chan->half[dir];
+	struct route_edge *e = &rstate->edges[hc->edge];
+
+	e->htlc_minimum = hc->htlc_minimum;
+	e->htlc_maximum = hc->htlc_maximum;
+	e->base_fee = hc->base_fee;
+	e->proportional_fee = hc->proportional_fee;
+	e->delay = hc->delay;
+	e->enabled = is_halfchan_enabled(hc)
+		&& !is_chan_local_disabled(rstate, chan);
+}
+
+static void move_route_edge(struct routing_state *rstate, u32 from, u32 to)
+{
+	struct route_edge *e = &rstate->edges[to];
+
+	*e = rstate->edges[from];
+	get_channel(rstate, &e->scid)->half[e->dir].edge = to;
+}
+
+/* Pack every node's edges together again, in node order. */
+static void compact_route_edges(struct routing_state *rstate)
+{
+	struct route_edge *old = rstate->edges;
+	size_t num = 0;
+
+	for (size_t i = 0; i < tal_count(rstate->edge_ranges); i++)
+		num += rstate->edge_ranges[i].num;
+
+	rstate->edges = tal_arr(rstate, struct route_edge, num);
+	num = 0;
+	for (size_t i = 0; i < tal_count(rstate->edge_ranges); i++) {
+		struct edge_range *r = &rstate->edge_ranges[i];
+
+		for (size_t j = 0; j < r->num; j++) {
+			struct route_edge *e = &rstate->edges[num + j];
+
+			*e = old[r->start + j];
+			get_channel(rstate, &e->scid)->half[e->dir].edge
+				= num + j;
+		}
+		r->start = num;
+		r->max = r->num;
+		num += r->num;
+	}
+	tal_free(old);
+	rstate->edges_wasted = 0;
+}
+
+/* Make room for another incoming edge for node_arr[nodeidx]. */
+static void grow_edge_range(struct routing_state *rstate, u32 nodeidx)
+{
+	struct edge_range *r = &rstate->edge_ranges[nodeidx];
+	size_t end;
+
+	if (r->num < r->max)
+		return;
+
+	if (rstate->edges_wasted > tal_count(rstate->edges) / 2)
+		compact_route_edges(rstate);
+
+	/* Double it: at the end of the array, we can just extend. */
+	end = tal_count(rstate->edges);
+	if (r->start + r->max == end) {
+		r->max = r->max ? r->max * 2 : 2;
+		tal_resize(&rstate->edges, r->start + r->max);
+		return;
+	}
+
+	r->max = r->max ? r->max * 2 : 2;
+	tal_resize(&rstate->edges, end + r->max);
+	for (size_t i = 0; i < r->num; i++)
+		move_route_edge(rstate, r->start + i, end + i);
+	rstate->edges_wasted += r->num;
+	r->start = end;
+}
+
+static void add_route_edge(struct routing_state *rstate,
+			   struct chan *chan, int dir)
+{
+	/* half[dir] goes from nodes[dir] to nodes[!dir] */
+	u32 dst = chan->nodes[!dir]->index;
+	struct edge_range *r;
+	struct route_edge *e;
+
+	grow_edge_range(rstate, dst);
+	r = &rstate->edge_ranges[dst];
+	chan->half[dir].edge = r->start + r->num++;
+
+	e = &rstate->edges[chan->half[dir].edge];
+	e->scid = chan->scid;
+	e->src = chan->nodes[dir]->index;
+	e->dst = dst;
+	e->dir = dir;
+	update_route_edge(rstate, chan, dir);
+}
+
+static void del_route_edge(struct routing_state *rstate,
+			   struct chan *chan, int dir)
+{
+	u32 edge = chan->half[dir].edge;
+	struct edge_range *r = &rstate->edge_ranges[rstate->edges[edge].dst];
+
+	/* Fill the gap with the last one in the range. */
+	r->num--;
+	if (edge != r->start + r->num)
+		move_route_edge(rstate, r->start + r->num, edge);
+}
+
 static void destroy_node(struct node *node, struct routing_state *rstate)
 {
 	struct chan_map_iter i;
 	struct chan *c;
+	struct node *last;
+
 	node_map_del(rstate->nodes, node);
 
 	/* These remove themselves from chans[]. */
@@ -254,6 +383,22 @@ static void destroy_node(struct node *node, struct routing_state *rstate)
 	/* Free htable if we need. */
 	if (node_uses_chan_map(node))
 		chan_map_clear(&node->chans.map);
+
+	/* Keep node_arr dense: move the last node into our slot.  That
+	 * means renumbering its edges, both incoming and outgoing. */
+	last = rstate->node_arr[tal_count(rstate->node_arr) - 1];
+	rstate->edges_wasted += rstate->edge_ranges[node->index].max;
+	rstate->edge_ranges[node->index] = rstate->edge_ranges[last->index];
+	for (c = first_chan(last, &i); c; c = next_chan(last, &i)) {
+		int idx = half_chan_to(last, c);
+
+		rstate->edges[c->half[idx].edge].dst = node->index;
+		rstate->edges[c->half[!idx].edge].src = node->index;
+	}
+	last->index = node->index;
+	rstate->node_arr[last->index] = last;
+	tal_resize(&rstate->node_arr, tal_count(rstate->node_arr) - 1);
+	tal_resize(&rstate->edge_ranges, tal_count(rstate->edge_ranges) - 1);
 }
 
 struct node *get_node(struct routing_state *rstate,
@@ -274,6 +419,15 @@ static struct node *new_node(struct routing_state *rstate,
 	memset(n->chans.arr, 0, sizeof(n->chans.arr));
 	broadcastable_init(&n->bcast);
 	node_map_add(rstate->nodes, n);
+	/* Can't use tal_arr_expand: it shadows n! */
+	n->index = tal_count(rstate->node_arr);
+	tal_resize(&rstate->node_arr, n->index + 1);
+	rstate->node_arr[n->index] = n;
+	/* No edges yet: grow_edge_range() will find it room. */
+	tal_resize(&rstate->edge_ranges, n->index + 1);
+	rstate->edge_ranges[n->index].start = tal_count(rstate->edges);
+	rstate->edge_ranges[n->index].num = 0;
+	rstate->edge_ranges[n->index].max = 0;
 	tal_add_destructor2(n, destroy_node, rstate);
 
 	return n;
@@ -381,10 +535,65 @@ static void remove_chan_from_node(struct routing_state *rstate,
 	}
 }
 
+/*~ Payment processors tend to pay the same few nodes over and over, and
+ * between payments the graph barely changes.  So we remember the routes
+ * get_route() found, and forget one whenever a channel on it changes. */
+#define ROUTE_CACHE_MAX 128
+
+struct route_cache_entry {
+	/* First, so memleak sees the list pointing at us. */
+	struct list_node list;
+
+	/* What we were asked: any amount with the same highest bit will do,
+	 * since we check the route still carries it before reusing it. */
+	bool have_source;
+	struct node_id source, destination;
+	int amount_bucket;
+	double riskfactor;
+	size_t max_hops;
+	struct short_channel_id_dir *excluded;
+
+	/* route_cache.gen when we found it. */
+	u64 gen;
+	struct chan **route;
+};
+
+static void route_cache_del(struct route_cache *cache,
+			    struct route_cache_entry *e)
+{
+	list_del_from(&cache->entries, &e->list);
+	cache->num--;
+	tal_free(e);
+}
+
+/* Drop any cached route which uses this channel. */
+static void route_cache_forget_chan(struct routing_state *rstate,
+				    const struct chan *chan)
+{
+	struct route_cache *cache = &rstate->route_cache;
+	struct route_cache_entry *e, *next;
+
+	list_for_each_safe(&cache->entries, e, next, list) {
+		for (size_t i = 0; i < tal_count(e->route); i++) {
+			if (e->route[i] == chan) {
+				route_cache_del(cache, e);
+				cache->invalidated++;
+				break;
+			}
+		}
+	}
+}
+
 /* We used to make this a tal_add_destructor2, but that costs 40 bytes per
  * chan, and we only ever explicitly free it anyway. */
 void free_chan(struct routing_state *rstate, struct chan *chan)
 {
+	/* Cached routes keep pointers to it! */
+	route_cache_forget_chan(rstate, chan);
+
+	del_route_edge(rstate, chan, 0);
+	del_route_edge(rstate, chan, 1);
+
 	remove_chan_from_node(rstate, chan->nodes[0], chan);
 	remove_chan_from_node(rstate, chan->nodes[1], chan);
 
@@ -405,6 +614,7 @@ static void init_half_chan(struct routing_state *rstate,
 	c->channel_flags = channel_idx;
 	// TODO: wireup message_flags
 	c->message_flags = 0;
+	c->csum = 0;
 	broadcastable_init(&c->bcast);
 }
 
@@ -453,44 +663,44 @@ struct chan *new_chan(struct routing_state *rstate,
 	init_half_chan(rstate, chan, !n1idx);
 
 	uintmap_add(&rstate->chanmap, scid->u64, chan);
+
+	add_route_edge(rstate, chan, 0);
+	add_route_edge(rstate, chan, 1);
 	return chan;
 }
 
 /* Too big to reach, but don't overflow if added. */
 #define INFINITE AMOUNT_MSAT(0x3FFFFFFFFFFFFFFFULL)
 
-/* We hack a multimap into a uintmap to implement a minheap by cost.
- * This is relatively inefficient, containing an array for each cost
- * value, assuming there aren't too many at same cost.
- *
- * We further optimize by never freeing or shrinking these entries,
- * but delete by replacing with NULL.  This means that we cache the
- * lowest index which actually contains something, since others may
- * contain empty arrays. */
+/* dijkstra.heapidx once a node has been removed from the unvisited heap */
+#define DIJKSTRA_VISITED UINT32_MAX
+
+/* A binary minheap of node indices, ordered by cost.  Each node's
+ * dijkstra.heapidx tracks where it is, so we can move it up when we find
+ * a cheaper way to reach it.  This all lives in routing_state, so we don't
+ * reallocate it for every search. */
 struct unvisited {
-	u64 min_index;
-	UINTMAP(struct node **) map;
+	/* rstate->node_arr and rstate->dijkstra */
+	struct node **nodes;
+	struct dijkstra *dij;
+	/* The heap itself: the first num entries are valid. */
+	u32 *heap;
+	size_t num;
+	/* Entries in dij with a different gen haven't been reached. */
+	u32 gen;
 };
 
 
-/* Risk of passing through this channel.
- *
- * There are two ways this function is used:
- *
- * 1. Normally, riskbias = 1.  A tiny bias here in order to prefer
- *    shorter routes, all things equal.
- * 2. Trying to find a shorter route, riskbias > 1.  By adding an extra
- *    cost to every hop, we're trying to bias against overlength routes.
- */
+/* Risk of passing through this channel.  We add a tiny bias here in order
+ * to prefer shorter routes, all things equal. */
 static WARN_UNUSED_RESULT bool risk_add_fee(struct amount_msat *risk,
 					    struct amount_msat msat,
-					    u32 delay, double riskfactor,
-					    u64 riskbias)
+					    u32 delay, double riskfactor)
 {
 	double r;
 
 	/* Won't overflow on add, just lose precision */
-	r = (double)riskbias + riskfactor * delay * msat.millisatoshis + risk->millisatoshis; /* Raw: to double */
+	r = 1.0 + riskfactor * delay * msat.millisatoshis + risk->millisatoshis; /* Raw: to double */
 	if (r > UINT64_MAX)
 		return false;
 	risk->millisatoshis = r; /* Raw: from double */
@@ -500,11 +710,11 @@ static WARN_UNUSED_RESULT bool risk_add_fee(struct amount_msat *risk,
 /* Check that we can fit through this channel's indicated
  * maximum_ and minimum_msat requirements.
  */
-static bool hc_can_carry(const struct half_chan *hc,
-			 struct amount_msat requiredcap)
+static bool edge_can_carry(const struct route_edge *e,
+			   struct amount_msat requiredcap)
 {
-	return amount_msat_greater_eq(hc->htlc_maximum, requiredcap) &&
-		amount_msat_less_eq(hc->htlc_minimum, requiredcap);
+	return amount_msat_greater_eq(e->htlc_maximum, requiredcap) &&
+		amount_msat_less_eq(e->htlc_minimum, requiredcap);
 }
 
 /* Theoretically, this could overflow. */
@@ -535,23 +745,21 @@ static bool fuzz_fee(u64 *fee,
 
 /* Can we carry this amount across the channel?  If so, returns true and
  * sets newtotal and newrisk */
-static bool can_reach(const struct half_chan *c,
-		      const struct short_channel_id *scid,
+static bool can_reach(const struct route_edge *e,
 		      bool no_charge,
 		      struct amount_msat total,
 		      struct amount_msat risk,
 		      double riskfactor,
-		      u64 riskbias,
 		      double fuzz, const struct siphash_seed *base_seed,
 		      struct amount_msat *newtotal, struct amount_msat *newrisk)
 {
 	/* FIXME: Bias against smaller channels. */
 	struct amount_msat fee;
 
-	if (!amount_msat_fee(&fee, total, c->base_fee, c->proportional_fee))
+	if (!amount_msat_fee(&fee, total, e->base_fee, e->proportional_fee))
 		return false;
 
-  	if (!fuzz_fee(&fee.millisatoshis, scid, fuzz, base_seed)) /* Raw: double manipulation */
+  	if (!fuzz_fee(&fee.millisatoshis, &e->scid, fuzz, base_seed)) /* Raw: double manipulation */
 		return false;
 
 	if (no_charge) {
@@ -571,10 +779,10 @@ static bool can_reach(const struct half_chan *c,
 
 	/* Skip a channel if it indicated that it won't route the
 	 * requested amount. */
-	if (!hc_can_carry(c, *newtotal))
+	if (!edge_can_carry(e, *newtotal))
 		return false;
 
-	if (!risk_add_fee(newrisk, *newtotal, c->delay, riskfactor, riskbias))
+	if (!risk_add_fee(newrisk, *newtotal, e->delay, riskfactor))
 		return false;
 
 	return true;
@@ -598,19 +806,6 @@ normal_cost_function(struct amount_msat *cost,
 	return false;
 }
 
-static WARN_UNUSED_RESULT bool
-shortest_cost_function(struct amount_msat *cost,
-		       struct amount_msat total, struct amount_msat risk)
-{
-	/* We add 1, so cost is never 0, for our hacky uintmap-as-minheap. */
-	if (amount_msat_add(cost, risk, AMOUNT_MSAT(1)))
-		return true;
-
-	status_broken("Can't add 1 to risk of node %s",
-		      type_to_string(tmpctx, struct amount_msat, &risk));
-	return false;
-}
-
 /* Does totala+riska add up to less than totalb+riskb?
  * Saves sums if you want them.
  */
@@ -636,180 +831,157 @@ static bool costs_less(struct amount_msat totala,
 	return amount_msat_less(suma, sumb);
 }
 
-/* Determine if the given half_chan is routable */
-static bool hc_is_routable(struct routing_state *rstate,
-			   const struct chan *chan, int idx)
+/* Nodes we haven't reached yet cost INFINITE */
+static struct amount_msat dijkstra_total(const struct unvisited *unvisited,
+					 u32 nodeidx)
 {
-	return is_halfchan_enabled(&chan->half[idx])
-		&& !is_chan_local_disabled(rstate, chan);
+	const struct dijkstra *d = &unvisited->dij[nodeidx];
+
+	if (d->gen != unvisited->gen)
+		return INFINITE;
+	return d->total;
 }
 
-static void unvisited_add(struct unvisited *unvisited, struct amount_msat cost,
-			  struct node **arr)
+static struct amount_msat dijkstra_risk(const struct unvisited *unvisited,
+					u32 nodeidx)
 {
-	u64 idx = cost.millisatoshis; /* Raw: uintmap needs u64 index */
-	if (idx < unvisited->min_index) {
-		assert(idx); /* We don't allow sending 0 satoshis */
-		unvisited->min_index = idx - 1;
-	}
-	uintmap_add(&unvisited->map, idx, arr);
+	const struct dijkstra *d = &unvisited->dij[nodeidx];
+
+	if (d->gen != unvisited->gen)
+		return INFINITE;
+	return d->risk;
 }
 
-static struct node **unvisited_get(const struct unvisited *unvisited,
-				   struct amount_msat cost)
+static bool is_unvisited(u32 nodeidx, const struct unvisited *unvisited)
 {
-	return uintmap_get(&unvisited->map, cost.millisatoshis); /* Raw: uintmap */
+	const struct dijkstra *d = &unvisited->dij[nodeidx];
+
+	return d->gen != unvisited->gen || d->heapidx != DIJKSTRA_VISITED;
 }
 
-static struct node **unvisited_del(struct unvisited *unvisited,
-				   struct amount_msat cost)
+static void heap_set(struct unvisited *unvisited, size_t pos, u32 nodeidx)
 {
-	return uintmap_del(&unvisited->map, cost.millisatoshis); /* Raw: uintmap */
+	unvisited->heap[pos] = nodeidx;
+	unvisited->dij[nodeidx].heapidx = pos;
 }
 
-static bool is_unvisited(const struct node *node,
-			 const struct unvisited *unvisited,
-			 costfn_t *costfn)
+static bool heap_less(const struct unvisited *unvisited, u32 a, u32 b)
 {
-	struct node **arr;
-	struct amount_msat cost;
+	return amount_msat_less(unvisited->dij[a].cost, unvisited->dij[b].cost);
+}
 
-	/* If it's infinite, definitely unvisited */
-	if (amount_msat_eq(node->dijkstra.total, INFINITE))
-		return true;
+/* Node at pos may be cheaper than its parents: move it up. */
+static void heap_up(struct unvisited *unvisited, size_t pos)
+{
+	u32 nodeidx = unvisited->heap[pos];
 
-	/* Shouldn't happen! */
-	if (!costfn(&cost, node->dijkstra.total, node->dijkstra.risk))
-		return false;
+	while (pos > 0) {
+		size_t parent = (pos - 1) / 2;
 
-	arr = unvisited_get(unvisited, cost);
-	for (size_t i = 0; i < tal_count(arr); i++) {
-		if (arr[i] == node)
-			return true;
+		if (!heap_less(unvisited, nodeidx, unvisited->heap[parent]))
+			break;
+		heap_set(unvisited, pos, unvisited->heap[parent]);
+		pos = parent;
 	}
-	return false;
+	heap_set(unvisited, pos, nodeidx);
 }
 
-static void unvisited_del_node(struct unvisited *unvisited,
-			       struct amount_msat cost,
-			       const struct node *node)
+/* Node at pos may be dearer than its children: move it down. */
+static void heap_down(struct unvisited *unvisited, size_t pos)
 {
-	struct node **arr;
+	u32 nodeidx = unvisited->heap[pos];
 
-	arr = unvisited_get(unvisited, cost);
-	for (size_t i = 0; i < tal_count(arr); i++) {
-		if (arr[i] == node) {
-			arr[i] = NULL;
-			return;
-		}
+	for (;;) {
+		size_t child = pos * 2 + 1;
+
+		if (child >= unvisited->num)
+			break;
+		if (child + 1 < unvisited->num
+		    && heap_less(unvisited, unvisited->heap[child + 1],
+				 unvisited->heap[child]))
+			child++;
+		if (!heap_less(unvisited, unvisited->heap[child], nodeidx))
+			break;
+		heap_set(unvisited, pos, unvisited->heap[child]);
+		pos = child;
 	}
-	abort();
+	heap_set(unvisited, pos, nodeidx);
 }
 
-static void adjust_unvisited(struct node *node,
+static void adjust_unvisited(u32 nodeidx,
 			     struct unvisited *unvisited,
-			     struct amount_msat cost_before,
 			     struct amount_msat total,
 			     struct amount_msat risk,
-			     struct amount_msat cost_after)
+			     struct amount_msat cost_after,
+			     u32 edge)
 {
-	struct node **arr;
-
-	/* If it was in unvisited map, remove it. */
-	if (!amount_msat_eq(node->dijkstra.total, INFINITE))
-		unvisited_del_node(unvisited, cost_before, node);
+	struct dijkstra *d = &unvisited->dij[nodeidx];
+	bool reached = (d->gen == unvisited->gen);
 
 	/* Update node */
-	node->dijkstra.total = total;
-	node->dijkstra.risk = risk;
+	d->gen = unvisited->gen;
+	d->total = total;
+	d->risk = risk;
+	d->cost = cost_after;
+	d->edge = edge;
 
 	SUPERVERBOSE("%s now cost %s",
-		     type_to_string(tmpctx, struct node_id, &node->id),
+		     type_to_string(tmpctx, struct node_id,
+				    &unvisited->nodes[nodeidx]->id),
 		     type_to_string(tmpctx, struct amount_msat, &cost_after));
 
-	/* Update map of unvisited nodes */
-	arr = unvisited_get(unvisited, cost_after);
-	if (arr) {
-		struct node **old_arr;
-		/* Try for empty slot */
-		for (size_t i = 0; i < tal_count(arr); i++) {
-			if (arr[i] == NULL) {
-				arr[i] = node;
-				return;
-			}
-		}
-		/* Nope, expand */
-		old_arr = arr;
-		tal_arr_expand(&arr, node);
-		if (arr == old_arr)
-			return;
-
-		/* Realloc moved it; del and add again. */
-		unvisited_del(unvisited, cost_after);
-	} else {
-		arr = tal_arr(unvisited, struct node *, 1);
-		arr[0] = node;
-	}
-
-	unvisited_add(unvisited, cost_after, arr);
-}
-
-static void remove_unvisited(struct node *node, struct unvisited *unvisited,
-			     costfn_t *costfn)
-{
-	struct amount_msat cost;
-
-	/* Shouldn't happen! */
-	if (!costfn(&cost, node->dijkstra.total, node->dijkstra.risk))
+	/* It can only have become cheaper, so it can only move up. */
+	if (reached) {
+		heap_up(unvisited, d->heapidx);
 		return;
+	}
 
-	unvisited_del_node(unvisited, cost, node);
+	heap_set(unvisited, unvisited->num, nodeidx);
+	heap_up(unvisited, unvisited->num++);
 }
 
 static void update_unvisited_neighbors(struct routing_state *rstate,
-				       struct node *cur,
+				       u32 cur,
 				       const struct node *me,
 				       double riskfactor,
-				       u64 riskbias,
 				       double fuzz,
 				       const struct siphash_seed *base_seed,
 				       struct unvisited *unvisited,
 				       costfn_t *costfn)
 {
-	struct chan_map_iter i;
-	struct chan *chan;
+	const struct edge_range *r = &rstate->edge_ranges[cur];
 
-	/* Consider all neighbors */
-	for (chan = first_chan(cur, &i); chan; chan = next_chan(cur, &i)) {
-		struct amount_msat total, risk, cost_before, cost_after;
-		int idx = half_chan_to(cur, chan);
-		struct node *peer = chan->nodes[idx];
+	/* Consider all neighbors: these are the edges *into* cur. */
+	for (u32 i = r->start; i < r->start + r->num; i++) {
+		const struct route_edge *e = &rstate->edges[i];
+		struct amount_msat total, risk, cost_after;
 
 		SUPERVERBOSE("CONSIDERING: %s -> %s (%s/%s)",
 			     type_to_string(tmpctx, struct node_id,
-					    &cur->id),
+					    &unvisited->nodes[cur]->id),
 			     type_to_string(tmpctx, struct node_id,
-					    &peer->id),
+					    &unvisited->nodes[e->src]->id),
 			     type_to_string(tmpctx, struct amount_msat,
-					    &peer->dijkstra.total),
+					    &unvisited->dij[e->src].total),
 			     type_to_string(tmpctx, struct amount_msat,
-					    &peer->dijkstra.risk));
+					    &unvisited->dij[e->src].risk));
 
-		if (!hc_is_routable(rstate, chan, idx)) {
+		if (!e->enabled) {
 			SUPERVERBOSE("... not routable");
 			continue;
 		}
 
-		if (!is_unvisited(peer, unvisited, costfn)) {
+		if (!is_unvisited(e->src, unvisited)) {
 			SUPERVERBOSE("... already visited");
 			continue;
 		}
 
 		/* We're looking at channels *backwards*, so peer == me
 		 * is the right test here for whether we don't charge fees. */
-		if (!can_reach(&chan->half[idx], &chan->scid, peer == me,
-			       cur->dijkstra.total, cur->dijkstra.risk,
-			       riskfactor, riskbias, fuzz, base_seed,
+		if (!can_reach(e, me && e->src == me->index,
+			       dijkstra_total(unvisited, cur),
+			       dijkstra_risk(unvisited, cur),
+			       riskfactor, fuzz, base_seed,
 			       &total, &risk)) {
 			SUPERVERBOSE("... can't reach");
 			continue;
@@ -817,58 +989,56 @@ static void update_unvisited_neighbors(struct routing_state *rstate,
 
 		/* This effectively adds it to the map if it was infinite */
 		if (costs_less(total, risk, &cost_after,
-			       peer->dijkstra.total, peer->dijkstra.risk,
-			       &cost_before,
+			       dijkstra_total(unvisited, e->src),
+			       dijkstra_risk(unvisited, e->src),
+			       NULL,
 			       costfn)) {
 			SUPERVERBOSE("...%s can reach %s"
 				     " total %s risk %s",
 				     type_to_string(tmpctx, struct node_id,
-						    &cur->id),
+						    &unvisited->nodes[cur]->id),
 				     type_to_string(tmpctx, struct node_id,
-						    &peer->id),
+						    &unvisited->nodes[e->src]->id),
 				     type_to_string(tmpctx, struct amount_msat,
 						    &total),
 				     type_to_string(tmpctx, struct amount_msat,
 						    &risk));
-			adjust_unvisited(peer, unvisited,
-					 cost_before, total, risk, cost_after);
+			adjust_unvisited(e->src, unvisited,
+					 total, risk, cost_after, i);
 		}
 	}
 }
 
-static struct node *first_unvisited(struct unvisited *unvisited)
+/* Pop the cheapest unvisited node from the heap. */
+static bool first_unvisited(struct unvisited *unvisited, u32 *nodeidx)
 {
-	struct node **arr;
+	if (unvisited->num == 0)
+		return false;
 
-	while ((arr = uintmap_after(&unvisited->map, &unvisited->min_index))) {
-		for (size_t i = 0; i < tal_count(arr); i++) {
-			if (arr[i]) {
-				unvisited->min_index--;
-				return arr[i];
-			}
-		}
+	*nodeidx = unvisited->heap[0];
+	unvisited->dij[*nodeidx].heapidx = DIJKSTRA_VISITED;
+	if (--unvisited->num != 0) {
+		heap_set(unvisited, 0, unvisited->heap[unvisited->num]);
+		heap_down(unvisited, 0);
 	}
-
-	return NULL;
+	return true;
 }
 
 static void dijkstra(struct routing_state *rstate,
 		     const struct node *dst,
 		     const struct node *me,
 		     double riskfactor,
-		     u64 riskbias,
 		     double fuzz, const struct siphash_seed *base_seed,
 		     struct unvisited *unvisited,
 		     costfn_t *costfn)
 {
-	struct node *cur;
+	u32 cur;
 
-	while ((cur = first_unvisited(unvisited)) != NULL) {
+	while (first_unvisited(unvisited, &cur)) {
 		update_unvisited_neighbors(rstate, cur, me,
-					   riskfactor, riskbias,
-					   fuzz, base_seed, unvisited, costfn);
-		remove_unvisited(cur, unvisited, costfn);
-		if (cur == dst)
+					   riskfactor, fuzz, base_seed,
+					   unvisited, costfn);
+		if (cur == dst->index)
 			return;
 	}
 }
@@ -877,89 +1047,45 @@ static void dijkstra(struct routing_state *rstate,
  * here has a high cost, "to" has a cost of exact amount sent. */
 static struct chan **build_route(const tal_t *ctx,
 				 struct routing_state *rstate,
+				 const struct unvisited *unvisited,
 				 const struct node *from,
 				 const struct node *to,
-				 const struct node *me,
-				 double riskfactor,
-				 u64 riskbias,
-				 double fuzz,
-				 const struct siphash_seed *base_seed,
 				 struct amount_msat *fee)
 {
-	const struct node *i;
-	struct chan **route, *chan;
+	u32 i;
+	struct chan **route;
 
 	SUPERVERBOSE("Building route from %s (%s) -> %s (%s)",
 		     type_to_string(tmpctx, struct node_id, &from->id),
 		     type_to_string(tmpctx, struct amount_msat,
-				    &from->dijkstra.total),
+				    &unvisited->dij[from->index].total),
 		     type_to_string(tmpctx, struct node_id, &to->id),
 		     type_to_string(tmpctx, struct amount_msat,
-				    &to->dijkstra.total));
+				    &unvisited->dij[to->index].total));
 	/* Never reached? */
-	if (amount_msat_eq(from->dijkstra.total, INFINITE))
+	if (amount_msat_eq(dijkstra_total(unvisited, from->index), INFINITE))
 		return NULL;
 
-	/* Walk to find which neighbors we used */
+	/* Follow the edges we reached each node by */
 	route = tal_arr(ctx, struct chan *, 0);
-	for (i = from; i != to; i = other_node(i, chan)) {
-		struct chan_map_iter it;
-
-		/* Consider all neighbors */
-		for (chan = first_chan(i, &it); chan; chan = next_chan(i, &it)) {
-			struct node *peer = other_node(i, chan);
-			struct half_chan *hc = half_chan_from(i, chan);
-			struct amount_msat total, risk;
-
-			SUPERVERBOSE("CONSIDER: %s -> %s (%s/%s)",
-				     type_to_string(tmpctx, struct node_id,
-						    &i->id),
-				     type_to_string(tmpctx, struct node_id,
-						    &peer->id),
-				     type_to_string(tmpctx, struct amount_msat,
-						    &peer->dijkstra.total),
-				     type_to_string(tmpctx, struct amount_msat,
-						    &peer->dijkstra.risk));
+	for (i = from->index; i != to->index;) {
+		const struct route_edge *e
+			= &rstate->edges[unvisited->dij[i].edge];
 
-			/* If traversing this wasn't possible, ignore */
-			if (!hc_is_routable(rstate, chan, !half_chan_to(i, chan))) {
-				continue;
-			}
-
-			if (!can_reach(hc, &chan->scid, i == me,
-				       peer->dijkstra.total, peer->dijkstra.risk,
-				       riskfactor,
-				       riskbias,
-				       fuzz, base_seed,
-				       &total, &risk))
-				continue;
-
-			/* If this was the path we took, we're done (if there are
-			 * two identical ones, it doesn't matter which) */
-			if (amount_msat_eq(total, i->dijkstra.total)
-			    && amount_msat_eq(risk, i->dijkstra.risk))
-				break;
-		}
-
-		if (!chan) {
-			status_broken("Could not find hop to %s",
-				      type_to_string(tmpctx, struct node_id,
-						     &i->id));
-			return tal_free(route);
-		}
-		tal_arr_expand(&route, chan);
+		tal_arr_expand(&route, get_channel(rstate, &e->scid));
+		i = e->dst;
 	}
 
 	/* We don't charge ourselves fees, so skip first hop */
+	i = rstate->edges[unvisited->dij[from->index].edge].dst;
 	if (!amount_msat_sub(fee,
-			     other_node(from, route[0])->dijkstra.total,
-			     to->dijkstra.total)) {
+			     dijkstra_total(unvisited, i),
+			     dijkstra_total(unvisited, to->index))) {
 		status_broken("Could not subtract %s - %s for fee",
 			      type_to_string(tmpctx, struct amount_msat,
-					     &other_node(from, route[0])
-					     ->dijkstra.total),
+					     &unvisited->dij[i].total),
 			      type_to_string(tmpctx, struct amount_msat,
-					     &to->dijkstra.total));
+					     &unvisited->dij[to->index].total));
 		return tal_free(route);
 	}
 
@@ -972,172 +1098,211 @@ static struct unvisited *dijkstra_prepare(const tal_t *ctx,
 					  struct amount_msat msat,
 					  costfn_t *costfn)
 {
-	struct node_map_iter it;
 	struct unvisited *unvisited;
-	struct node *n;
-	struct node **arr;
+	size_t num_nodes = tal_count(rstate->node_arr);
 	struct amount_msat cost;
 
-	unvisited = tal(tmpctx, struct unvisited);
-	uintmap_init(&unvisited->map);
-	unvisited->min_index = UINT64_MAX;
+	/* New nodes since last time?  A gen of 0 means never reached. */
+	if (tal_count(rstate->dijkstra) < num_nodes) {
+		size_t old_num = tal_count(rstate->dijkstra);
 
-	/* Reset all the information. */
-	for (n = node_map_first(rstate->nodes, &it);
-	     n;
-	     n = node_map_next(rstate->nodes, &it)) {
-		if (n == src)
-			continue;
-		n->dijkstra.total = INFINITE;
-		n->dijkstra.risk = INFINITE;
+		tal_resize(&rstate->dijkstra, num_nodes);
+		tal_resize(&rstate->unvisited_heap, num_nodes);
+		for (size_t i = old_num; i < num_nodes; i++)
+			rstate->dijkstra[i].gen = 0;
+	}
+
+	/* Rather than resetting every node, we start a new generation. */
+	if (++rstate->dijkstra_gen == 0) {
+		/* Wrapped, so do it the hard way. */
+		for (size_t i = 0; i < tal_count(rstate->dijkstra); i++)
+			rstate->dijkstra[i].gen = 0;
+		rstate->dijkstra_gen = 1;
 	}
 
-	/* Mark start cost: place in unvisited map. */
-	src->dijkstra.total = msat;
-	src->dijkstra.risk = AMOUNT_MSAT(0);
-	arr = tal_arr(unvisited, struct node *, 1);
-	arr[0] = src;
+	unvisited = tal(ctx, struct unvisited);
+	unvisited->nodes = rstate->node_arr;
+	unvisited->dij = rstate->dijkstra;
+	unvisited->heap = rstate->unvisited_heap;
+	unvisited->num = 0;
+	unvisited->gen = rstate->dijkstra_gen;
+
+	/* Mark start cost: place in unvisited heap. */
 	/* Adding 0 can never fail */
-	if (!costfn(&cost, src->dijkstra.total, src->dijkstra.risk))
+	if (!costfn(&cost, msat, AMOUNT_MSAT(0)))
 		abort();
-	unvisited_add(unvisited, cost, arr);
+	adjust_unvisited(src->index, unvisited, msat, AMOUNT_MSAT(0), cost,
+			 UINT32_MAX);
 
 	return unvisited;
 }
 
-static void dijkstra_cleanup(struct unvisited *unvisited)
-{
-	struct node **arr;
-	u64 idx;
-
-	/* uintmap uses malloc, so manual cleaning needed */
-	while ((arr = uintmap_first(&unvisited->map, &idx)) != NULL) {
-		tal_free(arr);
-		uintmap_del(&unvisited->map, idx);
-	}
-	tal_free(unvisited);
-}
+/* A way to get from src to node using a given number of hops. */
+struct hop_label {
+	/* Which node (offset in rstate->node_arr) */
+	u32 node;
+	/* Offset in rstate->edges we take from node towards src. */
+	u32 edge;
+	/* The label at the other end of that edge, one hop closer to src. */
+	u32 prev;
+	struct amount_msat total, risk, cost;
+};
 
-/* We need to start biassing against long routes. */
+/* Add or improve the label for this node in the layer we're building
+ * (which starts at layer_end). */
+static u32 set_hop_label(struct hop_label **labels,
+			 struct unvisited *unvisited,
+			 size_t layer_end,
+			 u32 nodeidx, u32 edge, u32 prev,
+			 struct amount_msat total,
+			 struct amount_msat risk,
+			 struct amount_msat cost)
+{
+	struct dijkstra *d = &unvisited->dij[nodeidx];
+	struct hop_label *l;
+
+	/* Reached using fewer hops?  That label is still useful for
+	 * shorter routes, so we only replace labels in this layer. */
+	if (d->gen != unvisited->gen || d->label < layer_end) {
+		d->label = tal_count(*labels);
+		tal_resize(labels, d->label + 1);
+	}
+	d->gen = unvisited->gen;
+	d->total = total;
+	d->risk = risk;
+	d->cost = cost;
+
+	l = &(*labels)[d->label];
+	l->node = nodeidx;
+	l->edge = edge;
+	l->prev = prev;
+	l->total = total;
+	l->risk = risk;
+	l->cost = cost;
+	return d->label;
+}
+
+/* The cheapest route is too long, so find the cheapest one which is
+ * at most max_hops long.
+ *
+ * This is Bellman-Ford, one hop at a time: each layer of labels holds the
+ * nodes we found a cheaper way to reach using one more hop than the layer
+ * before.  A longer route is only interesting if it's cheaper, so only
+ * those nodes can improve anything in the next layer, and we can stop
+ * as soon as a layer is empty. */
 static struct chan **
-find_shorter_route(const tal_t *ctx, struct routing_state *rstate,
-		   struct node *src, struct node *dst,
-		   const struct node *me,
-		   struct amount_msat msat,
-		   size_t max_hops,
-		   double fuzz, const struct siphash_seed *base_seed,
-		   struct chan **long_route,
-		   struct amount_msat *fee)
+hop_bounded_route(const tal_t *ctx, struct routing_state *rstate,
+		  struct node *src, struct node *dst,
+		  const struct node *me,
+		  struct amount_msat msat,
+		  double riskfactor,
+		  size_t max_hops,
+		  double fuzz, const struct siphash_seed *base_seed,
+		  struct amount_msat *fee)
 {
 	struct unvisited *unvisited;
-	struct chan **short_route = NULL;
-	struct amount_msat long_cost, short_cost, cost_diff;
-	u64 min_bias, max_bias;
-	double riskfactor;
+	struct hop_label *labels;
+	struct chan **route;
+	size_t layer_start, layer_end;
+	u32 best = UINT32_MAX;
 
-	/* We traverse backwards, so dst has largest total */
-	if (!amount_msat_sub(&long_cost,
-			     dst->dijkstra.total, src->dijkstra.total))
-		goto bad_total;
-	tal_free(long_route);
-
-	/* FIXME: It's hard to juggle both the riskfactor and riskbias here,
-	 * so we set our riskfactor to rougly equate to 1 millisatoshi
-	 * per block delay, which is close enough to zero to not break
-	 * this algorithm, but still provide some bias towards
-	 * low-delay routes. */
-	riskfactor = (double)1.0 / msat.millisatoshis; /* Raw: inversion */
-
-	/* First, figure out if a short route is even possible.
-	 * We set the cost function to ignore total, riskbias 1 and riskfactor
-	 * ~0 so risk simply operates as a simple hop counter. */
+	/* We don't use the heap, just the dijkstra entries: each one holds
+	 * the cheapest label for that node so far. */
 	unvisited = dijkstra_prepare(tmpctx, rstate, src, msat,
-				     shortest_cost_function);
-	SUPERVERBOSE("Running shortest path from %s -> %s",
-		     type_to_string(tmpctx, struct node_id, &dst->id),
-		     type_to_string(tmpctx, struct node_id, &src->id));
-	dijkstra(rstate, dst, NULL, riskfactor, 1, fuzz, base_seed,
-		 unvisited, shortest_cost_function);
-	dijkstra_cleanup(unvisited);
-
-	/* This must succeed, since we found a route before */
-	short_route = build_route(ctx, rstate, dst, src, me, riskfactor, 1,
-				  fuzz, base_seed, fee);
-	assert(short_route);
-	if (!amount_msat_sub(&short_cost,
-			     dst->dijkstra.total, src->dijkstra.total))
-		goto bad_total;
-
-	/* Still too long?  Oh well. */
-	if (tal_count(short_route) > max_hops) {
-		status_info("Minimal possible route %s->%s is %zu",
+				     normal_cost_function);
+	labels = tal_arr(tmpctx, struct hop_label, 1);
+	labels[0].node = src->index;
+	labels[0].edge = labels[0].prev = UINT32_MAX;
+	labels[0].total = msat;
+	labels[0].risk = AMOUNT_MSAT(0);
+	labels[0].cost = unvisited->dij[src->index].cost;
+	unvisited->dij[src->index].label = 0;
+
+	layer_start = 0;
+	layer_end = 1;
+	for (size_t hops = 1;
+	     hops <= max_hops && layer_start < layer_end;
+	     hops++) {
+		for (size_t l = layer_start; l < layer_end; l++) {
+			const struct edge_range *r
+				= &rstate->edge_ranges[labels[l].node];
+
+			/* No point going through dst, or continuing
+			 * something already dearer than a route to dst. */
+			if (labels[l].node == dst->index)
+				continue;
+			if (best != UINT32_MAX
+			    && !amount_msat_less(labels[l].cost,
+						 labels[best].cost))
+				continue;
+
+			for (u32 i = r->start; i < r->start + r->num; i++) {
+				const struct route_edge *e = &rstate->edges[i];
+				struct amount_msat total, risk, cost;
+				u32 label;
+
+				if (!e->enabled)
+					continue;
+
+				if (!can_reach(e, me && e->src == me->index,
+					       labels[l].total, labels[l].risk,
+					       riskfactor, fuzz, base_seed,
+					       &total, &risk))
+					continue;
+
+				if (!costs_less(total, risk, &cost,
+						dijkstra_total(unvisited, e->src),
+						dijkstra_risk(unvisited, e->src),
+						NULL, normal_cost_function))
+					continue;
+
+				if (best != UINT32_MAX
+				    && !amount_msat_less(cost,
+							 labels[best].cost))
+					continue;
+
+				label = set_hop_label(&labels, unvisited,
+						      layer_end, e->src, i, l,
+						      total, risk, cost);
+				if (e->src == dst->index)
+					best = label;
+			}
+		}
+		SUPERVERBOSE("%zu hops: %zu new labels",
+			     hops, tal_count(labels) - layer_end);
+		layer_start = layer_end;
+		layer_end = tal_count(labels);
+	}
+
+	if (best == UINT32_MAX) {
+		status_info("No route %s->%s within %zu hops",
 			    type_to_string(tmpctx, struct node_id, &dst->id),
 			    type_to_string(tmpctx, struct node_id, &src->id),
-			    tal_count(short_route));
-		goto out;
+			    max_hops);
+		tal_free(labels);
+		tal_free(unvisited);
+		return NULL;
 	}
 
-	/* OK, so it's possible, just more expensive. */
-	min_bias = 0;
-
-	if (!amount_msat_sub(&cost_diff, short_cost, long_cost)) {
-		status_broken("Short cost %s < long cost %s?",
-			      type_to_string(tmpctx, struct amount_msat,
-					     &short_cost),
-			      type_to_string(tmpctx, struct amount_msat,
-					     &long_cost));
-		goto out;
+	/* Follow the labels back towards src. */
+	route = tal_arr(ctx, struct chan *, 0);
+	for (u32 l = best; labels[l].prev != UINT32_MAX; l = labels[l].prev) {
+		const struct route_edge *e = &rstate->edges[labels[l].edge];
+		tal_arr_expand(&route, get_channel(rstate, &e->scid));
 	}
 
-	/* This is a gross overestimate, but it works. */
-	max_bias = cost_diff.millisatoshis; /* Raw: bias calc */
-
-	SUPERVERBOSE("maxbias %"PRIu64" gave rlen %zu",
-		     max_bias, tal_count(short_route));
-
-	/* Now, binary search */
-	while (min_bias < max_bias) {
-		struct chan **route;
-		struct amount_msat this_fee;
-		u64 riskbias = (min_bias + max_bias) / 2;
-
-		unvisited = dijkstra_prepare(tmpctx, rstate, src, msat,
-					     normal_cost_function);
-		dijkstra(rstate, dst, me, riskfactor, riskbias, fuzz, base_seed,
-			 unvisited, normal_cost_function);
-		dijkstra_cleanup(unvisited);
-
-		route = build_route(ctx, rstate, dst, src, me,
-				    riskfactor, riskbias,
-				    fuzz, base_seed, &this_fee);
-
-		SUPERVERBOSE("riskbias %"PRIu64" rlen %zu",
-			     riskbias, tal_count(route));
-		/* Too long still?  This is our new min_bias */
-		if (tal_count(route) > max_hops) {
-			tal_free(route);
-			min_bias = riskbias + 1;
-		} else {
-			/* This route is acceptable. */
-			tal_free(short_route);
-			short_route = route;
-			/* Save this fee in case we exit loop */
-			*fee = this_fee;
-			max_bias = riskbias;
-		}
+	/* We don't charge ourselves fees, so skip first hop */
+	if (!amount_msat_sub(fee, labels[labels[best].prev].total, msat)) {
+		status_broken("Could not subtract %s - %s for fee",
+			      type_to_string(tmpctx, struct amount_msat,
+					     &labels[labels[best].prev].total),
+			      type_to_string(tmpctx, struct amount_msat, &msat));
+		route = tal_free(route);
 	}
 
-	return short_route;
-
-bad_total:
-	status_broken("dst total %s < src total %s?",
-		      type_to_string(tmpctx, struct amount_msat,
-				     &dst->dijkstra.total),
-		      type_to_string(tmpctx, struct amount_msat,
-				     &src->dijkstra.total));
-out:
-	tal_free(short_route);
-	return NULL;
+	tal_free(labels);
+	tal_free(unvisited);
+	return route;
 }
 
 /* riskfactor is already scaled to per-block amount */
@@ -1183,18 +1348,20 @@ find_route(const tal_t *ctx, struct routing_state *rstate,
 
 	unvisited = dijkstra_prepare(tmpctx, rstate, src, msat,
 				     normal_cost_function);
-	dijkstra(rstate, dst, me, riskfactor, 1, fuzz, base_seed,
+	dijkstra(rstate, dst, me, riskfactor, fuzz, base_seed,
 		 unvisited, normal_cost_function);
-	dijkstra_cleanup(unvisited);
 
-	route = build_route(ctx, rstate, dst, src, me, riskfactor, 1,
-			    fuzz, base_seed, fee);
-	if (tal_count(route) <= max_hops)
+	route = build_route(ctx, rstate, unvisited, dst, src, fee);
+	if (tal_count(route) <= max_hops) {
+		tal_free(unvisited);
 		return route;
+	}
 
 	/* This is the far more unlikely case */
-	return find_shorter_route(ctx, rstate, src, dst, me, msat,
-				  max_hops, fuzz, base_seed, route, fee);
+	tal_free(route);
+	tal_free(unvisited);
+	return hop_bounded_route(ctx, rstate, src, dst, me, msat, riskfactor,
+				 max_hops, fuzz, base_seed, fee);
 }
 
 /* Checks that key is valid, and signed this hash */
@@ -1418,38 +1585,71 @@ static void add_channel_announce_to_broadcast(struct routing_state *rstate,
 	rstate->local_channel_announced |= is_local_channel(rstate, chan);
 }
 
-bool routing_add_channel_announcement(struct routing_state *rstate,
-				      const u8 *msg TAKES,
-				      struct amount_sat sat,
-				      u32 index)
+bool decode_channel_announcement_ids(const u8 *msg, size_t len,
+				     bool check,
+				     struct short_channel_id *scid,
+				     struct node_id *node_id_1,
+				     struct node_id *node_id_2)
+{
+	const u8 *cursor = msg;
+	size_t max = len;
+	secp256k1_ecdsa_signature sig;
+	struct pubkey key;
+
+	/* BOLT #7:
+	 *
+	 * 1. type: 256 (`channel_announcement`)
+	 * 2. data:
+	 *     * [`signature`:`node_signature_1`]
+	 *     * [`signature`:`node_signature_2`]
+	 *     * [`signature`:`bitcoin_signature_1`]
+	 *     * [`signature`:`bitcoin_signature_2`]
+	 *     * [`u16`:`len`]
+	 *     * [`len*byte`:`features`]
+	 *     * [`chain_hash`:`chain_hash`]
+	 *     * [`short_channel_id`:`short_channel_id`]
+	 *     * [`point`:`node_id_1`]
+	 *     * [`point`:`node_id_2`]
+	 *     * [`point`:`bitcoin_key_1`]
+	 *     * [`point`:`bitcoin_key_2`]
+	 */
+	if (fromwire_u16(&cursor, &max) != WIRE_CHANNEL_ANNOUNCEMENT)
+		return false;
+	for (size_t i = 0; i < 4; i++) {
+		if (check)
+			fromwire_secp256k1_ecdsa_signature(&cursor, &max, &sig);
+		else
+			fromwire_pad(&cursor, &max, 64);
+	}
+	fromwire_pad(&cursor, &max, fromwire_u16(&cursor, &max));
+	fromwire_pad(&cursor, &max, sizeof(struct bitcoin_blkid));
+	fromwire_short_channel_id(&cursor, &max, scid);
+	fromwire_node_id(&cursor, &max, node_id_1);
+	fromwire_node_id(&cursor, &max, node_id_2);
+	if (check) {
+		fromwire_pubkey(&cursor, &max, &key);
+		fromwire_pubkey(&cursor, &max, &key);
+	}
+	return cursor != NULL;
+}
+
+/* Common code for adding a channel_announcement we've decoded */
+static bool add_channel_announcement(struct routing_state *rstate,
+				     const u8 *msg,
+				     struct amount_sat sat,
+				     u32 index,
+				     const struct short_channel_id *scid,
+				     const struct node_id *node_id_1,
+				     const struct node_id *node_id_2)
 {
 	struct chan *chan;
-	secp256k1_ecdsa_signature node_signature_1, node_signature_2;
-	secp256k1_ecdsa_signature bitcoin_signature_1, bitcoin_signature_2;
-	u8 *features;
-	struct bitcoin_blkid chain_hash;
-	struct short_channel_id scid;
-	struct node_id node_id_1;
-	struct node_id node_id_2;
-	struct pubkey bitcoin_key_1;
-	struct pubkey bitcoin_key_2;
 	struct unupdated_channel *uc;
 	const u8 *private_updates[2] = { NULL, NULL };
 
-	/* Make sure we own msg, even if we don't save it. */
-	if (taken(msg))
-		tal_steal(tmpctx, msg);
-
-	if (!fromwire_channel_announcement(
-		    tmpctx, msg, &node_signature_1, &node_signature_2,
-		    &bitcoin_signature_1, &bitcoin_signature_2, &features, &chain_hash,
-		    &scid, &node_id_1, &node_id_2, &bitcoin_key_1, &bitcoin_key_2))
-		return false;
-
 	/* The channel may already exist if it was non-public from
 	 * local_add_channel(); normally we don't accept new
 	 * channel_announcements.  See handle_channel_announcement. */
-	chan = get_channel(rstate, &scid);
+	chan = get_channel(rstate, scid);
 
 	/* private updates will exist in the store before the announce: we
 	 * can't index those for broadcast since they would predate it, so we
@@ -1484,15 +1684,15 @@ bool routing_add_channel_announcement(struct routing_state *rstate,
 	uc->added = time_now();
 	uc->index = index;
 	uc->sat = sat;
-	uc->scid = scid;
-	uc->id[0] = node_id_1;
-	uc->id[1] = node_id_2;
-	uintmap_add(&rstate->unupdated_chanmap, scid.u64, uc);
+	uc->scid = *scid;
+	uc->id[0] = *node_id_1;
+	uc->id[1] = *node_id_2;
+	uintmap_add(&rstate->unupdated_chanmap, scid->u64, uc);
 	tal_add_destructor2(uc, destroy_unupdated_channel, rstate);
 
 	/* If a node_announcement comes along, save it for once we're updated */
-	catch_node_announcement(uc, rstate, &node_id_1);
-	catch_node_announcement(uc, rstate, &node_id_2);
+	catch_node_announcement(uc, rstate, &uc->id[0]);
+	catch_node_announcement(uc, rstate, &uc->id[1]);
 
 	/* If we had private updates, they'll immediately create the channel. */
 	if (private_updates[0])
@@ -1503,8 +1703,57 @@ bool routing_add_channel_announcement(struct routing_state *rstate,
 	return true;
 }
 
+bool routing_add_channel_announcement(struct routing_state *rstate,
+				      const u8 *msg TAKES,
+				      struct amount_sat sat,
+				      u32 index)
+{
+	secp256k1_ecdsa_signature node_signature_1, node_signature_2;
+	secp256k1_ecdsa_signature bitcoin_signature_1, bitcoin_signature_2;
+	u8 *features;
+	struct bitcoin_blkid chain_hash;
+	struct short_channel_id scid;
+	struct node_id node_id_1;
+	struct node_id node_id_2;
+	struct pubkey bitcoin_key_1;
+	struct pubkey bitcoin_key_2;
+
+	/* Make sure we own msg, even if we don't save it. */
+	if (taken(msg))
+		tal_steal(tmpctx, msg);
+
+	if (!fromwire_channel_announcement(
+		    tmpctx, msg, &node_signature_1, &node_signature_2,
+		    &bitcoin_signature_1, &bitcoin_signature_2, &features, &chain_hash,
+		    &scid, &node_id_1, &node_id_2, &bitcoin_key_1, &bitcoin_key_2))
+		return false;
+
+	return add_channel_announcement(rstate, msg, sat, index,
+					&scid, &node_id_1, &node_id_2);
+}
+
+bool routing_add_checked_channel_announcement(struct routing_state *rstate,
+					      const u8 *msg TAKES,
+					      struct amount_sat sat,
+					      u32 index)
+{
+	struct short_channel_id scid;
+	struct node_id node_id_1, node_id_2;
+
+	if (taken(msg))
+		tal_steal(tmpctx, msg);
+
+	if (!decode_channel_announcement_ids(msg, tal_count(msg), false,
+					     &scid, &node_id_1, &node_id_2))
+		return false;
+
+	return add_channel_announcement(rstate, msg, sat, index,
+					&scid, &node_id_1, &node_id_2);
+}
+
 u8 *handle_channel_announcement(struct routing_state *rstate,
 				const u8 *announce TAKES,
+				bool sigs_checked,
 				const struct short_channel_id **scid)
 {
 	struct pending_cannouncement *pending;
@@ -1517,6 +1766,7 @@ u8 *handle_channel_announcement(struct routing_state *rstate,
 	pending = tal(rstate, struct pending_cannouncement);
 	pending->updates[0] = NULL;
 	pending->updates[1] = NULL;
+	pending->update_sig_checked[0] = pending->update_sig_checked[1] = false;
 	pending->announce = tal_dup_arr(pending, u8,
 					announce, tal_count(announce), 0);
 	pending->update_timestamps[0] = pending->update_timestamps[1] = 0;
@@ -1613,17 +1863,21 @@ u8 *handle_channel_announcement(struct routing_state *rstate,
 		goto ignored;
 	}
 
-	/* Note that if node_id_1 or node_id_2 are malformed, it's caught here */
-	err = check_channel_announcement(rstate,
-					 &pending->node_id_1,
-					 &pending->node_id_2,
-					 &pending->bitcoin_key_1,
-					 &pending->bitcoin_key_2,
-					 &node_signature_1,
-					 &node_signature_2,
-					 &bitcoin_signature_1,
-					 &bitcoin_signature_2,
-					 pending->announce);
+	/* Note that if node_id_1 or node_id_2 are malformed, it's caught here
+	 * (or by sigcheck, which won't call them good). */
+	if (sigs_checked)
+		err = NULL;
+	else
+		err = check_channel_announcement(rstate,
+						 &pending->node_id_1,
+						 &pending->node_id_2,
+						 &pending->bitcoin_key_1,
+						 &pending->bitcoin_key_2,
+						 &node_signature_1,
+						 &node_signature_2,
+						 &bitcoin_signature_1,
+						 &bitcoin_signature_2,
+						 pending->announce);
 	if (err) {
 		/* BOLT #7:
 		 *
@@ -1666,7 +1920,8 @@ ignored:
 
 static void process_pending_channel_update(struct routing_state *rstate,
 					   const struct short_channel_id *scid,
-					   const u8 *cupdate)
+					   const u8 *cupdate,
+					   const struct node_id *signed_by)
 {
 	u8 *err;
 
@@ -1674,7 +1929,8 @@ static void process_pending_channel_update(struct routing_state *rstate,
 		return;
 
 	/* FIXME: We don't remember who sent us updates, so can't error them */
-	err = handle_channel_update(rstate, cupdate, "pending update", NULL);
+	err = handle_channel_update(rstate, cupdate, signed_by,
+				    "pending update", NULL);
 	if (err) {
 		status_trace("Pending channel_update for %s: %s",
 			     type_to_string(tmpctx, struct short_channel_id, scid),
@@ -1743,8 +1999,12 @@ bool handle_pending_cannouncement(struct routing_state *rstate,
 			      "Could not add channel_announcement");
 
 	/* Did we have an update waiting?  If so, apply now. */
-	process_pending_channel_update(rstate, scid, pending->updates[0]);
-	process_pending_channel_update(rstate, scid, pending->updates[1]);
+	process_pending_channel_update(rstate, scid, pending->updates[0],
+				       pending->update_sig_checked[0]
+				       ? &pending->node_id_1 : NULL);
+	process_pending_channel_update(rstate, scid, pending->updates[1],
+				       pending->update_sig_checked[1]
+				       ? &pending->node_id_2 : NULL);
 
 	tal_free(pending);
 	return true;
@@ -1752,7 +2012,8 @@ bool handle_pending_cannouncement(struct routing_state *rstate,
 
 static void update_pending(struct pending_cannouncement *pending,
 			   u32 timestamp, const u8 *update,
-			   const u8 direction)
+			   const u8 direction,
+			   const struct node_id *signed_by)
 {
 	SUPERVERBOSE("Deferring update for pending channel %s/%d",
 		     type_to_string(tmpctx, struct short_channel_id,
@@ -1765,6 +2026,11 @@ static void update_pending(struct pending_cannouncement *pending,
 		}
 		pending->updates[direction] = tal_dup_arr(pending, u8, update, tal_count(update), 0);
 		pending->update_timestamps[direction] = timestamp;
+		pending->update_sig_checked[direction]
+			= signed_by
+			&& node_id_eq(signed_by, direction
+				      ? &pending->node_id_2
+				      : &pending->node_id_1);
 	}
 }
 
@@ -1796,6 +2062,35 @@ static void set_connection_values(struct chan *chan,
 		     idx);
 }
 
+/* BOLT-61a1365a45cc8b463ddbbe3429d350f8eac787dd #7:
+ *
+ * The checksum of a `channel_update` is the CRC32C checksum as specified in
+ * [RFC3720](https://tools.ietf.org/html/rfc3720#appendix-B.4) of this
+ * `channel_update` without its `signature` and `timestamp` fields.
+ */
+u32 crc32_of_update(const u8 *channel_update, size_t len)
+{
+	u32 sum;
+
+	/* BOLT #7:
+	 *
+	 * 1. type: 258 (`channel_update`)
+	 * 2. data:
+	 *    * [`signature`:`signature`]
+	 *    * [`chain_hash`:`chain_hash`]
+	 *    * [`short_channel_id`:`short_channel_id`]
+	 *    * [`u32`:`timestamp`]
+	 *...
+	 */
+	/* Note: 2 bytes for `type` field */
+	/* We already checked it's valid before accepting */
+	assert(len > 2 + 64 + 32 + 8 + 4);
+	sum = crc32c(0, channel_update + 2 + 64, 32 + 8);
+	sum = crc32c(sum, channel_update + 2 + 64 + 32 + 8 + 4,
+		     len - (64 + 2 + 32 + 8 + 4));
+	return sum;
+}
+
 bool routing_add_channel_update(struct routing_state *rstate,
 				const u8 *update TAKES,
 				u32 index)
@@ -1814,6 +2109,7 @@ bool routing_add_channel_update(struct routing_state *rstate,
 	struct unupdated_channel *uc;
 	u8 direction;
 	struct amount_sat sat;
+	bool was_enabled;
 
 	/* Make sure we own msg, even if we don't save it. */
 	if (taken(update))
@@ -1896,11 +2192,22 @@ bool routing_add_channel_update(struct routing_state *rstate,
 	if (amount_msat_greater(htlc_maximum, rstate->chainparams->max_payment))
 		htlc_maximum = rstate->chainparams->max_payment;
 
+	was_enabled = is_halfchan_enabled(hc);
 	set_connection_values(chan, direction, fee_base_msat,
 			      fee_proportional_millionths, expiry,
 			      message_flags, channel_flags,
 			      timestamp, htlc_minimum, htlc_maximum);
 
+	/* Routes over this may not be the best any more (or work at all);
+	 * if it's newly usable, it might be a better route to anywhere. */
+	route_cache_forget_chan(rstate, chan);
+	if (!was_enabled && is_halfchan_enabled(hc))
+		rstate->route_cache.gen++;
+
+	/* Peers asking for channel ranges want this for every channel, so
+	 * work it out now rather than re-reading the store each time. */
+	hc->csum = crc32_of_update(update, tal_count(update));
+
 	/* Safe even if was never added, but if it's a private channel it
 	 * would be a WIRE_GOSSIP_STORE_PRIVATE_UPDATE. */
 	gossip_store_delete(rstate->gs, &hc->bcast,
@@ -1930,6 +2237,7 @@ bool routing_add_channel_update(struct routing_state *rstate,
 								  update);
 		} else
 			hc->bcast.index = index;
+		update_route_edge(rstate, chan, direction);
 		return true;
 	}
 
@@ -1941,6 +2249,7 @@ bool routing_add_channel_update(struct routing_state *rstate,
 			= gossip_store_add(rstate->gs, update,
 					   hc->bcast.timestamp,
 					   NULL);
+	update_route_edge(rstate, chan, direction);
 
 	if (uc) {
 		/* If we were waiting for these nodes to appear (or gain a
@@ -1969,6 +2278,23 @@ static const struct node_id *get_channel_owner(struct routing_state *rstate,
 	return NULL;
 }
 
+const struct node_id *channel_update_signer(struct routing_state *rstate,
+					    const struct short_channel_id *scid,
+					    int direction)
+{
+	struct pending_cannouncement *pending;
+	const struct node_id *owner;
+
+	owner = get_channel_owner(rstate, scid, direction);
+	if (owner)
+		return owner;
+
+	pending = find_pending_cannouncement(rstate, scid);
+	if (pending)
+		return direction ? &pending->node_id_2 : &pending->node_id_1;
+	return NULL;
+}
+
 void remove_channel_from_store(struct routing_state *rstate,
 			       struct chan *chan)
 {
@@ -1992,6 +2318,7 @@ void remove_channel_from_store(struct routing_state *rstate,
 }
 
 u8 *handle_channel_update(struct routing_state *rstate, const u8 *update TAKES,
+			  const struct node_id *signed_by,
 			  const char *source,
 			  struct short_channel_id *unknown_scid)
 {
@@ -2055,7 +2382,8 @@ u8 *handle_channel_update(struct routing_state *rstate, const u8 *update TAKES,
 					    struct short_channel_id,
 					    &short_channel_id),
 			     direction);
-		update_pending(pending, timestamp, serialized, direction);
+		update_pending(pending, timestamp, serialized, direction,
+			       signed_by);
 		return NULL;
 	}
 
@@ -2073,7 +2401,11 @@ u8 *handle_channel_update(struct routing_state *rstate, const u8 *update TAKES,
 		return NULL;
 	}
 
-	err = check_channel_update(rstate, owner, &signature, serialized);
+	if (signed_by && node_id_eq(signed_by, owner))
+		err = NULL;
+	else
+		err = check_channel_update(rstate, owner, &signature,
+					   serialized);
 	if (err) {
 		/* BOLT #7:
 		 *
@@ -2223,7 +2555,8 @@ bool routing_add_node_announcement(struct routing_state *rstate,
 	return true;
 }
 
-u8 *handle_node_announcement(struct routing_state *rstate, const u8 *node_ann)
+u8 *handle_node_announcement(struct routing_state *rstate, const u8 *node_ann,
+			     bool sig_checked)
 {
 	u8 *serialized;
 	struct sha256_double hash;
@@ -2271,7 +2604,8 @@ u8 *handle_node_announcement(struct routing_state *rstate, const u8 *node_ann)
 
 	sha256_double(&hash, serialized + 66, tal_count(serialized) - 66);
 	/* If node_id is invalid, it fails here */
-	if (!check_signed_hash_nodeid(&hash, &signature, &node_id)) {
+	if (!sig_checked
+	    && !check_signed_hash_nodeid(&hash, &signature, &node_id)) {
 		/* BOLT #7:
 		 *
 		 * - if `signature` is not a valid signature, using
@@ -2315,45 +2649,30 @@ u8 *handle_node_announcement(struct routing_state *rstate, const u8 *node_ann)
 	return NULL;
 }
 
-struct route_hop *get_route(const tal_t *ctx, struct routing_state *rstate,
-			    const struct node_id *source,
-			    const struct node_id *destination,
-			    struct amount_msat msat, double riskfactor,
-			    u32 final_cltv,
-			    double fuzz, u64 seed,
-			    const struct short_channel_id_dir *excluded,
-			    size_t max_hops)
+/* Temporarily set excluded channels' capacity to zero: returns what to
+ * hand to restore_excluded() afterwards. */
+static struct amount_msat *
+exclude_channels(struct routing_state *rstate,
+		 const struct short_channel_id_dir *excluded)
 {
-	struct chan **route;
-	struct amount_msat total_amount;
-	unsigned int total_delay;
-	struct amount_msat fee;
-	struct route_hop *hops;
-	struct node *n;
 	struct amount_msat *saved_capacity;
-	struct siphash_seed base_seed;
 
 	saved_capacity = tal_arr(tmpctx, struct amount_msat, tal_count(excluded));
-
-	base_seed.u.u64[0] = base_seed.u.u64[1] = seed;
-
-	if (amount_msat_eq(msat, AMOUNT_MSAT(0)))
-		return NULL;
-
-	/* Temporarily set excluded channels' capacity to zero. */
 	for (size_t i = 0; i < tal_count(excluded); i++) {
 		struct chan *chan = get_channel(rstate, &excluded[i].scid);
 		if (!chan)
 			continue;
 		saved_capacity[i] = chan->half[excluded[i].dir].htlc_maximum;
 		chan->half[excluded[i].dir].htlc_maximum = AMOUNT_MSAT(0);
+		update_route_edge(rstate, chan, excluded[i].dir);
 	}
+	return saved_capacity;
+}
 
-	route = find_route(ctx, rstate, source, destination, msat,
-			   riskfactor / BLOCKS_PER_YEAR / 100,
-			   fuzz, &base_seed, max_hops, &fee);
-
-	/* Now restore the capacity. */
+static void restore_excluded(struct routing_state *rstate,
+			     const struct short_channel_id_dir *excluded,
+			     const struct amount_msat *saved_capacity)
+{
 	/* Restoring is done in reverse order, in order to properly
 	 * handle the case where a channel is indicated twice in
 	 * our input.
@@ -2368,13 +2687,24 @@ struct route_hop *get_route(const tal_t *ctx, struct routing_state *rstate,
 		if (!chan)
 			continue;
 		chan->half[excluded[i].dir].htlc_maximum = saved_capacity[i];
+		update_route_edge(rstate, chan, excluded[i].dir);
 	}
+}
 
-	if (!route) {
-		return NULL;
-	}
+/* Fees, delays need to be calculated backwards along route. */
+static struct route_hop *route_to_hops(const tal_t *ctx,
+				       struct routing_state *rstate,
+				       struct chan **route,
+				       const struct node_id *source,
+				       const struct node_id *destination,
+				       struct amount_msat msat,
+				       u32 final_cltv)
+{
+	struct amount_msat total_amount;
+	unsigned int total_delay;
+	struct route_hop *hops;
+	struct node *n;
 
-	/* Fees, delays need to be calculated backwards along route. */
 	hops = tal_arr(ctx, struct route_hop, tal_count(route));
 	total_amount = msat;
 	total_delay = final_cltv;
@@ -2409,6 +2739,385 @@ struct route_hop *get_route(const tal_t *ctx, struct routing_state *rstate,
 	return hops;
 }
 
+static int amount_bucket(struct amount_msat msat)
+{
+	return ilog64(msat.millisatoshis); /* Raw: bucketing */
+}
+
+static bool excluded_eq(const struct short_channel_id_dir *a,
+			const struct short_channel_id_dir *b)
+{
+	if (tal_count(a) != tal_count(b))
+		return false;
+	for (size_t i = 0; i < tal_count(a); i++) {
+		if (!short_channel_id_eq(&a[i].scid, &b[i].scid)
+		    || a[i].dir != b[i].dir)
+			return false;
+	}
+	return true;
+}
+
+/* Can this route still carry msat?  Same checks as can_reach(). */
+static bool route_carries(struct routing_state *rstate,
+			  struct chan **route,
+			  const struct node_id *source,
+			  const struct node_id *destination,
+			  struct amount_msat msat)
+{
+	struct amount_msat total = msat;
+	struct node *n = get_node(rstate, destination);
+
+	for (int i = tal_count(route) - 1; i >= 0; i--) {
+		int idx = half_chan_to(n, route[i]);
+		const struct route_edge *e
+			= &rstate->edges[route[i]->half[idx].edge];
+		struct amount_msat fee;
+
+		if (!e->enabled)
+			return false;
+		/* We don't charge ourselves fees. */
+		if (i != 0 || source) {
+			if (!amount_msat_fee(&fee, total,
+					     e->base_fee, e->proportional_fee)
+			    || !amount_msat_add(&total, total, fee))
+				return false;
+		}
+		if (!edge_can_carry(e, total))
+			return false;
+		n = other_node(n, route[i]);
+	}
+	return true;
+}
+
+static struct chan **route_cache_get(struct routing_state *rstate,
+				     const struct node_id *source,
+				     const struct node_id *destination,
+				     struct amount_msat msat,
+				     double riskfactor,
+				     const struct short_channel_id_dir *excluded,
+				     size_t max_hops)
+{
+	struct route_cache *cache = &rstate->route_cache;
+	struct route_cache_entry *e;
+	int bucket = amount_bucket(msat);
+
+	list_for_each(&cache->entries, e, list) {
+		if (e->have_source != (source != NULL)
+		    || (source && !node_id_eq(&e->source, source))
+		    || !node_id_eq(&e->destination, destination)
+		    || e->amount_bucket != bucket
+		    || e->riskfactor != riskfactor
+		    || e->max_hops != max_hops
+		    || !excluded_eq(e->excluded, excluded))
+			continue;
+
+		if (e->gen != cache->gen
+		    || !route_carries(rstate, e->route, source, destination,
+				      msat)) {
+			route_cache_del(cache, e);
+			break;
+		}
+
+		/* Move to front. */
+		list_del_from(&cache->entries, &e->list);
+		list_add(&cache->entries, &e->list);
+		cache->hits++;
+		return e->route;
+	}
+	cache->misses++;
+	return NULL;
+}
+
+static void route_cache_add(struct routing_state *rstate,
+			    const struct node_id *source,
+			    const struct node_id *destination,
+			    struct amount_msat msat,
+			    double riskfactor,
+			    const struct short_channel_id_dir *excluded,
+			    size_t max_hops,
+			    struct chan **route)
+{
+	struct route_cache *cache = &rstate->route_cache;
+	struct route_cache_entry *e;
+
+	/* Evict the least recently used. */
+	if (cache->num == ROUTE_CACHE_MAX)
+		route_cache_del(cache, list_tail(&cache->entries,
+						 struct route_cache_entry,
+						 list));
+
+	e = tal(rstate, struct route_cache_entry);
+	e->have_source = (source != NULL);
+	if (source)
+		e->source = *source;
+	e->destination = *destination;
+	e->amount_bucket = amount_bucket(msat);
+	e->riskfactor = riskfactor;
+	e->max_hops = max_hops;
+	e->excluded = tal_dup_arr(e, struct short_channel_id_dir,
+				  excluded, tal_count(excluded), 0);
+	e->gen = cache->gen;
+	e->route = tal_dup_arr(e, struct chan *, route, tal_count(route), 0);
+	list_add(&cache->entries, &e->list);
+	cache->num++;
+}
+
+struct route_hop *get_route(const tal_t *ctx, struct routing_state *rstate,
+			    const struct node_id *source,
+			    const struct node_id *destination,
+			    struct amount_msat msat, double riskfactor,
+			    u32 final_cltv,
+			    double fuzz, u64 seed,
+			    const struct short_channel_id_dir *excluded,
+			    size_t max_hops)
+{
+	struct chan **route;
+	struct amount_msat fee;
+	struct amount_msat *saved_capacity;
+	struct siphash_seed base_seed;
+
+	base_seed.u.u64[0] = base_seed.u.u64[1] = seed;
+
+	if (amount_msat_eq(msat, AMOUNT_MSAT(0)))
+		return NULL;
+
+	/* Fuzzing is supposed to give a different answer each time. */
+	if (fuzz == 0.0) {
+		route = route_cache_get(rstate, source, destination, msat,
+					riskfactor, excluded, max_hops);
+		if (route)
+			return route_to_hops(ctx, rstate, route,
+					     source, destination,
+					     msat, final_cltv);
+	}
+
+	saved_capacity = exclude_channels(rstate, excluded);
+
+	route = find_route(ctx, rstate, source, destination, msat,
+			   riskfactor / BLOCKS_PER_YEAR / 100,
+			   fuzz, &base_seed, max_hops, &fee);
+
+	/* Now restore the capacity. */
+	restore_excluded(rstate, excluded, saved_capacity);
+
+	if (!route) {
+		return NULL;
+	}
+
+	if (fuzz == 0.0)
+		route_cache_add(rstate, source, destination, msat,
+				riskfactor, excluded, max_hops, route);
+
+	return route_to_hops(ctx, rstate, route, source, destination,
+			     msat, final_cltv);
+}
+
+/*~ getroutes wants routes from one source to many destinations (and
+ * amounts).  get_route() searches backwards from the destination, since the
+ * fee each channel charges depends on the amount it forwards, which we only
+ * know once we know what comes after it.  That search can't be shared
+ * between destinations, so here we search *forwards* from the source, and
+ * charge each channel's fee (and risk) on the amount being delivered,
+ * ignoring the (comparatively tiny) fees the rest of the route adds to it.
+ * The tree that leaves gives a route to every destination; we then work out
+ * its real fees backwards as usual. */
+static void update_unvisited_successors(struct routing_state *rstate,
+					u32 cur,
+					const struct node *me,
+					struct amount_msat msat,
+					double riskfactor,
+					double fuzz,
+					const struct siphash_seed *base_seed,
+					struct unvisited *unvisited)
+{
+	const struct node *n = unvisited->nodes[cur];
+	struct chan_map_iter it;
+	struct chan *c;
+
+	/* Consider all channels: these are the edges *out of* cur. */
+	for (c = first_chan(n, &it); c; c = next_chan(n, &it)) {
+		u32 edge = half_chan_from(n, c)->edge;
+		const struct route_edge *e = &rstate->edges[edge];
+		struct amount_msat fee, total, risk, cost_after;
+
+		if (!e->enabled || !is_unvisited(e->dst, unvisited))
+			continue;
+
+		if (!edge_can_carry(e, msat))
+			continue;
+
+		if (!amount_msat_fee(&fee, msat, e->base_fee,
+				     e->proportional_fee)
+		    || !fuzz_fee(&fee.millisatoshis, &e->scid, fuzz, base_seed)) /* Raw: double manipulation */
+			continue;
+
+		total = dijkstra_total(unvisited, cur);
+		risk = dijkstra_risk(unvisited, cur);
+		/* As in can_reach(), our own fee is counted as risk. */
+		if (me && cur == me->index) {
+			if (!amount_msat_add(&risk, risk, fee))
+				continue;
+		} else if (!amount_msat_add(&total, total, fee))
+			continue;
+
+		if (!risk_add_fee(&risk, msat, e->delay, riskfactor))
+			continue;
+
+		if (costs_less(total, risk, &cost_after,
+			       dijkstra_total(unvisited, e->dst),
+			       dijkstra_risk(unvisited, e->dst),
+			       NULL,
+			       normal_cost_function))
+			adjust_unvisited(e->dst, unvisited,
+					 total, risk, cost_after, edge);
+	}
+}
+
+/* Follow the tree back from dst to src: NULL if we never reached dst. */
+static struct chan **build_forward_route(const tal_t *ctx,
+					 struct routing_state *rstate,
+					 const struct unvisited *unvisited,
+					 const struct node *src,
+					 const struct node *dst)
+{
+	struct chan **route;
+	size_t n;
+
+	if (amount_msat_eq(dijkstra_total(unvisited, dst->index), INFINITE))
+		return NULL;
+
+	route = tal_arr(ctx, struct chan *, 0);
+	for (u32 i = dst->index; i != src->index;) {
+		const struct route_edge *e
+			= &rstate->edges[unvisited->dij[i].edge];
+
+		tal_arr_expand(&route, get_channel(rstate, &e->scid));
+		i = e->src;
+	}
+
+	/* We built it backwards. */
+	n = tal_count(route);
+	for (size_t i = 0; i < n / 2; i++) {
+		struct chan *tmp = route[i];
+		route[i] = route[n - 1 - i];
+		route[n - 1 - i] = tmp;
+	}
+	return route;
+}
+
+struct route_hop **get_routes(const tal_t *ctx, struct routing_state *rstate,
+			      const struct node_id *source,
+			      const struct node_id *destinations,
+			      const struct amount_msat *msats,
+			      double riskfactor,
+			      u32 final_cltv,
+			      double fuzz, u64 seed,
+			      const struct short_channel_id_dir *excluded,
+			      size_t max_hops)
+{
+	size_t num = tal_count(destinations);
+	struct route_hop **routes;
+	struct amount_msat *saved_capacity;
+	struct siphash_seed base_seed;
+	struct node *src;
+	const struct node *me;
+	bool *searched, *retry;
+
+	assert(tal_count(msats) == num);
+	routes = tal_arrz(ctx, struct route_hop *, num);
+	base_seed.u.u64[0] = base_seed.u.u64[1] = seed;
+
+	/* If source is NULL, that means it's us. */
+	if (!source)
+		me = src = get_node(rstate, &rstate->local_id);
+	else {
+		src = get_node(rstate, source);
+		me = NULL;
+	}
+	if (!src) {
+		status_info("get_routes: cannot find source (%s)",
+			    source ? type_to_string(tmpctx, struct node_id,
+						    source) : "us");
+		return routes;
+	}
+
+	searched = tal_arrz(tmpctx, bool, num);
+	retry = tal_arrz(tmpctx, bool, num);
+
+	saved_capacity = exclude_channels(rstate, excluded);
+
+	/* One search for each power-of-two bucket of amounts, using the
+	 * largest amount in the bucket. */
+	for (size_t i = 0; i < num; i++) {
+		struct unvisited *unvisited;
+		struct amount_msat msat = msats[i];
+		int bucket = amount_bucket(msats[i]);
+		u32 cur;
+
+		if (searched[i] || amount_msat_eq(msats[i], AMOUNT_MSAT(0)))
+			continue;
+
+		for (size_t j = i + 1; j < num; j++) {
+			if (amount_bucket(msats[j]) == bucket
+			    && amount_msat_greater(msats[j], msat))
+				msat = msats[j];
+		}
+
+		unvisited = dijkstra_prepare(tmpctx, rstate, src, msat,
+					     normal_cost_function);
+		while (first_unvisited(unvisited, &cur))
+			update_unvisited_successors(rstate, cur, me, msat,
+						    riskfactor
+						    / BLOCKS_PER_YEAR / 100,
+						    fuzz, &base_seed,
+						    unvisited);
+
+		for (size_t j = i; j < num; j++) {
+			struct node *dst;
+			struct chan **route;
+
+			if (searched[j]
+			    || amount_msat_eq(msats[j], AMOUNT_MSAT(0))
+			    || amount_bucket(msats[j]) != bucket)
+				continue;
+			searched[j] = true;
+
+			dst = get_node(rstate, &destinations[j]);
+			if (!dst || dst == src)
+				continue;
+
+			/* If it's too long, or can't carry the real amount,
+			 * get_route() will have to do it the slow way. */
+			route = build_forward_route(tmpctx, rstate, unvisited,
+						    src, dst);
+			if (!route
+			    || tal_count(route) > max_hops
+			    || !route_carries(rstate, route, source,
+					      &destinations[j], msats[j])) {
+				retry[j] = true;
+				continue;
+			}
+
+			routes[j] = route_to_hops(routes, rstate, route,
+						  source, &destinations[j],
+						  msats[j], final_cltv);
+		}
+		tal_free(unvisited);
+	}
+
+	restore_excluded(rstate, excluded, saved_capacity);
+
+	for (size_t i = 0; i < num; i++) {
+		if (retry[i])
+			routes[i] = get_route(routes, rstate, source,
+					      &destinations[i], msats[i],
+					      riskfactor, final_cltv,
+					      fuzz, seed, excluded, max_hops);
+	}
+
+	return routes;
+}
+
 void routing_failure(struct routing_state *rstate,
 		     const struct node_id *erring_node_id,
 		     const struct short_channel_id *scid,
@@ -2428,8 +3137,8 @@ void routing_failure(struct routing_state *rstate,
 
 	/* lightningd will only extract this if UPDATE is set. */
 	if (channel_update) {
-		u8 *err = handle_channel_update(rstate, channel_update, "error",
-						NULL);
+		u8 *err = handle_channel_update(rstate, channel_update, NULL,
+						"error", NULL);
 		if (err) {
 			status_unusual("routing_failure: "
 				       "bad channel_update %s",
@@ -2443,6 +3152,25 @@ void routing_failure(struct routing_state *rstate,
 			       (int) failcode);
 	}
 
+	/* Even a temporary failure means we shouldn't hand out routes over
+	 * it again without looking for another. */
+	if (failcode & NODE) {
+		struct node *node = get_node(rstate, erring_node_id);
+		struct chan_map_iter i;
+		struct chan *c;
+
+		if (node) {
+			for (c = first_chan(node, &i); c;
+			     c = next_chan(node, &i))
+				route_cache_forget_chan(rstate, c);
+		}
+	} else {
+		struct chan *chan = get_channel(rstate, scid);
+
+		if (chan)
+			route_cache_forget_chan(rstate, chan);
+	}
+
 	/* We respond to permanent errors, ignore the rest: they're
 	 * for the pay command to worry about.  */
 	if (!(failcode & PERM))
@@ -2582,6 +3310,25 @@ bool handle_local_add_channel(struct routing_state *rstate,
 	return true;
 }
 
+void local_disable_chan(struct routing_state *rstate, const struct chan *chan)
+{
+	if (!is_chan_local_disabled(rstate, chan)) {
+		chan_map_add(&rstate->local_disabled_map, chan);
+		update_route_edge(rstate, chan, 0);
+		update_route_edge(rstate, chan, 1);
+		route_cache_forget_chan(rstate, chan);
+	}
+}
+
+void local_enable_chan(struct routing_state *rstate, const struct chan *chan)
+{
+	if (chan_map_del(&rstate->local_disabled_map, chan)) {
+		update_route_edge(rstate, chan, 0);
+		update_route_edge(rstate, chan, 1);
+		rstate->route_cache.gen++;
+	}
+}
+
 struct timeabs gossip_time_now(const struct routing_state *rstate)
 {
 #if DEVELOPER
@@ -2642,6 +3389,12 @@ void remove_all_gossip(struct routing_state *rstate)
 		tal_free(c);
 	}
 
+	/* Those skipped destroy_node and free_chan, so reset these too. */
+	tal_resize(&rstate->node_arr, 0);
+	tal_resize(&rstate->edge_ranges, 0);
+	tal_resize(&rstate->edges, 0);
+	rstate->edges_wasted = 0;
+
 	while ((uc = uintmap_first(&rstate->unupdated_chanmap, &index)) != NULL)
 		tal_free(uc);
 
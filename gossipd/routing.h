@@ -5,6 +5,7 @@
 #include <ccan/crypto/siphash24/siphash24.h>
 #include <ccan/htable/htable_type.h>
 #include <ccan/intmap/intmap.h>
+#include <ccan/list/list.h>
 #include <ccan/time/time.h>
 #include <common/amount.h>
 #include <common/node_id.h>
@@ -38,6 +39,12 @@ struct half_chan {
 
 	/* Minimum and maximum number of msatoshi in an HTLC */
 	struct amount_msat htlc_minimum, htlc_maximum;
+
+	/* Our offset in routing_state->edges */
+	u32 edge;
+
+	/* crc32_of_update() of the channel_update, for reply_channel_range */
+	u32 csum;
 };
 
 struct chan {
@@ -115,13 +122,56 @@ struct node {
 		struct chan *arr[NUM_IMMEDIATE_CHANS+1];
 	} chans;
 
-	/* Temporary data for routefinding. */
-	struct {
-		/* Total to get to here from target. */
-		struct amount_msat total;
-		/* Total risk premium of this route. */
-		struct amount_msat risk;
-	} dijkstra;
+	/* Our offset in routing_state->node_arr (and ->dijkstra) */
+	u32 index;
+};
+
+/* Temporary data for routefinding, indexed by node->index.
+ *
+ * This is only valid if gen == routing_state->dijkstra_gen: otherwise the
+ * node hasn't been reached yet.  This means we don't have to reset every
+ * node before each search. */
+struct dijkstra {
+	/* Which search this is valid for. */
+	u32 gen;
+	/* Offset in unvisited heap, or DIJKSTRA_VISITED. */
+	u32 heapidx;
+	/* Total to get to here from target. */
+	struct amount_msat total;
+	/* Total risk premium of this route. */
+	struct amount_msat risk;
+	/* costfn(total, risk): what the unvisited heap is ordered by. */
+	struct amount_msat cost;
+	/* Offset in routing_state->edges we used to get here. */
+	u32 edge;
+	/* For hop_bounded_route: offset of our cheapest label. */
+	u32 label;
+};
+
+/* A copy of everything routefinding needs to know about a half_chan.
+ *
+ * We search backwards from the destination, so these are grouped by dst:
+ * routing_state->edge_ranges[n] says where node_arr[n]'s incoming edges
+ * live in routing_state->edges, so considering a node's neighbors is a
+ * walk over contiguous memory rather than chasing chan pointers. */
+struct route_edge {
+	struct amount_msat htlc_minimum, htlc_maximum;
+	struct short_channel_id scid;
+	u32 base_fee;
+	u32 proportional_fee;
+	u32 delay;
+	/* Offsets in routing_state->node_arr */
+	u32 src, dst;
+	/* Which chan->half[] this is */
+	u8 dir;
+	/* is_halfchan_enabled() and not is_chan_local_disabled() */
+	bool enabled;
+};
+
+/* A node's incoming edges are edges[start] to edges[start+num-1]; there's
+ * room for max before we have to move them to the end of the array. */
+struct edge_range {
+	u32 start, num, max;
 };
 
 const struct node_id *node_map_keyof_node(const struct node *n);
@@ -150,6 +200,9 @@ struct pending_cannouncement {
 
 	/* Only ever replace with newer updates */
 	u32 update_timestamps[2];
+
+	/* Have we already checked the signatures on updates[]? */
+	bool update_sig_checked[2];
 };
 
 static inline const struct short_channel_id *panding_cannouncement_map_scid(
@@ -208,6 +261,19 @@ static inline int half_chan_to(const struct node *n, const struct chan *chan)
 	return !idx;
 }
 
+/* Recent get_route() answers, so repeated payments to the same place don't
+ * search the whole graph every time. */
+struct route_cache {
+	/* struct route_cache_entry, most recently used first. */
+	struct list_head entries;
+	size_t num;
+	/* Bumped whenever a new edge becomes usable: that could make a
+	 * better route to anywhere, so older entries are stale. */
+	u64 gen;
+	/* For dev-route-cache */
+	u64 hits, misses, invalidated;
+};
+
 struct routing_state {
 	/* Which chain we're on */
 	const struct chainparams *chainparams;
@@ -215,6 +281,22 @@ struct routing_state {
 	/* All known nodes. */
 	struct node_map *nodes;
 
+	/* The same nodes, packed into an array by node->index */
+	struct node **node_arr;
+
+	/* Scratch space for routefinding, reused by every search: per-node
+	 * data, the heap of unvisited nodes, and the current generation. */
+	struct dijkstra *dijkstra;
+	u32 *unvisited_heap;
+	u32 dijkstra_gen;
+
+	/* Both halves of every channel, packed for routefinding, and the
+	 * range for each node (by node->index).  Moving a range leaves a
+	 * hole: once too much is wasted, we repack. */
+	struct route_edge *edges;
+	struct edge_range *edge_ranges;
+	size_t edges_wasted;
+
 	/* node_announcements which are waiting on pending_cannouncement */
 	struct pending_node_map *pending_node_map;
 
@@ -247,6 +329,9 @@ struct routing_state {
         /* A map of (local) disabled channels by short_channel_ids */
 	struct chan_map local_disabled_map;
 
+	/* Routes we've found recently */
+	struct route_cache route_cache;
+
 #if DEVELOPER
 	/* Override local time for gossip messages */
 	struct timeabs *gossip_time;
@@ -294,9 +379,11 @@ struct chan *new_chan(struct routing_state *rstate,
  *
  * Returns error message if we should fail channel.  Make *scid non-NULL
  * (for checking) if we extracted a short_channel_id, otherwise ignore.
+ * If @sigs_checked, the signatures have already been checked (by sigcheck).
  */
 u8 *handle_channel_announcement(struct routing_state *rstate,
 				const u8 *announce TAKES,
+				bool sigs_checked,
 				const struct short_channel_id **scid);
 
 /**
@@ -315,13 +402,23 @@ struct chan *next_chan(const struct node *node, struct chan_map_iter *i);
 
 /* Returns NULL if all OK, otherwise an error for the peer which sent.
  * If the error is that the channel is unknown, fills in *unknown_scid
- * (if not NULL). */
+ * (if not NULL).  If @signed_by is not NULL, we've already checked it was
+ * signed by that node (we still check that's the channel's owner). */
 u8 *handle_channel_update(struct routing_state *rstate, const u8 *update TAKES,
+			  const struct node_id *signed_by,
 			  const char *source,
 			  struct short_channel_id *unknown_scid);
 
-/* Returns NULL if all OK, otherwise an error for the peer which sent. */
-u8 *handle_node_announcement(struct routing_state *rstate, const u8 *node);
+/* Returns NULL if all OK, otherwise an error for the peer which sent.
+ * If @sig_checked, the signature has already been checked. */
+u8 *handle_node_announcement(struct routing_state *rstate, const u8 *node,
+			     bool sig_checked);
+
+/* Who should have signed a channel_update for this channel and direction,
+ * if we know yet (the channel may be waiting for its txout lookup). */
+const struct node_id *channel_update_signer(struct routing_state *rstate,
+					    const struct short_channel_id *scid,
+					    int direction);
 
 /* Get a node: use this instead of node_map_get() */
 struct node *get_node(struct routing_state *rstate,
@@ -337,6 +434,22 @@ struct route_hop *get_route(const tal_t *ctx, struct routing_state *rstate,
 			    u64 seed,
 			    const struct short_channel_id_dir *excluded,
 			    size_t max_hops);
+
+/* Compute routes from source (NULL means us) to each of destinations, for
+ * the matching amount in msats, sharing one search per power-of-two bucket
+ * of amounts.  Returns an array of tal_count(destinations) routes, with NULL
+ * for destinations it couldn't find a route to (within max_hops). */
+struct route_hop **get_routes(const tal_t *ctx, struct routing_state *rstate,
+			      const struct node_id *source,
+			      const struct node_id *destinations,
+			      const struct amount_msat *msats,
+			      double riskfactor,
+			      u32 final_cltv,
+			      double fuzz,
+			      u64 seed,
+			      const struct short_channel_id_dir *excluded,
+			      size_t max_hops);
+
 /* Disable channel(s) based on the given routing failure. */
 void routing_failure(struct routing_state *rstate,
 		     const struct node_id *erring_node,
@@ -362,6 +475,29 @@ bool routing_add_channel_announcement(struct routing_state *rstate,
 				      struct amount_sat sat,
 				      u32 index);
 
+/**
+ * Get the short_channel_id and node_ids from a channel_announcement.
+ *
+ * This doesn't allocate or need @msg to be a tal object, so it's safe to
+ * call from other threads.  If @check, it also makes sure the signatures
+ * and bitcoin keys parse, which is where fromwire_channel_announcement
+ * spends almost all its time.
+ */
+bool decode_channel_announcement_ids(const u8 *msg, size_t len,
+				     bool check,
+				     struct short_channel_id *scid,
+				     struct node_id *node_id_1,
+				     struct node_id *node_id_2);
+
+/**
+ * routing_add_channel_announcement for one which has already passed
+ * decode_channel_announcement_ids(check=true), so we don't parse it again.
+ */
+bool routing_add_checked_channel_announcement(struct routing_state *rstate,
+					      const u8 *msg TAKES,
+					      struct amount_sat sat,
+					      u32 index);
+
 /**
  * Add a channel_update without checking for errors
  *
@@ -374,6 +510,9 @@ bool routing_add_channel_update(struct routing_state *rstate,
 				const u8 *update TAKES,
 				u32 index);
 
+/* The checksum of a channel_update, as used in reply_channel_range */
+u32 crc32_of_update(const u8 *channel_update, size_t len);
+
 /**
  * Add a node_announcement to the network view without checking it
  *
@@ -412,18 +551,8 @@ static inline bool is_chan_local_disabled(struct routing_state *rstate,
 	return chan_map_get(&rstate->local_disabled_map, &chan->scid) != NULL;
 }
 
-static inline void local_disable_chan(struct routing_state *rstate,
-				      const struct chan *chan)
-{
-	if (!is_chan_local_disabled(rstate, chan))
-		chan_map_add(&rstate->local_disabled_map, chan);
-}
-
-static inline void local_enable_chan(struct routing_state *rstate,
-				     const struct chan *chan)
-{
-	chan_map_del(&rstate->local_disabled_map, chan);
-}
+void local_disable_chan(struct routing_state *rstate, const struct chan *chan);
+void local_enable_chan(struct routing_state *rstate, const struct chan *chan);
 
 /* Helper to convert on-wire addresses format to wireaddrs array */
 struct wireaddr *read_addresses(const tal_t *ctx, const u8 *ser);
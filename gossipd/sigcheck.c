@@ -0,0 +1,254 @@
+#include "sigcheck.h"
+#include <bitcoin/pubkey.h>
+#include <bitcoin/shadouble.h>
+#include <bitcoin/signature.h>
+#include <common/status.h>
+#include <common/utils.h>
+#include <pthread.h>
+#include <wire/gen_peer_wire.h>
+#include <wire/wire.h>
+
+/* How many jobs a thread takes at once. */
+#define SIGCHECK_CHUNK 8
+
+struct sigcheck_pool {
+	pthread_t *threads;
+
+	/* Everything below is protected by lock. */
+	pthread_mutex_t lock;
+	/* Workers wait on this for a new batch (or stop) */
+	pthread_cond_t work;
+	/* sigcheck_run() waits on this for busy to drop to 0 */
+	pthread_cond_t done;
+
+	/* The current batch, and the next job nobody has taken yet. */
+	struct sigcheck_job *jobs;
+	size_t num, next;
+	/* Incremented for every batch. */
+	u64 batch;
+	/* Number of workers working on the current batch. */
+	size_t busy;
+	bool stop;
+};
+
+/* The signature(s) cover the double-SHA256 of everything after them. */
+static bool check_sig(const struct sigcheck_job *job, size_t offset,
+		      const secp256k1_ecdsa_signature *sig,
+		      const struct pubkey *key)
+{
+	struct sha256_double hash;
+
+	sha256_double(&hash, job->msg + offset, job->len - offset);
+	return check_signed_hash(&hash, sig, key);
+}
+
+static enum sigcheck_result check_cannounce_job(const struct sigcheck_job *job)
+{
+	const u8 *cursor = job->msg;
+	size_t max = job->len;
+	secp256k1_ecdsa_signature sigs[4];
+	struct node_id ids[2];
+	struct pubkey keys[4];
+	struct sha256_double hash;
+
+	/* See decode_channel_announcement_ids() for the format. */
+	fromwire_u16(&cursor, &max);
+	for (size_t i = 0; i < 4; i++)
+		fromwire_secp256k1_ecdsa_signature(&cursor, &max, &sigs[i]);
+	fromwire_pad(&cursor, &max, fromwire_u16(&cursor, &max));
+	fromwire_pad(&cursor, &max, sizeof(struct bitcoin_blkid));
+	fromwire_pad(&cursor, &max, sizeof(struct short_channel_id));
+	fromwire_node_id(&cursor, &max, &ids[0]);
+	fromwire_node_id(&cursor, &max, &ids[1]);
+	fromwire_pubkey(&cursor, &max, &keys[2]);
+	fromwire_pubkey(&cursor, &max, &keys[3]);
+	if (!cursor
+	    || !pubkey_from_node_id(&keys[0], &ids[0])
+	    || !pubkey_from_node_id(&keys[1], &ids[1]))
+		return SIGCHECK_UNCHECKED;
+
+	/* 2 byte msg type + 256 byte signatures */
+	sha256_double(&hash, job->msg + 258, job->len - 258);
+	for (size_t i = 0; i < 4; i++) {
+		if (!check_signed_hash(&hash, &sigs[i], &keys[i]))
+			return SIGCHECK_BAD;
+	}
+	return SIGCHECK_GOOD;
+}
+
+static enum sigcheck_result check_update_job(const struct sigcheck_job *job)
+{
+	const u8 *cursor = job->msg;
+	size_t max = job->len;
+	secp256k1_ecdsa_signature sig;
+	struct pubkey key;
+
+	if (!job->have_signer)
+		return SIGCHECK_UNCHECKED;
+
+	fromwire_u16(&cursor, &max);
+	fromwire_secp256k1_ecdsa_signature(&cursor, &max, &sig);
+	if (!cursor || !pubkey_from_node_id(&key, &job->signer))
+		return SIGCHECK_UNCHECKED;
+
+	/* 2 byte msg type + 64 byte signature */
+	return check_sig(job, 66, &sig, &key) ? SIGCHECK_GOOD : SIGCHECK_BAD;
+}
+
+static enum sigcheck_result check_nannounce_job(const struct sigcheck_job *job)
+{
+	const u8 *cursor = job->msg;
+	size_t max = job->len;
+	secp256k1_ecdsa_signature sig;
+	struct node_id id;
+	struct pubkey key;
+
+	/* BOLT #7:
+	 *
+	 * 1. type: 257 (`node_announcement`)
+	 * 2. data:
+	 *    * [`signature`:`signature`]
+	 *    * [`u16`:`flen`]
+	 *    * [`flen*byte`:`features`]
+	 *    * [`u32`:`timestamp`]
+	 *    * [`point`:`node_id`]
+	 */
+	fromwire_u16(&cursor, &max);
+	fromwire_secp256k1_ecdsa_signature(&cursor, &max, &sig);
+	fromwire_pad(&cursor, &max, fromwire_u16(&cursor, &max));
+	fromwire_u32(&cursor, &max);
+	fromwire_node_id(&cursor, &max, &id);
+	if (!cursor || !pubkey_from_node_id(&key, &id))
+		return SIGCHECK_UNCHECKED;
+
+	return check_sig(job, 66, &sig, &key) ? SIGCHECK_GOOD : SIGCHECK_BAD;
+}
+
+static void check_job(struct sigcheck_job *job)
+{
+	const u8 *cursor = job->msg;
+	size_t max = job->len;
+
+	/* Can't use peektype: we don't touch tal in threads. */
+	switch (fromwire_u16(&cursor, &max)) {
+	case WIRE_CHANNEL_ANNOUNCEMENT:
+		job->result = check_cannounce_job(job);
+		return;
+	case WIRE_CHANNEL_UPDATE:
+		job->result = check_update_job(job);
+		return;
+	case WIRE_NODE_ANNOUNCEMENT:
+		job->result = check_nannounce_job(job);
+		return;
+	}
+	job->result = SIGCHECK_UNCHECKED;
+}
+
+/* Take chunks of the current batch until there are none left.  Called with
+ * the lock held, returns with it held. */
+static void do_jobs(struct sigcheck_pool *pool)
+{
+	while (pool->next < pool->num) {
+		struct sigcheck_job *jobs = pool->jobs + pool->next;
+		size_t num = pool->num - pool->next;
+
+		if (num > SIGCHECK_CHUNK)
+			num = SIGCHECK_CHUNK;
+		pool->next += num;
+
+		pthread_mutex_unlock(&pool->lock);
+		for (size_t i = 0; i < num; i++)
+			check_job(&jobs[i]);
+		pthread_mutex_lock(&pool->lock);
+	}
+}
+
+static void *sigcheck_thread(void *arg)
+{
+	struct sigcheck_pool *pool = arg;
+	u64 batch = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (!pool->stop && pool->batch == batch)
+			pthread_cond_wait(&pool->work, &pool->lock);
+		if (pool->stop)
+			break;
+
+		/* If we woke late, this batch may be done already: then
+		 * num == next and we do nothing. */
+		batch = pool->batch;
+		pool->busy++;
+		do_jobs(pool);
+		if (--pool->busy == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+static void destroy_sigcheck_pool(struct sigcheck_pool *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (size_t i = 0; i < tal_count(pool->threads); i++)
+		pthread_join(pool->threads[i], NULL);
+	pthread_cond_destroy(&pool->work);
+	pthread_cond_destroy(&pool->done);
+	pthread_mutex_destroy(&pool->lock);
+}
+
+struct sigcheck_pool *new_sigcheck_pool(const tal_t *ctx, size_t nthreads)
+{
+	struct sigcheck_pool *pool = tal(ctx, struct sigcheck_pool);
+
+	pool->threads = tal_arr(pool, pthread_t, 0);
+	pool->jobs = NULL;
+	pool->num = pool->next = 0;
+	pool->batch = 0;
+	pool->busy = 0;
+	pool->stop = false;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	for (size_t i = 0; i < nthreads; i++) {
+		pthread_t thread;
+
+		/* We can always manage with fewer. */
+		if (pthread_create(&thread, NULL, sigcheck_thread, pool) != 0) {
+			status_unusual("sigcheck: only started %zu of %zu"
+				       " threads", i, nthreads);
+			break;
+		}
+		tal_arr_expand(&pool->threads, thread);
+	}
+	tal_add_destructor(pool, destroy_sigcheck_pool);
+	return pool;
+}
+
+void sigcheck_run(struct sigcheck_pool *pool,
+		  struct sigcheck_job *jobs, size_t num)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->jobs = jobs;
+	pool->num = num;
+	pool->next = 0;
+	/* Not worth waking anyone for a handful. */
+	if (num > SIGCHECK_CHUNK) {
+		pool->batch++;
+		pthread_cond_broadcast(&pool->work);
+	}
+
+	do_jobs(pool);
+	while (pool->busy)
+		pthread_cond_wait(&pool->done, &pool->lock);
+
+	/* Nobody can start on these once we return. */
+	pool->jobs = NULL;
+	pool->num = pool->next = 0;
+	pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,60 @@
+#ifndef LIGHTNING_GOSSIPD_SIGCHECK_H
+#define LIGHTNING_GOSSIPD_SIGCHECK_H
+#include "config.h"
+#include <ccan/short_types/short_types.h>
+#include <ccan/tal/tal.h>
+#include <common/node_id.h>
+
+/**
+ * sigcheck -- check gossip signatures on worker threads
+ *
+ * Checking signatures is almost all the work of accepting gossip: four for
+ * a channel_announcement, one each for channel_update and node_announcement.
+ * A sigcheck_pool checks a batch of messages at once, using every CPU.
+ */
+struct sigcheck_pool;
+
+enum sigcheck_result {
+	/* Couldn't tell (malformed, or channel_update with no signer):
+	 * the routing code has to check it as usual. */
+	SIGCHECK_UNCHECKED,
+	/* All the signatures are good. */
+	SIGCHECK_GOOD,
+	/* At least one is bad (the routing code will say which). */
+	SIGCHECK_BAD,
+};
+
+struct sigcheck_job {
+	/* channel_announcement, channel_update or node_announcement */
+	const u8 *msg;
+	size_t len;
+
+	/* channel_update isn't self-contained: who should have signed it? */
+	bool have_signer;
+	struct node_id signer;
+
+	/* Set by sigcheck_run() */
+	enum sigcheck_result result;
+};
+
+/**
+ * new_sigcheck_pool - start worker threads for checking signatures
+ * @ctx: tal context; freeing the pool stops the threads.
+ * @nthreads: number of threads, in addition to the caller of sigcheck_run().
+ *
+ * With @nthreads 0, sigcheck_run() just checks everything itself.
+ */
+struct sigcheck_pool *new_sigcheck_pool(const tal_t *ctx, size_t nthreads);
+
+/**
+ * sigcheck_run - check the signatures of every job, and wait for them all.
+ * @pool: the pool from new_sigcheck_pool().
+ * @jobs: the messages to check: this sets their ->result.
+ * @num: the number of @jobs.
+ *
+ * The caller works on the batch too.  The threads don't allocate, and only
+ * read ->msg, so the messages can be ordinary tal objects.
+ */
+void sigcheck_run(struct sigcheck_pool *pool,
+		  struct sigcheck_job *jobs, size_t num);
+#endif /* LIGHTNING_GOSSIPD_SIGCHECK_H */
@@ -0,0 +1,418 @@
+/* How long does it take to answer a query_channel_range for every channel
+ * we know, with timestamps and checksums?  (Those are only sent with
+ * EXPERIMENTAL_FEATURES, so otherwise we just time the scids.)
+ *
+ * Usage: run-bench-channel_range [num_channels [num_nodes]]
+ *
+ * Try 1000000 to see what a peer asking for the whole network costs us. */
+int gossipd_main(int argc, char *argv[]);
+#define main gossipd_main
+#include "../gossipd.c"
+#undef main
+/* gossipd.c has its own static one of these. */
+#define node_has_public_channels routing_node_has_public_channels
+#include "../routing.c"
+#undef node_has_public_channels
+#include "../gossip_store.c"
+#include <ccan/err/err.h>
+#include <common/test/bench.h>
+#include <stdio.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for check_ping_make_pong */
+bool check_ping_make_pong(const tal_t *ctx UNNEEDED, const u8 *ping UNNEEDED, u8 **pong UNNEEDED)
+{ fprintf(stderr, "check_ping_make_pong called!\n"); abort(); }
+/* Generated stub for daemon_conn_new_ */
+struct daemon_conn *daemon_conn_new_(const tal_t *ctx UNNEEDED, int fd UNNEEDED,
+				     struct io_plan *(*recv)(struct io_conn * UNNEEDED,
+							     const u8 * UNNEEDED,
+							     void *) UNNEEDED,
+				     void (*outq_empty)(void *) UNNEEDED,
+				     void *arg UNNEEDED)
+{ fprintf(stderr, "daemon_conn_new_ called!\n"); abort(); }
+/* Generated stub for daemon_conn_read_next */
+struct io_plan *daemon_conn_read_next(struct io_conn *conn UNNEEDED,
+				      struct daemon_conn *dc UNNEEDED)
+{ fprintf(stderr, "daemon_conn_read_next called!\n"); abort(); }
+/* Generated stub for daemon_conn_send_fd */
+void daemon_conn_send_fd(struct daemon_conn *dc UNNEEDED, int fd UNNEEDED)
+{ fprintf(stderr, "daemon_conn_send_fd called!\n"); abort(); }
+/* Generated stub for daemon_conn_wake */
+void daemon_conn_wake(struct daemon_conn *dc UNNEEDED)
+{ fprintf(stderr, "daemon_conn_wake called!\n"); abort(); }
+/* Generated stub for daemon_shutdown */
+void daemon_shutdown(void)
+{ fprintf(stderr, "daemon_shutdown called!\n"); abort(); }
+/* Generated stub for decode_short_ids */
+struct short_channel_id *decode_short_ids(const tal_t *ctx UNNEEDED, const u8 *encoded UNNEEDED)
+{ fprintf(stderr, "decode_short_ids called!\n"); abort(); }
+/* Generated stub for dump_memleak */
+bool dump_memleak(struct htable *memtable UNNEEDED)
+{ fprintf(stderr, "dump_memleak called!\n"); abort(); }
+/* Generated stub for fromwire_amount_below_minimum */
+bool fromwire_amount_below_minimum(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct amount_msat *htlc_msat UNNEEDED, u8 **channel_update UNNEEDED)
+{ fprintf(stderr, "fromwire_amount_below_minimum called!\n"); abort(); }
+/* Generated stub for fromwire_expiry_too_soon */
+bool fromwire_expiry_too_soon(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u8 **channel_update UNNEEDED)
+{ fprintf(stderr, "fromwire_expiry_too_soon called!\n"); abort(); }
+/* Generated stub for fromwire_fee_insufficient */
+bool fromwire_fee_insufficient(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct amount_msat *htlc_msat UNNEEDED, u8 **channel_update UNNEEDED)
+{ fprintf(stderr, "fromwire_fee_insufficient called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_dev_set_max_scids_encode_size */
+bool fromwire_gossip_dev_set_max_scids_encode_size(const void *p UNNEEDED, u32 *max UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_dev_set_max_scids_encode_size called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_dev_suppress */
+bool fromwire_gossip_dev_suppress(const void *p UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_dev_suppress called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_get_addrs */
+bool fromwire_gossip_get_addrs(const void *p UNNEEDED, struct node_id *id UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_get_addrs called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_get_channel_peer */
+bool fromwire_gossip_get_channel_peer(const void *p UNNEEDED, struct short_channel_id *channel_id UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_get_channel_peer called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_get_incoming_channels */
+bool fromwire_gossip_get_incoming_channels(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, bool **private_too UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_get_incoming_channels called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_get_txout_reply */
+bool fromwire_gossip_get_txout_reply(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct short_channel_id *short_channel_id UNNEEDED, struct amount_sat *satoshis UNNEEDED, u8 **outscript UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_get_txout_reply called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_getchannels_request */
+bool fromwire_gossip_getchannels_request(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct short_channel_id **short_channel_id UNNEEDED, struct node_id **source UNNEEDED, struct short_channel_id **prev UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_getchannels_request called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_getnodes_request */
+bool fromwire_gossip_getnodes_request(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id **id UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_getnodes_request called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_getroute_request */
+bool fromwire_gossip_getroute_request(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id **source UNNEEDED, struct node_id *destination UNNEEDED, struct amount_msat *msatoshi UNNEEDED, u64 *riskfactor_by_million UNNEEDED, u32 *final_cltv UNNEEDED, double *fuzz UNNEEDED, struct short_channel_id_dir **excluded UNNEEDED, u32 *max_hops UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_getroute_request called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_getroutes_request */
+bool fromwire_gossip_getroutes_request(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id **source UNNEEDED, struct node_id **destinations UNNEEDED, struct amount_msat **msatoshis UNNEEDED, u64 *riskfactor_by_million UNNEEDED, u32 *final_cltv UNNEEDED, double *fuzz UNNEEDED, struct short_channel_id_dir **excluded UNNEEDED, u32 *max_hops UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_getroutes_request called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_local_channel_close */
+bool fromwire_gossip_local_channel_close(const void *p UNNEEDED, struct short_channel_id *short_channel_id UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_local_channel_close called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_new_peer */
+bool fromwire_gossip_new_peer(const void *p UNNEEDED, struct node_id *id UNNEEDED, bool *gossip_queries_feature UNNEEDED, bool *initial_routing_sync UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_new_peer called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_outpoint_spent */
+bool fromwire_gossip_outpoint_spent(const void *p UNNEEDED, struct short_channel_id *short_channel_id UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_outpoint_spent called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_payment_failure */
+bool fromwire_gossip_payment_failure(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id *erring_node UNNEEDED, struct short_channel_id *erring_channel UNNEEDED, u8 *erring_channel_direction UNNEEDED, u8 **error UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_payment_failure called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_ping */
+bool fromwire_gossip_ping(const void *p UNNEEDED, struct node_id *id UNNEEDED, u16 *num_pong_bytes UNNEEDED, u16 *len UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_ping called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_query_channel_range */
+bool fromwire_gossip_query_channel_range(const void *p UNNEEDED, struct node_id *id UNNEEDED, u32 *first_blocknum UNNEEDED, u32 *number_of_blocks UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_query_channel_range called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_query_scids */
+bool fromwire_gossip_query_scids(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id *id UNNEEDED, struct short_channel_id **ids UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_query_scids called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_send_timestamp_filter */
+bool fromwire_gossip_send_timestamp_filter(const void *p UNNEEDED, struct node_id *id UNNEEDED, u32 *first_timestamp UNNEEDED, u32 *timestamp_range UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_send_timestamp_filter called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_store_channel_amount */
+bool fromwire_gossip_store_channel_amount(const void *p UNNEEDED, struct amount_sat *satoshis UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_store_channel_amount called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_store_private_update */
+bool fromwire_gossip_store_private_update(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u8 **update UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_store_private_update called!\n"); abort(); }
+/* Generated stub for fromwire_gossipctl_init */
+bool fromwire_gossipctl_init(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct bitcoin_blkid *chain_hash UNNEEDED, struct node_id *id UNNEEDED, u8 **globalfeatures UNNEEDED, u8 rgb[3] UNNEEDED, u8 alias[32] UNNEEDED, u32 *update_channel_interval UNNEEDED, struct wireaddr **announcable UNNEEDED, u32 **dev_gossip_time UNNEEDED)
+{ fprintf(stderr, "fromwire_gossipctl_init called!\n"); abort(); }
+/* Generated stub for fromwire_gossipd_get_update */
+bool fromwire_gossipd_get_update(const void *p UNNEEDED, struct short_channel_id *short_channel_id UNNEEDED)
+{ fprintf(stderr, "fromwire_gossipd_get_update called!\n"); abort(); }
+/* Generated stub for fromwire_gossipd_local_add_channel */
+bool fromwire_gossipd_local_add_channel(const void *p UNNEEDED, struct short_channel_id *short_channel_id UNNEEDED, struct node_id *remote_node_id UNNEEDED, struct amount_sat *satoshis UNNEEDED)
+{ fprintf(stderr, "fromwire_gossipd_local_add_channel called!\n"); abort(); }
+/* Generated stub for fromwire_gossipd_local_channel_update */
+bool fromwire_gossipd_local_channel_update(const void *p UNNEEDED, struct short_channel_id *short_channel_id UNNEEDED, bool *disable UNNEEDED, u16 *cltv_expiry_delta UNNEEDED, struct amount_msat *htlc_minimum_msat UNNEEDED, u32 *fee_base_msat UNNEEDED, u32 *fee_proportional_millionths UNNEEDED, struct amount_msat *htlc_maximum_msat UNNEEDED)
+{ fprintf(stderr, "fromwire_gossipd_local_channel_update called!\n"); abort(); }
+/* Generated stub for fromwire_hsm_cupdate_sig_reply */
+bool fromwire_hsm_cupdate_sig_reply(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u8 **cu UNNEEDED)
+{ fprintf(stderr, "fromwire_hsm_cupdate_sig_reply called!\n"); abort(); }
+/* Generated stub for fromwire_hsm_node_announcement_sig_reply */
+bool fromwire_hsm_node_announcement_sig_reply(const void *p UNNEEDED, secp256k1_ecdsa_signature *signature UNNEEDED)
+{ fprintf(stderr, "fromwire_hsm_node_announcement_sig_reply called!\n"); abort(); }
+/* Generated stub for fromwire_incorrect_cltv_expiry */
+bool fromwire_incorrect_cltv_expiry(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u32 *cltv_expiry UNNEEDED, u8 **channel_update UNNEEDED)
+{ fprintf(stderr, "fromwire_incorrect_cltv_expiry called!\n"); abort(); }
+/* Generated stub for fromwire_temporary_channel_failure */
+bool fromwire_temporary_channel_failure(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u8 **channel_update UNNEEDED)
+{ fprintf(stderr, "fromwire_temporary_channel_failure called!\n"); abort(); }
+/* Generated stub for fromwire_wireaddr */
+bool fromwire_wireaddr(const u8 **cursor UNNEEDED, size_t *max UNNEEDED, struct wireaddr *addr UNNEEDED)
+{ fprintf(stderr, "fromwire_wireaddr called!\n"); abort(); }
+/* Generated stub for gossip_peerd_wire_type_name */
+const char *gossip_peerd_wire_type_name(int e UNNEEDED)
+{ fprintf(stderr, "gossip_peerd_wire_type_name called!\n"); abort(); }
+/* Generated stub for got_pong */
+const char *got_pong(const u8 *pong UNNEEDED, size_t *num_pings_outstanding UNNEEDED)
+{ fprintf(stderr, "got_pong called!\n"); abort(); }
+/* Generated stub for make_ping */
+u8 *make_ping(const tal_t *ctx UNNEEDED, u16 num_pong_bytes UNNEEDED, u16 padlen UNNEEDED)
+{ fprintf(stderr, "make_ping called!\n"); abort(); }
+/* Generated stub for master_badmsg */
+void master_badmsg(u32 type_expected UNNEEDED, const u8 *msg)
+{ fprintf(stderr, "master_badmsg called!\n"); abort(); }
+/* Generated stub for memleak_add_helper_ */
+void memleak_add_helper_(const tal_t *p UNNEEDED, void (*cb)(struct htable *memtable UNNEEDED,
+						    const tal_t *)){ }
+/* Generated stub for memleak_enter_allocations */
+struct htable *memleak_enter_allocations(const tal_t *ctx UNNEEDED,
+					 const void *exclude1 UNNEEDED,
+					 const void *exclude2 UNNEEDED)
+{ fprintf(stderr, "memleak_enter_allocations called!\n"); abort(); }
+/* Generated stub for memleak_remove_htable */
+void memleak_remove_htable(struct htable *memtable UNNEEDED, const struct htable *ht UNNEEDED)
+{ fprintf(stderr, "memleak_remove_htable called!\n"); abort(); }
+/* Generated stub for memleak_remove_referenced */
+void memleak_remove_referenced(struct htable *memtable UNNEEDED, const void *root UNNEEDED)
+{ fprintf(stderr, "memleak_remove_referenced called!\n"); abort(); }
+/* Generated stub for new_reltimer_ */
+struct oneshot *new_reltimer_(struct timers *timers UNNEEDED,
+			      const tal_t *ctx UNNEEDED,
+			      struct timerel expire UNNEEDED,
+			      void (*cb)(void *) UNNEEDED, void *arg UNNEEDED)
+{ fprintf(stderr, "new_reltimer_ called!\n"); abort(); }
+/* Generated stub for new_sigcheck_pool */
+struct sigcheck_pool *new_sigcheck_pool(const tal_t *ctx UNNEEDED, size_t nthreads UNNEEDED)
+{ fprintf(stderr, "new_sigcheck_pool called!\n"); abort(); }
+/* Generated stub for notleak_ */
+void *notleak_(const void *ptr UNNEEDED, bool plus_children UNNEEDED)
+{ fprintf(stderr, "notleak_ called!\n"); abort(); }
+/* Generated stub for onion_type_name */
+const char *onion_type_name(int e UNNEEDED)
+{ fprintf(stderr, "onion_type_name called!\n"); abort(); }
+/* Generated stub for sanitize_error */
+char *sanitize_error(const tal_t *ctx UNNEEDED, const u8 *errmsg UNNEEDED,
+		     struct channel_id *channel_id UNNEEDED)
+{ fprintf(stderr, "sanitize_error called!\n"); abort(); }
+/* Generated stub for sigcheck_run */
+void sigcheck_run(struct sigcheck_pool *pool UNNEEDED,
+		  struct sigcheck_job *jobs UNNEEDED, size_t num UNNEEDED)
+{ fprintf(stderr, "sigcheck_run called!\n"); abort(); }
+/* Generated stub for status_failed */
+void status_failed(enum status_failreason code UNNEEDED,
+		   const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "status_failed called!\n"); abort(); }
+/* Generated stub for status_setup_async */
+void status_setup_async(struct daemon_conn *master UNNEEDED)
+{ fprintf(stderr, "status_setup_async called!\n"); abort(); }
+/* Generated stub for subdaemon_setup */
+void subdaemon_setup(int argc UNNEEDED, char *argv[])
+{ fprintf(stderr, "subdaemon_setup called!\n"); abort(); }
+/* Generated stub for timer_expired */
+void timer_expired(tal_t *ctx UNNEEDED, struct timer *timer UNNEEDED)
+{ fprintf(stderr, "timer_expired called!\n"); abort(); }
+/* Generated stub for towire_errorfmt */
+u8 *towire_errorfmt(const tal_t *ctx UNNEEDED,
+		    const struct channel_id *channel UNNEEDED,
+		    const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "towire_errorfmt called!\n"); abort(); }
+/* Generated stub for towire_gossip_dev_compact_store_reply */
+u8 *towire_gossip_dev_compact_store_reply(const tal_t *ctx UNNEEDED, bool success UNNEEDED)
+{ fprintf(stderr, "towire_gossip_dev_compact_store_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_dev_memleak_reply */
+u8 *towire_gossip_dev_memleak_reply(const tal_t *ctx UNNEEDED, bool leak UNNEEDED)
+{ fprintf(stderr, "towire_gossip_dev_memleak_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_dev_route_cache_reply */
+u8 *towire_gossip_dev_route_cache_reply(const tal_t *ctx UNNEEDED, u32 entries UNNEEDED, u64 hits UNNEEDED, u64 misses UNNEEDED, u64 invalidated UNNEEDED)
+{ fprintf(stderr, "towire_gossip_dev_route_cache_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_get_addrs_reply */
+u8 *towire_gossip_get_addrs_reply(const tal_t *ctx UNNEEDED, const struct wireaddr *addrs UNNEEDED)
+{ fprintf(stderr, "towire_gossip_get_addrs_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_get_channel_peer_reply */
+u8 *towire_gossip_get_channel_peer_reply(const tal_t *ctx UNNEEDED, const struct node_id *peer_id UNNEEDED)
+{ fprintf(stderr, "towire_gossip_get_channel_peer_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_get_incoming_channels_reply */
+u8 *towire_gossip_get_incoming_channels_reply(const tal_t *ctx UNNEEDED, const struct route_info *route_info UNNEEDED)
+{ fprintf(stderr, "towire_gossip_get_incoming_channels_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_get_txout */
+u8 *towire_gossip_get_txout(const tal_t *ctx UNNEEDED, const struct short_channel_id *short_channel_id UNNEEDED)
+{ fprintf(stderr, "towire_gossip_get_txout called!\n"); abort(); }
+/* Generated stub for towire_gossip_getchannels_reply */
+u8 *towire_gossip_getchannels_reply(const tal_t *ctx UNNEEDED, bool complete UNNEEDED, const struct gossip_getchannels_entry **nodes UNNEEDED)
+{ fprintf(stderr, "towire_gossip_getchannels_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_getnodes_reply */
+u8 *towire_gossip_getnodes_reply(const tal_t *ctx UNNEEDED, const struct gossip_getnodes_entry **nodes UNNEEDED)
+{ fprintf(stderr, "towire_gossip_getnodes_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_getroute_reply */
+u8 *towire_gossip_getroute_reply(const tal_t *ctx UNNEEDED, const struct route_hop *hops UNNEEDED)
+{ fprintf(stderr, "towire_gossip_getroute_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_getroutes_reply */
+u8 *towire_gossip_getroutes_reply(const tal_t *ctx UNNEEDED, const u16 *route_lens UNNEEDED, const struct route_hop *hops UNNEEDED)
+{ fprintf(stderr, "towire_gossip_getroutes_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_new_peer_reply */
+u8 *towire_gossip_new_peer_reply(const tal_t *ctx UNNEEDED, bool success UNNEEDED, const struct gossip_state *gs UNNEEDED)
+{ fprintf(stderr, "towire_gossip_new_peer_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_ping_reply */
+u8 *towire_gossip_ping_reply(const tal_t *ctx UNNEEDED, const struct node_id *id UNNEEDED, bool sent UNNEEDED, u16 totlen UNNEEDED)
+{ fprintf(stderr, "towire_gossip_ping_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_query_channel_range_reply */
+u8 *towire_gossip_query_channel_range_reply(const tal_t *ctx UNNEEDED, u32 final_first_block UNNEEDED, u32 final_num_blocks UNNEEDED, bool final_complete UNNEEDED, const struct short_channel_id *scids UNNEEDED)
+{ fprintf(stderr, "towire_gossip_query_channel_range_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_scids_reply */
+u8 *towire_gossip_scids_reply(const tal_t *ctx UNNEEDED, bool ok UNNEEDED, bool complete UNNEEDED)
+{ fprintf(stderr, "towire_gossip_scids_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_store_channel_amount */
+u8 *towire_gossip_store_channel_amount(const tal_t *ctx UNNEEDED, struct amount_sat satoshis UNNEEDED)
+{ fprintf(stderr, "towire_gossip_store_channel_amount called!\n"); abort(); }
+/* Generated stub for towire_gossip_store_private_update */
+u8 *towire_gossip_store_private_update(const tal_t *ctx UNNEEDED, const u8 *update UNNEEDED)
+{ fprintf(stderr, "towire_gossip_store_private_update called!\n"); abort(); }
+/* Generated stub for towire_gossipd_get_update_reply */
+u8 *towire_gossipd_get_update_reply(const tal_t *ctx UNNEEDED, const u8 *update UNNEEDED)
+{ fprintf(stderr, "towire_gossipd_get_update_reply called!\n"); abort(); }
+/* Generated stub for towire_gossipd_new_store_fd */
+u8 *towire_gossipd_new_store_fd(const tal_t *ctx UNNEEDED, const u64 *old_offsets UNNEEDED, const u64 *new_offsets UNNEEDED)
+{ fprintf(stderr, "towire_gossipd_new_store_fd called!\n"); abort(); }
+/* Generated stub for towire_hsm_cupdate_sig_req */
+u8 *towire_hsm_cupdate_sig_req(const tal_t *ctx UNNEEDED, const u8 *cu UNNEEDED)
+{ fprintf(stderr, "towire_hsm_cupdate_sig_req called!\n"); abort(); }
+/* Generated stub for towire_hsm_node_announcement_sig_req */
+u8 *towire_hsm_node_announcement_sig_req(const tal_t *ctx UNNEEDED, const u8 *announcement UNNEEDED)
+{ fprintf(stderr, "towire_hsm_node_announcement_sig_req called!\n"); abort(); }
+/* Generated stub for towire_wireaddr */
+void towire_wireaddr(u8 **pptr UNNEEDED, const struct wireaddr *addr UNNEEDED)
+{ fprintf(stderr, "towire_wireaddr called!\n"); abort(); }
+/* Generated stub for wire_sync_read */
+u8 *wire_sync_read(const tal_t *ctx UNNEEDED, int fd UNNEEDED)
+{ fprintf(stderr, "wire_sync_read called!\n"); abort(); }
+/* Generated stub for wire_sync_write */
+bool wire_sync_write(int fd UNNEEDED, const void *msg TAKES UNNEEDED)
+{ fprintf(stderr, "wire_sync_write called!\n"); abort(); }
+/* Generated stub for wireaddr_eq */
+bool wireaddr_eq(const struct wireaddr *a UNNEEDED, const struct wireaddr *b UNNEEDED)
+{ fprintf(stderr, "wireaddr_eq called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+static size_t num_replies, reply_bytes;
+
+void status_fmt(enum log_level level UNUSED, const char *fmt UNUSED, ...)
+{
+}
+
+void daemon_conn_send(struct daemon_conn *dc UNUSED, const u8 *msg TAKES)
+{
+	num_replies++;
+	reply_bytes += tal_bytelen(msg);
+	if (taken(msg))
+		tal_free(msg);
+}
+
+static struct node_id nodeid(size_t n)
+{
+	struct node_id id;
+	struct pubkey k;
+	struct secret s;
+
+	memset(&s, 0xFF, sizeof(s));
+	memcpy(&s, &n, sizeof(n));
+	pubkey_from_secret(&s, &k);
+	node_id_from_pubkey(&id, &k);
+	return id;
+}
+
+/* As if we'd loaded them from the gossip_store. */
+static void add_channel(struct routing_state *rstate,
+			const struct node_id *nodes, size_t num_nodes,
+			size_t n)
+{
+	struct short_channel_id scid;
+	struct chan *chan;
+	size_t n1 = pseudorand(num_nodes), n2;
+
+	/* Roughly mainnet density: a dozen channels a block. */
+	if (!mk_short_channel_id(&scid, 500000 + n / 12, n % 12, 0))
+		abort();
+
+	do {
+		n2 = pseudorand(num_nodes);
+	} while (n2 == n1);
+	if (node_id_cmp(&nodes[n1], &nodes[n2]) > 0) {
+		size_t tmp = n1;
+		n1 = n2;
+		n2 = tmp;
+	}
+
+	chan = new_chan(rstate, &scid, &nodes[n1], &nodes[n2],
+			AMOUNT_SAT(1000000));
+	/* Non-zero means public / defined. */
+	chan->bcast.index = 1;
+	for (size_t i = 0; i < 2; i++) {
+		chan->half[i].bcast.index = 1;
+		chan->half[i].bcast.timestamp = 1570000000 + pseudorand(1000000);
+		chan->half[i].csum = pseudorand(UINT32_MAX);
+	}
+}
+
+static void bench(struct peer *peer, u32 last_block,
+		  enum query_option_flags flags, const char *desc)
+{
+	struct timemono start;
+	u64 usec;
+
+	num_replies = reply_bytes = 0;
+	start = time_mono();
+	/* Just what handle_query_channel_range does for 0+UINT32_MAX. */
+	if (!queue_channel_ranges(peer, 0, last_block + 1,
+				  UINT32_MAX - last_block - 1, flags))
+		errx(1, "queue_channel_ranges failed");
+	usec = bench_usec_since(start);
+	printf("%s: %zu replies, %zu bytes, %"PRIu64" usec\n",
+	       desc, num_replies, reply_bytes, usec);
+}
+
+int main(int argc, char *argv[])
+{
+	struct daemon *daemon;
+	struct peer *peer;
+	struct node_id *nodes;
+	size_t num_channels = 50, num_nodes = 20;
+	struct short_channel_id last_scid;
+
+	setup_locale();
+	secp256k1_ctx = secp256k1_context_create(SECP256K1_CONTEXT_VERIFY
+						 | SECP256K1_CONTEXT_SIGN);
+	setup_tmpctx();
+
+	/* Try 35000 5000, about the size of mainnet. */
+	bench_sizes(argc, argv, "[num_channels [num_nodes]]",
+		    &num_channels, &num_nodes);
+	if (num_nodes < 2)
+		errx(1, "Need at least 2 nodes");
+
+	daemon = tal(tmpctx, struct daemon);
+	memset(&daemon->chain_hash, 0, sizeof(daemon->chain_hash));
+	daemon->id = nodeid(0);
+	daemon->rstate = new_routing_state(daemon, NULL, &daemon->id, 0,
+					   NULL, NULL);
+
+	nodes = tal_arr(daemon, struct node_id, num_nodes);
+	for (size_t i = 0; i < num_nodes; i++)
+		nodes[i] = nodeid(i + 1);
+	for (size_t i = 0; i < num_channels; i++)
+		add_channel(daemon->rstate, nodes, num_nodes, i);
+
+	peer = tal(daemon, struct peer);
+	peer->daemon = daemon;
+	peer->dc = NULL;
+
+	if (!uintmap_last(&daemon->rstate->chanmap, &last_scid.u64))
+		errx(1, "No channels?");
+
+	bench(peer, short_channel_id_blocknum(&last_scid), 0, "scids only");
+#if EXPERIMENTAL_FEATURES
+	/* This is where the cached checksums matter. */
+	bench(peer, short_channel_id_blocknum(&last_scid),
+	      QUERY_ADD_TIMESTAMPS|QUERY_ADD_CHECKSUMS,
+	      "with timestamps and checksums");
+#endif
+
+	tal_free(tmpctx);
+	secp256k1_context_destroy(secp256k1_ctx);
+	return 0;
+}
@@ -64,7 +64,9 @@ u8 *towire_gossip_store_channel_amount(const tal_t *ctx UNNEEDED, struct amount_
 u8 *towire_gossip_store_private_update(const tal_t *ctx UNNEEDED, const u8 *update UNNEEDED)
 { fprintf(stderr, "towire_gossip_store_private_update called!\n"); abort(); }
 /* Generated stub for update_peers_broadcast_index */
-void update_peers_broadcast_index(struct list_head *peers UNNEEDED, u32 offset UNNEEDED)
+void update_peers_broadcast_index(struct list_head *peers UNNEEDED,
+				  const u64 *old_offsets UNNEEDED,
+				  const u64 *new_offsets UNNEEDED)
 { fprintf(stderr, "update_peers_broadcast_index called!\n"); abort(); }
 /* AUTOGENERATED MOCKS END */
 
@@ -108,6 +110,7 @@ static void add_connection(struct routing_state *rstate,
 	c->bcast.index = 1;
 	c->htlc_maximum = AMOUNT_MSAT(-1ULL);
 	c->htlc_minimum = AMOUNT_MSAT(0);
+	update_route_edge(rstate, chan, idx);
 }
 
 static struct node_id nodeid(size_t n)
@@ -170,6 +173,8 @@ int main(int argc, char *argv[])
 	size_t num_nodes = 100, num_runs = 1;
 	struct timemono start, end;
 	size_t route_lengths[ROUTING_MAX_HOPS+1];
+	unsigned int max_hops = ROUTING_MAX_HOPS;
+	struct timerel slowest = time_from_nsec(0);
 	struct node_id me;
 	struct node_id *nodes;
 	bool perfme = false;
@@ -184,6 +189,9 @@ int main(int argc, char *argv[])
 	rstate = new_routing_state(tmpctx, NULL, &me, 0, NULL, NULL);
 	opt_register_noarg("--perfme", opt_set_bool, &perfme,
 			   "Run perfme-start and perfme-stop around benchmark");
+	opt_register_arg("--max-hops", opt_set_uintval, opt_show_uintval,
+			 &max_hops,
+			 "Limit routes to this many hops (lower is slower)");
 
 	opt_parse(&argc, argv, opt_log_stderr_exit);
 
@@ -193,6 +201,8 @@ int main(int argc, char *argv[])
 		num_runs = atoi(argv[2]);
 	if (argc > 3)
 		opt_usage_and_exit("[num_nodes [num_runs]]");
+	if (max_hops < 1 || max_hops > ROUTING_MAX_HOPS)
+		errx(1, "--max-hops must be 1 to %u", ROUTING_MAX_HOPS);
 
 	printf("Creating nodes...\n");
 	nodes = tal_arr(rstate, struct node_id, num_nodes);
@@ -216,13 +226,18 @@ int main(int argc, char *argv[])
 		struct amount_msat fee;
 		struct chan **route;
 		size_t num_hops;
+		struct timemono route_start = time_mono();
+		struct timerel route_time;
 
 		route = find_route(tmpctx, rstate, from, to,
 				   (struct amount_msat){pseudorand(100000)},
 				   riskfactor,
 				   0.75, &base_seed,
-				   ROUTING_MAX_HOPS,
+				   max_hops,
 				   &fee);
+		route_time = timemono_since(route_start);
+		if (time_greater(route_time, slowest))
+			slowest = route_time;
 		num_hops = tal_count(route);
 		assert(num_hops < ARRAY_SIZE(route_lengths));
 		route_lengths[num_hops]++;
@@ -233,10 +248,14 @@ int main(int argc, char *argv[])
 	if (perfme)
 		run("perfme-stop");
 
-	printf("%zu (%zu succeeded) routes in %zu nodes in %"PRIu64" msec (%"PRIu64" nanoseconds per route)\n",
+	printf("%zu (%zu succeeded) routes in %zu nodes in %"PRIu64" msec (%"PRIu64" nanoseconds per route, %.1f routes/sec)\n",
 	       num_runs, num_runs - route_lengths[0], num_nodes,
 	       time_to_msec(timemono_between(end, start)),
-	       time_to_nsec(time_divide(timemono_between(end, start), num_runs)));
+	       time_to_nsec(time_divide(timemono_between(end, start), num_runs)),
+	       num_runs * 1000000000.0
+	       / time_to_nsec(timemono_between(end, start)));
+	printf("Slowest route (max %u hops) took %"PRIu64" usec\n",
+	       max_hops, time_to_usec(slowest));
 	for (size_t i = 0; i < ARRAY_SIZE(route_lengths); i++)
 		if (route_lengths[i])
 			printf(" Length %zu: %zu\n", i, route_lengths[i]);
@@ -0,0 +1,271 @@
+/* How long does compacting the gossip_store take, and how long does it stop
+ * us from doing anything else?
+ *
+ * Usage: run-bench-gossip_store_compact [num_channels [updates_per_msec]]
+ *
+ * We keep replacing channel_updates while it's going, like a busy gossipd,
+ * and check everything ends up where it should. */
+#include "../routing.c"
+#include "../gossip_store.c"
+#include "../gen_gossip_store.c"
+#include <ccan/err/err.h>
+#include <ccan/read_write_all/read_write_all.h>
+#include <common/test/bench.h>
+#include <stdio.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for fromwire_gossipd_local_add_channel */
+bool fromwire_gossipd_local_add_channel(const void *p UNNEEDED, struct short_channel_id *short_channel_id UNNEEDED, struct node_id *remote_node_id UNNEEDED, struct amount_sat *satoshis UNNEEDED)
+{ fprintf(stderr, "fromwire_gossipd_local_add_channel called!\n"); abort(); }
+/* Generated stub for fromwire_wireaddr */
+bool fromwire_wireaddr(const u8 **cursor UNNEEDED, size_t *max UNNEEDED, struct wireaddr *addr UNNEEDED)
+{ fprintf(stderr, "fromwire_wireaddr called!\n"); abort(); }
+/* Generated stub for memleak_add_helper_ */
+void memleak_add_helper_(const tal_t *p UNNEEDED, void (*cb)(struct htable *memtable UNNEEDED,
+						    const tal_t *)){ }
+/* Generated stub for memleak_remove_htable */
+void memleak_remove_htable(struct htable *memtable UNNEEDED, const struct htable *ht UNNEEDED)
+{ fprintf(stderr, "memleak_remove_htable called!\n"); abort(); }
+/* Generated stub for onion_type_name */
+const char *onion_type_name(int e UNNEEDED)
+{ fprintf(stderr, "onion_type_name called!\n"); abort(); }
+/* Generated stub for sanitize_error */
+char *sanitize_error(const tal_t *ctx UNNEEDED, const u8 *errmsg UNNEEDED,
+		     struct channel_id *channel_id UNNEEDED)
+{ fprintf(stderr, "sanitize_error called!\n"); abort(); }
+/* Generated stub for status_failed */
+void status_failed(enum status_failreason code UNNEEDED,
+		   const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "status_failed called!\n"); abort(); }
+/* Generated stub for towire_errorfmt */
+u8 *towire_errorfmt(const tal_t *ctx UNNEEDED,
+		    const struct channel_id *channel UNNEEDED,
+		    const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "towire_errorfmt called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+static int old_store_fd;
+static size_t num_offsets;
+
+void status_fmt(enum log_level level UNUSED, const char *fmt UNUSED, ...)
+{
+}
+
+/* The records they'd be told about must be the same in each store. */
+void update_peers_broadcast_index(struct list_head *peers UNUSED,
+				  const u64 *old_offsets,
+				  const u64 *new_offsets)
+{
+	int new_fd = open(GOSSIP_STORE_FILENAME, O_RDONLY);
+
+	num_offsets = tal_count(old_offsets);
+	assert(num_offsets >= 2);
+	assert(old_offsets[0] == 1 && new_offsets[0] == 1);
+	for (size_t i = 1; i < num_offsets - 1; i++) {
+		struct gossip_hdr oldhdr, newhdr;
+
+		assert(old_offsets[i] > old_offsets[i-1]);
+		assert(new_offsets[i] > new_offsets[i-1]);
+		assert(pread(old_store_fd, &oldhdr, sizeof(oldhdr),
+			     old_offsets[i]) == sizeof(oldhdr));
+		assert(pread(new_fd, &newhdr, sizeof(newhdr),
+			     new_offsets[i]) == sizeof(newhdr));
+		assert(oldhdr.crc == newhdr.crc);
+	}
+	/* The old end is the new end. */
+	assert(old_offsets[num_offsets-1] == lseek(old_store_fd, 0, SEEK_END));
+	assert(new_offsets[num_offsets-1] == lseek(new_fd, 0, SEEK_END));
+	close(new_fd);
+}
+
+static struct node_id nodeid(size_t n)
+{
+	struct node_id id;
+	struct pubkey k;
+	struct secret s;
+
+	memset(&s, 0xFF, sizeof(s));
+	memcpy(&s, &n, sizeof(n));
+	pubkey_from_secret(&s, &k);
+	node_id_from_pubkey(&id, &k);
+	return id;
+}
+
+/* Just enough to tell them apart. */
+static u8 *mkmsg(const tal_t *ctx, enum wire_type type, size_t len,
+		 u64 n, u32 gen)
+{
+	u8 *msg = tal_arr(ctx, u8, 0);
+
+	towire_u16(&msg, type);
+	towire_u64(&msg, n);
+	towire_u32(&msg, gen);
+	while (tal_count(msg) < len)
+		towire_u8(&msg, 0);
+	return msg;
+}
+
+static void check_msg(struct gossip_store *gs, u32 index,
+		      enum wire_type type, u64 n, u32 gen)
+{
+	const u8 *msg = gossip_store_get(tmpctx, gs, index);
+	const u8 *cursor = msg;
+	size_t max = tal_count(msg);
+
+	assert(fromwire_u16(&cursor, &max) == type);
+	assert(fromwire_u64(&cursor, &max) == n);
+	assert(fromwire_u32(&cursor, &max) == gen);
+}
+
+/* gens[n * 2 + dir] counts the updates to each side of channel n. */
+static void replace_update(struct gossip_store *gs, struct chan *chan,
+			   size_t n, int dir, u32 *gens)
+{
+	u32 gen = ++gens[n * 2 + dir];
+
+	gossip_store_delete(gs, &chan->half[dir].bcast, WIRE_CHANNEL_UPDATE);
+	chan->half[dir].bcast.index
+		= gossip_store_add(gs,
+				   mkmsg(tmpctx, WIRE_CHANNEL_UPDATE, 136,
+					 n * 2 + dir, gen),
+				   1570000000 + gen, NULL);
+}
+
+int main(int argc, char *argv[])
+{
+	struct routing_state *rstate;
+	struct gossip_store *gs;
+	struct node_id *nodes, me;
+	struct chan **chans;
+	u32 *gens;
+	size_t num_channels = 50, num_nodes, updates_per_msec = 1;
+	size_t num_updates = 0, num_polls = 0, stale;
+	char tmpdir[] = "/tmp/run-bench-gossip_store_compact.XXXXXX";
+	struct timemono start;
+	u64 usec, longest = 0;
+	bool ok;
+
+	setup_locale();
+	secp256k1_ctx = secp256k1_context_create(SECP256K1_CONTEXT_VERIFY
+						 | SECP256K1_CONTEXT_SIGN);
+	setup_tmpctx();
+
+	/* Try 10000, or 100000 to see the stop matter. */
+	bench_sizes(argc, argv, "[num_channels [updates_per_msec]]",
+		    &num_channels, &updates_per_msec);
+	num_nodes = num_channels / 10 + 2;
+
+	/* routing.c writes the gossip_store in the current directory. */
+	if (!mkdtemp(tmpdir) || chdir(tmpdir) != 0)
+		err(1, "Making temporary directory");
+
+	me = nodeid(0);
+	rstate = new_routing_state(NULL, NULL, &me, 0, NULL, NULL);
+	gs = rstate->gs;
+
+	nodes = tal_arr(rstate, struct node_id, num_nodes);
+	for (size_t i = 0; i < num_nodes; i++)
+		nodes[i] = nodeid(i + 1);
+
+	chans = tal_arr(rstate, struct chan *, num_channels);
+	gens = tal_arrz(rstate, u32, num_channels * 2);
+	for (size_t i = 0; i < num_channels; i++) {
+		struct short_channel_id scid;
+		const u8 *amount;
+		size_t n1 = i % num_nodes, n2 = (i * 7 + 1) % num_nodes;
+
+		if (n1 == n2)
+			n2 = (n2 + 1) % num_nodes;
+		if (node_id_cmp(&nodes[n1], &nodes[n2]) > 0) {
+			size_t tmp = n1;
+			n1 = n2;
+			n2 = tmp;
+		}
+		if (!mk_short_channel_id(&scid, 500000 + i / 12, i % 12, 0))
+			abort();
+		chans[i] = new_chan(rstate, &scid, &nodes[n1], &nodes[n2],
+				    AMOUNT_SAT(1000000));
+		amount = towire_gossip_store_channel_amount(tmpctx,
+							    AMOUNT_SAT(1000000));
+		chans[i]->bcast.index
+			= gossip_store_add(gs,
+					   mkmsg(tmpctx,
+						 WIRE_CHANNEL_ANNOUNCEMENT,
+						 430, i, 0),
+					   1570000000, amount);
+		for (int dir = 0; dir < 2; dir++)
+			replace_update(gs, chans[i], i, dir, gens);
+	}
+
+	/* A real store is mostly old channel_updates. */
+	for (size_t r = 0; r < 3; r++) {
+		for (size_t i = 0; i < num_channels; i++)
+			replace_update(gs, chans[i], i, r % 2, gens);
+		clean_tmpctx();
+	}
+	stale = gs->deleted;
+
+	old_store_fd = open(GOSSIP_STORE_FILENAME, O_RDONLY);
+	assert(old_store_fd >= 0);
+
+	start = time_mono();
+	if (!gossip_store_compact(gs))
+		errx(1, "Could not start compaction");
+	/* We can't start another one. */
+	assert(!gossip_store_compact(gs));
+
+	for (;;) {
+		struct timemono before = time_mono();
+		bool done = gossip_store_compact_done(gs, &ok);
+
+		usec = bench_usec_since(before);
+		if (usec > longest)
+			longest = usec;
+		num_polls++;
+		if (done)
+			break;
+
+		/* Meanwhile, gossip keeps arriving. */
+		for (size_t i = 0; i < updates_per_msec; i++) {
+			size_t n = pseudorand(num_channels);
+			int dir = pseudorand(2);
+			replace_update(gs, chans[n], n, dir, gens);
+			num_updates++;
+		}
+		clean_tmpctx();
+		usleep(1000);
+	}
+	usec = bench_usec_since(start);
+	assert(ok);
+	assert(num_offsets);
+	assert(!gs->compaction);
+
+	/* Everything is where it should be. */
+	for (size_t i = 0; i < num_channels; i++) {
+		check_msg(gs, chans[i]->bcast.index,
+			  WIRE_CHANNEL_ANNOUNCEMENT, i, 0);
+		for (int dir = 0; dir < 2; dir++)
+			check_msg(gs, chans[i]->half[dir].bcast.index,
+				  WIRE_CHANNEL_UPDATE, i * 2 + dir,
+				  gens[i * 2 + dir]);
+	}
+	/* Announcement, amount and two updates each (the only deleted ones
+	 * are those replaced while we were compacting). */
+	assert(gs->count - gs->deleted == num_channels * 4);
+	assert(gs->deleted <= num_updates);
+
+	printf("%zu channels, %zu stale records: %"PRIu64" usec to compact,"
+	       " %zu updates meanwhile, longest stop %"PRIu64" usec"
+	       " (%zu polls), %zu peer offsets\n",
+	       num_channels, stale, usec, num_updates, longest, num_polls,
+	       num_offsets);
+
+	close(old_store_fd);
+	tal_free(rstate);
+	tal_free(tmpctx);
+	unlink(GOSSIP_STORE_FILENAME);
+	if (chdir("/") != 0 || rmdir(tmpdir) != 0)
+		err(1, "Removing %s", tmpdir);
+	secp256k1_context_destroy(secp256k1_ctx);
+	return 0;
+}
@@ -0,0 +1,293 @@
+/* How much does the route cache help when we keep paying the same few
+ * nodes, while channel_updates keep arriving?
+ *
+ * Usage: run-bench-route_cache [--churn=N] [num_nodes [num_payments [num_destinations]]]
+ */
+#include <assert.h>
+#include <bitcoin/pubkey.h>
+#include <ccan/err/err.h>
+#include <ccan/opt/opt.h>
+#include <ccan/time/time.h>
+#include <common/pseudorand.h>
+#include <common/status.h>
+#include <common/test/bench.h>
+#include <stdio.h>
+
+#include "../routing.c"
+#include "../gossip_store.c"
+
+void status_fmt(enum log_level level UNUSED, const char *fmt UNUSED, ...)
+{
+}
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for fromwire_gossip_store_channel_amount */
+bool fromwire_gossip_store_channel_amount(const void *p UNNEEDED, struct amount_sat *satoshis UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_store_channel_amount called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_store_private_update */
+bool fromwire_gossip_store_private_update(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u8 **update UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_store_private_update called!\n"); abort(); }
+/* Generated stub for fromwire_gossipd_local_add_channel */
+bool fromwire_gossipd_local_add_channel(const void *p UNNEEDED, struct short_channel_id *short_channel_id UNNEEDED, struct node_id *remote_node_id UNNEEDED, struct amount_sat *satoshis UNNEEDED)
+{ fprintf(stderr, "fromwire_gossipd_local_add_channel called!\n"); abort(); }
+/* Generated stub for fromwire_wireaddr */
+bool fromwire_wireaddr(const u8 **cursor UNNEEDED, size_t *max UNNEEDED, struct wireaddr *addr UNNEEDED)
+{ fprintf(stderr, "fromwire_wireaddr called!\n"); abort(); }
+/* Generated stub for memleak_add_helper_ */
+void memleak_add_helper_(const tal_t *p UNNEEDED, void (*cb)(struct htable *memtable UNNEEDED,
+						    const tal_t *)){ }
+/* Generated stub for onion_type_name */
+const char *onion_type_name(int e UNNEEDED)
+{ fprintf(stderr, "onion_type_name called!\n"); abort(); }
+/* Generated stub for sanitize_error */
+char *sanitize_error(const tal_t *ctx UNNEEDED, const u8 *errmsg UNNEEDED,
+		     struct channel_id *channel_id UNNEEDED)
+{ fprintf(stderr, "sanitize_error called!\n"); abort(); }
+/* Generated stub for status_failed */
+void status_failed(enum status_failreason code UNNEEDED,
+		   const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "status_failed called!\n"); abort(); }
+/* Generated stub for towire_errorfmt */
+u8 *towire_errorfmt(const tal_t *ctx UNNEEDED,
+		    const struct channel_id *channel UNNEEDED,
+		    const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "towire_errorfmt called!\n"); abort(); }
+/* Generated stub for towire_gossip_store_channel_amount */
+u8 *towire_gossip_store_channel_amount(const tal_t *ctx UNNEEDED, struct amount_sat satoshis UNNEEDED)
+{ fprintf(stderr, "towire_gossip_store_channel_amount called!\n"); abort(); }
+/* Generated stub for towire_gossip_store_private_update */
+u8 *towire_gossip_store_private_update(const tal_t *ctx UNNEEDED, const u8 *update UNNEEDED)
+{ fprintf(stderr, "towire_gossip_store_private_update called!\n"); abort(); }
+/* Generated stub for update_peers_broadcast_index */
+void update_peers_broadcast_index(struct list_head *peers UNNEEDED,
+				  const u64 *old_offsets UNNEEDED,
+				  const u64 *new_offsets UNNEEDED)
+{ fprintf(stderr, "update_peers_broadcast_index called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+#if DEVELOPER
+/* Generated stub for memleak_remove_htable */
+void memleak_remove_htable(struct htable *memtable UNNEEDED, const struct htable *ht UNNEEDED)
+{ fprintf(stderr, "memleak_remove_htable called!\n"); abort(); }
+/* Generated stub for memleak_remove_intmap_ */
+void memleak_remove_intmap_(struct htable *memtable UNNEEDED, const struct intmap *m UNNEEDED)
+{ fprintf(stderr, "memleak_remove_intmap_ called!\n"); abort(); }
+#endif
+
+static struct chan **all_chans;
+
+/* Like routing_add_channel_update() does, without all the gossip. */
+static void set_half_chan(struct routing_state *rstate, struct chan *chan,
+			  int idx, u32 base_fee, u32 proportional_fee,
+			  u32 delay)
+{
+	struct half_chan *c = &chan->half[idx];
+
+	c->base_fee = base_fee;
+	c->proportional_fee = proportional_fee;
+	c->delay = delay;
+	c->channel_flags = idx;
+	/* This must be non-zero, otherwise we consider it disabled! */
+	c->bcast.index = 1;
+	c->htlc_maximum = AMOUNT_MSAT(-1ULL);
+	c->htlc_minimum = AMOUNT_MSAT(0);
+	update_route_edge(rstate, chan, idx);
+	route_cache_forget_chan(rstate, chan);
+}
+
+static void add_connection(struct routing_state *rstate,
+			   const struct node_id *nodes,
+			   u32 from, u32 to)
+{
+	struct short_channel_id scid;
+	struct chan *chan;
+	int idx = node_id_idx(&nodes[from], &nodes[to]);
+
+	if (from == to)
+		return;
+
+	/* Encode src and dst in scid. */
+	memcpy((char *)&scid + idx * sizeof(from), &from, sizeof(from));
+	memcpy((char *)&scid + (!idx) * sizeof(to), &to, sizeof(to));
+
+	chan = get_channel(rstate, &scid);
+	if (!chan) {
+		chan = new_chan(rstate, &scid, &nodes[from], &nodes[to],
+				AMOUNT_SAT(1000000));
+		tal_arr_expand(&all_chans, chan);
+	}
+	set_half_chan(rstate, chan, idx,
+		      pseudorand(1000), pseudorand(1000), pseudorand(144));
+}
+
+static struct node_id nodeid(size_t n)
+{
+	struct node_id id;
+	struct pubkey k;
+	struct secret s;
+
+	memset(&s, 0xFF, sizeof(s));
+	memcpy(&s, &n, sizeof(n));
+	pubkey_from_secret(&s, &k);
+	node_id_from_pubkey(&id, &k);
+	return id;
+}
+
+static void route_cache_clear(struct route_cache *cache)
+{
+	struct route_cache_entry *e;
+
+	while ((e = list_top(&cache->entries, struct route_cache_entry, list))
+	       != NULL)
+		route_cache_del(cache, e);
+}
+
+static bool hops_eq(const struct route_hop *a, const struct route_hop *b)
+{
+	if (tal_count(a) != tal_count(b))
+		return false;
+	for (size_t i = 0; i < tal_count(a); i++) {
+		if (!short_channel_id_eq(&a[i].channel_id, &b[i].channel_id)
+		    || a[i].direction != b[i].direction
+		    || !node_id_eq(&a[i].nodeid, &b[i].nodeid)
+		    || !amount_msat_eq(a[i].amount, b[i].amount)
+		    || a[i].delay != b[i].delay)
+			return false;
+	}
+	return true;
+}
+
+/* Pay the destinations in turn, with some channel_updates in between. */
+static u64 pay(struct routing_state *rstate, const struct node_id *nodes,
+	       size_t num_payments, size_t num_destinations, size_t churn,
+	       bool cached)
+{
+	struct timemono start;
+	u64 nsec = 0;
+
+	for (size_t i = 0; i < num_payments; i++) {
+		for (size_t j = 0; j < churn; j++) {
+			struct chan *c = all_chans[pseudorand(tal_count(all_chans))];
+			set_half_chan(rstate, c, pseudorand(2),
+				      pseudorand(1000), pseudorand(1000),
+				      pseudorand(144));
+		}
+
+		if (!cached)
+			route_cache_clear(&rstate->route_cache);
+		start = time_mono();
+		get_route(tmpctx, rstate, NULL,
+			  &nodes[1 + i % num_destinations],
+			  (struct amount_msat){100000 + pseudorand(100000)},
+			  1.0, 9, 0.0, 0, NULL, ROUTING_MAX_HOPS);
+		nsec += time_to_nsec(timemono_since(start));
+		clean_tmpctx();
+	}
+	return nsec;
+}
+
+int main(int argc, char *argv[])
+{
+	struct routing_state *rstate;
+	struct route_cache *cache;
+	size_t num_nodes = 50, num_payments = 50, num_destinations = 10;
+	unsigned int churn = 1;
+	u64 uncached_nsec, cached_nsec;
+	struct node_id *nodes;
+	char tmpdir[] = "/tmp/run-bench-route_cache.XXXXXX";
+
+	setup_locale();
+	secp256k1_ctx = secp256k1_context_create(SECP256K1_CONTEXT_VERIFY
+						 | SECP256K1_CONTEXT_SIGN);
+	setup_tmpctx();
+
+	opt_register_arg("--churn", opt_set_uintval, opt_show_uintval, &churn,
+			 "channel_updates between each payment");
+	opt_parse(&argc, argv, opt_log_stderr_exit);
+	/* Try 1000 1000. */
+	bench_sizes(argc, argv, "[num_nodes [num_payments [num_destinations]]]",
+		    &num_nodes, &num_payments, &num_destinations);
+	if (num_destinations + 1 >= num_nodes)
+		errx(1, "Need more nodes than destinations");
+
+	/* routing.c writes the gossip_store in the current directory. */
+	if (!mkdtemp(tmpdir) || chdir(tmpdir) != 0)
+		err(1, "Making temporary directory");
+
+	nodes = tal_arr(NULL, struct node_id, num_nodes);
+	for (size_t i = 0; i < num_nodes; i++)
+		nodes[i] = nodeid(i);
+	rstate = new_routing_state(NULL, NULL, &nodes[0], 0, NULL, NULL);
+	cache = &rstate->route_cache;
+
+	all_chans = tal_arr(rstate, struct chan *, 0);
+	for (size_t i = 1; i < num_nodes; i++) {
+		/* Two random channels each, usable in both directions. */
+		for (size_t j = 0; j < 2; j++) {
+			u32 other = pseudorand(i);
+			add_connection(rstate, nodes, i, other);
+			add_connection(rstate, nodes, other, i);
+		}
+	}
+
+	/* Same question, same answer. */
+	for (size_t i = 1; i <= num_destinations; i++) {
+		struct route_hop *hops, *again;
+
+		hops = get_route(tmpctx, rstate, NULL, &nodes[i],
+				 AMOUNT_MSAT(100000), 1.0, 9, 0.0, 0, NULL,
+				 ROUTING_MAX_HOPS);
+		again = get_route(tmpctx, rstate, NULL, &nodes[i],
+				  AMOUNT_MSAT(100000), 1.0, 9, 0.0, 0, NULL,
+				  ROUTING_MAX_HOPS);
+		assert(hops_eq(hops, again));
+		if (!hops)
+			continue;
+		assert(cache->hits == 1);
+		cache->hits = 0;
+
+		/* Updating a channel on it means searching again. */
+		set_half_chan(rstate, get_channel(rstate, &hops[0].channel_id),
+			      hops[0].direction, 0, 0, 1);
+		/* (Other cached routes may start with it, too) */
+		assert(cache->invalidated >= 1);
+		cache->invalidated = 0;
+		get_route(tmpctx, rstate, NULL, &nodes[i],
+			  AMOUNT_MSAT(100000), 1.0, 9, 0.0, 0, NULL,
+			  ROUTING_MAX_HOPS);
+		assert(cache->hits == 0);
+
+		/* Fuzzed ones don't use it at all. */
+		get_route(tmpctx, rstate, NULL, &nodes[i],
+			  AMOUNT_MSAT(100000), 1.0, 9, 0.05, 0, NULL,
+			  ROUTING_MAX_HOPS);
+		assert(cache->hits == 0);
+	}
+	route_cache_clear(cache);
+	cache->hits = cache->misses = cache->invalidated = 0;
+
+	uncached_nsec = pay(rstate, nodes, num_payments, num_destinations,
+			    churn, false);
+	cache->hits = cache->misses = cache->invalidated = 0;
+	cached_nsec = pay(rstate, nodes, num_payments, num_destinations,
+			  churn, true);
+
+	printf("%zu nodes, %zu payments to %zu destinations, %u updates"
+	       " between each: uncached %.1f routes/sec, cached %.1f routes/sec"
+	       " (%"PRIu64" hits, %"PRIu64" misses, %"PRIu64" invalidated)\n",
+	       num_nodes, num_payments, num_destinations, churn,
+	       num_payments * 1000000000.0 / uncached_nsec,
+	       num_payments * 1000000000.0 / cached_nsec,
+	       cache->hits, cache->misses, cache->invalidated);
+	assert(cache->hits + cache->misses == num_payments);
+
+	tal_free(rstate);
+	tal_free(nodes);
+	tal_free(tmpctx);
+	unlink(GOSSIP_STORE_FILENAME);
+	if (chdir("/") != 0 || rmdir(tmpdir) != 0)
+		err(1, "Removing %s", tmpdir);
+	secp256k1_context_destroy(secp256k1_ctx);
+	opt_free_table();
+	return 0;
+}
@@ -0,0 +1,726 @@
+/* How fast can we take in gossip, checking signatures on worker threads or
+ * not?
+ *
+ * Usage: run-bench-sigcheck [num_channels|gossip_store [threads]]
+ *
+ * Given a gossip_store file (eg. copied from a running node), we replay the
+ * gossip in it as if a peer were sending it to us; otherwise we make up
+ * num_channels worth, as a peer would send it in initial sync.  The default
+ * number of threads is what gossipd would use on this machine, but always at
+ * least one, so we compare the threaded path with doing it all ourselves. */
+int gossipd_main(int argc, char *argv[]);
+#define main gossipd_main
+#include "../gossipd.c"
+#undef main
+/* gossipd.c has its own static one of these. */
+#define node_has_public_channels routing_node_has_public_channels
+#include "../routing.c"
+#undef node_has_public_channels
+#include "../gossip_store.c"
+#include "../gen_gossip_store.c"
+#include "../sigcheck.c"
+#include "../../common/timeout.c"
+#include <ccan/err/err.h>
+#include <ccan/read_write_all/read_write_all.h>
+#include <common/test/bench.h>
+#include <ctype.h>
+#include <stdio.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for check_ping_make_pong */
+bool check_ping_make_pong(const tal_t *ctx UNNEEDED, const u8 *ping UNNEEDED, u8 **pong UNNEEDED)
+{ fprintf(stderr, "check_ping_make_pong called!\n"); abort(); }
+/* Generated stub for daemon_conn_new_ */
+struct daemon_conn *daemon_conn_new_(const tal_t *ctx UNNEEDED, int fd UNNEEDED,
+				     struct io_plan *(*recv)(struct io_conn * UNNEEDED,
+							     const u8 * UNNEEDED,
+							     void *) UNNEEDED,
+				     void (*outq_empty)(void *) UNNEEDED,
+				     void *arg UNNEEDED)
+{ fprintf(stderr, "daemon_conn_new_ called!\n"); abort(); }
+/* Generated stub for daemon_conn_read_next */
+struct io_plan *daemon_conn_read_next(struct io_conn *conn UNNEEDED,
+				      struct daemon_conn *dc UNNEEDED)
+{ fprintf(stderr, "daemon_conn_read_next called!\n"); abort(); }
+/* Generated stub for daemon_conn_send_fd */
+void daemon_conn_send_fd(struct daemon_conn *dc UNNEEDED, int fd UNNEEDED)
+{ fprintf(stderr, "daemon_conn_send_fd called!\n"); abort(); }
+/* Generated stub for daemon_conn_wake */
+void daemon_conn_wake(struct daemon_conn *dc UNNEEDED)
+{ fprintf(stderr, "daemon_conn_wake called!\n"); abort(); }
+/* Generated stub for daemon_shutdown */
+void daemon_shutdown(void)
+{ fprintf(stderr, "daemon_shutdown called!\n"); abort(); }
+/* Generated stub for decode_short_ids */
+struct short_channel_id *decode_short_ids(const tal_t *ctx UNNEEDED, const u8 *encoded UNNEEDED)
+{ fprintf(stderr, "decode_short_ids called!\n"); abort(); }
+/* Generated stub for dump_memleak */
+bool dump_memleak(struct htable *memtable UNNEEDED)
+{ fprintf(stderr, "dump_memleak called!\n"); abort(); }
+/* Generated stub for fromwire_amount_below_minimum */
+bool fromwire_amount_below_minimum(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct amount_msat *htlc_msat UNNEEDED, u8 **channel_update UNNEEDED)
+{ fprintf(stderr, "fromwire_amount_below_minimum called!\n"); abort(); }
+/* Generated stub for fromwire_expiry_too_soon */
+bool fromwire_expiry_too_soon(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u8 **channel_update UNNEEDED)
+{ fprintf(stderr, "fromwire_expiry_too_soon called!\n"); abort(); }
+/* Generated stub for fromwire_fee_insufficient */
+bool fromwire_fee_insufficient(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct amount_msat *htlc_msat UNNEEDED, u8 **channel_update UNNEEDED)
+{ fprintf(stderr, "fromwire_fee_insufficient called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_dev_set_max_scids_encode_size */
+bool fromwire_gossip_dev_set_max_scids_encode_size(const void *p UNNEEDED, u32 *max UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_dev_set_max_scids_encode_size called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_dev_suppress */
+bool fromwire_gossip_dev_suppress(const void *p UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_dev_suppress called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_get_addrs */
+bool fromwire_gossip_get_addrs(const void *p UNNEEDED, struct node_id *id UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_get_addrs called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_get_channel_peer */
+bool fromwire_gossip_get_channel_peer(const void *p UNNEEDED, struct short_channel_id *channel_id UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_get_channel_peer called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_get_incoming_channels */
+bool fromwire_gossip_get_incoming_channels(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, bool **private_too UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_get_incoming_channels called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_get_txout_reply */
+bool fromwire_gossip_get_txout_reply(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct short_channel_id *short_channel_id UNNEEDED, struct amount_sat *satoshis UNNEEDED, u8 **outscript UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_get_txout_reply called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_getchannels_request */
+bool fromwire_gossip_getchannels_request(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct short_channel_id **short_channel_id UNNEEDED, struct node_id **source UNNEEDED, struct short_channel_id **prev UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_getchannels_request called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_getnodes_request */
+bool fromwire_gossip_getnodes_request(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id **id UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_getnodes_request called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_getroute_request */
+bool fromwire_gossip_getroute_request(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id **source UNNEEDED, struct node_id *destination UNNEEDED, struct amount_msat *msatoshi UNNEEDED, u64 *riskfactor_by_million UNNEEDED, u32 *final_cltv UNNEEDED, double *fuzz UNNEEDED, struct short_channel_id_dir **excluded UNNEEDED, u32 *max_hops UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_getroute_request called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_getroutes_request */
+bool fromwire_gossip_getroutes_request(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id **source UNNEEDED, struct node_id **destinations UNNEEDED, struct amount_msat **msatoshis UNNEEDED, u64 *riskfactor_by_million UNNEEDED, u32 *final_cltv UNNEEDED, double *fuzz UNNEEDED, struct short_channel_id_dir **excluded UNNEEDED, u32 *max_hops UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_getroutes_request called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_local_channel_close */
+bool fromwire_gossip_local_channel_close(const void *p UNNEEDED, struct short_channel_id *short_channel_id UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_local_channel_close called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_new_peer */
+bool fromwire_gossip_new_peer(const void *p UNNEEDED, struct node_id *id UNNEEDED, bool *gossip_queries_feature UNNEEDED, bool *initial_routing_sync UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_new_peer called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_outpoint_spent */
+bool fromwire_gossip_outpoint_spent(const void *p UNNEEDED, struct short_channel_id *short_channel_id UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_outpoint_spent called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_payment_failure */
+bool fromwire_gossip_payment_failure(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id *erring_node UNNEEDED, struct short_channel_id *erring_channel UNNEEDED, u8 *erring_channel_direction UNNEEDED, u8 **error UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_payment_failure called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_ping */
+bool fromwire_gossip_ping(const void *p UNNEEDED, struct node_id *id UNNEEDED, u16 *num_pong_bytes UNNEEDED, u16 *len UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_ping called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_query_channel_range */
+bool fromwire_gossip_query_channel_range(const void *p UNNEEDED, struct node_id *id UNNEEDED, u32 *first_blocknum UNNEEDED, u32 *number_of_blocks UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_query_channel_range called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_query_scids */
+bool fromwire_gossip_query_scids(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id *id UNNEEDED, struct short_channel_id **ids UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_query_scids called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_send_timestamp_filter */
+bool fromwire_gossip_send_timestamp_filter(const void *p UNNEEDED, struct node_id *id UNNEEDED, u32 *first_timestamp UNNEEDED, u32 *timestamp_range UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_send_timestamp_filter called!\n"); abort(); }
+/* Generated stub for fromwire_gossipctl_init */
+bool fromwire_gossipctl_init(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct bitcoin_blkid *chain_hash UNNEEDED, struct node_id *id UNNEEDED, u8 **globalfeatures UNNEEDED, u8 rgb[3] UNNEEDED, u8 alias[32] UNNEEDED, u32 *update_channel_interval UNNEEDED, struct wireaddr **announcable UNNEEDED, u32 **dev_gossip_time UNNEEDED)
+{ fprintf(stderr, "fromwire_gossipctl_init called!\n"); abort(); }
+/* Generated stub for fromwire_gossipd_get_update */
+bool fromwire_gossipd_get_update(const void *p UNNEEDED, struct short_channel_id *short_channel_id UNNEEDED)
+{ fprintf(stderr, "fromwire_gossipd_get_update called!\n"); abort(); }
+/* Generated stub for fromwire_gossipd_local_add_channel */
+bool fromwire_gossipd_local_add_channel(const void *p UNNEEDED, struct short_channel_id *short_channel_id UNNEEDED, struct node_id *remote_node_id UNNEEDED, struct amount_sat *satoshis UNNEEDED)
+{ fprintf(stderr, "fromwire_gossipd_local_add_channel called!\n"); abort(); }
+/* Generated stub for fromwire_gossipd_local_channel_update */
+bool fromwire_gossipd_local_channel_update(const void *p UNNEEDED, struct short_channel_id *short_channel_id UNNEEDED, bool *disable UNNEEDED, u16 *cltv_expiry_delta UNNEEDED, struct amount_msat *htlc_minimum_msat UNNEEDED, u32 *fee_base_msat UNNEEDED, u32 *fee_proportional_millionths UNNEEDED, struct amount_msat *htlc_maximum_msat UNNEEDED)
+{ fprintf(stderr, "fromwire_gossipd_local_channel_update called!\n"); abort(); }
+/* Generated stub for fromwire_hsm_cupdate_sig_reply */
+bool fromwire_hsm_cupdate_sig_reply(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u8 **cu UNNEEDED)
+{ fprintf(stderr, "fromwire_hsm_cupdate_sig_reply called!\n"); abort(); }
+/* Generated stub for fromwire_hsm_node_announcement_sig_reply */
+bool fromwire_hsm_node_announcement_sig_reply(const void *p UNNEEDED, secp256k1_ecdsa_signature *signature UNNEEDED)
+{ fprintf(stderr, "fromwire_hsm_node_announcement_sig_reply called!\n"); abort(); }
+/* Generated stub for fromwire_incorrect_cltv_expiry */
+bool fromwire_incorrect_cltv_expiry(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u32 *cltv_expiry UNNEEDED, u8 **channel_update UNNEEDED)
+{ fprintf(stderr, "fromwire_incorrect_cltv_expiry called!\n"); abort(); }
+/* Generated stub for fromwire_temporary_channel_failure */
+bool fromwire_temporary_channel_failure(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u8 **channel_update UNNEEDED)
+{ fprintf(stderr, "fromwire_temporary_channel_failure called!\n"); abort(); }
+/* Generated stub for fromwire_wireaddr */
+bool fromwire_wireaddr(const u8 **cursor UNNEEDED, size_t *max UNNEEDED, struct wireaddr *addr UNNEEDED)
+{ fprintf(stderr, "fromwire_wireaddr called!\n"); abort(); }
+/* Generated stub for gossip_peerd_wire_type_name */
+const char *gossip_peerd_wire_type_name(int e UNNEEDED)
+{ fprintf(stderr, "gossip_peerd_wire_type_name called!\n"); abort(); }
+/* Generated stub for got_pong */
+const char *got_pong(const u8 *pong UNNEEDED, size_t *num_pings_outstanding UNNEEDED)
+{ fprintf(stderr, "got_pong called!\n"); abort(); }
+/* Generated stub for make_ping */
+u8 *make_ping(const tal_t *ctx UNNEEDED, u16 num_pong_bytes UNNEEDED, u16 padlen UNNEEDED)
+{ fprintf(stderr, "make_ping called!\n"); abort(); }
+/* Generated stub for master_badmsg */
+void master_badmsg(u32 type_expected UNNEEDED, const u8 *msg)
+{ fprintf(stderr, "master_badmsg called!\n"); abort(); }
+/* Generated stub for memleak_add_helper_ */
+void memleak_add_helper_(const tal_t *p UNNEEDED, void (*cb)(struct htable *memtable UNNEEDED,
+						    const tal_t *)){ }
+/* Generated stub for memleak_enter_allocations */
+struct htable *memleak_enter_allocations(const tal_t *ctx UNNEEDED,
+					 const void *exclude1 UNNEEDED,
+					 const void *exclude2 UNNEEDED)
+{ fprintf(stderr, "memleak_enter_allocations called!\n"); abort(); }
+/* Generated stub for memleak_remove_htable */
+void memleak_remove_htable(struct htable *memtable UNNEEDED, const struct htable *ht UNNEEDED)
+{ fprintf(stderr, "memleak_remove_htable called!\n"); abort(); }
+/* Generated stub for memleak_remove_referenced */
+void memleak_remove_referenced(struct htable *memtable UNNEEDED, const void *root UNNEEDED)
+{ fprintf(stderr, "memleak_remove_referenced called!\n"); abort(); }
+/* Generated stub for notleak_ */
+void *notleak_(const void *ptr UNNEEDED, bool plus_children UNNEEDED)
+{ fprintf(stderr, "notleak_ called!\n"); abort(); }
+/* Generated stub for onion_type_name */
+const char *onion_type_name(int e UNNEEDED)
+{ fprintf(stderr, "onion_type_name called!\n"); abort(); }
+/* Generated stub for sanitize_error */
+char *sanitize_error(const tal_t *ctx UNNEEDED, const u8 *errmsg UNNEEDED,
+		     struct channel_id *channel_id UNNEEDED)
+{ fprintf(stderr, "sanitize_error called!\n"); abort(); }
+/* Generated stub for status_failed */
+void status_failed(enum status_failreason code UNNEEDED,
+		   const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "status_failed called!\n"); abort(); }
+/* Generated stub for status_setup_async */
+void status_setup_async(struct daemon_conn *master UNNEEDED)
+{ fprintf(stderr, "status_setup_async called!\n"); abort(); }
+/* Generated stub for subdaemon_setup */
+void subdaemon_setup(int argc UNNEEDED, char *argv[])
+{ fprintf(stderr, "subdaemon_setup called!\n"); abort(); }
+/* Generated stub for towire_gossip_dev_compact_store_reply */
+u8 *towire_gossip_dev_compact_store_reply(const tal_t *ctx UNNEEDED, bool success UNNEEDED)
+{ fprintf(stderr, "towire_gossip_dev_compact_store_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_dev_memleak_reply */
+u8 *towire_gossip_dev_memleak_reply(const tal_t *ctx UNNEEDED, bool leak UNNEEDED)
+{ fprintf(stderr, "towire_gossip_dev_memleak_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_dev_route_cache_reply */
+u8 *towire_gossip_dev_route_cache_reply(const tal_t *ctx UNNEEDED, u32 entries UNNEEDED, u64 hits UNNEEDED, u64 misses UNNEEDED, u64 invalidated UNNEEDED)
+{ fprintf(stderr, "towire_gossip_dev_route_cache_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_get_addrs_reply */
+u8 *towire_gossip_get_addrs_reply(const tal_t *ctx UNNEEDED, const struct wireaddr *addrs UNNEEDED)
+{ fprintf(stderr, "towire_gossip_get_addrs_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_get_channel_peer_reply */
+u8 *towire_gossip_get_channel_peer_reply(const tal_t *ctx UNNEEDED, const struct node_id *peer_id UNNEEDED)
+{ fprintf(stderr, "towire_gossip_get_channel_peer_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_get_incoming_channels_reply */
+u8 *towire_gossip_get_incoming_channels_reply(const tal_t *ctx UNNEEDED, const struct route_info *route_info UNNEEDED)
+{ fprintf(stderr, "towire_gossip_get_incoming_channels_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_getchannels_reply */
+u8 *towire_gossip_getchannels_reply(const tal_t *ctx UNNEEDED, bool complete UNNEEDED, const struct gossip_getchannels_entry **nodes UNNEEDED)
+{ fprintf(stderr, "towire_gossip_getchannels_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_getnodes_reply */
+u8 *towire_gossip_getnodes_reply(const tal_t *ctx UNNEEDED, const struct gossip_getnodes_entry **nodes UNNEEDED)
+{ fprintf(stderr, "towire_gossip_getnodes_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_getroute_reply */
+u8 *towire_gossip_getroute_reply(const tal_t *ctx UNNEEDED, const struct route_hop *hops UNNEEDED)
+{ fprintf(stderr, "towire_gossip_getroute_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_getroutes_reply */
+u8 *towire_gossip_getroutes_reply(const tal_t *ctx UNNEEDED, const u16 *route_lens UNNEEDED, const struct route_hop *hops UNNEEDED)
+{ fprintf(stderr, "towire_gossip_getroutes_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_new_peer_reply */
+u8 *towire_gossip_new_peer_reply(const tal_t *ctx UNNEEDED, bool success UNNEEDED, const struct gossip_state *gs UNNEEDED)
+{ fprintf(stderr, "towire_gossip_new_peer_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_ping_reply */
+u8 *towire_gossip_ping_reply(const tal_t *ctx UNNEEDED, const struct node_id *id UNNEEDED, bool sent UNNEEDED, u16 totlen UNNEEDED)
+{ fprintf(stderr, "towire_gossip_ping_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_query_channel_range_reply */
+u8 *towire_gossip_query_channel_range_reply(const tal_t *ctx UNNEEDED, u32 final_first_block UNNEEDED, u32 final_num_blocks UNNEEDED, bool final_complete UNNEEDED, const struct short_channel_id *scids UNNEEDED)
+{ fprintf(stderr, "towire_gossip_query_channel_range_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_scids_reply */
+u8 *towire_gossip_scids_reply(const tal_t *ctx UNNEEDED, bool ok UNNEEDED, bool complete UNNEEDED)
+{ fprintf(stderr, "towire_gossip_scids_reply called!\n"); abort(); }
+/* Generated stub for towire_gossipd_get_update_reply */
+u8 *towire_gossipd_get_update_reply(const tal_t *ctx UNNEEDED, const u8 *update UNNEEDED)
+{ fprintf(stderr, "towire_gossipd_get_update_reply called!\n"); abort(); }
+/* Generated stub for towire_gossipd_new_store_fd */
+u8 *towire_gossipd_new_store_fd(const tal_t *ctx UNNEEDED, const u64 *old_offsets UNNEEDED, const u64 *new_offsets UNNEEDED)
+{ fprintf(stderr, "towire_gossipd_new_store_fd called!\n"); abort(); }
+/* Generated stub for towire_hsm_cupdate_sig_req */
+u8 *towire_hsm_cupdate_sig_req(const tal_t *ctx UNNEEDED, const u8 *cu UNNEEDED)
+{ fprintf(stderr, "towire_hsm_cupdate_sig_req called!\n"); abort(); }
+/* Generated stub for towire_hsm_node_announcement_sig_req */
+u8 *towire_hsm_node_announcement_sig_req(const tal_t *ctx UNNEEDED, const u8 *announcement UNNEEDED)
+{ fprintf(stderr, "towire_hsm_node_announcement_sig_req called!\n"); abort(); }
+/* Generated stub for towire_wireaddr */
+void towire_wireaddr(u8 **pptr UNNEEDED, const struct wireaddr *addr UNNEEDED)
+{ fprintf(stderr, "towire_wireaddr called!\n"); abort(); }
+/* Generated stub for wire_sync_read */
+u8 *wire_sync_read(const tal_t *ctx UNNEEDED, int fd UNNEEDED)
+{ fprintf(stderr, "wire_sync_read called!\n"); abort(); }
+/* Generated stub for wire_sync_write */
+bool wire_sync_write(int fd UNNEEDED, const void *msg TAKES UNNEEDED)
+{ fprintf(stderr, "wire_sync_write called!\n"); abort(); }
+/* Generated stub for wireaddr_eq */
+bool wireaddr_eq(const struct wireaddr *a UNNEEDED, const struct wireaddr *b UNNEEDED)
+{ fprintf(stderr, "wireaddr_eq called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+static size_t num_errors;
+static struct short_channel_id *txout_queries;
+
+void status_fmt(enum log_level level UNUSED, const char *fmt UNUSED, ...)
+{
+}
+
+/* The peer only gets errors; lightningd only gets our txout queries. */
+void daemon_conn_send(struct daemon_conn *dc UNUSED, const u8 *msg TAKES)
+{
+	if (fromwire_peektype(msg) == WIRE_ERROR)
+		num_errors++;
+	if (taken(msg))
+		tal_free(msg);
+}
+
+/* Only the type matters to daemon_conn_send(). */
+u8 *towire_errorfmt(const tal_t *ctx,
+		    const struct channel_id *channel UNUSED,
+		    const char *fmt UNUSED, ...)
+{
+	struct channel_id all_channels;
+
+	memset(&all_channels, 0, sizeof(all_channels));
+	return towire_error(ctx, &all_channels, NULL);
+}
+
+/* We answer these ourselves, after each batch. */
+u8 *towire_gossip_get_txout(const tal_t *ctx,
+			    const struct short_channel_id *short_channel_id)
+{
+	tal_arr_expand(&txout_queries, *short_channel_id);
+	return tal_arr(ctx, u8, 0);
+}
+
+/* Every channel is unspent, with just the output they say. */
+static void answer_txouts(struct routing_state *rstate)
+{
+	for (size_t i = 0; i < tal_count(txout_queries); i++) {
+		struct pending_cannouncement *pending;
+		const u8 *outscript;
+
+		pending = find_pending_cannouncement(rstate, &txout_queries[i]);
+		if (!pending)
+			continue;
+		outscript = scriptpubkey_p2wsh(tmpctx,
+					       bitcoin_redeem_2of2(tmpctx,
+							&pending->bitcoin_key_1,
+							&pending->bitcoin_key_2));
+		handle_pending_cannouncement(rstate, &txout_queries[i],
+					     AMOUNT_SAT(1000000), outscript);
+	}
+	tal_resize(&txout_queries, 0);
+}
+
+static void privkey_for(struct privkey *privkey, size_t n)
+{
+	memset(privkey, 0xFF, sizeof(*privkey));
+	memcpy(privkey, &n, sizeof(n));
+}
+
+static void sign_msg(u8 *msg, size_t sigoff, size_t hashoff,
+		     const struct privkey *privkey)
+{
+	struct sha256_double hash;
+	secp256k1_ecdsa_signature sig;
+	u8 *sigbytes = tal_arr(tmpctx, u8, 0);
+
+	sha256_double(&hash, msg + hashoff, tal_count(msg) - hashoff);
+	sign_hash(privkey, &hash, &sig);
+	towire_secp256k1_ecdsa_signature(&sigbytes, &sig);
+	memcpy(msg + sigoff, sigbytes, tal_count(sigbytes));
+}
+
+static void add_update(const u8 ***msgs,
+		       const struct bitcoin_blkid *chain_hash,
+		       const struct short_channel_id *scid, int direction,
+		       const struct privkey *privkey, u32 timestamp)
+{
+	secp256k1_ecdsa_signature sig;
+	u8 *msg;
+
+	memset(&sig, 0, sizeof(sig));
+	msg = towire_channel_update(*msgs, &sig, chain_hash, scid, timestamp,
+				    0, direction, 6, AMOUNT_MSAT(1000),
+				    1000, 10);
+	sign_msg(msg, 2, 66, privkey);
+	tal_arr_expand(msgs, msg);
+}
+
+/* Each channel_announcement followed by its channel_updates, then all the
+ * node_announcements. */
+static const u8 **make_gossip(const tal_t *ctx,
+			      const struct chainparams *chainparams,
+			      size_t num_channels, size_t num_nodes)
+{
+	const u8 **msgs = tal_arr(ctx, const u8 *, 0);
+	struct privkey *keys = tal_arr(tmpctx, struct privkey, num_nodes);
+	struct node_id *ids = tal_arr(tmpctx, struct node_id, num_nodes);
+	u32 now = time_now().ts.tv_sec;
+	secp256k1_ecdsa_signature sig;
+
+	memset(&sig, 0, sizeof(sig));
+	for (size_t i = 0; i < num_nodes; i++) {
+		struct pubkey k;
+		privkey_for(&keys[i], i + 1);
+		pubkey_from_privkey(&keys[i], &k);
+		node_id_from_pubkey(&ids[i], &k);
+	}
+
+	for (size_t i = 0; i < num_channels; i++) {
+		struct short_channel_id scid;
+		struct privkey bkeys[2];
+		struct pubkey bpubkeys[2];
+		size_t n1 = pseudorand(num_nodes), n2;
+		u8 *msg;
+
+		/* Roughly mainnet density: a dozen channels a block. */
+		if (!mk_short_channel_id(&scid, 500000 + i / 12, i % 12, 0))
+			abort();
+
+		do {
+			n2 = pseudorand(num_nodes);
+		} while (n2 == n1);
+		if (node_id_cmp(&ids[n1], &ids[n2]) > 0) {
+			size_t tmp = n1;
+			n1 = n2;
+			n2 = tmp;
+		}
+
+		for (size_t j = 0; j < 2; j++) {
+			privkey_for(&bkeys[j], num_nodes + 1 + i * 2 + j);
+			pubkey_from_privkey(&bkeys[j], &bpubkeys[j]);
+		}
+
+		msg = towire_channel_announcement(msgs, &sig, &sig, &sig, &sig,
+						  NULL,
+						  &chainparams->genesis_blockhash,
+						  &scid, &ids[n1], &ids[n2],
+						  &bpubkeys[0], &bpubkeys[1]);
+		/* 2 byte type, then 4 signatures over the rest. */
+		sign_msg(msg, 2, 258, &keys[n1]);
+		sign_msg(msg, 2 + 64, 258, &keys[n2]);
+		sign_msg(msg, 2 + 128, 258, &bkeys[0]);
+		sign_msg(msg, 2 + 192, 258, &bkeys[1]);
+		tal_arr_expand(&msgs, msg);
+
+		add_update(&msgs, &chainparams->genesis_blockhash, &scid, 0,
+			   &keys[n1], now);
+		add_update(&msgs, &chainparams->genesis_blockhash, &scid, 1,
+			   &keys[n2], now);
+	}
+
+	for (size_t i = 0; i < num_nodes; i++) {
+		u8 rgb[3], alias[32];
+		u8 *msg;
+
+		memset(rgb, i, sizeof(rgb));
+		memset(alias, 0, sizeof(alias));
+		snprintf((char *)alias, sizeof(alias), "node%zu", i);
+		msg = towire_node_announcement(msgs, &sig, NULL, now, &ids[i],
+					       rgb, alias, NULL);
+		sign_msg(msg, 2, 66, &keys[i]);
+		tal_arr_expand(&msgs, msg);
+	}
+	return msgs;
+}
+
+/* The gossip in a gossip_store, in the order it was stored. */
+static const u8 **read_gossip_store(const tal_t *ctx, const char *filename,
+				    const struct chainparams **chainparams)
+{
+	const u8 **msgs = tal_arr(ctx, const u8 *, 0);
+	struct gossip_hdr hdr;
+	u8 version;
+	int fd = open(filename, O_RDONLY);
+
+	if (fd < 0)
+		err(1, "Opening %s", filename);
+	if (!read_all(fd, &version, sizeof(version)))
+		errx(1, "%s is empty", filename);
+	if (version != GOSSIP_STORE_VERSION)
+		errx(1, "%s is version %u not %u",
+		     filename, version, GOSSIP_STORE_VERSION);
+
+	*chainparams = NULL;
+	while (read_all(fd, &hdr, sizeof(hdr))) {
+		u32 len = be32_to_cpu(hdr.len);
+		bool deleted = (len & GOSSIP_STORE_LEN_DELETED_BIT);
+		int type;
+		u8 *msg;
+
+		len &= ~GOSSIP_STORE_LEN_DELETED_BIT;
+		msg = tal_arr(msgs, u8, len);
+		if (!read_all(fd, msg, len))
+			errx(1, "%s truncated", filename);
+
+		type = fromwire_peektype(msg);
+		if (deleted
+		    || (type != WIRE_CHANNEL_ANNOUNCEMENT
+			&& type != WIRE_CHANNEL_UPDATE
+			&& type != WIRE_NODE_ANNOUNCEMENT)) {
+			tal_free(msg);
+			continue;
+		}
+
+		/* Whatever chain it is, we'll pretend to be on it. */
+		if (!*chainparams && type == WIRE_CHANNEL_UPDATE) {
+			secp256k1_ecdsa_signature sig;
+			struct bitcoin_blkid chain_hash;
+			struct short_channel_id scid;
+			struct amount_msat htlc_min;
+			u32 timestamp, fee_base, fee_ppm;
+			u8 message_flags, channel_flags;
+			u16 cltv;
+
+			if (fromwire_channel_update(msg, &sig, &chain_hash,
+						    &scid, &timestamp,
+						    &message_flags,
+						    &channel_flags, &cltv,
+						    &htlc_min, &fee_base,
+						    &fee_ppm))
+				*chainparams = chainparams_by_chainhash(&chain_hash);
+		}
+		tal_arr_expand(&msgs, msg);
+	}
+	close(fd);
+
+	if (!*chainparams)
+		errx(1, "%s has no gossip for any chain we know", filename);
+	return msgs;
+}
+
+static size_t num_channels(struct routing_state *rstate)
+{
+	size_t n = 0;
+	u64 idx;
+
+	for (struct chan *c = uintmap_first(&rstate->chanmap, &idx);
+	     c;
+	     c = uintmap_after(&rstate->chanmap, &idx))
+		n++;
+	return n;
+}
+
+static size_t num_nodes(struct routing_state *rstate)
+{
+	struct node_map_iter it;
+	size_t n = 0;
+
+	for (struct node *node = node_map_first(rstate->nodes, &it);
+	     node;
+	     node = node_map_next(rstate->nodes, &it))
+		n++;
+	return n;
+}
+
+/* The first message of this type, if any. */
+static const u8 *first_msg(const u8 **msgs, int type)
+{
+	for (size_t i = 0; i < tal_count(msgs); i++)
+		if (fromwire_peektype(msgs[i]) == type)
+			return msgs[i];
+	return NULL;
+}
+
+/* Check msg with one bit of the byte at flip (if not 0) inverted. */
+static enum sigcheck_result sigcheck_one(struct sigcheck_pool *pool,
+					 const u8 *msg, size_t flip,
+					 const struct node_id *signer)
+{
+	struct sigcheck_job job;
+	u8 *copy = tal_dup_arr(tmpctx, u8, msg, tal_count(msg), 0);
+
+	if (flip)
+		copy[flip] ^= 1;
+	job.msg = copy;
+	job.len = tal_count(copy);
+	job.have_signer = (signer != NULL);
+	if (signer)
+		job.signer = *signer;
+	sigcheck_run(pool, &job, 1);
+	return job.result;
+}
+
+/* A corrupted signature is always caught, and a channel_update the pool
+ * checked against someone other than the owner is checked again. */
+static void check_sigs(struct daemon *daemon, const u8 **msgs)
+{
+	struct routing_state *rstate = daemon->rstate;
+	const u8 *cannounce, *update, *nannounce;
+	const struct node_id *owner;
+	struct short_channel_id scid;
+	struct privkey privkey;
+	u8 *wrong_signer;
+
+	/* The last byte of each signature's R. */
+	cannounce = first_msg(msgs, WIRE_CHANNEL_ANNOUNCEMENT);
+	if (cannounce) {
+		assert(sigcheck_one(daemon->sigcheck, cannounce, 0, NULL)
+		       == SIGCHECK_GOOD);
+		/* node_signature_1 */
+		assert(sigcheck_one(daemon->sigcheck, cannounce, 2 + 31, NULL)
+		       == SIGCHECK_BAD);
+		/* bitcoin_signature_2 */
+		assert(sigcheck_one(daemon->sigcheck, cannounce,
+				    2 + 64 * 3 + 31, NULL)
+		       == SIGCHECK_BAD);
+	}
+
+	nannounce = first_msg(msgs, WIRE_NODE_ANNOUNCEMENT);
+	if (nannounce) {
+		assert(sigcheck_one(daemon->sigcheck, nannounce, 0, NULL)
+		       == SIGCHECK_GOOD);
+		assert(sigcheck_one(daemon->sigcheck, nannounce, 2 + 31, NULL)
+		       == SIGCHECK_BAD);
+	}
+
+	update = first_msg(msgs, WIRE_CHANNEL_UPDATE);
+	if (!update)
+		return;
+	/* The short_channel_id is after the signature and chain_hash,
+	 * channel_flags (with the direction) after it and the timestamp. */
+	memcpy(&scid, update + 2 + 64 + 32, sizeof(scid));
+	scid.u64 = be64_to_cpu(scid.u64);
+	owner = channel_update_signer(rstate, &scid,
+				      update[2 + 64 + 32 + 8 + 4 + 1] & 1);
+	if (!owner)
+		return;
+	assert(sigcheck_one(daemon->sigcheck, update, 0, owner)
+	       == SIGCHECK_GOOD);
+	assert(sigcheck_one(daemon->sigcheck, update, 2 + 31, owner)
+	       == SIGCHECK_BAD);
+
+	/* Signed by us instead: the pool is happy, given us as the signer,
+	 * but handle_channel_update() must not take its word for it. */
+	assert(!node_id_eq(owner, &daemon->id));
+	wrong_signer = tal_dup_arr(tmpctx, u8, update, tal_count(update), 0);
+	privkey_for(&privkey, 0);
+	sign_msg(wrong_signer, 2, 66, &privkey);
+	assert(sigcheck_one(daemon->sigcheck, wrong_signer, 0, &daemon->id)
+	       == SIGCHECK_GOOD);
+	assert(handle_channel_update(rstate, wrong_signer, &daemon->id,
+				     "test", NULL));
+}
+
+/* Feed them all in as if from the peer, and time until we're done. */
+static void replay(struct daemon *daemon, const struct chainparams *chainparams,
+		   const u8 **msgs, size_t nthreads,
+		   size_t *channels, size_t *nodes)
+{
+	struct peer *peer;
+	struct timemono start;
+	u64 usec;
+
+	daemon->rstate = new_routing_state(daemon, chainparams, &daemon->id,
+					   0, &daemon->peers, NULL);
+	daemon->sigcheck = new_sigcheck_pool(daemon, nthreads);
+	daemon->gossip_queue = tal_arr(daemon, struct queued_gossip, 0);
+	daemon->gossip_queue_timer = NULL;
+
+	peer = tal(daemon, struct peer);
+	peer->daemon = daemon;
+	peer->dc = NULL;
+	peer->num_queued_gossip = 0;
+	list_add_tail(&daemon->peers, &peer->list);
+
+	num_errors = 0;
+	start = time_mono();
+	for (size_t i = 0; i < tal_count(msgs); i++) {
+		/* This handles them if the queue is full... */
+		queue_gossip(peer, msgs[i]);
+		/* ...and lightningd would reply to txout queries quickly. */
+		answer_txouts(daemon->rstate);
+	}
+	/* Instead of waiting for the timer. */
+	if (tal_count(daemon->gossip_queue))
+		handle_gossip_queue(daemon);
+	answer_txouts(daemon->rstate);
+	usec = bench_usec_since(start);
+
+	*channels = num_channels(daemon->rstate);
+	*nodes = num_nodes(daemon->rstate);
+	printf("%zu threads: %zu messages, %zu channels, %zu nodes,"
+	       " %zu errors: %"PRIu64" usec (%.0f msgs/sec)\n",
+	       tal_count(daemon->sigcheck->threads), tal_count(msgs),
+	       *channels, *nodes,
+	       num_errors, usec, bench_per_sec(tal_count(msgs), usec));
+	/* new_sigcheck_pool() makes do with fewer, but not none. */
+	assert((tal_count(daemon->sigcheck->threads) > 0) == (nthreads > 0));
+	assert(num_errors == 0);
+
+	check_sigs(daemon, msgs);
+
+	list_del_from(&daemon->peers, &peer->list);
+	tal_free(peer);
+	tal_free(daemon->gossip_queue);
+	tal_free(daemon->sigcheck);
+	tal_free(daemon->rstate);
+	/* Start the next one afresh. */
+	unlink(GOSSIP_STORE_FILENAME);
+}
+
+int main(int argc, char *argv[])
+{
+	struct daemon *daemon;
+	const struct chainparams *chainparams;
+	const u8 **msgs;
+	size_t nthreads = sigcheck_threads(), nchans = 20;
+	const char *usage = "[num_channels|gossip_store [nthreads]]";
+	char tmpdir[] = "/tmp/run-bench-sigcheck.XXXXXX";
+	struct privkey privkey;
+	struct pubkey pubkey;
+	size_t channels[2], nodes[2];
+
+	setup_locale();
+	secp256k1_ctx = secp256k1_context_create(SECP256K1_CONTEXT_VERIFY
+						 | SECP256K1_CONTEXT_SIGN);
+	setup_tmpctx();
+
+	daemon = tal(NULL, struct daemon);
+	daemon->master = NULL;
+	list_head_init(&daemon->peers);
+	timers_init(&daemon->timers, time_mono());
+	txout_queries = tal_arr(daemon, struct short_channel_id, 0);
+	privkey_for(&privkey, 0);
+	pubkey_from_privkey(&privkey, &pubkey);
+	node_id_from_pubkey(&daemon->id, &pubkey);
+
+	/* Try 1000, or a real gossip_store. */
+	if (argc > 1 && !isdigit(argv[1][0])) {
+		msgs = read_gossip_store(daemon, argv[1], &chainparams);
+		/* So the thread count is the first size. */
+		argv[1] = argv[0];
+		bench_sizes(argc - 1, argv + 1, usage, &nthreads);
+	} else {
+		bench_sizes(argc, argv, usage, &nchans, &nthreads);
+		chainparams = chainparams_for_network("regtest");
+		msgs = make_gossip(daemon, chainparams, nchans, nchans / 10 + 2);
+	}
+
+	/* routing.c writes a gossip_store in the current directory. */
+	if (!mkdtemp(tmpdir) || chdir(tmpdir) != 0)
+		err(1, "Making temporary directory");
+
+	/* There's no point comparing no threads with no threads. */
+	if (nthreads == 0)
+		nthreads = 1;
+
+	replay(daemon, chainparams, msgs, 0, &channels[0], &nodes[0]);
+	replay(daemon, chainparams, msgs, nthreads, &channels[1], &nodes[1]);
+	/* The threads only check signatures: the result is the same. */
+	assert(channels[0] == channels[1]);
+	assert(nodes[0] == nodes[1]);
+
+	if (chdir("/") != 0 || rmdir(tmpdir) != 0)
+		err(1, "Removing %s", tmpdir);
+	timers_cleanup(&daemon->timers);
+	tal_free(daemon);
+	tal_free(tmpctx);
+	secp256k1_context_destroy(secp256k1_ctx);
+	return 0;
+}
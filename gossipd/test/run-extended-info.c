@@ -24,6 +24,11 @@ int gossipd_main(int argc, char *argv[]);
 #endif
 
 /* AUTOGENERATED MOCKS START */
+/* Generated stub for channel_update_signer */
+const struct node_id *channel_update_signer(struct routing_state *rstate UNNEEDED,
+					    const struct short_channel_id *scid UNNEEDED,
+					    int direction UNNEEDED)
+{ fprintf(stderr, "channel_update_signer called!\n"); abort(); }
 /* Generated stub for check_ping_make_pong */
 bool check_ping_make_pong(const tal_t *ctx UNNEEDED, const u8 *ping UNNEEDED, u8 **pong UNNEEDED)
 { fprintf(stderr, "check_ping_make_pong called!\n"); abort(); }
@@ -51,6 +56,13 @@ void daemon_conn_wake(struct daemon_conn *dc UNNEEDED)
 /* Generated stub for daemon_shutdown */
 void daemon_shutdown(void)
 { fprintf(stderr, "daemon_shutdown called!\n"); abort(); }
+/* Generated stub for decode_channel_announcement_ids */
+bool decode_channel_announcement_ids(const u8 *msg UNNEEDED, size_t len UNNEEDED,
+				     bool check UNNEEDED,
+				     struct short_channel_id *scid UNNEEDED,
+				     struct node_id *node_id_1 UNNEEDED,
+				     struct node_id *node_id_2 UNNEEDED)
+{ fprintf(stderr, "decode_channel_announcement_ids called!\n"); abort(); }
 /* Generated stub for decode_scid_query_flags */
 bigsize_t *decode_scid_query_flags(const tal_t *ctx UNNEEDED,
 				   const struct tlv_query_short_channel_ids_tlvs_query_flags *qf UNNEEDED)
@@ -109,6 +121,9 @@ bool fromwire_gossip_getnodes_request(const tal_t *ctx UNNEEDED, const void *p U
 /* Generated stub for fromwire_gossip_getroute_request */
 bool fromwire_gossip_getroute_request(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id **source UNNEEDED, struct node_id *destination UNNEEDED, struct amount_msat *msatoshi UNNEEDED, u64 *riskfactor_by_million UNNEEDED, u32 *final_cltv UNNEEDED, double *fuzz UNNEEDED, struct short_channel_id_dir **excluded UNNEEDED, u32 *max_hops UNNEEDED)
 { fprintf(stderr, "fromwire_gossip_getroute_request called!\n"); abort(); }
+/* Generated stub for fromwire_gossip_getroutes_request */
+bool fromwire_gossip_getroutes_request(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id **source UNNEEDED, struct node_id **destinations UNNEEDED, struct amount_msat **msatoshis UNNEEDED, u64 *riskfactor_by_million UNNEEDED, u32 *final_cltv UNNEEDED, double *fuzz UNNEEDED, struct short_channel_id_dir **excluded UNNEEDED, u32 *max_hops UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_getroutes_request called!\n"); abort(); }
 /* Generated stub for fromwire_gossip_get_txout_reply */
 bool fromwire_gossip_get_txout_reply(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct short_channel_id *short_channel_id UNNEEDED, struct amount_sat *satoshis UNNEEDED, u8 **outscript UNNEEDED)
 { fprintf(stderr, "fromwire_gossip_get_txout_reply called!\n"); abort(); }
@@ -163,12 +178,26 @@ struct route_hop *get_route(const tal_t *ctx UNNEEDED, struct routing_state *rst
 			    const struct short_channel_id_dir *excluded UNNEEDED,
 			    size_t max_hops UNNEEDED)
 { fprintf(stderr, "get_route called!\n"); abort(); }
+/* Generated stub for get_routes */
+struct route_hop **get_routes(const tal_t *ctx UNNEEDED, struct routing_state *rstate UNNEEDED,
+			      const struct node_id *sources UNNEEDED,
+			      const struct node_id *destination UNNEEDED,
+			      const struct amount_msat msat UNNEEDED, double riskfactor UNNEEDED,
+			      u32 final_cltv UNNEEDED,
+			      double fuzz UNNEEDED,
+			      u64 seed UNNEEDED,
+			      const struct short_channel_id_dir *excluded UNNEEDED,
+			      size_t max_hops UNNEEDED)
+{ fprintf(stderr, "get_routes called!\n"); abort(); }
 /* Generated stub for gossip_peerd_wire_type_name */
 const char *gossip_peerd_wire_type_name(int e UNNEEDED)
 { fprintf(stderr, "gossip_peerd_wire_type_name called!\n"); abort(); }
 /* Generated stub for gossip_store_compact */
 bool gossip_store_compact(struct gossip_store *gs UNNEEDED)
 { fprintf(stderr, "gossip_store_compact called!\n"); abort(); }
+/* Generated stub for gossip_store_compact_done */
+bool gossip_store_compact_done(struct gossip_store *gs UNNEEDED, bool *ok UNNEEDED)
+{ fprintf(stderr, "gossip_store_compact_done called!\n"); abort(); }
 /* Generated stub for gossip_store_get */
 const u8 *gossip_store_get(const tal_t *ctx UNNEEDED,
 			   struct gossip_store *gs UNNEEDED,
@@ -186,10 +215,12 @@ const char *got_pong(const u8 *pong UNNEEDED, size_t *num_pings_outstanding UNNE
 /* Generated stub for handle_channel_announcement */
 u8 *handle_channel_announcement(struct routing_state *rstate UNNEEDED,
 				const u8 *announce TAKES UNNEEDED,
+				bool sigs_checked UNNEEDED,
 				const struct short_channel_id **scid UNNEEDED)
 { fprintf(stderr, "handle_channel_announcement called!\n"); abort(); }
 /* Generated stub for handle_channel_update */
 u8 *handle_channel_update(struct routing_state *rstate UNNEEDED, const u8 *update TAKES UNNEEDED,
+			  const struct node_id *signed_by UNNEEDED,
 			  const char *source UNNEEDED,
 			  struct short_channel_id *unknown_scid UNNEEDED)
 { fprintf(stderr, "handle_channel_update called!\n"); abort(); }
@@ -198,7 +229,8 @@ bool handle_local_add_channel(struct routing_state *rstate UNNEEDED, const u8 *m
 			      u64 index UNNEEDED)
 { fprintf(stderr, "handle_local_add_channel called!\n"); abort(); }
 /* Generated stub for handle_node_announcement */
-u8 *handle_node_announcement(struct routing_state *rstate UNNEEDED, const u8 *node UNNEEDED)
+u8 *handle_node_announcement(struct routing_state *rstate UNNEEDED, const u8 *node UNNEEDED,
+			     bool sig_checked UNNEEDED)
 { fprintf(stderr, "handle_node_announcement called!\n"); abort(); }
 /* Generated stub for handle_pending_cannouncement */
 bool handle_pending_cannouncement(struct routing_state *rstate UNNEEDED,
@@ -206,6 +238,12 @@ bool handle_pending_cannouncement(struct routing_state *rstate UNNEEDED,
 				  const struct amount_sat sat UNNEEDED,
 				  const u8 *txscript UNNEEDED)
 { fprintf(stderr, "handle_pending_cannouncement called!\n"); abort(); }
+/* Generated stub for local_disable_chan */
+void local_disable_chan(struct routing_state *rstate UNNEEDED, const struct chan *chan UNNEEDED)
+{ fprintf(stderr, "local_disable_chan called!\n"); abort(); }
+/* Generated stub for local_enable_chan */
+void local_enable_chan(struct routing_state *rstate UNNEEDED, const struct chan *chan UNNEEDED)
+{ fprintf(stderr, "local_enable_chan called!\n"); abort(); }
 /* Generated stub for make_ping */
 u8 *make_ping(const tal_t *ctx UNNEEDED, u16 num_pong_bytes UNNEEDED, u16 padlen UNNEEDED)
 { fprintf(stderr, "make_ping called!\n"); abort(); }
@@ -234,6 +272,9 @@ struct routing_state *new_routing_state(const tal_t *ctx UNNEEDED,
 					struct list_head *peers UNNEEDED,
 					const u32 *dev_gossip_time UNNEEDED)
 { fprintf(stderr, "new_routing_state called!\n"); abort(); }
+/* Generated stub for new_sigcheck_pool */
+struct sigcheck_pool *new_sigcheck_pool(const tal_t *ctx UNNEEDED, size_t nthreads UNNEEDED)
+{ fprintf(stderr, "new_sigcheck_pool called!\n"); abort(); }
 /* Generated stub for next_chan */
 struct chan *next_chan(const struct node *node UNNEEDED, struct chan_map_iter *i UNNEEDED)
 { fprintf(stderr, "next_chan called!\n"); abort(); }
@@ -258,6 +299,10 @@ void routing_failure(struct routing_state *rstate UNNEEDED,
 		     enum onion_type failcode UNNEEDED,
 		     const u8 *channel_update UNNEEDED)
 { fprintf(stderr, "routing_failure called!\n"); abort(); }
+/* Generated stub for sigcheck_run */
+void sigcheck_run(struct sigcheck_pool *pool UNNEEDED,
+		  struct sigcheck_job *jobs UNNEEDED, size_t num UNNEEDED)
+{ fprintf(stderr, "sigcheck_run called!\n"); abort(); }
 /* Generated stub for status_failed */
 void status_failed(enum status_failreason code UNNEEDED,
 		   const char *fmt UNNEEDED, ...)
@@ -286,7 +331,7 @@ u8 *towire_gossip_dev_memleak_reply(const tal_t *ctx UNNEEDED, bool leak UNNEEDE
 u8 *towire_gossipd_get_update_reply(const tal_t *ctx UNNEEDED, const u8 *update UNNEEDED)
 { fprintf(stderr, "towire_gossipd_get_update_reply called!\n"); abort(); }
 /* Generated stub for towire_gossipd_new_store_fd */
-u8 *towire_gossipd_new_store_fd(const tal_t *ctx UNNEEDED, u64 offset_shorter UNNEEDED)
+u8 *towire_gossipd_new_store_fd(const tal_t *ctx UNNEEDED, const u64 *old_offsets UNNEEDED, const u64 *new_offsets UNNEEDED)
 { fprintf(stderr, "towire_gossipd_new_store_fd called!\n"); abort(); }
 /* Generated stub for towire_gossip_get_addrs_reply */
 u8 *towire_gossip_get_addrs_reply(const tal_t *ctx UNNEEDED, const struct wireaddr *addrs UNNEEDED)
@@ -306,6 +351,9 @@ u8 *towire_gossip_getnodes_reply(const tal_t *ctx UNNEEDED, const struct gossip_
 /* Generated stub for towire_gossip_getroute_reply */
 u8 *towire_gossip_getroute_reply(const tal_t *ctx UNNEEDED, const struct route_hop *hops UNNEEDED)
 { fprintf(stderr, "towire_gossip_getroute_reply called!\n"); abort(); }
+/* Generated stub for towire_gossip_getroutes_reply */
+u8 *towire_gossip_getroutes_reply(const tal_t *ctx UNNEEDED, const u16 *route_lens UNNEEDED, const struct route_hop *hops UNNEEDED)
+{ fprintf(stderr, "towire_gossip_getroutes_reply called!\n"); abort(); }
 /* Generated stub for towire_gossip_get_txout */
 u8 *towire_gossip_get_txout(const tal_t *ctx UNNEEDED, const struct short_channel_id *short_channel_id UNNEEDED)
 { fprintf(stderr, "towire_gossip_get_txout called!\n"); abort(); }
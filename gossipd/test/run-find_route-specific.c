@@ -53,7 +53,9 @@ u8 *towire_gossip_store_channel_amount(const tal_t *ctx UNNEEDED, struct amount_
 u8 *towire_gossip_store_private_update(const tal_t *ctx UNNEEDED, const u8 *update UNNEEDED)
 { fprintf(stderr, "towire_gossip_store_private_update called!\n"); abort(); }
 /* Generated stub for update_peers_broadcast_index */
-void update_peers_broadcast_index(struct list_head *peers UNNEEDED, u32 offset UNNEEDED)
+void update_peers_broadcast_index(struct list_head *peers UNNEEDED,
+				  const u64 *old_offsets UNNEEDED,
+				  const u64 *new_offsets UNNEEDED)
 { fprintf(stderr, "update_peers_broadcast_index called!\n"); abort(); }
 /* AUTOGENERATED MOCKS END */
 
@@ -94,6 +96,19 @@ get_or_make_connection(struct routing_state *rstate,
 	return &chan->half[idx];
 }
 
+/* We set half_chan fields directly, so tell routing about them. */
+static void update_route_edges(struct routing_state *rstate)
+{
+	u64 idx;
+
+	for (struct chan *chan = uintmap_first(&rstate->chanmap, &idx);
+	     chan;
+	     chan = uintmap_after(&rstate->chanmap, &idx)) {
+		update_route_edge(rstate, chan, 0);
+		update_route_edge(rstate, chan, 1);
+	}
+}
+
 static bool channel_is_between(const struct chan *chan,
 			       const struct node_id *a, const struct node_id *b)
 {
@@ -175,6 +190,7 @@ int main(void)
 	nc->channel_flags = 1;
 	nc->message_flags = 0;
 	nc->bcast.timestamp = 1504064344;
+	update_route_edges(rstate);
 
 	route = find_route(tmpctx, rstate, &a, &c, AMOUNT_MSAT(100000), riskfactor, 0.0, NULL,
 			   ROUTING_MAX_HOPS, &fee);
@@ -211,6 +227,7 @@ int main(void)
 	nc->bcast.timestamp = 1504064344;
 	nc->htlc_minimum = AMOUNT_MSAT(100);
 	nc->htlc_maximum = AMOUNT_MSAT(500000); /* half capacity */
+	update_route_edges(rstate);
 
 	/* This should route correctly at the max_msat level */
 	route = find_route(tmpctx, rstate, &a, &d, AMOUNT_MSAT(500000), riskfactor, 0.0, NULL,
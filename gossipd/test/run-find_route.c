@@ -51,7 +51,9 @@ u8 *towire_gossip_store_channel_amount(const tal_t *ctx UNNEEDED, struct amount_
 u8 *towire_gossip_store_private_update(const tal_t *ctx UNNEEDED, const u8 *update UNNEEDED)
 { fprintf(stderr, "towire_gossip_store_private_update called!\n"); abort(); }
 /* Generated stub for update_peers_broadcast_index */
-void update_peers_broadcast_index(struct list_head *peers UNNEEDED, u32 offset UNNEEDED)
+void update_peers_broadcast_index(struct list_head *peers UNNEEDED,
+				  const u64 *old_offsets UNNEEDED,
+				  const u64 *new_offsets UNNEEDED)
 { fprintf(stderr, "update_peers_broadcast_index called!\n"); abort(); }
 /* AUTOGENERATED MOCKS END */
 
@@ -100,6 +102,7 @@ static void add_connection(struct routing_state *rstate,
 	c->channel_flags = node_id_idx(from, to);
 	c->htlc_minimum = AMOUNT_MSAT(0);
 	c->htlc_maximum = AMOUNT_MSAT(100000 * 1000);
+	update_route_edge(rstate, chan, node_id_idx(from, to));
 }
 
 /* Returns chan connecting from and to: *idx set to refer
@@ -121,25 +124,6 @@ static struct chan *find_channel(struct routing_state *rstate UNUSED,
 	return NULL;
 }
 
-static struct half_chan *get_connection(struct routing_state *rstate,
-					       const struct node_id *from_id,
-					       const struct node_id *to_id)
-{
-	int idx;
-	struct node *from, *to;
-	struct chan *c;
-
-	from = get_node(rstate, from_id);
-	to = get_node(rstate, to_id);
-	if (!from || ! to)
-		return NULL;
-
-	c = find_channel(rstate, from, to, &idx);
-	if (!c)
-		return NULL;
-	return &c->half[idx];
-}
-
 static bool channel_is_between(const struct chan *chan,
 			       const struct node_id *a, const struct node_id *b)
 {
@@ -162,7 +146,11 @@ int main(void)
 	struct node_id a, b, c, d;
 	struct privkey tmp;
 	struct amount_msat fee;
-	struct chan **route;
+	struct chan **route, *chan;
+	struct node_id *dests;
+	struct amount_msat *msats;
+	struct route_hop **routes;
+	int idx;
 	const double riskfactor = 1.0 / BLOCKS_PER_YEAR / 10000;
 
 	secp256k1_ctx = secp256k1_context_create(SECP256K1_CONTEXT_VERIFY
@@ -231,8 +219,40 @@ int main(void)
 	assert(channel_is_between(route[1], &b, &c));
 	assert(amount_msat_eq(fee, AMOUNT_MSAT(1 + 3)));
 
+	/* get_routes shares the search, but gives the same answers. */
+	dests = tal_arr(tmpctx, struct node_id, 2);
+	msats = tal_arr(tmpctx, struct amount_msat, 2);
+	dests[0] = dests[1] = c;
+	msats[0] = AMOUNT_MSAT(1000);
+	msats[1] = AMOUNT_MSAT(3000000);
+	routes = get_routes(tmpctx, rstate, NULL, dests, msats, 1.0, 9,
+			    0.0, 0, NULL, ROUTING_MAX_HOPS);
+	assert(tal_count(routes) == 2);
+	for (size_t i = 0; i < 2; i++) {
+		struct route_hop *hops;
+
+		hops = get_route(tmpctx, rstate, NULL, &dests[i], msats[i],
+				 1.0, 9, 0.0, 0, NULL, ROUTING_MAX_HOPS);
+		assert(tal_count(routes[i]) == 2);
+		assert(tal_count(hops) == 2);
+		for (size_t j = 0; j < 2; j++) {
+			assert(short_channel_id_eq(&routes[i][j].channel_id,
+						   &hops[j].channel_id));
+			assert(node_id_eq(&routes[i][j].nodeid,
+					  &hops[j].nodeid));
+			assert(amount_msat_eq(routes[i][j].amount,
+					      hops[j].amount));
+			assert(routes[i][j].delay == hops[j].delay);
+		}
+	}
+	assert(node_id_eq(&routes[0][0].nodeid, &d));
+	assert(node_id_eq(&routes[1][0].nodeid, &b));
+
 	/* Make B->C inactive, force it back via D */
-	get_connection(rstate, &b, &c)->channel_flags |= ROUTING_FLAGS_DISABLED;
+	chan = find_channel(rstate, get_node(rstate, &b), get_node(rstate, &c),
+			    &idx);
+	chan->half[idx].channel_flags |= ROUTING_FLAGS_DISABLED;
+	update_route_edge(rstate, chan, idx);
 	route = find_route(tmpctx, rstate, &a, &c, AMOUNT_MSAT(3000000), riskfactor, 0.0, NULL,
 			   ROUTING_MAX_HOPS, &fee);
 	assert(route);
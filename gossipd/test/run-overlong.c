@@ -51,7 +51,9 @@ u8 *towire_gossip_store_channel_amount(const tal_t *ctx UNNEEDED, struct amount_
 u8 *towire_gossip_store_private_update(const tal_t *ctx UNNEEDED, const u8 *update UNNEEDED)
 { fprintf(stderr, "towire_gossip_store_private_update called!\n"); abort(); }
 /* Generated stub for update_peers_broadcast_index */
-void update_peers_broadcast_index(struct list_head *peers UNNEEDED, u32 offset UNNEEDED)
+void update_peers_broadcast_index(struct list_head *peers UNNEEDED,
+				  const u64 *old_offsets UNNEEDED,
+				  const u64 *new_offsets UNNEEDED)
 { fprintf(stderr, "update_peers_broadcast_index called!\n"); abort(); }
 /* AUTOGENERATED MOCKS END */
 
@@ -119,6 +121,8 @@ int main(void)
 		hc->channel_flags = node_id_idx(&ids[i-1], &ids[i]);
 		hc->htlc_minimum = AMOUNT_MSAT(0);
 		hc->htlc_maximum = AMOUNT_MSAT(1000000 * 1000);
+		update_route_edge(rstate, chan,
+				  node_id_idx(&ids[i-1], &ids[i]));
 		SUPERVERBOSE("Joining %s to %s, fee %u",
 			     type_to_string(tmpctx, struct node_id, &ids[i-1]),
 			     type_to_string(tmpctx, struct node_id, &ids[i]),
@@ -138,6 +142,7 @@ int main(void)
 		hc->channel_flags = node_id_idx(&ids[1], &ids[i]);
 		hc->htlc_minimum = AMOUNT_MSAT(0);
 		hc->htlc_maximum = AMOUNT_MSAT(1000000 * 1000);
+		update_route_edge(rstate, chan, node_id_idx(&ids[1], &ids[i]));
 		SUPERVERBOSE("Joining %s to %s, fee %u",
 			     type_to_string(tmpctx, struct node_id, &ids[1]),
 			     type_to_string(tmpctx, struct node_id, &ids[i]),
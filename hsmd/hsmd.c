@@ -44,6 +44,7 @@
 /*~ All gen_ files are autogenerated; in this case by tools/generate-wire.py */
 #include <hsmd/gen_hsm_wire.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <secp256k1_ecdh.h>
 #include <sodium/randombytes.h>
 #include <sys/socket.h>
@@ -296,7 +297,12 @@ static struct io_plan *req_reply(struct io_conn *conn,
 	 *
 	 * If we were to queue outgoing messages ourselves, we *would* have to
 	 * consider such scenarios; this is why our daemons generally avoid
-	 * buffering from untrusted parties. */
+	 * buffering from untrusted parties.
+	 *
+	 * Clients don't have to wait for each reply before sending their next
+	 * request (see common/hsm_client.c): we simply handle whatever they've
+	 * queued back-to-back, and since we only read the next request once
+	 * this reply is written, replies always come back in request order. */
 	return io_write_wire(conn, msg_out, client_read_next, c);
 }
 
@@ -646,6 +652,32 @@ static struct io_plan *handle_ecdh(struct io_conn *conn,
 	return req_reply(conn, c, take(towire_hsm_ecdh_resp(NULL, &ss)));
 }
 
+/*~ channeld needs a shared secret for every HTLC it's offered; rather than
+ * asking for each one as it arrives, it asks for them all at once. */
+static struct io_plan *handle_ecdh_batch(struct io_conn *conn,
+					 struct client *c,
+					 const u8 *msg_in)
+{
+	struct privkey privkey;
+	struct pubkey *points;
+	struct secret *ss;
+
+	if (!fromwire_hsm_ecdh_batch_req(tmpctx, msg_in, &points))
+		return bad_req(conn, c, msg_in);
+
+	node_key(&privkey, NULL);
+	ss = tal_arr(tmpctx, struct secret, tal_count(points));
+	for (size_t i = 0; i < tal_count(points); i++) {
+		if (secp256k1_ecdh(secp256k1_ctx, ss[i].data,
+				   &points[i].pubkey,
+				   privkey.secret.data, NULL, NULL) != 1)
+			return bad_req_fmt(conn, c, msg_in,
+					   "secp256k1_ecdh fail %zu", i);
+	}
+
+	return req_reply(conn, c, take(towire_hsm_ecdh_batch_resp(NULL, ss)));
+}
+
 /*~ The specific routine to sign the channel_announcement message.  This is
  * defined in BOLT #7, and requires *two* signatures: one from this node's key
  * (to prove it's from us), and one from the bitcoin key used to create the
@@ -957,6 +989,164 @@ static struct io_plan *handle_sign_remote_htlc_tx(struct io_conn *conn,
 	return req_reply(conn, c, take(towire_hsm_sign_tx_reply(NULL, &sig)));
 }
 
+/*~ Asking for the commitment signature and then one HTLC signature at a time
+ * costs channeld a round trip per HTLC, during which it can't talk to its
+ * peer; so it can ask for them all at once instead.  There can be almost a
+ * thousand HTLC txs, so we spread the signing over a few threads.  That's
+ * safe because sign_tx_input() doesn't allocate: each thread just fills in
+ * its own part of the signature array. */
+#define HTLC_SIGS_PER_THREAD 32
+
+struct htlc_sign_chunk {
+	pthread_t thread;
+	struct bitcoin_tx **txs;
+	struct hsm_htlc_input **inputs;
+	const struct privkey *privkey;
+	const struct pubkey *pubkey;
+	struct bitcoin_signature *sigs;
+	size_t start, end;
+};
+
+static void *sign_htlc_chunk(void *arg)
+{
+	struct htlc_sign_chunk *chunk = arg;
+
+	for (size_t i = chunk->start; i < chunk->end; i++)
+		sign_tx_input(chunk->txs[i], 0, NULL, chunk->inputs[i]->wscript,
+			      chunk->privkey, chunk->pubkey, SIGHASH_ALL,
+			      &chunk->sigs[i]);
+	return NULL;
+}
+
+static void sign_htlc_txs(struct bitcoin_tx **txs,
+			  struct hsm_htlc_input **inputs,
+			  const struct privkey *privkey,
+			  const struct pubkey *pubkey,
+			  struct bitcoin_signature *sigs)
+{
+	size_t num = tal_count(txs), nchunks;
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	struct htlc_sign_chunk *chunks;
+
+	nchunks = (num + HTLC_SIGS_PER_THREAD - 1) / HTLC_SIGS_PER_THREAD;
+	if (ncpus < 1)
+		ncpus = 1;
+	if (nchunks > (size_t)ncpus)
+		nchunks = ncpus;
+	if (nchunks == 0)
+		return;
+
+	chunks = tal_arr(tmpctx, struct htlc_sign_chunk, nchunks);
+	for (size_t i = 0; i < nchunks; i++) {
+		chunks[i].txs = txs;
+		chunks[i].inputs = inputs;
+		chunks[i].privkey = privkey;
+		chunks[i].pubkey = pubkey;
+		chunks[i].sigs = sigs;
+		chunks[i].start = num * i / nchunks;
+		chunks[i].end = num * (i + 1) / nchunks;
+		/* We do the first one ourselves (or any which fail). */
+		if (i == 0
+		    || pthread_create(&chunks[i].thread, NULL,
+				      sign_htlc_chunk, &chunks[i]) != 0)
+			chunks[i].thread = pthread_self();
+	}
+
+	sign_htlc_chunk(&chunks[0]);
+	for (size_t i = 1; i < nchunks; i++) {
+		if (pthread_equal(chunks[i].thread, pthread_self()))
+			sign_htlc_chunk(&chunks[i]);
+		else
+			pthread_join(chunks[i].thread, NULL);
+	}
+	tal_free(chunks);
+}
+
+static struct io_plan *handle_sign_remote_commitment_txs(struct io_conn *conn,
+							 struct client *c,
+							 const u8 *msg_in)
+{
+	struct pubkey remote_funding_pubkey, local_funding_pubkey;
+	struct pubkey remote_per_commit_point, htlc_pubkey;
+	struct amount_sat funding;
+	struct secret channel_seed;
+	struct bitcoin_tx *tx, **htlc_txs;
+	struct hsm_htlc_input **htlc_inputs;
+	struct bitcoin_signature sig, *htlc_sigs;
+	struct secrets secrets;
+	struct basepoints basepoints;
+	struct privkey htlc_privkey;
+	const u8 *funding_wscript;
+
+	if (!fromwire_hsm_sign_remote_commitment_txs(tmpctx, msg_in,
+						     &tx,
+						     &remote_funding_pubkey,
+						     &funding,
+						     &remote_per_commit_point,
+						     &htlc_txs,
+						     &htlc_inputs))
+		return bad_req(conn, c, msg_in);
+	tx->chainparams = c->chainparams;
+
+	/* Basic sanity checks. */
+	if (tx->wtx->num_inputs != 1)
+		return bad_req_fmt(conn, c, msg_in, "tx must have 1 input");
+	if (tx->wtx->num_outputs == 0)
+		return bad_req_fmt(conn, c, msg_in, "tx must have > 0 outputs");
+	if (tal_count(htlc_txs) != tal_count(htlc_inputs))
+		return bad_req_fmt(conn, c, msg_in,
+				   "%zu htlc txs but %zu inputs",
+				   tal_count(htlc_txs),
+				   tal_count(htlc_inputs));
+	for (size_t i = 0; i < tal_count(htlc_txs); i++) {
+		if (htlc_txs[i]->wtx->num_inputs != 1)
+			return bad_req_fmt(conn, c, msg_in,
+					   "htlc tx %zu must have 1 input", i);
+		htlc_txs[i]->chainparams = c->chainparams;
+		/* Need input amount for signing */
+		htlc_txs[i]->input_amounts[0]
+			= tal_dup(htlc_txs[i], struct amount_sat,
+				  &htlc_inputs[i]->amount);
+	}
+
+	get_channel_seed(&c->id, c->dbid, &channel_seed);
+	derive_basepoints(&channel_seed,
+			  &local_funding_pubkey, &basepoints, &secrets, NULL);
+
+	funding_wscript = bitcoin_redeem_2of2(tmpctx,
+					      &local_funding_pubkey,
+					      &remote_funding_pubkey);
+	tx->input_amounts[0] = tal_dup(tx, struct amount_sat, &funding);
+	sign_tx_input(tx, 0, NULL, funding_wscript,
+		      &secrets.funding_privkey,
+		      &local_funding_pubkey,
+		      SIGHASH_ALL,
+		      &sig);
+
+	if (!derive_simple_privkey(&secrets.htlc_basepoint_secret,
+				   &basepoints.htlc,
+				   &remote_per_commit_point,
+				   &htlc_privkey))
+		return bad_req_fmt(conn, c, msg_in,
+				   "Failed deriving htlc privkey");
+
+	if (!derive_simple_key(&basepoints.htlc,
+			       &remote_per_commit_point,
+			       &htlc_pubkey))
+		return bad_req_fmt(conn, c, msg_in,
+				   "Failed deriving htlc pubkey");
+
+	htlc_sigs = tal_arr(tmpctx, struct bitcoin_signature,
+			    tal_count(htlc_txs));
+	sign_htlc_txs(htlc_txs, htlc_inputs, &htlc_privkey, &htlc_pubkey,
+		      htlc_sigs);
+
+	return req_reply(conn, c,
+			 take(towire_hsm_sign_remote_commitment_txs_reply(NULL,
+									  &sig,
+									  htlc_sigs)));
+}
+
 /*~ This covers several cases where onchaind is creating a transaction which
  * sends funds to our internal wallet. */
 /* FIXME: Derive output address for this client, and check it here! */
@@ -1689,6 +1879,7 @@ static bool check_client_capabilities(struct client *client,
 	 */
 	switch (t) {
 	case WIRE_HSM_ECDH_REQ:
+	case WIRE_HSM_ECDH_BATCH_REQ:
 		return (client->capabilities & HSM_CAP_ECDH) != 0;
 
 	case WIRE_HSM_CANNOUNCEMENT_SIG_REQ:
@@ -1708,6 +1899,7 @@ static bool check_client_capabilities(struct client *client,
 
 	case WIRE_HSM_SIGN_REMOTE_COMMITMENT_TX:
 	case WIRE_HSM_SIGN_REMOTE_HTLC_TX:
+	case WIRE_HSM_SIGN_REMOTE_COMMITMENT_TXS:
 		return (client->capabilities & HSM_CAP_SIGN_REMOTE_TX) != 0;
 
 	case WIRE_HSM_SIGN_MUTUAL_CLOSE_TX:
@@ -1727,6 +1919,7 @@ static bool check_client_capabilities(struct client *client,
 	 * FIXME: Since we autogenerate these, we should really generate separate
 	 * enums for replies to avoid this kind of clutter! */
 	case WIRE_HSM_ECDH_RESP:
+	case WIRE_HSM_ECDH_BATCH_RESP:
 	case WIRE_HSM_CANNOUNCEMENT_SIG_REPLY:
 	case WIRE_HSM_CUPDATE_SIG_REPLY:
 	case WIRE_HSM_CLIENT_HSMFD_REPLY:
@@ -1742,6 +1935,7 @@ static bool check_client_capabilities(struct client *client,
 	case WIRE_HSM_CHECK_FUTURE_SECRET_REPLY:
 	case WIRE_HSM_GET_CHANNEL_BASEPOINTS_REPLY:
 	case WIRE_HSM_DEV_MEMLEAK_REPLY:
+	case WIRE_HSM_SIGN_REMOTE_COMMITMENT_TXS_REPLY:
 		break;
 	}
 	return false;
@@ -1774,6 +1968,9 @@ static struct io_plan *handle_client(struct io_conn *conn, struct client *c)
 	case WIRE_HSM_ECDH_REQ:
 		return handle_ecdh(conn, c, c->msg_in);
 
+	case WIRE_HSM_ECDH_BATCH_REQ:
+		return handle_ecdh_batch(conn, c, c->msg_in);
+
 	case WIRE_HSM_CANNOUNCEMENT_SIG_REQ:
 		return handle_cannouncement_sig(conn, c, c->msg_in);
 
@@ -1819,6 +2016,9 @@ static struct io_plan *handle_client(struct io_conn *conn, struct client *c)
 	case WIRE_HSM_SIGN_REMOTE_HTLC_TX:
 		return handle_sign_remote_htlc_tx(conn, c, c->msg_in);
 
+	case WIRE_HSM_SIGN_REMOTE_COMMITMENT_TXS:
+		return handle_sign_remote_commitment_txs(conn, c, c->msg_in);
+
 	case WIRE_HSM_SIGN_MUTUAL_CLOSE_TX:
 		return handle_sign_mutual_close_tx(conn, c, c->msg_in);
 
@@ -1829,6 +2029,7 @@ static struct io_plan *handle_client(struct io_conn *conn, struct client *c)
 	case WIRE_HSM_DEV_MEMLEAK:
 #endif /* DEVELOPER */
 	case WIRE_HSM_ECDH_RESP:
+	case WIRE_HSM_ECDH_BATCH_RESP:
 	case WIRE_HSM_CANNOUNCEMENT_SIG_REPLY:
 	case WIRE_HSM_CUPDATE_SIG_REPLY:
 	case WIRE_HSM_CLIENT_HSMFD_REPLY:
@@ -1844,6 +2045,7 @@ static struct io_plan *handle_client(struct io_conn *conn, struct client *c)
 	case WIRE_HSM_CHECK_FUTURE_SECRET_REPLY:
 	case WIRE_HSM_GET_CHANNEL_BASEPOINTS_REPLY:
 	case WIRE_HSM_DEV_MEMLEAK_REPLY:
+	case WIRE_HSM_SIGN_REMOTE_COMMITMENT_TXS_REPLY:
 		break;
 	}
 
@@ -1,4 +1,5 @@
-/* Code for talking to bitcoind.  We use bitcoin-cli. */
+/* Code for talking to bitcoind.  We use its JSON-RPC interface directly if
+ * we can, otherwise bitcoin-cli. */
 #include "bitcoin/base58.h"
 #include "bitcoin/block.h"
 #include "bitcoin/feerate.h"
@@ -7,9 +8,13 @@
 #include "bitcoind.h"
 #include "lightningd.h"
 #include "log.h"
+#include <ccan/array_size/array_size.h>
 #include <ccan/cast/cast.h>
 #include <ccan/io/io.h>
+#include <ccan/json_escape/json_escape.h>
+#include <ccan/noerr/noerr.h>
 #include <ccan/pipecmd/pipecmd.h>
+#include <ccan/read_write_all/read_write_all.h>
 #include <ccan/str/hex/hex.h>
 #include <ccan/take/take.h>
 #include <ccan/tal/grab_file/grab_file.h>
@@ -22,6 +27,9 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <lightningd/chaintopology.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 
 /* Bitcoind's web server has a default of 4 threads, with queue depth 16.
  * It will *fail* rather than queue beyond that, so we must not stress it!
@@ -178,9 +186,8 @@ static void bcli_failure(struct bitcoind *bitcoind,
 		     retry_bcli, bcli);
 }
 
-static void bcli_finished(struct io_conn *conn UNUSED, struct bitcoin_cli *bcli)
+static void bcli_done(struct bitcoin_cli *bcli, int exitstatus)
 {
-	int ret, status;
 	struct bitcoind *bitcoind = bcli->bitcoind;
 	enum bitcoind_prio prio = bcli->prio;
 	bool ok;
@@ -194,27 +201,16 @@ static void bcli_finished(struct io_conn *conn UNUSED, struct bitcoin_cli *bcli)
 
 	assert(bitcoind->num_requests[prio] > 0);
 
-	/* FIXME: If we waited for SIGCHILD, this could never hang! */
-	while ((ret = waitpid(bcli->pid, &status, 0)) < 0 && errno == EINTR);
-	if (ret != bcli->pid)
-		fatal("%s %s", bcli_args(tmpctx, bcli),
-		      ret == 0 ? "not exited?" : strerror(errno));
-
-	if (!WIFEXITED(status))
-		fatal("%s died with signal %i",
-		      bcli_args(tmpctx, bcli),
-		      WTERMSIG(status));
-
 	if (!bcli->exitstatus) {
-		if (WEXITSTATUS(status) != 0) {
-			bcli_failure(bitcoind, bcli, WEXITSTATUS(status));
+		if (exitstatus != 0) {
+			bcli_failure(bitcoind, bcli, exitstatus);
 			bitcoind->num_requests[prio]--;
 			goto done;
 		}
 	} else
-		*bcli->exitstatus = WEXITSTATUS(status);
+		*bcli->exitstatus = exitstatus;
 
-	if (WEXITSTATUS(status) == 0)
+	if (exitstatus == 0)
 		bitcoind->error_count = 0;
 
 	bitcoind->num_requests[bcli->prio]--;
@@ -228,7 +224,7 @@ static void bcli_finished(struct io_conn *conn UNUSED, struct bitcoin_cli *bcli)
 	db_commit_transaction(bitcoind->ld->wallet->db);
 
 	if (!ok)
-		bcli_failure(bitcoind, bcli, WEXITSTATUS(status));
+		bcli_failure(bitcoind, bcli, exitstatus);
 	else
 		tal_free(bcli);
 
@@ -236,6 +232,420 @@ done:
 	next_bcli(bitcoind, prio);
 }
 
+static void bcli_finished(struct io_conn *conn UNUSED, struct bitcoin_cli *bcli)
+{
+	int ret, status;
+
+	/* FIXME: If we waited for SIGCHILD, this could never hang! */
+	while ((ret = waitpid(bcli->pid, &status, 0)) < 0 && errno == EINTR);
+	if (ret != bcli->pid)
+		fatal("%s %s", bcli_args(tmpctx, bcli),
+		      ret == 0 ? "not exited?" : strerror(errno));
+
+	if (!WIFEXITED(status))
+		fatal("%s died with signal %i",
+		      bcli_args(tmpctx, bcli),
+		      WTERMSIG(status));
+
+	bcli_done(bcli, WEXITSTATUS(status));
+}
+
+/* Rather than forking bitcoin-cli for every request, we can talk JSON-RPC
+ * to bitcoind ourselves.  We keep (HTTP/1.1 keep-alive) connections open
+ * and reuse them, and turn the replies back into what bitcoin-cli would
+ * have given us, so the process() functions don't care. */
+struct bitcoind_rpc {
+	/* Where bitcoind is listening. */
+	struct addrinfo *addr;
+
+	/* "host:port", for Host: and for messages. */
+	char *hostport;
+
+	/* Base64 of "user:password" */
+	char *auth;
+
+	/* Connections which aren't running a request. */
+	struct list_head idle;
+
+	u64 next_id;
+};
+
+struct rpc_conn {
+	/* In bitcoind->rpc->idle, if idle. */
+	struct list_node list;
+	bool idle;
+
+	struct bitcoind *bitcoind;
+
+	/* The request we're running (NULL if none) */
+	struct bitcoin_cli *bcli;
+
+	/* Has bitcoind answered anything on this connection before? */
+	bool reused;
+
+	char *request;
+
+	/* The reply: hdrlen is 0 until we have the whole header. */
+	char *buf;
+	size_t len, new_bytes, hdrlen, bodylen;
+	bool keepalive;
+};
+
+/* The command and its parameters, after bitcoin-cli's own options */
+static const char **bcli_cmd(const char **args)
+{
+	size_t i = 1;
+
+	while (args[i][0] == '-')
+		i++;
+	return args + i;
+}
+
+static char *base64(const tal_t *ctx, const char *str)
+{
+	static const char enc[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t len = strlen(str);
+	char *out = tal_arr(ctx, char, (len + 2) / 3 * 4 + 1), *p = out;
+
+	for (size_t i = 0; i < len; i += 3) {
+		u32 v = (u32)(u8)str[i] << 16;
+		if (i + 1 < len)
+			v |= (u32)(u8)str[i+1] << 8;
+		if (i + 2 < len)
+			v |= (u8)str[i+2];
+		*(p++) = enc[(v >> 18) & 63];
+		*(p++) = enc[(v >> 12) & 63];
+		*(p++) = i + 1 < len ? enc[(v >> 6) & 63] : '=';
+		*(p++) = i + 2 < len ? enc[v & 63] : '=';
+	}
+	*p = '\0';
+	return out;
+}
+
+/* bitcoin-cli hands these parameters to bitcoind as JSON, not strings
+ * (see vRPCConvertParams in bitcoin's src/rpc/client.cpp), so must we. */
+static const struct {
+	const char *method;
+	size_t param;
+} rpc_json_params[] = {
+	{ "estimatesmartfee", 0 },
+	{ "getblock", 1 },
+	{ "getblockhash", 0 },
+	{ "gettxout", 1 },
+	{ "gettxout", 2 },
+	{ "sendrawtransaction", 1 },
+};
+
+static bool rpc_param_is_json(const char *method, size_t param)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(rpc_json_params); i++) {
+		if (streq(rpc_json_params[i].method, method)
+		    && rpc_json_params[i].param == param)
+			return true;
+	}
+	return false;
+}
+
+/* cmd is the method, followed by its parameters, NULL-terminated */
+static char *rpc_request(const tal_t *ctx, struct bitcoind_rpc *rpc,
+			 const char **cmd)
+{
+	char *body;
+
+	body = tal_fmt(tmpctx,
+		       "{\"jsonrpc\":\"1.0\",\"id\":%"PRIu64","
+		       "\"method\":\"%s\",\"params\":[",
+		       rpc->next_id++, cmd[0]);
+	for (size_t i = 1; cmd[i]; i++) {
+		if (i != 1)
+			tal_append_fmt(&body, ",");
+		if (rpc_param_is_json(cmd[0], i - 1))
+			tal_append_fmt(&body, "%s", cmd[i]);
+		else
+			tal_append_fmt(&body, "\"%s\"",
+				       json_escape(tmpctx, cmd[i])->s);
+	}
+	tal_append_fmt(&body, "]}");
+
+	return tal_fmt(ctx,
+		       "POST / HTTP/1.1\r\n"
+		       "Host: %s\r\n"
+		       "Connection: keep-alive\r\n"
+		       "Authorization: Basic %s\r\n"
+		       "Content-Type: application/json\r\n"
+		       "Content-Length: %zu\r\n"
+		       "\r\n"
+		       "%s",
+		       rpc->hostport, rpc->auth, strlen(body), body);
+}
+
+/* Returns false if it's not a reply we understand.  Otherwise sets
+ * *hdrlen, or leaves it 0 if we need more. */
+static bool http_parse_headers(const char *buf, size_t len,
+			       size_t *hdrlen, size_t *bodylen,
+			       bool *keepalive)
+{
+	const char *end = memmem(buf, len, "\r\n\r\n", 4);
+	char **lines;
+	bool have_len = false;
+
+	*hdrlen = 0;
+	if (!end)
+		/* bitcoind's headers are tiny. */
+		return len < 8192;
+
+	lines = tal_strsplit(tmpctx, tal_strndup(tmpctx, buf, end - buf),
+			     "\r\n", STR_NO_EMPTY);
+
+	/* We ignore the status: errors still come with a JSON-RPC body. */
+	if (!lines[0] || !strstarts(lines[0], "HTTP/1."))
+		return false;
+	*keepalive = strstarts(lines[0], "HTTP/1.1");
+
+	for (size_t i = 1; lines[i]; i++) {
+		if (strncasecmp(lines[i], "Content-Length:", 15) == 0) {
+			char *endp;
+			*bodylen = strtoul(lines[i] + 15, &endp, 10);
+			have_len = (endp != lines[i] + 15);
+		} else if (strncasecmp(lines[i], "Connection:", 11) == 0)
+			*keepalive = !strcasestr(lines[i] + 11, "close");
+	}
+
+	/* bitcoind always tells us the length. */
+	if (!have_len)
+		return false;
+
+	*hdrlen = end + 4 - buf;
+	return true;
+}
+
+static char *rpc_strdup(const tal_t *ctx, const char *buffer,
+			const jsmntok_t *tok)
+{
+	const char *str;
+
+	if (!memchr(buffer + tok->start, '\\', tok->end - tok->start))
+		return json_strdup(ctx, buffer, tok);
+
+	str = json_escape_unescape(ctx,
+				   json_escape_string_(tmpctx,
+						       buffer + tok->start,
+						       tok->end - tok->start));
+	if (!str)
+		return json_strdup(ctx, buffer, tok);
+	return cast_const(char *, str);
+}
+
+/* Turn a JSON-RPC reply into what bitcoin-cli would have printed, and
+ * return the exit status it would have given.  Returns -1 (with an
+ * explanation in *output) if it's not a JSON-RPC reply at all. */
+static int rpc_reply_to_cli(const tal_t *ctx,
+			    const char *body, size_t bodylen,
+			    char **output)
+{
+	const jsmntok_t *toks, *result, *error, *codetok, *msgtok;
+	bool valid;
+	int code;
+
+	toks = json_parse_input(tmpctx, body, bodylen, &valid);
+	if (!toks || toks[0].type != JSMN_OBJECT)
+		goto not_jsonrpc;
+
+	result = json_get_member(body, toks, "result");
+	error = json_get_member(body, toks, "error");
+	if (!result || !error)
+		goto not_jsonrpc;
+
+	if (!json_tok_is_null(body, error)) {
+		codetok = json_get_member(body, error, "code");
+		msgtok = json_get_member(body, error, "message");
+		if (!codetok || !json_to_int(body, codetok, &code) || !msgtok)
+			goto not_jsonrpc;
+		*output = tal_fmt(ctx, "error code: %i\nerror message:\n%s\n",
+				  code, rpc_strdup(tmpctx, body, msgtok));
+		/* bitcoin-cli exits with abs(code) */
+		return code ? abs(code) : 1;
+	}
+
+	if (json_tok_is_null(body, result))
+		*output = tal_strdup(ctx, "");
+	else if (result->type == JSMN_STRING)
+		*output = tal_fmt(ctx, "%s\n", rpc_strdup(tmpctx, body, result));
+	else
+		*output = tal_fmt(ctx, "%.*s\n",
+				  json_tok_full_len(result),
+				  json_tok_full(body, result));
+	return 0;
+
+not_jsonrpc:
+	*output = tal_fmt(ctx, "bitcoind gave non-JSON-RPC reply '%.*s'",
+			  (int)bodylen, body);
+	return -1;
+}
+
+static void rpc_finish_bcli(struct rpc_conn *rc, int exitstatus, char *output)
+{
+	struct bitcoin_cli *bcli = rc->bcli;
+
+	rc->bcli = NULL;
+	bcli->output = tal_steal(bcli, output);
+	bcli->output_bytes = strlen(output);
+	bcli_done(bcli, exitstatus);
+}
+
+static struct io_plan *rpc_read_reply(struct io_conn *conn,
+				      struct rpc_conn *rc);
+
+static struct io_plan *rpc_send_request(struct io_conn *conn,
+					struct rpc_conn *rc)
+{
+	tal_free(rc->request);
+	rc->request = rpc_request(rc, rc->bitcoind->rpc,
+				  bcli_cmd(rc->bcli->args));
+
+	tal_free(rc->buf);
+	rc->buf = tal_arr(rc, char, 4096);
+	rc->len = rc->new_bytes = rc->hdrlen = 0;
+	return io_write(conn, rc->request, strlen(rc->request),
+			rpc_read_reply, rc);
+}
+
+static struct io_plan *rpc_reply_done(struct io_conn *conn,
+				      struct rpc_conn *rc)
+{
+	struct bitcoind *bitcoind = rc->bitcoind;
+	char *output;
+	int exitstatus;
+
+	exitstatus = rpc_reply_to_cli(tmpctx, rc->buf + rc->hdrlen,
+				      rc->bodylen, &output);
+	if (exitstatus < 0)
+		exitstatus = 1;
+
+	rc->reused = true;
+	if (rc->keepalive) {
+		list_add(&bitcoind->rpc->idle, &rc->list);
+		rc->idle = true;
+	}
+
+	/* This may hand us the next request already. */
+	rpc_finish_bcli(rc, exitstatus, output);
+
+	if (!rc->keepalive)
+		return io_close(conn);
+	if (rc->bcli)
+		return rpc_send_request(conn, rc);
+	return io_wait(conn, rc, rpc_send_request, rc);
+}
+
+static struct io_plan *rpc_read_reply(struct io_conn *conn,
+				      struct rpc_conn *rc)
+{
+	rc->len += rc->new_bytes;
+
+	if (!rc->hdrlen) {
+		if (!http_parse_headers(rc->buf, rc->len, &rc->hdrlen,
+					&rc->bodylen, &rc->keepalive)) {
+			log_unusual(rc->bitcoind->log,
+				    "%s: bad HTTP reply '%.*s'",
+				    rc->bitcoind->rpc->hostport,
+				    (int)rc->len, rc->buf);
+			return io_close(conn);
+		}
+		/* Make room for the whole reply at once. */
+		if (rc->hdrlen && tal_count(rc->buf) < rc->hdrlen + rc->bodylen)
+			tal_resize(&rc->buf, rc->hdrlen + rc->bodylen);
+	}
+
+	if (rc->hdrlen && rc->len >= rc->hdrlen + rc->bodylen)
+		return rpc_reply_done(conn, rc);
+
+	if (rc->len == tal_count(rc->buf))
+		tal_resize(&rc->buf, rc->len * 2);
+	return io_read_partial(conn, rc->buf + rc->len,
+			       tal_count(rc->buf) - rc->len,
+			       &rc->new_bytes, rpc_read_reply, rc);
+}
+
+static struct io_plan *rpc_connect(struct io_conn *conn, struct rpc_conn *rc)
+{
+	return io_connect(conn, rc->bitcoind->rpc->addr, rpc_send_request, rc);
+}
+
+/* We connect from the io_loop, so any failure is reported from there too,
+ * not before rpc_start() returns. */
+static struct io_plan *rpc_conn_init(struct io_conn *conn, struct rpc_conn *rc)
+{
+	return io_always(conn, rpc_connect, rc);
+}
+
+static void rpc_conn_finished(struct io_conn *conn UNUSED, struct rpc_conn *rc)
+{
+	struct bitcoind *bitcoind = rc->bitcoind;
+	struct bitcoin_cli *bcli = rc->bcli;
+
+	/* Don't touch anything if we're being freed for shutdown */
+	if (bitcoind->shutdown)
+		return;
+
+	if (rc->idle)
+		list_del_from(&bitcoind->rpc->idle, &rc->list);
+
+	if (!bcli)
+		return;
+
+	/* bitcoind closes idle connections (-rpcservertimeout): if this one
+	 * went away before answering, simply try again on another. */
+	if (rc->reused && rc->len == 0) {
+		rc->bcli = NULL;
+		bitcoind->num_requests[bcli->prio]--;
+		list_add(&bitcoind->pending[bcli->prio], &bcli->list);
+		next_bcli(bitcoind, bcli->prio);
+		return;
+	}
+
+	rpc_finish_bcli(rc, 1,
+			tal_fmt(tmpctx, "error: talking to bitcoind at %s: %s",
+				bitcoind->rpc->hostport, strerror(errno)));
+}
+
+static void rpc_start(struct bitcoind *bitcoind, struct bitcoin_cli *bcli)
+{
+	struct rpc_conn *rc;
+	struct io_conn *conn;
+	int fd;
+
+	rc = list_pop(&bitcoind->rpc->idle, struct rpc_conn, list);
+	if (rc) {
+		rc->idle = false;
+		rc->bcli = bcli;
+		io_wake(rc);
+		return;
+	}
+
+	fd = socket(bitcoind->rpc->addr->ai_family, SOCK_STREAM, 0);
+	if (fd < 0)
+		fatal("Creating socket for bitcoind: %s", strerror(errno));
+
+	rc = tal(bitcoind, struct rpc_conn);
+	rc->idle = false;
+	rc->bitcoind = bitcoind;
+	rc->bcli = bcli;
+	rc->reused = false;
+	rc->request = NULL;
+	rc->buf = NULL;
+	rc->len = 0;
+
+	conn = io_new_conn(bitcoind, fd, rpc_conn_init, rc);
+	if (!conn)
+		fatal("Creating connection to bitcoind: %s", strerror(errno));
+	/* This lifetime is attached to bitcoind */
+	notleak(conn);
+	tal_steal(conn, rc);
+	io_set_finish(conn, rpc_conn_finished, rc);
+}
+
 static void next_bcli(struct bitcoind *bitcoind, enum bitcoind_prio prio)
 {
 	struct bitcoin_cli *bcli;
@@ -248,6 +658,13 @@ static void next_bcli(struct bitcoind *bitcoind, enum bitcoind_prio prio)
 	if (!bcli)
 		return;
 
+	if (bitcoind->rpc) {
+		bcli->start = time_now();
+		bitcoind->num_requests[prio]++;
+		rpc_start(bitcoind, bcli);
+		return;
+	}
+
 	bcli->pid = pipecmdarr(NULL, &bcli->fd, &bcli->fd,
 			       cast_const2(char **, bcli->args));
 	if (bcli->pid < 0)
@@ -783,47 +1200,155 @@ void bitcoind_gettxout(struct bitcoind *bitcoind,
 			  NULL);
 }
 
+/* How many gettxout checks a getfilteredblock call keeps queued: enough to
+ * keep all our low-priority requests busy. */
+#define FILTEREDBLOCK_PARALLEL_TXOUT BITCOIND_MAX_PARALLEL
+
+/* How many different heights we fetch at once. */
+#define FILTEREDBLOCK_PIPELINE 4
+
+/* How many recent results we keep around. */
+#define FILTEREDBLOCK_CACHE_SIZE 16
+
 /* Context for the getfilteredblock call. Wraps the actual arguments while we
  * process the various steps. */
 struct filteredblock_call {
 	struct list_node list;
+	struct bitcoind *bitcoind;
 	void (*cb)(struct bitcoind *bitcoind, const struct filteredblock *fb,
 		   void *arg);
 	void *arg;
 
 	struct filteredblock *result;
 	struct filteredblock_outpoint **outpoints;
-	size_t current_outpoint;
+	/* What gettxout said about each of outpoints. */
+	bool *unspent;
+	/* The next outpoint to check, and how many checks are running. */
+	size_t next_outpoint, num_checking;
 	struct timeabs start_time;
 	u32 height;
+
+	/* Are we fetching this height (for everyone waiting on it)? */
+	bool active;
+};
+
+/* A single gettxout check for a filteredblock_call. */
+struct filteredblock_txout {
+	struct filteredblock_call *call;
+	size_t idx;
+};
+
+/* Whether an output is unspent changes as blocks come in, so we only trust
+ * a cached result until we would have polled for a new block anyway. */
+struct filteredblock_cache {
+	struct filteredblock *fb;
+	struct timemono time;
 };
 
+static struct filteredblock *
+filteredblock_cache_find(struct bitcoind *bitcoind,
+			 const struct bitcoin_blkid *blkid)
+{
+	struct timerel maxage
+		= time_from_sec(bitcoind->ld->topology->poll_seconds);
+
+	for (size_t i = 0; i < tal_count(bitcoind->filteredblock_cache); i++) {
+		struct filteredblock_cache *c = &bitcoind->filteredblock_cache[i];
+		if (!bitcoin_blkid_eq(&c->fb->id, blkid))
+			continue;
+		if (time_greater(timemono_since(c->time), maxage))
+			return NULL;
+		return c->fb;
+	}
+	return NULL;
+}
+
+/* Takes ownership of fb. */
+static void filteredblock_cache_add(struct bitcoind *bitcoind,
+				    struct filteredblock *fb)
+{
+	struct filteredblock_cache c;
+	size_t n = tal_count(bitcoind->filteredblock_cache);
+
+	for (size_t i = 0; i < n; i++) {
+		if (bitcoind->filteredblock_cache[i].fb != fb
+		    && !bitcoin_blkid_eq(&bitcoind->filteredblock_cache[i].fb->id,
+					 &fb->id))
+			continue;
+		/* A cache hit: it's still as old as it was. */
+		if (bitcoind->filteredblock_cache[i].fb == fb)
+			return;
+		/* A fresh result replaces an expired one. */
+		tal_free(bitcoind->filteredblock_cache[i].fb);
+		bitcoind->filteredblock_cache[i].fb
+			= tal_steal(bitcoind->filteredblock_cache, fb);
+		bitcoind->filteredblock_cache[i].time = time_mono();
+		return;
+	}
+
+	if (n == FILTEREDBLOCK_CACHE_SIZE) {
+		tal_free(bitcoind->filteredblock_cache[0].fb);
+		memmove(bitcoind->filteredblock_cache,
+			bitcoind->filteredblock_cache + 1,
+			sizeof(bitcoind->filteredblock_cache[0]) * (n - 1));
+		tal_resize(&bitcoind->filteredblock_cache, n - 1);
+	}
+	c.fb = tal_steal(bitcoind->filteredblock_cache, fb);
+	c.time = time_mono();
+	tal_arr_expand(&bitcoind->filteredblock_cache, c);
+}
+
 /* Declaration for recursion in process_getfilteredblock_step1 */
 static void
 process_getfiltered_block_final(struct bitcoind *bitcoind,
-				const struct filteredblock_call *call);
+				struct filteredblock_call *call);
+
+static void filteredblock_check_txouts(struct bitcoind *bitcoind,
+				       struct filteredblock_call *call);
 
 static void
 process_getfilteredblock_step3(struct bitcoind *bitcoind,
 			       const struct bitcoin_tx_output *output,
 			       void *arg)
 {
-	struct filteredblock_call *call = (struct filteredblock_call *)arg;
-	struct filteredblock_outpoint *o = call->outpoints[call->current_outpoint];
+	struct filteredblock_txout *t = arg;
+	struct filteredblock_call *call = t->call;
 
-	/* If this output is unspent, add it to the filteredblock result. */
-	if (output)
-		tal_arr_expand(&call->result->outpoints, tal_steal(call->result, o));
+	call->unspent[t->idx] = (output != NULL);
+	tal_free(t);
+	call->num_checking--;
+	filteredblock_check_txouts(bitcoind, call);
+}
 
-	call->current_outpoint++;
-	if (call->current_outpoint < tal_count(call->outpoints)) {
-		o = call->outpoints[call->current_outpoint];
+/* Keep up to FILTEREDBLOCK_PARALLEL_TXOUT gettxout checks going at once. */
+static void filteredblock_check_txouts(struct bitcoind *bitcoind,
+				       struct filteredblock_call *call)
+{
+	while (call->num_checking < FILTEREDBLOCK_PARALLEL_TXOUT
+	       && call->next_outpoint < tal_count(call->outpoints)) {
+		struct filteredblock_txout *t;
+		struct filteredblock_outpoint *o;
+
+		t = tal(call, struct filteredblock_txout);
+		t->call = call;
+		t->idx = call->next_outpoint++;
+		o = call->outpoints[t->idx];
+		call->num_checking++;
 		bitcoind_gettxout(bitcoind, &o->txid, o->outnum,
-				  process_getfilteredblock_step3, call);
-	} else {
-		/* If there were no more outpoints to check, we call the callback. */
-		process_getfiltered_block_final(bitcoind, call);
+				  process_getfilteredblock_step3, t);
+	}
+
+	if (call->num_checking != 0)
+		return;
+
+	/* Add the unspent ones to the filteredblock result, in order. */
+	for (size_t i = 0; i < tal_count(call->outpoints); i++) {
+		if (call->unspent[i])
+			tal_arr_expand(&call->result->outpoints,
+				       tal_steal(call->result,
+						 call->outpoints[i]));
 	}
+	process_getfiltered_block_final(bitcoind, call);
 }
 
 static void process_getfilteredblock_step2(struct bitcoind *bitcoind,
@@ -833,11 +1358,6 @@ static void process_getfilteredblock_step2(struct bitcoind *bitcoind,
 	struct filteredblock_outpoint *o;
 	struct bitcoin_tx *tx;
 
-	/* If for some reason we couldn't get the block, just report a
-	 * failure. */
-	if (block == NULL)
-		return process_getfiltered_block_final(bitcoind, call);
-
 	call->result->prev_hash = block->hdr.prev_hash;
 
 	/* Allocate an array containing all the potentially interesting
@@ -864,30 +1384,44 @@ static void process_getfilteredblock_step2(struct bitcoind *bitcoind,
 		}
 	}
 
-	if (tal_count(call->outpoints) == 0) {
-		/* If there were no outpoints to check, we can short-circuit
-		 * and just call the callback. */
-		process_getfiltered_block_final(bitcoind, call);
-	} else {
+	/* Now check which are unspent; if there are none to check, this
+	 * goes straight to the callback. */
+	call->unspent = tal_arrz(call, bool, tal_count(call->outpoints));
+	filteredblock_check_txouts(bitcoind, call);
+}
 
-		/* Otherwise we start iterating through call->outpoints and
-		 * store the one's that are unspent in
-		 * call->result->outpoints. */
-		o = call->outpoints[call->current_outpoint];
-		bitcoind_gettxout(bitcoind, &o->txid, o->outnum,
-				  process_getfilteredblock_step3, call);
-	}
+static void process_getfilteredblock_step1(struct bitcoind *bitcoind,
+					   const struct bitcoin_blkid *blkid,
+					   struct filteredblock_call *call);
+
+static void retry_getfilteredblock(struct filteredblock_call *call)
+{
+	bitcoind_getblockhash(call->bitcoind, call->height,
+			      process_getfilteredblock_step1, call);
 }
 
 static void process_getfilteredblock_step1(struct bitcoind *bitcoind,
 					   const struct bitcoin_blkid *blkid,
 					   struct filteredblock_call *call)
 {
-	/* If we were unable to fetch the block hash (bitcoind doesn't know
-	 * about a block at that height), we can short-circuit and just call
-	 * the callback. */
-	if (!blkid)
-		return process_getfiltered_block_final(bitcoind, call);
+	struct filteredblock *fb;
+
+	/* If bitcoind doesn't know about a block at that height (yet), try
+	 * again later; meanwhile we get on with the other heights. */
+	if (!blkid) {
+		notleak(new_reltimer(bitcoind->ld->timers, call,
+				     time_from_sec(1),
+				     retry_getfilteredblock, call));
+		return;
+	}
+
+	/* Maybe we've just done this block. */
+	fb = filteredblock_cache_find(bitcoind, blkid);
+	if (fb) {
+		call->result = fb;
+		process_getfiltered_block_final(bitcoind, call);
+		return;
+	}
 
 	/* So we have the first piece of the puzzle, the block hash */
 	call->result = tal(call, struct filteredblock);
@@ -900,20 +1434,54 @@ static void process_getfilteredblock_step1(struct bitcoind *bitcoind,
 	bitcoind_getrawblock(bitcoind, blkid, process_getfilteredblock_step2, call);
 }
 
+/* Start fetching queued heights, up to FILTEREDBLOCK_PIPELINE at once. */
+static void start_getfilteredblocks(struct bitcoind *bitcoind)
+{
+	struct filteredblock_call *c, *a;
+	size_t num_active = 0;
+
+	list_for_each(&bitcoind->pending_getfilteredblock, c, list)
+		num_active += c->active;
+
+	list_for_each(&bitcoind->pending_getfilteredblock, c, list) {
+		bool fetching = false;
+
+		if (num_active == FILTEREDBLOCK_PIPELINE)
+			break;
+		if (c->active)
+			continue;
+
+		/* Is someone already fetching this height? */
+		list_for_each(&bitcoind->pending_getfilteredblock, a, list) {
+			if (a->active && a->height == c->height) {
+				fetching = true;
+				break;
+			}
+		}
+		if (fetching)
+			continue;
+
+		c->active = true;
+		num_active++;
+		bitcoind_getblockhash(bitcoind, c->height,
+				      process_getfilteredblock_step1, c);
+	}
+}
+
 /* Takes a call, dispatches it to all queued requests that match the same
  * height, and then kicks off the next call. */
 static void
 process_getfiltered_block_final(struct bitcoind *bitcoind,
-				const struct filteredblock_call *call)
+				struct filteredblock_call *call)
 {
 	struct filteredblock_call *c, *next;
 	u32 height = call->height;
+	struct filteredblock *fb = call->result;
 
-	if (call->result == NULL)
-		goto next;
+	/* Need to add it to the cache first, so we don't accidentally free it
+	 * while iterating through the list below. */
+	filteredblock_cache_add(bitcoind, fb);
 
-	/* Need to steal so we don't accidentally free it while iterating through the list below. */
-	struct filteredblock *fb = tal_steal(NULL, call->result);
 	list_for_each_safe(&bitcoind->pending_getfilteredblock, c, next, list) {
 		if (c->height == height) {
 			c->cb(bitcoind, fb, c->arg);
@@ -921,16 +1489,8 @@ process_getfiltered_block_final(struct bitcoind *bitcoind,
 			tal_free(c);
 		}
 	}
-	tal_free(fb);
-
-next:
-	/* Nothing to free here, since `*call` was already deleted during the
-	 * iteration above. It was also removed from the list, so no need to
-	 * pop here. */
-	if (!list_empty(&bitcoind->pending_getfilteredblock)) {
-		c = list_top(&bitcoind->pending_getfilteredblock, struct filteredblock_call, list);
-		bitcoind_getblockhash(bitcoind, c->height, process_getfilteredblock_step1, c);
-	}
+
+	start_getfilteredblocks(bitcoind);
 }
 
 void bitcoind_getfilteredblock_(struct bitcoind *bitcoind, u32 height,
@@ -942,19 +1502,18 @@ void bitcoind_getfilteredblock_(struct bitcoind *bitcoind, u32 height,
 	/* Stash the call context for when we need to call the callback after
 	 * all the bitcoind calls we need to perform. */
 	struct filteredblock_call *call = tal(bitcoind, struct filteredblock_call);
-	/* If this is the first request, we should start processing it. */
-	bool start = list_empty(&bitcoind->pending_getfilteredblock);
+	call->bitcoind = bitcoind;
 	call->cb = cb;
 	call->arg = arg;
 	call->height = height;
 	assert(call->cb != NULL);
 	call->start_time = time_now();
 	call->result = NULL;
-	call->current_outpoint = 0;
+	call->next_outpoint = call->num_checking = 0;
+	call->active = false;
 
 	list_add_tail(&bitcoind->pending_getfilteredblock, &call->list);
-	if (start)
-		bitcoind_getblockhash(bitcoind, height, process_getfilteredblock_step1, call);
+	start_getfilteredblocks(bitcoind);
 }
 
 static bool extract_numeric_version(struct bitcoin_cli *bcli,
@@ -1194,6 +1753,210 @@ static char* check_blockchain_from_bitcoincli(const tal_t *ctx,
 	return NULL;
 }
 
+/* bitcoind writes a cookie file for us if it doesn't have rpcpassword */
+static char *rpc_cookie(const tal_t *ctx, const struct bitcoind *bitcoind)
+{
+	const char *dir = bitcoind->datadir, *chain;
+	char *cookie;
+
+	if (!dir) {
+		const char *home = getenv("HOME");
+		if (!home)
+			return NULL;
+		dir = path_join(tmpctx, home, ".bitcoin");
+	}
+
+	/* Everything except mainnet lives in a subdirectory. */
+	chain = bitcoind->chainparams->bip70_name;
+	if (streq(chain, "test"))
+		dir = path_join(tmpctx, dir, "testnet3");
+	else if (!streq(chain, "main"))
+		dir = path_join(tmpctx, dir, chain);
+
+	cookie = grab_file(ctx, path_join(tmpctx, dir, ".cookie"));
+	if (!cookie)
+		return NULL;
+	cookie[strcspn(cookie, "\r\n")] = '\0';
+	return cookie;
+}
+
+/* Set up bitcoind->rpc, if we know where bitcoind is and how to log in. */
+static bool rpc_setup(struct bitcoind *bitcoind)
+{
+	struct bitcoind_rpc *rpc;
+	const char *host, *port, *userpass;
+	struct addrinfo hints, *ai;
+	int err;
+
+	if (bitcoind->rpcuser && bitcoind->rpcpass)
+		userpass = tal_fmt(tmpctx, "%s:%s",
+				   bitcoind->rpcuser, bitcoind->rpcpass);
+	else {
+		userpass = rpc_cookie(tmpctx, bitcoind);
+		if (!userpass)
+			return false;
+	}
+
+	host = bitcoind->rpcconnect ? bitcoind->rpcconnect : "127.0.0.1";
+	port = bitcoind->rpcport ? bitcoind->rpcport
+		: tal_fmt(tmpctx, "%i", bitcoind->chainparams->rpc_port);
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	err = getaddrinfo(host, port, &hints, &ai);
+	if (err != 0) {
+		log_debug(bitcoind->log, "Could not look up %s:%s: %s",
+			  host, port, gai_strerror(err));
+		return false;
+	}
+
+	rpc = tal(bitcoind, struct bitcoind_rpc);
+	rpc->addr = tal_dup(rpc, struct addrinfo, ai);
+	rpc->addr->ai_addr = (struct sockaddr *)tal_dup_arr(rpc->addr, u8,
+							    (u8 *)ai->ai_addr,
+							    ai->ai_addrlen, 0);
+	rpc->addr->ai_canonname = NULL;
+	rpc->addr->ai_next = NULL;
+	freeaddrinfo(ai);
+
+	rpc->hostport = tal_fmt(rpc, "%s:%s", host, port);
+	rpc->auth = base64(rpc, userpass);
+	list_head_init(&rpc->idle);
+	rpc->next_id = 0;
+	bitcoind->rpc = rpc;
+	return true;
+}
+
+/* How long we wait for bitcoind at startup before trying bitcoin-cli. */
+#define RPC_SYNC_TIMEOUT_SECS 10
+
+static const char *rpc_sync_strerror(int err)
+{
+	/* What a timeout looks like, with SO_SNDTIMEO/SO_RCVTIMEO */
+	if (err == EINPROGRESS || err == EAGAIN || err == EWOULDBLOCK)
+		return "timed out";
+	return strerror(err);
+}
+
+/* Blocking call, for startup.  Returns the exit status bitcoin-cli would
+ * have given, or -1 if we couldn't talk to bitcoind at all. */
+static int rpc_call_sync(const tal_t *ctx, struct bitcoind *bitcoind,
+			 const char **cmd, char **output)
+{
+	const struct addrinfo *addr = bitcoind->rpc->addr;
+	char *req = rpc_request(tmpctx, bitcoind->rpc, cmd);
+	char *buf = tal_arr(tmpctx, char, 4096);
+	size_t len = 0, hdrlen = 0, bodylen = 0;
+	struct timeval timeout = { RPC_SYNC_TIMEOUT_SECS, 0 };
+	bool keepalive;
+	int fd, ret = -1;
+
+	fd = socket(addr->ai_family, SOCK_STREAM, 0);
+	if (fd < 0) {
+		*output = tal_fmt(ctx, "socket: %s", strerror(errno));
+		return -1;
+	}
+
+	/* Don't hang startup on a bitcoind which isn't answering: on Linux,
+	 * SO_SNDTIMEO limits connect() too.  We fall back to bitcoin-cli. */
+	if (setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout))
+	    || setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO,
+			  &timeout, sizeof(timeout))) {
+		*output = tal_fmt(ctx, "setsockopt: %s", strerror(errno));
+		goto out;
+	}
+
+	if (connect(fd, addr->ai_addr, addr->ai_addrlen) != 0
+	    || !write_all(fd, req, strlen(req))) {
+		*output = tal_strdup(ctx, rpc_sync_strerror(errno));
+		goto out;
+	}
+
+	while (!hdrlen || len < hdrlen + bodylen) {
+		ssize_t r;
+
+		if (!hdrlen
+		    && !http_parse_headers(buf, len, &hdrlen, &bodylen,
+					   &keepalive)) {
+			*output = tal_fmt(ctx, "bad HTTP reply '%.*s'",
+					  (int)len, buf);
+			goto out;
+		}
+		if (hdrlen && len >= hdrlen + bodylen)
+			break;
+
+		if (len == tal_count(buf))
+			tal_resize(&buf, len * 2);
+		r = read(fd, buf + len, tal_count(buf) - len);
+		if (r <= 0) {
+			*output = tal_strdup(ctx, r == 0 ? "connection closed"
+					     : rpc_sync_strerror(errno));
+			goto out;
+		}
+		len += r;
+	}
+
+	ret = rpc_reply_to_cli(ctx, buf + hdrlen, bodylen, output);
+
+out:
+	close_noerr(fd);
+	return ret;
+}
+
+/* Returns false if we should use bitcoin-cli instead. */
+static bool wait_for_bitcoind_rpc(struct bitcoind *bitcoind)
+{
+	const char **cmd = cmdarr(tmpctx, bitcoind, "getblockchaininfo", NULL);
+	bool printed = false;
+	char *output, *errstr;
+	int status;
+
+	/* If they specified bitcoin-cli, they probably want it used. */
+	if (bitcoind->use_cli || bitcoind->cli || !rpc_setup(bitcoind))
+		return false;
+
+	for (;;) {
+		status = rpc_call_sync(tmpctx, bitcoind, bcli_cmd(cmd), &output);
+		if (status < 0) {
+			log_info(bitcoind->log,
+				 "Could not talk to bitcoind at %s (%s):"
+				 " using %s",
+				 bitcoind->rpc->hostport, output,
+				 bitcoind->chainparams->cli);
+			bitcoind->rpc = tal_free(bitcoind->rpc);
+			return false;
+		}
+
+		if (status == 0) {
+			errstr = check_blockchain_from_bitcoincli(tmpctx,
+								  bitcoind,
+								  output, cmd);
+			if (errstr)
+				fatal("%s", errstr);
+			break;
+		}
+
+		/* bitcoin/src/rpc/protocol.h:
+		 *	RPC_IN_WARMUP = -28, //!< Client still warming up
+		 */
+		if (status != 28)
+			fatal("bitcoind at %s: getblockchaininfo gave %s",
+			      bitcoind->rpc->hostport, output);
+
+		if (!printed) {
+			log_unusual(bitcoind->log,
+				    "Waiting for bitcoind to warm up...");
+			printed = true;
+		}
+		sleep(1);
+	}
+
+	log_debug(bitcoind->log, "Talking to bitcoind at %s directly",
+		  bitcoind->rpc->hostport);
+	return true;
+}
+
 void wait_for_bitcoind(struct bitcoind *bitcoind)
 {
 	int from, status, ret;
@@ -1202,6 +1965,11 @@ void wait_for_bitcoind(struct bitcoind *bitcoind)
 	bool printed = false;
 	char *errstr;
 
+	if (wait_for_bitcoind_rpc(bitcoind)) {
+		tal_free(cmd);
+		return;
+	}
+
 	for (;;) {
 		child = pipecmdarr(NULL, &from, &from, cast_const2(char **,cmd));
 		if (child < 0) {
@@ -1267,6 +2035,8 @@ struct bitcoind *new_bitcoind(const tal_t *ctx,
 		list_head_init(&bitcoind->pending[i]);
 	}
 	list_head_init(&bitcoind->pending_getfilteredblock);
+	bitcoind->filteredblock_cache
+		= tal_arr(bitcoind, struct filteredblock_cache, 0);
 	bitcoind->shutdown = false;
 	bitcoind->error_count = 0;
 	bitcoind->retry_timeout = 60;
@@ -1274,6 +2044,8 @@ struct bitcoind *new_bitcoind(const tal_t *ctx,
 	bitcoind->rpcpass = NULL;
 	bitcoind->rpcconnect = NULL;
 	bitcoind->rpcport = NULL;
+	bitcoind->use_cli = false;
+	bitcoind->rpc = NULL;
 	tal_add_destructor(bitcoind, destroy_bitcoind);
 
 	return bitcoind;
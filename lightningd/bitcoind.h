@@ -69,7 +69,16 @@ struct bitcoind {
 	/* Passthrough parameters for bitcoin-cli */
 	char *rpcuser, *rpcpass, *rpcconnect, *rpcport;
 
+	/* Never talk JSON-RPC to bitcoind directly, always use bitcoin-cli */
+	bool use_cli;
+
+	/* If non-NULL, we send requests over HTTP instead of bitcoin-cli. */
+	struct bitcoind_rpc *rpc;
+
 	struct list_head pending_getfilteredblock;
+
+	/* Recent getfilteredblock results, oldest first. */
+	struct filteredblock_cache *filteredblock_cache;
 };
 
 /* A single outpoint in a filtered block */
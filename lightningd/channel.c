@@ -100,6 +100,9 @@ static void destroy_channel(struct channel *channel)
 	/* Free any old owner still hanging around. */
 	channel_set_owner(channel, NULL);
 
+	if (channel->scid)
+		channel_scid_map_del(channel->peer->ld->channels_by_scid,
+				     channel);
 	list_del_from(&channel->peer->channels, &channel->list);
 }
 
@@ -250,6 +253,8 @@ struct channel *new_channel(struct peer *peer, u64 dbid,
 		= tal_steal(channel, remote_upfront_shutdown_script);
 
 	list_add_tail(&peer->channels, &channel->list);
+	if (channel->scid)
+		channel_scid_map_add(peer->ld->channels_by_scid, channel);
 	tal_add_destructor(channel, destroy_channel);
 
 	/* Make sure we see any spends using this key */
@@ -324,6 +329,25 @@ struct channel *channel_by_dbid(struct lightningd *ld, const u64 dbid)
 	return NULL;
 }
 
+struct channel *channel_by_scid(struct lightningd *ld,
+				const struct short_channel_id *scid)
+{
+	return channel_scid_map_get(ld->channels_by_scid, scid);
+}
+
+void channel_set_scid(struct channel *channel,
+		      const struct short_channel_id *scid)
+{
+	struct channel_scid_map *map = channel->peer->ld->channels_by_scid;
+
+	if (channel->scid)
+		channel_scid_map_del(map, channel);
+	else
+		channel->scid = tal(channel, struct short_channel_id);
+	*channel->scid = *scid;
+	channel_scid_map_add(map, channel);
+}
+
 void channel_set_last_tx(struct channel *channel,
 			 struct bitcoin_tx *tx,
 			 const struct bitcoin_signature *sig,
@@ -1,6 +1,7 @@
 #ifndef LIGHTNING_LIGHTNINGD_CHANNEL_H
 #define LIGHTNING_LIGHTNINGD_CHANNEL_H
 #include "config.h"
+#include <ccan/htable/htable_type.h>
 #include <ccan/list/list.h>
 #include <lightningd/channel_state.h>
 #include <lightningd/peer_htlcs.h>
@@ -62,7 +63,8 @@ struct channel {
 	struct amount_sat funding;
 	struct amount_msat push;
 	bool remote_funding_locked;
-	/* Channel if locked locally. */
+	/* Channel if locked locally (in ld->channels_by_scid).  Use
+	 * channel_set_scid() to change it. */
 	struct short_channel_id *scid;
 
 	/* Amount going to us, not counting unfinished HTLCs; if we have one. */
@@ -203,6 +205,14 @@ struct channel *active_channel_by_id(struct lightningd *ld,
 
 struct channel *channel_by_dbid(struct lightningd *ld, const u64 dbid);
 
+/* Find a channel (active or not) by its short_channel_id, if any. */
+struct channel *channel_by_scid(struct lightningd *ld,
+				const struct short_channel_id *scid);
+
+/* Set (or, after a reorg, change) channel->scid, updating the index. */
+void channel_set_scid(struct channel *channel,
+		      const struct short_channel_id *scid);
+
 void channel_set_last_tx(struct channel *channel,
 			 struct bitcoin_tx *tx,
 			 const struct bitcoin_signature *sig,
@@ -248,4 +258,25 @@ void channel_set_billboard(struct channel *channel, bool perm,
 struct htlc_in *channel_has_htlc_in(struct channel *channel);
 struct htlc_out *channel_has_htlc_out(struct channel *channel);
 
+static inline const struct short_channel_id *
+channel_scid_keyof(const struct channel *channel)
+{
+	return channel->scid;
+}
+
+static inline size_t channel_scid_hash(const struct short_channel_id *scid)
+{
+	/* scids cost money to generate, so simple hash works here */
+	return (scid->u64 >> 32) ^ (scid->u64 >> 16) ^ scid->u64;
+}
+
+static inline bool channel_scid_eq(const struct channel *channel,
+				   const struct short_channel_id *scid)
+{
+	return short_channel_id_eq(channel->scid, scid);
+}
+
+HTABLE_DEFINE_TYPE(struct channel, channel_scid_keyof, channel_scid_hash,
+		   channel_scid_eq, channel_scid_map);
+
 #endif /* LIGHTNING_LIGHTNINGD_CHANNEL_H */
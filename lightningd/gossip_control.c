@@ -136,6 +136,7 @@ static unsigned gossip_msg(struct subd *gossip, const u8 *msg, const int *fds)
 	case WIRE_GOSSIPCTL_INIT:
 	case WIRE_GOSSIP_GETNODES_REQUEST:
 	case WIRE_GOSSIP_GETROUTE_REQUEST:
+	case WIRE_GOSSIP_GETROUTES_REQUEST:
 	case WIRE_GOSSIP_GETCHANNELS_REQUEST:
 	case WIRE_GOSSIP_PING:
 	case WIRE_GOSSIP_GET_CHANNEL_PEER:
@@ -151,9 +152,11 @@ static unsigned gossip_msg(struct subd *gossip, const u8 *msg, const int *fds)
 	case WIRE_GOSSIP_LOCAL_CHANNEL_CLOSE:
 	case WIRE_GOSSIP_DEV_MEMLEAK:
 	case WIRE_GOSSIP_DEV_COMPACT_STORE:
+	case WIRE_GOSSIP_DEV_ROUTE_CACHE:
 	/* This is a reply, so never gets through to here. */
 	case WIRE_GOSSIP_GETNODES_REPLY:
 	case WIRE_GOSSIP_GETROUTE_REPLY:
+	case WIRE_GOSSIP_GETROUTES_REPLY:
 	case WIRE_GOSSIP_GETCHANNELS_REPLY:
 	case WIRE_GOSSIP_SCIDS_REPLY:
 	case WIRE_GOSSIP_QUERY_CHANNEL_RANGE_REPLY:
@@ -161,6 +164,7 @@ static unsigned gossip_msg(struct subd *gossip, const u8 *msg, const int *fds)
 	case WIRE_GOSSIP_GET_INCOMING_CHANNELS_REPLY:
 	case WIRE_GOSSIP_DEV_MEMLEAK_REPLY:
 	case WIRE_GOSSIP_DEV_COMPACT_STORE_REPLY:
+	case WIRE_GOSSIP_DEV_ROUTE_CACHE_REPLY:
 		break;
 
 	case WIRE_GOSSIP_PING_REPLY:
@@ -305,6 +309,37 @@ static void json_getroute_reply(struct subd *gossip UNUSED, const u8 *reply, con
 	was_pending(command_success(cmd, response));
 }
 
+/* Converts an array of short-channel-id/direction */
+static struct command_result *json_to_excluded(struct command *cmd,
+					       const char *buffer,
+					       const jsmntok_t *excludetok,
+					       struct short_channel_id_dir **excluded)
+{
+	const jsmntok_t *t;
+	size_t i;
+
+	if (!excludetok) {
+		*excluded = NULL;
+		return NULL;
+	}
+
+	*excluded = tal_arr(cmd, struct short_channel_id_dir,
+			    excludetok->size);
+
+	json_for_each_arr(i, t, excludetok) {
+		if (!short_channel_id_dir_from_str(buffer + t->start,
+						   t->end - t->start,
+						   &(*excluded)[i])) {
+			return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
+					    "%.*s is not a valid"
+					    " short_channel_id/direction",
+					    t->end - t->start,
+					    buffer + t->start);
+		}
+	}
+	return NULL;
+}
+
 static struct command_result *json_getroute(struct command *cmd,
 					    const char *buffer,
 					    const jsmntok_t *obj UNNEEDED,
@@ -319,6 +354,7 @@ static struct command_result *json_getroute(struct command *cmd,
 	double *riskfactor;
 	struct short_channel_id_dir *excluded;
 	u32 *max_hops;
+	struct command_result *ret;
 
 	/* Higher fuzz means that some high-fee paths can be discounted
 	 * for an even larger value, increasing the scope for route
@@ -343,27 +379,9 @@ static struct command_result *json_getroute(struct command *cmd,
 	/* Convert from percentage */
 	*fuzz = *fuzz / 100.0;
 
-	if (excludetok) {
-		const jsmntok_t *t;
-		size_t i;
-
-		excluded = tal_arr(cmd, struct short_channel_id_dir,
-				   excludetok->size);
-
-		json_for_each_arr(i, t, excludetok) {
-			if (!short_channel_id_dir_from_str(buffer + t->start,
-							   t->end - t->start,
-							   &excluded[i])) {
-				return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
-						    "%.*s is not a valid"
-						    " short_channel_id/direction",
-						    t->end - t->start,
-						    buffer + t->start);
-			}
-		}
-	} else {
-		excluded = NULL;
-	}
+	ret = json_to_excluded(cmd, buffer, excludetok, &excluded);
+	if (ret)
+		return ret;
 
 	u8 *req = towire_gossip_getroute_request(cmd, source, destination,
 						 *msat,
@@ -388,6 +406,148 @@ static const struct json_command getroute_command = {
 };
 AUTODATA(json_command, &getroute_command);
 
+struct getroutes_info {
+	struct command *cmd;
+	struct node_id *destinations;
+	struct amount_msat *msats;
+};
+
+static void json_getroutes_reply(struct subd *gossip UNUSED, const u8 *reply,
+				 const int *fds UNUSED,
+				 struct getroutes_info *gri)
+{
+	struct command *cmd = gri->cmd;
+	struct json_stream *response;
+	struct route_hop *hops;
+	u16 *route_lens;
+	size_t off, num_routes;
+
+	if (!fromwire_gossip_getroutes_reply(reply, reply, &route_lens, &hops)
+	    || tal_count(route_lens) != tal_count(gri->destinations)) {
+		was_pending(command_fail(cmd, LIGHTNINGD,
+					 "Malformed gossipd reply %s",
+					 tal_hex(tmpctx, reply)));
+		return;
+	}
+
+	num_routes = 0;
+	for (size_t i = 0; i < tal_count(route_lens); i++)
+		num_routes += (route_lens[i] != 0);
+
+	if (num_routes == 0) {
+		was_pending(command_fail(cmd, PAY_ROUTE_NOT_FOUND,
+					 "Could not find a route"));
+		return;
+	}
+
+	response = json_stream_success(cmd);
+	json_array_start(response, "routes");
+	off = 0;
+	for (size_t i = 0; i < tal_count(route_lens); i++) {
+		if (!route_lens[i])
+			continue;
+		json_object_start(response, NULL);
+		json_add_node_id(response, "id", &gri->destinations[i]);
+		json_add_amount_msat_compat(response, gri->msats[i],
+					    "msatoshi", "amount_msat");
+		json_add_route(response, "route", hops + off, route_lens[i]);
+		json_object_end(response);
+		off += route_lens[i];
+	}
+	json_array_end(response);
+	was_pending(command_success(cmd, response));
+}
+
+static struct command_result *json_getroutes(struct command *cmd,
+					     const char *buffer,
+					     const jsmntok_t *obj UNNEEDED,
+					     const jsmntok_t *params)
+{
+	struct lightningd *ld = cmd->ld;
+	struct node_id *source;
+	const jsmntok_t *destinationstok, *excludetok, *t;
+	unsigned *cltv;
+	double *riskfactor, *fuzz;
+	struct short_channel_id_dir *excluded;
+	u32 *max_hops;
+	struct getroutes_info *gri;
+	struct command_result *ret;
+	size_t i;
+	u8 *req;
+
+	if (!param(cmd, buffer, params,
+		   p_req("destinations", param_array, &destinationstok),
+		   p_req("riskfactor", param_double, &riskfactor),
+		   p_opt_def("cltv", param_number, &cltv, 9),
+		   p_opt("fromid", param_node_id, &source),
+		   p_opt_def("fuzzpercent", param_percent, &fuzz, 5.0),
+		   p_opt("exclude", param_array, &excludetok),
+		   p_opt_def("maxhops", param_number, &max_hops,
+			     ROUTING_MAX_HOPS),
+		   NULL))
+		return command_param_failed();
+
+	/* Convert from percentage */
+	*fuzz = *fuzz / 100.0;
+
+	if (destinationstok->size > UINT16_MAX)
+		return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
+				    "Too many destinations (max %u)",
+				    UINT16_MAX);
+
+	gri = tal(cmd, struct getroutes_info);
+	gri->cmd = cmd;
+	gri->destinations = tal_arr(gri, struct node_id,
+				    destinationstok->size);
+	gri->msats = tal_arr(gri, struct amount_msat, destinationstok->size);
+	json_for_each_arr(i, t, destinationstok) {
+		const jsmntok_t *idtok, *msattok;
+
+		idtok = json_get_member(buffer, t, "id");
+		msattok = json_get_member(buffer, t, "msatoshi");
+		if (!idtok || !msattok)
+			return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
+					    "%.*s needs an 'id' and"
+					    " 'msatoshi'",
+					    json_tok_full_len(t),
+					    json_tok_full(buffer, t));
+		if (!json_to_node_id(buffer, idtok, &gri->destinations[i]))
+			return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
+					    "%.*s is not a valid node id",
+					    json_tok_full_len(idtok),
+					    json_tok_full(buffer, idtok));
+		if (!json_to_msat(buffer, msattok, &gri->msats[i]))
+			return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
+					    "%.*s is not a valid msatoshi",
+					    json_tok_full_len(msattok),
+					    json_tok_full(buffer, msattok));
+	}
+
+	ret = json_to_excluded(cmd, buffer, excludetok, &excluded);
+	if (ret)
+		return ret;
+
+	req = towire_gossip_getroutes_request(cmd, source, gri->destinations,
+					      gri->msats,
+					      *riskfactor * 1000000.0,
+					      *cltv, fuzz,
+					      excluded,
+					      *max_hops);
+	subd_req(ld->gossip, ld->gossip, req, -1, 0, json_getroutes_reply, gri);
+	return command_still_pending(cmd);
+}
+
+static const struct json_command getroutes_command = {
+	"getroutes",
+	"channels",
+	json_getroutes,
+	"Show routes to each of {destinations} (an array of {id}, {msatoshi}), "
+	"using {riskfactor} and optional {cltv} (default 9), sharing a single "
+	"search from {fromid} (default: us).  Takes the same {fuzzpercent}, "
+	"{exclude} and {maxhops} as getroute."
+};
+AUTODATA(json_command, &getroutes_command);
+
 static void json_add_halfchan(struct json_stream *response,
 			      const struct gossip_getchannels_entry *e,
 			      int idx)
@@ -762,4 +922,50 @@ static const struct json_command dev_compact_gossip_store = {
 	"Ask gossipd to rewrite the gossip store."
 };
 AUTODATA(json_command, &dev_compact_gossip_store);
+
+static void dev_route_cache_reply(struct subd *gossip UNUSED,
+				  const u8 *reply,
+				  const int *fds UNUSED,
+				  struct command *cmd)
+{
+	u32 entries;
+	u64 hits, misses, invalidated;
+	struct json_stream *response;
+
+	if (!fromwire_gossip_dev_route_cache_reply(reply, &entries, &hits,
+						   &misses, &invalidated)) {
+		was_pending(command_fail(cmd, LIGHTNINGD,
+					 "Gossip gave bad dev_route_cache_reply"));
+		return;
+	}
+
+	response = json_stream_success(cmd);
+	json_add_num(response, "entries", entries);
+	json_add_u64(response, "hits", hits);
+	json_add_u64(response, "misses", misses);
+	json_add_u64(response, "invalidated", invalidated);
+	was_pending(command_success(cmd, response));
+}
+
+static struct command_result *json_dev_route_cache(struct command *cmd,
+						   const char *buffer,
+						   const jsmntok_t *obj UNNEEDED,
+						   const jsmntok_t *params)
+{
+	if (!param(cmd, buffer, params, NULL))
+		return command_param_failed();
+
+	subd_req(cmd->ld->gossip, cmd->ld->gossip,
+		 take(towire_gossip_dev_route_cache(NULL)), -1, 0,
+		 dev_route_cache_reply, cmd);
+	return command_still_pending(cmd);
+}
+
+static const struct json_command dev_route_cache = {
+	"dev-route-cache",
+	"developer",
+	json_dev_route_cache,
+	"Show how often getroute found its answer in gossipd's route cache."
+};
+AUTODATA(json_command, &dev_route_cache);
 #endif /* DEVELOPER */
@@ -28,15 +28,53 @@ struct htlc_in *find_htlc_in(const struct htlc_in_map *map,
 	return htlc_in_map_get(map, &key);
 }
 
+void htlc_expiries_init(struct htlc_expiries *expiries)
+{
+	uintmap_init(&expiries->in);
+	uintmap_init(&expiries->out);
+	expiries->seq = 0;
+}
+
+void htlc_expiries_clear(struct htlc_expiries *expiries)
+{
+	uintmap_clear(&expiries->in);
+	uintmap_clear(&expiries->out);
+}
+
+void htlc_in_expiry_remove(struct htlc_in *hin)
+{
+	if (!hin->expiries)
+		return;
+	uintmap_del(&hin->expiries->in, hin->expiry_index);
+	hin->expiries = NULL;
+}
+
+void htlc_out_expiry_remove(struct htlc_out *hout)
+{
+	if (!hout->expiries)
+		return;
+	uintmap_del(&hout->expiries->out, hout->expiry_index);
+	hout->expiries = NULL;
+}
+
 static void destroy_htlc_in(struct htlc_in *hend, struct htlc_in_map *map)
 {
 	htlc_in_map_del(map, hend);
+	htlc_in_expiry_remove(hend);
 }
 
-void connect_htlc_in(struct htlc_in_map *map, struct htlc_in *hend)
+void connect_htlc_in(struct htlc_in_map *map, struct htlc_expiries *expiries,
+		     struct htlc_in *hend)
 {
 	tal_add_destructor2(hend, destroy_htlc_in, map);
 	htlc_in_map_add(map, hend);
+
+	/* Sequence numbers wrap, so skip any still in use. */
+	hend->expiries = expiries;
+	do {
+		hend->expiry_index = ((u64)hend->cltv_expiry << 32)
+			| expiries->seq++;
+	} while (!uintmap_add(&expiries->in, hend->expiry_index, hend));
 }
 
 struct htlc_out *find_htlc_out(const struct htlc_out_map *map,
@@ -50,12 +88,21 @@ struct htlc_out *find_htlc_out(const struct htlc_out_map *map,
 static void destroy_htlc_out(struct htlc_out *hend, struct htlc_out_map *map)
 {
 	htlc_out_map_del(map, hend);
+	htlc_out_expiry_remove(hend);
 }
 
-void connect_htlc_out(struct htlc_out_map *map, struct htlc_out *hend)
+void connect_htlc_out(struct htlc_out_map *map, struct htlc_expiries *expiries,
+		      struct htlc_out *hend)
 {
 	tal_add_destructor2(hend, destroy_htlc_out, map);
 	htlc_out_map_add(map, hend);
+
+	/* Sequence numbers wrap, so skip any still in use. */
+	hend->expiries = expiries;
+	do {
+		hend->expiry_index = ((u64)hend->cltv_expiry << 32)
+			| expiries->seq++;
+	} while (!uintmap_add(&expiries->out, hend->expiry_index, hend));
 }
 
 static void *PRINTF_FMT(2,3)
@@ -135,6 +182,7 @@ struct htlc_in *new_htlc_in(const tal_t *ctx,
 	hin->preimage = NULL;
 
 	hin->received_time = time_now();
+	hin->expiries = NULL;
 
 	return htlc_in_check(hin, "new_htlc_in");
 }
@@ -272,6 +320,7 @@ struct htlc_out *new_htlc_out(const tal_t *ctx,
 
 	hout->am_origin = am_origin;
 	hout->in = NULL;
+	hout->expiries = NULL;
 	if (in)
 		htlc_out_connect_htlc_in(hout, in);
 
@@ -2,6 +2,7 @@
 #define LIGHTNING_LIGHTNINGD_HTLC_END_H
 #include "config.h"
 #include <ccan/htable/htable_type.h>
+#include <ccan/intmap/intmap.h>
 #include <ccan/short_types/short_types.h>
 #include <ccan/time/time.h>
 #include <common/amount.h>
@@ -51,6 +52,10 @@ struct htlc_in {
 	/* Remember the timestamp we received this HTLC so we can later record
 	 * it, and the resolution time, in the forwards table. */
         struct timeabs received_time;
+
+	/* Where we are in htlc_expiries (NULL if we're not). */
+	struct htlc_expiries *expiries;
+	u64 expiry_index;
 };
 
 struct htlc_out {
@@ -84,6 +89,19 @@ struct htlc_out {
 
 	/* Where it's from, if not going to us. */
 	struct htlc_in *in;
+
+	/* Where we are in htlc_expiries (NULL if we're not). */
+	struct htlc_expiries *expiries;
+	u64 expiry_index;
+};
+
+/* HTLCs ordered by cltv_expiry, so we only have to look at the ones near
+ * their deadline each block.  The index is the cltv_expiry in the upper 32
+ * bits, and a sequence number to make it unique in the lower. */
+struct htlc_expiries {
+	UINTMAP(struct htlc_in *) in;
+	UINTMAP(struct htlc_out *) out;
+	u32 seq;
 };
 
 static inline const struct htlc_key *keyof_htlc_in(const struct htlc_in *in)
@@ -142,8 +160,17 @@ struct htlc_out *new_htlc_out(const tal_t *ctx,
 			      bool am_origin,
 			      struct htlc_in *in);
 
-void connect_htlc_in(struct htlc_in_map *map, struct htlc_in *hin);
-void connect_htlc_out(struct htlc_out_map *map, struct htlc_out *hout);
+void connect_htlc_in(struct htlc_in_map *map, struct htlc_expiries *expiries,
+		     struct htlc_in *hin);
+void connect_htlc_out(struct htlc_out_map *map, struct htlc_expiries *expiries,
+		      struct htlc_out *hout);
+
+void htlc_expiries_init(struct htlc_expiries *expiries);
+void htlc_expiries_clear(struct htlc_expiries *expiries);
+
+/* Once its deadline no longer matters, we can stop looking at it. */
+void htlc_in_expiry_remove(struct htlc_in *hin);
+void htlc_out_expiry_remove(struct htlc_out *hout);
 
 /* Set up hout->in to be hin (non-NULL), and clear if hin freed. */
 void htlc_out_connect_htlc_in(struct htlc_out *hout, struct htlc_in *hin);
@@ -83,6 +83,10 @@ struct json_connection {
 	/* The buffer (required to interpret tokens). */
 	char *buffer;
 
+	/* How far we've parsed the current request in buffer. */
+	jsmn_parser parser;
+	jsmntok_t *toks;
+
 	/* Internal state: */
 	/* How much is already filled. */
 	size_t used;
@@ -706,8 +710,7 @@ static struct io_plan *stream_out_complete(struct io_conn *conn,
 static struct io_plan *read_json(struct io_conn *conn,
 				 struct json_connection *jcon)
 {
-	jsmntok_t *toks;
-	bool valid;
+	bool complete;
 
 	if (jcon->len_read)
 		log_io(jcon->log, LOG_IO_IN, "",
@@ -724,46 +727,40 @@ static struct io_plan *read_json(struct io_conn *conn,
 		return io_wait(conn, conn, read_json, jcon);
 	}
 
-	toks = json_parse_input(jcon->buffer, jcon->buffer, jcon->used, &valid);
-	if (!toks) {
-		if (!valid) {
-			log_unusual(jcon->log,
-				    "Invalid token in json input: '%.*s'",
-				    (int)jcon->used, jcon->buffer);
-			json_command_malformed(
-			    jcon, "null",
-			    "Invalid token in json input");
-			return io_halfclose(conn);
-		}
-		/* We need more. */
-		goto read_more;
+	if (!json_parse_input_incr(&jcon->parser, &jcon->toks,
+				   jcon->buffer, jcon->used, &complete)) {
+		log_unusual(jcon->log,
+			    "Invalid token in json input: '%.*s'",
+			    (int)jcon->used, jcon->buffer);
+		json_command_malformed(
+		    jcon, "null",
+		    "Invalid token in json input");
+		return io_halfclose(conn);
 	}
 
-	/* Empty buffer? (eg. just whitespace). */
-	if (tal_count(toks) == 1) {
-		jcon->used = 0;
+	/* We need more. */
+	if (!complete)
 		goto read_more;
-	}
 
-	parse_request(jcon, toks);
+	parse_request(jcon, jcon->toks);
 
-	/* Remove first {}. */
-	memmove(jcon->buffer, jcon->buffer + toks[0].end,
-		tal_count(jcon->buffer) - toks[0].end);
-	jcon->used -= toks[0].end;
+	/* Remove first {}, and start parsing afresh. */
+	memmove(jcon->buffer, jcon->buffer + jcon->toks[0].end,
+		tal_count(jcon->buffer) - jcon->toks[0].end);
+	jcon->used -= jcon->toks[0].end;
+	jsmn_init(&jcon->parser);
+	toks_reset(jcon->toks);
 
 	/* If we have more to process, try again.  FIXME: this still gets
 	 * first priority in io_loop, so can starve others.  Hack would be
 	 * a (non-zero) timer, but better would be to have io_loop avoid
 	 * such livelock */
 	if (jcon->used) {
-		tal_free(toks);
 		jcon->len_read = 0;
 		return io_always(conn, read_json, jcon);
 	}
 
 read_more:
-	tal_free(toks);
 	return io_read_partial(conn, jcon->buffer + jcon->used,
 			       tal_count(jcon->buffer) - jcon->used,
 			       &jcon->len_read, read_json, jcon);
@@ -780,6 +777,8 @@ static struct io_plan *jcon_connected(struct io_conn *conn,
 	jcon->ld = ld;
 	jcon->used = 0;
 	jcon->buffer = tal_arr(jcon, char, 64);
+	jsmn_init(&jcon->parser);
+	jcon->toks = toks_alloc(jcon);
 	jcon->js_arr = tal_arr(jcon, struct json_stream *, 0);
 	jcon->len_read = 0;
 	list_head_init(&jcon->commands);
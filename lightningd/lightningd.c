@@ -74,6 +74,7 @@
 #include <lightningd/log.h>
 #include <lightningd/onchain_control.h>
 #include <lightningd/options.h>
+#include <lightningd/plugin_hook.h>
 #include <onchaind/onchain_wire.h>
 #include <signal.h>
 #include <sys/stat.h>
@@ -140,6 +141,17 @@ static struct lightningd *new_lightningd(const tal_t *ctx)
 	 * allocations to put things into a list. */
 	list_head_init(&ld->peers);
 
+	/*~ Looking up a peer by node_id happens for every forwarded HTLC,
+	 * so we keep hash tables next to the list, as well as one to find
+	 * channels by short_channel_id.  These are updated by new_peer,
+	 * peer_set_dbid, new_channel, channel_set_scid and the destructors. */
+	ld->peers_by_id = tal(ld, struct peer_id_map);
+	peer_id_map_init(ld->peers_by_id);
+	ld->peers_by_dbid = tal(ld, struct peer_dbid_map);
+	peer_dbid_map_init(ld->peers_by_dbid);
+	ld->channels_by_scid = tal(ld, struct channel_scid_map);
+	channel_scid_map_init(ld->channels_by_scid);
+
 	/*~ These are hash tables of incoming and outgoing HTLCs (contracts),
 	 * defined as `struct htlc_in` and `struct htlc_out`in htlc_end.h.
 	 * The hash tables are declared there using the very ugly
@@ -154,6 +166,7 @@ static struct lightningd *new_lightningd(const tal_t *ctx)
 	 * I was in a premature optimization mood when I wrote this: */
 	htlc_in_map_init(&ld->htlcs_in);
 	htlc_out_map_init(&ld->htlcs_out);
+	htlc_expiries_init(&ld->htlc_expiries);
 
 	/*~ We have a two-level log-book infrastructure: we define a 20MB log
 	 * book to hold all the entries (and trims as necessary), and multiple
@@ -227,6 +240,7 @@ static struct lightningd *new_lightningd(const tal_t *ctx)
 	 */
 	ld->plugins = plugins_new(ld, ld->log_book, ld);
 	ld->plugins->startup = true;
+	ld->db_write_batch = false;
 
 	/*~ This is set when a JSON RPC command comes in to shut us down. */
 	ld->stop_conn = NULL;
@@ -846,6 +860,9 @@ int main(int argc, char *argv[])
 
 	shutdown_subdaemons(ld);
 
+	/* Make sure the db_write plugin has everything before it goes. */
+	plugin_hook_db_sync_flush();
+
 	/* Remove plugins. */
 	ld->plugins = tal_free(ld->plugins);
 
@@ -860,6 +877,10 @@ int main(int argc, char *argv[])
 	/* Clean our our HTLC maps, since they use malloc. */
 	htlc_in_map_clear(&ld->htlcs_in);
 	htlc_out_map_clear(&ld->htlcs_out);
+	htlc_expiries_clear(&ld->htlc_expiries);
+	peer_id_map_clear(ld->peers_by_id);
+	peer_dbid_map_clear(ld->peers_by_dbid);
+	channel_scid_map_clear(ld->channels_by_scid);
 
 	remove(ld->pidfile);
 
@@ -151,6 +151,11 @@ struct lightningd {
 
 	/* All peers we're tracking. */
 	struct list_head peers;
+	/* ... indexed by node_id and database id. */
+	struct peer_id_map *peers_by_id;
+	struct peer_dbid_map *peers_by_dbid;
+	/* Their channels which have a short_channel_id. */
+	struct channel_scid_map *channels_by_scid;
 
 	/* Outstanding connect commands. */
 	struct list_head connects;
@@ -161,6 +166,8 @@ struct lightningd {
 	/* HTLCs in flight. */
 	struct htlc_in_map htlcs_in;
 	struct htlc_out_map htlcs_out;
+	/* ... and in order of expiry. */
+	struct htlc_expiries htlc_expiries;
 
 	struct wallet *wallet;
 
@@ -231,6 +238,9 @@ struct lightningd {
 	const char *original_directory;
 
 	struct plugins *plugins;
+
+	/* Don't wait for the db_write plugin on every commit? */
+	bool db_write_batch;
 };
 
 /* Turning this on allows a tal allocation to return NULL, rather than aborting.
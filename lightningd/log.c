@@ -4,9 +4,11 @@
 #include <ccan/array_size/array_size.h>
 #include <ccan/err/err.h>
 #include <ccan/io/io.h>
+#include <ccan/list/list.h>
 #include <ccan/opt/opt.h>
 #include <ccan/read_write_all/read_write_all.h>
 #include <ccan/str/hex/hex.h>
+#include <ccan/take/take.h>
 #include <ccan/tal/link/link.h>
 #include <ccan/tal/str/str.h>
 #include <common/json_command.h>
@@ -23,7 +25,9 @@
 #include <lightningd/lightningd.h>
 #include <lightningd/notification.h>
 #include <lightningd/options.h>
+#include <pthread.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -89,36 +93,607 @@ static void log_to_stdout(const char *prefix,
 	log_to_file(prefix, level, continued, time, str, io, io_len, stdout);
 }
 
-static size_t mem_used(const struct log_entry *e)
+/*~ Writing the log file used to happen right here: every line cost the
+ * main thread a gmtime(), a couple of printf()s and an fflush(), ie. a
+ * write() syscall.  At --log-level=debug (let alone io) that adds up, and
+ * the main thread is the one which is supposed to be talking to peers.
+ *
+ * So for --log-file we just copy the raw pieces of each line into a ring
+ * buffer, and a writer thread formats them and writes them out in big
+ * chunks.  There is exactly one producer (us) and one consumer (the
+ * writer), so the ring itself needs no lock: we only ever advance `head`,
+ * and it only ever advances `tail`.  The writer only advances `tail` once
+ * the lines are written, so `tail == head` means everything is out.
+ *
+ * If the writer falls too far behind, we drop lines rather than grow
+ * without bound; it notes in the log how many went missing.  They're all
+ * still in the log_book, of course, so a crash dump will have them. */
+#define LOG_WRITER_RING_SIZE (4 * 1024 * 1024)
+#define LOG_WRITER_OUTBUF (64 * 1024)
+#define LOG_WRITER_LINGER_USEC 1000
+
+struct log_record {
+	/* Total length, including this header, padded to 8 bytes.
+	 * 0 means "skip to the end of the ring". */
+	u32 len;
+	u32 prefix_len, str_len, io_len;
+	u8 level;
+	bool continued;
+	struct timeabs time;
+	/* Followed by prefix, str and io */
+};
+
+struct log_writer {
+	/* In log_writers, so we can flush on fork() and exit() */
+	struct list_node list;
+	int fd;
+
+	u8 *ring;
+	atomic_size_t head, tail;
+	_Atomic u64 dropped;
+	/* Writer is (about to be) waiting on wake */
+	atomic_bool sleeping;
+	atomic_bool stop;
+
+	pthread_mutex_t lock;
+	pthread_cond_t wake, drained;
+	pthread_t thread;
+	bool running;
+
+	/* Everything below is only touched by the writer. */
+	u64 dropped_reported;
+	/* "YYYY-mm-ddTHH:MM:SS." changes once a second, so cache it. */
+	time_t cached_sec;
+	char cached_ts[sizeof("YYYY-mm-ddTHH:MM:SS.")];
+	size_t outlen;
+	char out[LOG_WRITER_OUTBUF];
+};
+
+static LIST_HEAD(log_writers);
+
+/* There's only one of these, for --log-file. */
+static struct log_writer *logwriter;
+
+/* Records never wrap: if one doesn't fit before the end, we skip there */
+static size_t ring_space_at_end(size_t pos)
+{
+	return LOG_WRITER_RING_SIZE - pos % LOG_WRITER_RING_SIZE;
+}
+
+static void out_write(struct log_writer *w)
+{
+	/* Like fprintf before us, there's not much we can do on error. */
+	write_all(w->fd, w->out, w->outlen);
+	w->outlen = 0;
+}
+
+static void out_add(struct log_writer *w, const void *p, size_t len)
 {
-	return sizeof(*e) + strlen(e->log) + 1 + tal_count(e->io);
+	if (w->outlen + len > sizeof(w->out)) {
+		out_write(w);
+		if (len > sizeof(w->out)) {
+			write_all(w->fd, p, len);
+			return;
+		}
+	}
+	memcpy(w->out + w->outlen, p, len);
+	w->outlen += len;
 }
 
-static size_t prune_log(struct log_book *log)
+static void out_str(struct log_writer *w, const char *str)
 {
-	struct log_entry *i, *next, *tail;
-	size_t skipped = 0, deleted = 0;
+	out_add(w, str, strlen(str));
+}
 
-	/* Never delete the last one. */
-	tail = list_tail(&log->log, struct log_entry, list);
+/* Same as log_to_file: "YYYY-mm-ddTHH:MM:SS.nnnZ " */
+static void out_timestamp(struct log_writer *w, const struct timeabs *time)
+{
+	int msec = time->ts.tv_nsec / 1000000;
+	char tail[] = { '0' + msec / 100, '0' + msec / 10 % 10, '0' + msec % 10,
+			'Z', ' ' };
+
+	if (time->ts.tv_sec != w->cached_sec) {
+		struct tm tm;
+		/* Not gmtime(): that's not thread-safe! */
+		gmtime_r(&time->ts.tv_sec, &tm);
+		strftime(w->cached_ts, sizeof(w->cached_ts), "%FT%T.", &tm);
+		w->cached_sec = time->ts.tv_sec;
+	}
+	out_str(w, w->cached_ts);
+	out_add(w, tail, sizeof(tail));
+}
 
-	list_for_each_safe(&log->log, i, next, list) {
-		/* 50% chance of deleting IO_IN, 25% IO_OUT, 12.5% DEBUG... */
-		if (i == tail || !pseudorand(2 << i->level)) {
-			i->skipped += skipped;
-			skipped = 0;
+static void out_record(struct log_writer *w, const struct log_record *rec)
+{
+	const char *prefix = (const char *)(rec + 1);
+	const char *str = prefix + rec->prefix_len;
+	const u8 *io = (const u8 *)str + rec->str_len;
+
+	out_timestamp(w, &rec->time);
+	if (rec->level == LOG_IO_IN || rec->level == LOG_IO_OUT) {
+		/* We can't use tal here: it's not thread-safe either. */
+		char hex[512 * 2 + 1];
+
+		out_add(w, prefix, rec->prefix_len);
+		out_add(w, str, rec->str_len);
+		out_str(w, rec->level == LOG_IO_IN ? "[IN] " : "[OUT] ");
+		for (size_t off = 0; off < rec->io_len; off += 512) {
+			size_t n = rec->io_len - off;
+			if (n > 512)
+				n = 512;
+			hex_encode(io + off, n, hex, sizeof(hex));
+			out_add(w, hex, n * 2);
+		}
+	} else if (!rec->continued) {
+		out_str(w, level_prefix(rec->level));
+		out_str(w, " ");
+		out_add(w, prefix, rec->prefix_len);
+		out_str(w, " ");
+		out_add(w, str, rec->str_len);
+	} else {
+		out_add(w, prefix, rec->prefix_len);
+		out_str(w, " \t");
+		out_add(w, str, rec->str_len);
+	}
+	out_str(w, "\n");
+}
+
+static void out_dropped(struct log_writer *w)
+{
+	u64 dropped = atomic_load(&w->dropped);
+	struct timeabs now;
+	char buf[100];
+
+	if (dropped == w->dropped_reported)
+		return;
+
+	now = time_now();
+	out_timestamp(w, &now);
+	snprintf(buf, sizeof(buf),
+		 "**BROKEN** log: writer fell behind,"
+		 " dropped %"PRIu64" lines\n",
+		 dropped - w->dropped_reported);
+	out_str(w, buf);
+	w->dropped_reported = dropped;
+}
+
+/* Write out everything queued so far: false if there was nothing. */
+static bool log_writer_drain(struct log_writer *w)
+{
+	size_t tail = atomic_load_explicit(&w->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&w->head, memory_order_acquire);
+
+	if (tail == head)
+		return false;
+
+	while (tail != head) {
+		size_t end = ring_space_at_end(tail);
+		const struct log_record *rec;
+
+		rec = (const struct log_record *)(w->ring
+						  + tail % LOG_WRITER_RING_SIZE);
+		if (end < sizeof(*rec) || rec->len == 0) {
+			tail += end;
 			continue;
 		}
+		out_record(w, rec);
+		tail += rec->len;
+
+		/* Give the space back as we go, if this is a big backlog */
+		if (w->outlen > sizeof(w->out) / 2) {
+			out_write(w);
+			atomic_store_explicit(&w->tail, tail,
+					      memory_order_release);
+		}
+	}
+	out_dropped(w);
+	out_write(w);
+	atomic_store_explicit(&w->tail, tail, memory_order_release);
+	return true;
+}
+
+static void *log_writer_thread(void *arg)
+{
+	struct log_writer *w = arg;
+	const struct timespec linger = { 0, LOG_WRITER_LINGER_USEC * 1000 };
+	bool stop;
+
+	do {
+		if (log_writer_drain(w))
+			continue;
+
+		pthread_mutex_lock(&w->lock);
+		/* Set this before we check head: log_to_writer sets head
+		 * before it checks this, so one of us will notice. */
+		atomic_store(&w->sleeping, true);
+		while (atomic_load(&w->head) == atomic_load(&w->tail)
+		       && !atomic_load(&w->stop)) {
+			pthread_cond_broadcast(&w->drained);
+			pthread_cond_wait(&w->wake, &w->lock);
+		}
+		atomic_store(&w->sleeping, false);
+		stop = atomic_load(&w->stop)
+			&& atomic_load(&w->head) == atomic_load(&w->tail);
+		pthread_mutex_unlock(&w->lock);
 
-		list_del_from(&log->log, &i->list);
-		log->mem_used -= mem_used(i);
-		tal_free(i);
-		skipped++;
-		deleted++;
+		/* We were woken by the first line of a burst: give the rest
+		 * a moment to arrive, so we write them in one go. */
+		if (!stop && !atomic_load(&w->stop))
+			nanosleep(&linger, NULL);
+	} while (!stop);
+
+	return NULL;
+}
+
+static void log_writer_start(struct log_writer *w)
+{
+	w->running = (pthread_create(&w->thread, NULL, log_writer_thread, w)
+		      == 0);
+	/* No thread?  Then we do it ourselves, like we used to. */
+	if (!w->running)
+		log_writer_drain(w);
+}
+
+static void log_writer_wake(struct log_writer *w)
+{
+	pthread_mutex_lock(&w->lock);
+	pthread_cond_signal(&w->wake);
+	pthread_mutex_unlock(&w->lock);
+}
+
+static void log_to_writer(const char *prefix,
+			  enum log_level level,
+			  bool continued,
+			  const struct timeabs *time,
+			  const char *str,
+			  const u8 *io,
+			  size_t io_len,
+			  struct log_writer *w)
+{
+	size_t prefix_len = strlen(prefix), str_len = strlen(str);
+	size_t head = atomic_load_explicit(&w->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&w->tail, memory_order_acquire);
+	size_t len, skip = 0;
+	struct log_record *rec;
+	char *p;
+
+	len = (sizeof(*rec) + prefix_len + str_len + io_len + 7) & ~(size_t)7;
+	if (len > ring_space_at_end(head))
+		skip = ring_space_at_end(head);
+
+	/* Until we know it fits, the space at head may still be the
+	 * writer's: don't touch it! */
+	if (skip + len > LOG_WRITER_RING_SIZE - (head - tail)) {
+		atomic_fetch_add(&w->dropped, 1);
+		return;
 	}
 
-	assert(!skipped);
-	return deleted;
+	if (skip >= sizeof(*rec))
+		((struct log_record *)(w->ring + head
+				       % LOG_WRITER_RING_SIZE))->len = 0;
+	head += skip;
+	rec = (struct log_record *)(w->ring + head % LOG_WRITER_RING_SIZE);
+	rec->len = len;
+	rec->prefix_len = prefix_len;
+	rec->str_len = str_len;
+	rec->io_len = io_len;
+	rec->level = level;
+	rec->continued = continued;
+	rec->time = *time;
+	p = (char *)(rec + 1);
+	memcpy(p, prefix, prefix_len);
+	memcpy(p + prefix_len, str, str_len);
+	memcpy(p + prefix_len + str_len, io, io_len);
+	atomic_store(&w->head, head + len);
+
+	if (!w->running)
+		log_writer_start(w);
+	else if (atomic_load(&w->sleeping))
+		log_writer_wake(w);
+}
+
+/* Wait until everything logged so far has been written. */
+static void log_writer_flush(struct log_writer *w)
+{
+	if (!w->running) {
+		log_writer_drain(w);
+		return;
+	}
+
+	/* If the writer itself crashed, it's not going to drain anything! */
+	if (pthread_equal(pthread_self(), w->thread))
+		return;
+
+	pthread_mutex_lock(&w->lock);
+	while (atomic_load(&w->tail) != atomic_load(&w->head)) {
+		pthread_cond_signal(&w->wake);
+		pthread_cond_wait(&w->drained, &w->lock);
+	}
+	pthread_mutex_unlock(&w->lock);
+}
+
+/*~ fork() only copies the thread which calls it, so a child has our ring
+ * but nobody writing it.  Whatever's queued is the parent's writer's job,
+ * so the child forgets it (and whatever state the lock was in), and starts
+ * its own writer if it ever logs anything (which, since it's usually about
+ * to exec a subdaemon, is rare). */
+static void log_writers_postfork_child(void)
+{
+	struct log_writer *w;
+
+	list_for_each(&log_writers, w, list) {
+		pthread_mutex_init(&w->lock, NULL);
+		pthread_cond_init(&w->wake, NULL);
+		pthread_cond_init(&w->drained, NULL);
+		atomic_store(&w->sleeping, false);
+		atomic_store(&w->tail, atomic_load(&w->head));
+		w->dropped_reported = atomic_load(&w->dropped);
+		w->outlen = 0;
+		w->running = false;
+	}
+}
+
+static void log_writers_atexit(void)
+{
+	struct log_writer *w;
+
+	list_for_each(&log_writers, w, list)
+		log_writer_flush(w);
+}
+
+static void destroy_log_writer(struct log_writer *w)
+{
+	if (w->running) {
+		atomic_store(&w->stop, true);
+		log_writer_wake(w);
+		pthread_join(w->thread, NULL);
+	} else
+		log_writer_drain(w);
+
+	list_del_from(&log_writers, &w->list);
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->wake);
+	pthread_cond_destroy(&w->drained);
+	close(w->fd);
+}
+
+/* Takes ownership of fd.  The thread is started on the first line. */
+static struct log_writer *new_log_writer(const tal_t *ctx, int fd)
+{
+	static bool registered;
+	struct log_writer *w = tal(ctx, struct log_writer);
+
+	if (!registered) {
+		pthread_atfork(NULL, NULL, log_writers_postfork_child);
+		atexit(log_writers_atexit);
+		registered = true;
+	}
+
+	w->fd = fd;
+	w->ring = tal_arr(w, u8, LOG_WRITER_RING_SIZE);
+	atomic_init(&w->head, 0);
+	atomic_init(&w->tail, 0);
+	atomic_init(&w->dropped, 0);
+	atomic_init(&w->sleeping, false);
+	atomic_init(&w->stop, false);
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->wake, NULL);
+	pthread_cond_init(&w->drained, NULL);
+	w->running = false;
+	w->dropped_reported = 0;
+	w->cached_sec = -1;
+	w->outlen = 0;
+
+	list_add_tail(&log_writers, &w->list);
+	tal_add_destructor(w, destroy_log_writer);
+	return w;
+}
+
+/*~ The log_book used to be a list of individually allocated entries, and
+ * once it passed max_mem we'd walk the whole thing, randomly deleting
+ * (mostly chatty) ones.  Now each level gets a fixed share of max_mem
+ * (in sixteenths), which it uses as a ring: adding an entry simply pushes
+ * out the oldest entries *of that level*, so a flood of IO can never push
+ * out the last BROKEN message.  Every entry is numbered, so the gaps tell
+ * us how many were pruned. */
+static const size_t level_share[LOG_LEVEL_MAX+1] = {
+	[LOG_IO_OUT] = 4,
+	[LOG_IO_IN] = 4,
+	[LOG_DBG] = 4,
+	[LOG_INFORM] = 2,
+	[LOG_UNUSUAL] = 1,
+	[LOG_BROKEN] = 1,
+};
+
+struct log_book_entry {
+	u64 seq;
+	struct timeabs time;
+	const char *prefix;
+	/* Total length, including this header, padded to 8 bytes.
+	 * 0 means "skip to the end of the ring". */
+	u32 len;
+	u32 log_len, io_len;
+	/* Followed by log (nul-terminated), then io */
+};
+
+static struct log_book_entry *ring_entry(const struct log_ring *ring,
+					 size_t off)
+{
+	return (struct log_book_entry *)(ring->buf + off % ring->size);
+}
+
+/* Entries never wrap: if one doesn't fit before the end, we skip there. */
+static size_t ring_skip_end(const struct log_ring *ring, size_t off)
+{
+	size_t end = ring->size - off % ring->size;
+
+	if (off != ring->head
+	    && (end < sizeof(struct log_book_entry)
+		|| ring_entry(ring, off)->len == 0))
+		off += end;
+	return off;
+}
+
+static void ring_pop_oldest(struct log_ring *ring)
+{
+	ring->tail = ring_skip_end(ring, ring->tail);
+	ring->tail += ring_entry(ring, ring->tail)->len;
+}
+
+/* Make room for an entry of len bytes, pushing out old ones as needed. */
+static struct log_book_entry *ring_push(struct log_book *lr,
+					struct log_ring *ring, size_t len)
+{
+	struct log_book_entry *e;
+	size_t end, skip = 0;
+
+	if (!ring->buf)
+		ring->buf = tal_arr(lr, u8, ring->size);
+
+	end = ring->size - ring->head % ring->size;
+	if (len > end)
+		skip = end;
+
+	while (ring->size - (ring->head - ring->tail) < skip + len)
+		ring_pop_oldest(ring);
+
+	if (skip >= sizeof(struct log_book_entry))
+		ring_entry(ring, ring->head)->len = 0;
+	ring->latest = ring->head + skip;
+	ring->head = ring->latest + len;
+	lr->latest = ring;
+
+	e = ring_entry(ring, ring->latest);
+	e->len = len;
+	return e;
+}
+
+static const char *entry_log(const struct log_book_entry *e)
+{
+	return (const char *)(e + 1);
+}
+
+static const u8 *entry_io(const struct log_book_entry *e)
+{
+	return (const u8 *)(e + 1) + e->log_len + 1;
+}
+
+/* Move to a ring of a different size, keeping the newest entries which fit. */
+static void ring_resize(struct log_book *lr, struct log_ring *ring,
+			size_t size)
+{
+	size_t pos, off = 0;
+	u8 *buf;
+
+	if (!ring->buf) {
+		ring->size = size;
+		return;
+	}
+
+	while (ring->head - ring->tail > size)
+		ring_pop_oldest(ring);
+
+	buf = tal_arr(lr, u8, size);
+	for (pos = ring_skip_end(ring, ring->tail);
+	     pos != ring->head;
+	     pos = ring_skip_end(ring, pos)) {
+		const struct log_book_entry *e = ring_entry(ring, pos);
+
+		memcpy(buf + off, e, e->len);
+		off += e->len;
+		pos += e->len;
+	}
+	tal_free(ring->buf);
+	ring->buf = buf;
+	ring->size = size;
+	ring->tail = 0;
+	ring->head = ring->latest = off;
+}
+
+static void add_entry(struct log_book *lr,
+		      enum log_level level,
+		      u64 seq,
+		      const struct timeabs *time,
+		      const char *prefix,
+		      const char *log, size_t log_len,
+		      const u8 *io, size_t io_len)
+{
+	struct log_ring *ring = &lr->rings[level];
+	size_t len = (sizeof(struct log_book_entry) + log_len + 1 + io_len + 7)
+		& ~(size_t)7;
+	struct log_book_entry *e;
+	char *p;
+
+	/* log_io() limits io, but we never cut a message short: ring_push()
+	 * needs room for the entry plus a skip shorter than it, so grow the
+	 * ring for it.  Once it would have been pushed out of a ring of our
+	 * usual size, we go back to that, so max_mem is only exceeded while
+	 * such a giant message is still among the newest. */
+	if (len * 2 > ring->size) {
+		size_t size = ring->size;
+
+		while (size < len * 2)
+			size *= 2;
+		ring_resize(lr, ring, size);
+	} else if (ring->size != ring->share
+		   && len * 2 <= ring->share
+		   && ring->head >= ring->oversized + ring->share)
+		ring_resize(lr, ring, ring->share);
+
+	e = ring_push(lr, ring, len);
+	if (len * 2 > ring->share)
+		ring->oversized = ring->head;
+	e->seq = seq;
+	e->time = *time;
+	e->prefix = prefix;
+	e->log_len = log_len;
+	e->io_len = io_len;
+	p = (char *)(e + 1);
+	memcpy(p, log, log_len);
+	p[log_len] = '\0';
+	memcpy(p + log_len + 1, io, io_len);
+}
+
+/* Next entry in time order: pos[] starts as each ring's tail. */
+static const struct log_book_entry *next_entry(const struct log_book *lr,
+					       size_t pos[LOG_LEVEL_MAX+1],
+					       enum log_level *level)
+{
+	const struct log_book_entry *e = NULL;
+
+	for (size_t i = 0; i <= LOG_LEVEL_MAX; i++) {
+		const struct log_ring *ring = &lr->rings[i];
+		const struct log_book_entry *candidate;
+
+		pos[i] = ring_skip_end(ring, pos[i]);
+		if (pos[i] == ring->head)
+			continue;
+		candidate = ring_entry(ring, pos[i]);
+		if (!e || candidate->seq < e->seq) {
+			e = candidate;
+			*level = i;
+		}
+	}
+
+	if (e)
+		pos[*level] += e->len;
+	return e;
+}
+
+static void start_entries(const struct log_book *lr,
+			  size_t pos[LOG_LEVEL_MAX+1])
+{
+	for (size_t i = 0; i <= LOG_LEVEL_MAX; i++)
+		pos[i] = lr->rings[i].tail;
+}
+
+static size_t mem_used(const struct log_book *lr)
+{
+	size_t used = 0;
+
+	for (size_t i = 0; i <= LOG_LEVEL_MAX; i++)
+		used += lr->rings[i].head - lr->rings[i].tail;
+	return used;
 }
 
 struct log_book *new_log_book(struct lightningd *ld, size_t max_mem,
@@ -128,13 +703,24 @@ struct log_book *new_log_book(struct lightningd *ld, size_t max_mem,
 
 	/* Give a reasonable size for memory limit! */
 	assert(max_mem > sizeof(struct log) * 2);
-	lr->mem_used = 0;
 	lr->max_mem = max_mem;
 	lr->print = log_to_stdout;
 	lr->print_level = printlevel;
 	lr->init_time = time_now();
 	lr->ld = ld;
-	list_head_init(&lr->log);
+	for (size_t i = 0; i <= LOG_LEVEL_MAX; i++) {
+		struct log_ring *ring = &lr->rings[i];
+
+		ring->buf = NULL;
+		ring->size = (max_mem / 16 * level_share[i]) & ~(size_t)7;
+		/* We need room for at least one decent entry! */
+		if (ring->size < 1024)
+			ring->size = 1024;
+		ring->share = ring->size;
+		ring->head = ring->tail = ring->latest = ring->oversized = 0;
+	}
+	lr->next_seq = 0;
+	lr->latest = NULL;
 
 	return lr;
 }
@@ -203,7 +789,7 @@ size_t log_max_mem(const struct log_book *lr)
 
 size_t log_used(const struct log_book *lr)
 {
-	return lr->mem_used;
+	return mem_used(lr);
 }
 
 const struct timeabs *log_init_time(const struct log_book *lr)
@@ -211,63 +797,46 @@ const struct timeabs *log_init_time(const struct log_book *lr)
 	return &lr->init_time;
 }
 
-static void add_entry(struct log *log, struct log_entry *l)
+static void maybe_print(const struct log *log, enum log_level level,
+			bool continued, const struct timeabs *time,
+			const char *str, const u8 *io, size_t io_len)
 {
-	log->lr->mem_used += mem_used(l);
-	list_add_tail(&log->lr->log, &l->list);
-
-	if (log->lr->mem_used > log->lr->max_mem) {
-		size_t old_mem = log->lr->mem_used, deleted;
-		deleted = prune_log(log->lr);
-		log_debug(log, "Log pruned %zu entries (mem %zu -> %zu)",
-			  deleted, old_mem, log->lr->mem_used);
-	}
+	if (level >= log->lr->print_level)
+		log->lr->print(log->prefix, level, continued, time, str,
+			       io, io_len, log->lr->print_arg);
 }
 
-static struct log_entry *new_log_entry(struct log *log, enum log_level level)
+/* Sanitize any non-printable characters, and replace with '?' */
+static void sanitize(char *str)
 {
-	struct log_entry *l = tal(log->lr, struct log_entry);
-
-	l->time = time_now();
-	l->level = level;
-	l->skipped = 0;
-	l->prefix = log->prefix;
-	l->io = NULL;
-
-	return l;
-}
-
-static void maybe_print(const struct log *log, const struct log_entry *l,
-			size_t offset)
-{
-	if (l->level >= log->lr->print_level)
-		log->lr->print(log->prefix, l->level, offset != 0,
-			       &l->time, l->log + offset,
-			       l->io, tal_bytelen(l->io), log->lr->print_arg);
+	for (size_t i = 0; str[i]; i++)
+		if (str[i] < ' ' || str[i] >= 0x7f)
+			str[i] = '?';
 }
 
 void logv(struct log *log, enum log_level level, bool call_notifier,
 			const char *fmt, va_list ap)
 {
 	int save_errno = errno;
-	struct log_entry *l = new_log_entry(log, level);
-
-	l->log = tal_vfmt(l, fmt, ap);
+	struct log_entry l;
+	char *str = tal_vfmt(NULL, fmt, ap);
 
-	size_t log_len = strlen(l->log);
+	sanitize(str);
 
-	/* Sanitize any non-printable characters, and replace with '?' */
-	for (size_t i=0; i<log_len; i++)
-		if (l->log[i] < ' ' || l->log[i] >= 0x7f)
-			l->log[i] = '?';
+	l.time = time_now();
+	l.level = level;
+	l.prefix = log->prefix;
+	l.log = str;
 
-	maybe_print(log, l, 0);
+	maybe_print(log, level, false, &l.time, str, NULL, 0);
 
-	add_entry(log, l);
+	add_entry(log->lr, level, log->lr->next_seq++, &l.time, log->prefix,
+		  str, strlen(str), NULL, 0);
 
 	if (call_notifier)
-		notify_warning(log->lr->ld, l);
+		notify_warning(log->lr->ld, &l);
 
+	tal_free(str);
 	errno = save_errno;
 }
 
@@ -276,48 +845,52 @@ void log_io(struct log *log, enum log_level dir,
 	    const void *data TAKES, size_t len)
 {
 	int save_errno = errno;
-	struct log_entry *l = new_log_entry(log, dir);
+	struct timeabs now = time_now();
 
 	assert(dir == LOG_IO_IN || dir == LOG_IO_OUT);
 
 	/* Print first, in case we need to truncate. */
-	if (l->level >= log->lr->print_level)
-		log->lr->print(log->prefix, l->level, false,
-			       &l->time, str,
-			       data, len, log->lr->print_arg);
-
-	l->log = tal_strdup(l, str);
+	maybe_print(log, dir, false, &now, str, data, len);
 
-	/* Don't immediately fill buffer with giant IOs */
+	/* Don't immediately fill buffer with giant IOs: the sequence number
+	 * we skip shows up as a skipped entry. */
 	if (len > log->lr->max_mem / 64) {
-		l->skipped++;
+		log->lr->next_seq++;
 		len = log->lr->max_mem / 64;
 	}
-	l->io = tal_dup_arr(l, u8, data, len, 0);
 
-	add_entry(log, l);
+	add_entry(log->lr, dir, log->lr->next_seq++, &now, log->prefix,
+		  str, strlen(str), data, len);
+
+	if (taken(str))
+		tal_free(str);
+	if (taken(data))
+		tal_free(data);
 	errno = save_errno;
 }
 
 void logv_add(struct log *log, const char *fmt, va_list ap)
 {
-	struct log_entry *l = list_tail(&log->lr->log, struct log_entry, list);
-	size_t oldlen = strlen(l->log);
-
-	/* Remove from list, so it doesn't get pruned. */
-	log->lr->mem_used -= mem_used(l);
-	list_del_from(&log->lr->log, &l->list);
-
-	tal_append_vfmt(&l->log, fmt, ap);
-
-	/* Sanitize any non-printable characters, and replace with '?' */
-	for (size_t i=oldlen; i<strlen(l->log); i++)
-		if (l->log[i] < ' ' || l->log[i] >= 0x7f)
-			l->log[i] = '?';
-
-	add_entry(log, l);
-
-	maybe_print(log, l, oldlen);
+	struct log_ring *ring = log->lr->latest;
+	const struct log_book_entry *e = ring_entry(ring, ring->latest);
+	struct timeabs time = e->time;
+	const char *prefix = e->prefix;
+	u64 seq = e->seq;
+	char *str = tal_strdup(NULL, entry_log(e));
+	u8 *io = tal_dup_arr(str, u8, entry_io(e), e->io_len, 0);
+	size_t oldlen = strlen(str);
+
+	tal_append_vfmt(&str, fmt, ap);
+	sanitize(str + oldlen);
+
+	/* It's the newest in its ring, so we can simply replace it. */
+	ring->head = ring->latest;
+	add_entry(log->lr, ring - log->lr->rings, seq, &time, prefix,
+		  str, strlen(str), io, tal_count(io));
+
+	maybe_print(log, ring - log->lr->rings, true, &time, str + oldlen,
+		    NULL, 0);
+	tal_free(str);
 }
 
 void log_(struct log *log, enum log_level level, bool call_notifier,
@@ -345,36 +918,66 @@ void log_each_line_(const struct log_book *lr,
 				 enum log_level level,
 				 const char *prefix,
 				 const char *log,
-				 const u8 *io,
+				 const u8 *io, size_t io_len,
 				 void *arg),
 		    void *arg)
 {
-	const struct log_entry *i;
+	size_t pos[LOG_LEVEL_MAX+1];
+	const struct log_book_entry *e;
+	enum log_level level;
+	u64 next_seq = 0;
+
+	start_entries(lr, pos);
+	while ((e = next_entry(lr, pos, &level)) != NULL) {
+		bool is_io = (level == LOG_IO_IN || level == LOG_IO_OUT);
 
-	list_for_each(&lr->log, i, list) {
-		func(i->skipped, time_between(i->time, lr->init_time),
-		     i->level, i->prefix, i->log, i->io, arg);
+		func(e->seq - next_seq, time_between(e->time, lr->init_time),
+		     level, e->prefix, entry_log(e),
+		     is_io ? entry_io(e) : NULL, e->io_len, arg);
+		next_seq = e->seq + 1;
 	}
 }
 
 struct log_data {
 	int fd;
 	const char *prefix;
+	/* No allocations, may be in signal handler: so we batch here. */
+	size_t len;
+	char buf[8192];
 };
 
+static void dump_flush(struct log_data *data)
+{
+	write_all(data->fd, data->buf, data->len);
+	data->len = 0;
+}
+
+static void dump_add(struct log_data *data, const char *str, size_t len)
+{
+	if (data->len + len > sizeof(data->buf)) {
+		dump_flush(data);
+		if (len > sizeof(data->buf)) {
+			write_all(data->fd, str, len);
+			return;
+		}
+	}
+	memcpy(data->buf + data->len, str, len);
+	data->len += len;
+}
+
 static void log_one_line(unsigned int skipped,
 			 struct timerel diff,
 			 enum log_level level,
 			 const char *prefix,
 			 const char *log,
-			 const u8 *io,
+			 const u8 *io, size_t io_len,
 			 struct log_data *data)
 {
 	char buf[101];
 
 	if (skipped) {
 		snprintf(buf, sizeof(buf), "%s... %u skipped...", data->prefix, skipped);
-		write_all(data->fd, buf, strlen(buf));
+		dump_add(data, buf, strlen(buf));
 		data->prefix = "\n";
 	}
 
@@ -391,18 +994,17 @@ static void log_one_line(unsigned int skipped,
 		: level == LOG_BROKEN ? "BROKEN"
 		: "**INVALID**");
 
-	write_all(data->fd, buf, strlen(buf));
-	write_all(data->fd, log, strlen(log));
-	if (level == LOG_IO_IN || level == LOG_IO_OUT) {
-		size_t off, used, len = tal_count(io);
+	dump_add(data, buf, strlen(buf));
+	dump_add(data, log, strlen(log));
+	if (io) {
+		size_t off, used;
 
-		/* No allocations, may be in signal handler. */
-		for (off = 0; off < len; off += used) {
-			used = len - off;
+		for (off = 0; off < io_len; off += used) {
+			used = io_len - off;
 			if (hex_str_size(used) > sizeof(buf))
 				used = hex_data_size(sizeof(buf));
 			hex_encode(io + off, used, buf, hex_str_size(used));
-			write_all(data->fd, buf, strlen(buf));
+			dump_add(data, buf, strlen(buf));
 		}
 	}
 
@@ -470,17 +1072,24 @@ static void handle_sighup(int sig)
 /* Mutual recursion */
 static struct io_plan *setup_read(struct io_conn *conn, struct lightningd *ld);
 
+static int open_log_file(const char *logfile)
+{
+	return open(logfile, O_WRONLY|O_APPEND|O_CREAT, 0666);
+}
+
 static struct io_plan *rotate_log(struct io_conn *conn, struct lightningd *ld)
 {
-	FILE *logf;
+	int fd;
 
 	log_info(ld->log, "Ending log due to SIGHUP");
-	fclose(ld->log->lr->print_arg);
+	/* This writes out everything first, and closes the file. */
+	tal_free(logwriter);
 
-	logf = fopen(ld->logfile, "a");
-	if (!logf)
+	fd = open_log_file(ld->logfile);
+	if (fd < 0)
 		err(1, "failed to reopen log file %s", ld->logfile);
-	set_log_outfn(ld->log->lr, log_to_file, logf);
+	logwriter = new_log_writer(ld, fd);
+	set_log_outfn(ld->log->lr, log_to_writer, logwriter);
 
 	log_info(ld->log, "Started log due to SIGHUP");
 	return setup_read(conn, ld);
@@ -512,30 +1121,36 @@ static void setup_log_rotation(struct lightningd *ld)
 
 char *arg_log_to_file(const char *arg, struct lightningd *ld)
 {
-	const struct log_entry *i;
-	FILE *logf;
-	int size;
+	size_t pos[LOG_LEVEL_MAX+1];
+	const struct log_book_entry *e;
+	enum log_level level;
+	int fd;
 
 	if (ld->logfile) {
-		fclose(ld->log->lr->print_arg);
+		logwriter = tal_free(logwriter);
 		ld->logfile = tal_free(ld->logfile);
 	} else
 		setup_log_rotation(ld);
 
 	ld->logfile = tal_strdup(ld, arg);
-	logf = fopen(arg, "a");
-	if (!logf)
+	fd = open_log_file(arg);
+	if (fd < 0)
 		return tal_fmt(NULL, "Failed to open: %s", strerror(errno));
-	set_log_outfn(ld->log->lr, log_to_file, logf);
 
 	/* For convenience make a block of empty lines just like Bitcoin Core */
-	size = ftell(logf);
-	if (size > 0)
-		fprintf(logf, "\n\n\n\n");
+	if (lseek(fd, 0, SEEK_END) > 0)
+		write_all(fd, "\n\n\n\n", strlen("\n\n\n\n"));
+
+	logwriter = new_log_writer(ld, fd);
+	set_log_outfn(ld->log->lr, log_to_writer, logwriter);
 
 	/* Catch up */
-	list_for_each(&ld->log->lr->log, i, list)
-		maybe_print(ld->log, i, 0);
+	start_entries(ld->log->lr, pos);
+	while ((e = next_entry(ld->log->lr, pos, &level)) != NULL) {
+		bool is_io = (level == LOG_IO_IN || level == LOG_IO_OUT);
+		maybe_print(ld->log, level, false, &e->time, entry_log(e),
+			    is_io ? entry_io(e) : NULL, e->io_len);
+	}
 
 	log_debug(ld->log, "Opened log file %s", arg);
 	return NULL;
@@ -567,27 +1182,27 @@ void log_backtrace_print(const char *fmt, ...)
 
 static void log_dump_to_file(int fd, const struct log_book *lr)
 {
-	const struct log_entry *i;
 	char buf[100];
 	int len;
 	struct log_data data;
 	time_t start;
 
-	i = list_top(&lr->log, const struct log_entry, list);
-	if (!i) {
+	if (!lr->latest) {
 		write_all(fd, "0 bytes:\n\n", strlen("0 bytes:\n\n"));
 		return;
 	}
 
 	start = lr->init_time.ts.tv_sec;
-	len = snprintf(buf, sizeof(buf), "%zu bytes, %s", lr->mem_used, ctime(&start));
+	len = snprintf(buf, sizeof(buf), "%zu bytes, %s", mem_used(lr), ctime(&start));
 	write_all(fd, buf, len);
 
 	/* ctime includes \n... WTF? */
 	data.prefix = "";
 	data.fd = fd;
+	data.len = 0;
 	log_each_line(lr, log_one_line, &data);
-	write_all(fd, "\n\n", strlen("\n\n"));
+	dump_add(&data, "\n\n", strlen("\n\n"));
+	dump_flush(&data);
 }
 
 /* FIXME: Dump peer logs! */
@@ -603,6 +1218,10 @@ void log_backtrace_exit(void)
 	if (!crashlog)
 		return;
 
+	/* Get the backtrace into the log file too. */
+	if (logwriter)
+		log_writer_flush(logwriter);
+
 	/* We expect to be in config dir. */
 	snprintf(logfile, sizeof(logfile), "crash.log.%s", timebuf);
 
@@ -636,6 +1255,8 @@ void fatal(const char *fmt, ...)
 	va_start(ap, fmt);
 	logv(crashlog, LOG_BROKEN, true, fmt, ap);
 	va_end(ap);
+	if (logwriter)
+		log_writer_flush(logwriter);
 	abort();
 }
 
@@ -661,7 +1282,7 @@ static void log_to_json(unsigned int skipped,
 			enum log_level level,
 			const char *prefix,
 			const char *log,
-			const u8 *io,
+			const u8 *io, size_t io_len,
 			struct log_info *info)
 {
 	info->num_skipped += skipped;
@@ -686,7 +1307,7 @@ static void log_to_json(unsigned int skipped,
 	json_add_string(info->response, "source", prefix);
 	json_add_string(info->response, "log", log);
 	if (io)
-		json_add_hex_talarr(info->response, "data", io);
+		json_add_hex(info->response, "data", io, io_len);
 
 	json_object_end(info->response);
 }
@@ -1,7 +1,6 @@
 #ifndef LIGHTNING_LIGHTNINGD_LOG_H
 #define LIGHTNING_LIGHTNINGD_LOG_H
 #include "config.h"
-#include <ccan/list/list.h>
 #include <ccan/tal/tal.h>
 #include <ccan/time/time.h>
 #include <ccan/typesafe_cb/typesafe_cb.h>
@@ -15,19 +14,30 @@ struct json_stream;
 struct lightningd;
 struct timerel;
 
+/* A single entry, as handed to notify_warning() */
 struct log_entry {
-	struct list_node list;
 	struct timeabs time;
 	enum log_level level;
-	unsigned int skipped;
 	const char *prefix;
-	char *log;
-	/* Iff LOG_IO */
-	const u8 *io;
+	const char *log;
+};
+
+/* Entries of a single level, oldest first. */
+struct log_ring {
+	/* Allocated on first use. */
+	u8 *buf;
+	/* Normally our share of max_mem, but an entry too big for that grows
+	 * the ring until it's been followed by a share's worth of others. */
+	size_t size, share;
+	/* Where the last entry too big for our share ended. */
+	size_t oversized;
+	/* These only ever increase: oldest entry is at buf[tail % size] */
+	size_t head, tail;
+	/* Where the newest entry starts, for log_add(). */
+	size_t latest;
 };
 
 struct log_book {
-	size_t mem_used;
 	size_t max_mem;
 	void (*print)(const char *prefix,
 		      enum log_level level,
@@ -40,7 +50,13 @@ struct log_book {
 	enum log_level print_level;
 	struct timeabs init_time;
 
-	struct list_head log;
+	/* Each level gets its own share of max_mem. */
+	struct log_ring rings[LOG_LEVEL_MAX+1];
+	/* Every entry gets a number: gaps are entries which were pruned. */
+	u64 next_seq;
+	/* Ring holding the newest entry, if any. */
+	struct log_ring *latest;
+
 	/* Although log_book will copy log entries to parent log_book
 	 * (the log_book belongs to lightningd), a pointer to lightningd
 	 *  is more directly because the notification needs ld->plugins.
@@ -114,15 +130,16 @@ const struct timeabs *log_init_time(const struct log_book *lr);
 					   enum log_level,		\
 					   const char *,		\
 					   const char *,		\
-					   const u8 *), (arg))
+					   const u8 *, size_t), (arg))
 
+/* io is NULL unless level is LOG_IO_IN/LOG_IO_OUT. */
 void log_each_line_(const struct log_book *lr,
 		    void (*func)(unsigned int skipped,
 				 struct timerel time,
 				 enum log_level level,
 				 const char *prefix,
 				 const char *log,
-				 const u8 *io,
+				 const u8 *io, size_t io_len,
 				 void *arg),
 		    void *arg);
 
@@ -891,7 +891,11 @@ static void register_opts(struct lightningd *ld)
 
 	opt_register_arg("--bitcoin-cli", opt_set_talstr, NULL,
 			 &ld->topology->bitcoind->cli,
-			 "bitcoin-cli pathname");
+			 "bitcoin-cli pathname (implies --bitcoin-use-cli)");
+	opt_register_noarg("--bitcoin-use-cli", opt_set_bool,
+			   &ld->topology->bitcoind->use_cli,
+			   "Always run bitcoin-cli, rather than talking to"
+			   " bitcoind's RPC port directly");
 	opt_register_arg("--bitcoin-rpcuser", opt_set_talstr, NULL,
 			 &ld->topology->bitcoind->rpcuser,
 			 "bitcoind RPC username");
@@ -986,6 +990,11 @@ static void register_opts(struct lightningd *ld)
 	opt_register_noarg("--disable-dns", opt_set_invbool, &ld->config.use_dns,
 			   "Disable DNS lookups of peers");
 
+	opt_register_noarg("--db-write-batch", opt_set_bool,
+			   &ld->db_write_batch,
+			   "Don't wait for the db_write plugin on every commit:"
+			   " batch writes, and hold peer updates until acked");
+
 	opt_register_logging(ld);
 	opt_register_version();
 
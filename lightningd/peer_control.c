@@ -65,6 +65,9 @@ struct close_command {
 
 static void destroy_peer(struct peer *peer)
 {
+	peer_id_map_del(peer->ld->peers_by_id, peer);
+	if (peer->dbid != 0)
+		peer_dbid_map_del(peer->ld->peers_by_dbid, peer);
 	list_del_from(&peer->ld->peers, &peer->list);
 }
 
@@ -122,6 +125,9 @@ struct peer *new_peer(struct lightningd *ld, u64 dbid,
 	peer->log_book = new_log_book(peer->ld, 128*1024, get_log_level(ld->log_book));
 	set_log_outfn(peer->log_book, copy_to_parent_log, ld->log);
 	list_add_tail(&ld->peers, &peer->list);
+	peer_id_map_add(ld->peers_by_id, peer);
+	if (peer->dbid != 0)
+		peer_dbid_map_add(ld->peers_by_dbid, peer);
 	tal_add_destructor(peer, destroy_peer);
 	return peer;
 }
@@ -146,31 +152,30 @@ void maybe_delete_peer(struct peer *peer)
 		/* This isn't sufficient to keep it in db! */
 		if (peer->dbid != 0) {
 			wallet_peer_delete(peer->ld->wallet, peer->dbid);
-			peer->dbid = 0;
+			peer_set_dbid(peer, 0);
 		}
 		return;
 	}
 	delete_peer(peer);
 }
 
-struct peer *find_peer_by_dbid(struct lightningd *ld, u64 dbid)
+void peer_set_dbid(struct peer *peer, u64 dbid)
 {
-	struct peer *p;
+	if (peer->dbid != 0)
+		peer_dbid_map_del(peer->ld->peers_by_dbid, peer);
+	peer->dbid = dbid;
+	if (peer->dbid != 0)
+		peer_dbid_map_add(peer->ld->peers_by_dbid, peer);
+}
 
-	list_for_each(&ld->peers, p, list)
-		if (p->dbid == dbid)
-			return p;
-	return NULL;
+struct peer *find_peer_by_dbid(struct lightningd *ld, u64 dbid)
+{
+	return peer_dbid_map_get(ld->peers_by_dbid, &dbid);
 }
 
 struct peer *peer_by_id(struct lightningd *ld, const struct node_id *id)
 {
-	struct peer *p;
-
-	list_for_each(&ld->peers, p, list)
-		if (node_id_eq(&p->id, id))
-			return p;
-	return NULL;
+	return peer_id_map_get(ld->peers_by_id, id);
 }
 
 struct peer *peer_from_json(struct lightningd *ld,
@@ -1026,8 +1031,7 @@ static enum watch_result funding_depth_cb(struct lightningd *ld,
 
 		/* If we restart, we could already have peer->scid from database */
 		if (!channel->scid) {
-			channel->scid = tal(channel, struct short_channel_id);
-			*channel->scid = scid;
+			channel_set_scid(channel, &scid);
 			wallet_channel_save(ld->wallet, channel);
 
 		} else if (!short_channel_id_eq(channel->scid, &scid)) {
@@ -1038,7 +1042,7 @@ static enum watch_result funding_depth_cb(struct lightningd *ld,
 					       short_channel_id_to_str(tmpctx, &scid),
 					       short_channel_id_to_str(tmpctx, channel->scid));
 
-			*channel->scid = scid;
+			channel_set_scid(channel, &scid);
 			wallet_channel_save(ld->wallet, channel);
 			return KEEP_WATCHING;
 		}
@@ -1195,14 +1199,10 @@ command_find_channel(struct command *cmd,
 				    tok->end - tok->start,
 				    buffer + tok->start);
 	} else if (json_to_short_channel_id(buffer, tok, &scid)) {
-		list_for_each(&ld->peers, peer, list) {
-			*channel = peer_active_channel(peer);
-			if (!*channel)
-				continue;
-			if ((*channel)->scid
-			    && (*channel)->scid->u64 == scid.u64)
-				return NULL;
-		}
+		*channel = channel_by_scid(ld, &scid);
+		if (*channel
+		    && *channel == peer_active_channel((*channel)->peer))
+			return NULL;
 		return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
 				    "Short channel ID not found: '%.*s'",
 				    tok->end - tok->start,
@@ -1434,7 +1434,8 @@ struct htlc_in_map *load_channels_from_wallet(struct lightningd *ld)
 			if (!wallet_htlcs_load_for_channel(ld->wallet,
 							   channel,
 							   &ld->htlcs_in,
-							   &ld->htlcs_out)) {
+							   &ld->htlcs_out,
+							   &ld->htlc_expiries)) {
 				fatal("could not load htlcs for channel");
 			}
 		}
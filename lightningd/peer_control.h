@@ -3,11 +3,14 @@
 #include "config.h"
 #include <ccan/compiler/compiler.h>
 #include <ccan/crypto/shachain/shachain.h>
+#include <ccan/crypto/siphash24/siphash24.h>
+#include <ccan/htable/htable_type.h>
 #include <ccan/list/list.h>
 #include <common/channel_config.h>
 #include <common/htlc.h>
 #include <common/json.h>
 #include <common/node_id.h>
+#include <common/pseudorand.h>
 #include <common/wireaddr.h>
 #include <lightningd/channel.h>
 #include <lightningd/channel_state.h>
@@ -18,13 +21,14 @@
 struct per_peer_state;
 
 struct peer {
-	/* Inside ld->peers. */
+	/* Inside ld->peers (and ld->peers_by_id). */
 	struct list_node list;
 
 	/* Master context */
 	struct lightningd *ld;
 
-	/* Database ID of the peer */
+	/* Database ID of the peer: 0 == not in db yet.  Non-zero ones are
+	 * in ld->peers_by_dbid: use peer_set_dbid() to change it. */
 	u64 dbid;
 
 	/* ID of peer */
@@ -55,6 +59,7 @@ struct peer {
 };
 
 struct peer *find_peer_by_dbid(struct lightningd *ld, u64 dbid);
+void peer_set_dbid(struct peer *peer, u64 dbid);
 
 struct peer *new_peer(struct lightningd *ld, u64 dbid,
 		      const struct node_id *id,
@@ -98,4 +103,41 @@ struct htlc_in_map *load_channels_from_wallet(struct lightningd *ld);
 void peer_dev_memleak(struct command *cmd);
 #endif /* DEVELOPER */
 
+static inline const struct node_id *peer_id_keyof(const struct peer *peer)
+{
+	return &peer->id;
+}
+
+static inline size_t peer_id_hash(const struct node_id *id)
+{
+	return siphash24(siphash_seed(), id->k, sizeof(id->k));
+}
+
+static inline bool peer_id_eq(const struct peer *peer,
+			      const struct node_id *id)
+{
+	return node_id_eq(&peer->id, id);
+}
+
+HTABLE_DEFINE_TYPE(struct peer, peer_id_keyof, peer_id_hash, peer_id_eq,
+		   peer_id_map);
+
+static inline const u64 *peer_dbid_keyof(const struct peer *peer)
+{
+	return &peer->dbid;
+}
+
+static inline size_t peer_dbid_hash(const u64 *dbid)
+{
+	return siphash24(siphash_seed(), dbid, sizeof(*dbid));
+}
+
+static inline bool peer_dbid_eq(const struct peer *peer, const u64 *dbid)
+{
+	return peer->dbid == *dbid;
+}
+
+HTABLE_DEFINE_TYPE(struct peer, peer_dbid_keyof, peer_dbid_hash, peer_dbid_eq,
+		   peer_dbid_map);
+
 #endif /* LIGHTNING_LIGHTNINGD_PEER_CONTROL_H */
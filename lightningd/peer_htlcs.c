@@ -408,7 +408,7 @@ static void rcvd_htlc_reply(struct subd *subd, const u8 *msg, const int *fds UNU
 	}
 
 	/* Add it to lookup table now we know id. */
-	connect_htlc_out(&subd->ld->htlcs_out, hout);
+	connect_htlc_out(&subd->ld->htlcs_out, &subd->ld->htlc_expiries, hout);
 
 	/* When channeld includes it in commitment, we'll make it persistent. */
 }
@@ -477,6 +477,47 @@ enum onion_type send_htlc_out(struct channel *out,
 	return 0;
 }
 
+/* Where the time goes when we forward an HTLC (see dev-forward-latency). */
+enum forward_stage {
+	/* Unwrapping the onion. */
+	FORWARD_STAGE_ONION,
+	/* Waiting for the htlc_accepted hook. */
+	FORWARD_STAGE_HOOK,
+	/* Finding the next peer from the short_channel_id. */
+	FORWARD_STAGE_RESOLVE_LOCAL,
+	FORWARD_STAGE_RESOLVE_GOSSIPD,
+	/* Checking it and handing it to the outgoing channeld. */
+	FORWARD_STAGE_OFFER,
+};
+#define FORWARD_NUM_STAGES (FORWARD_STAGE_OFFER + 1)
+
+#if DEVELOPER
+static const char *forward_stage_names[FORWARD_NUM_STAGES] = {
+	"onion", "hook", "resolve_local", "resolve_gossipd", "offer"
+};
+
+static struct forward_stage_stats {
+	u64 count;
+	u64 total_usec, max_usec;
+} forward_stats[FORWARD_NUM_STAGES];
+#endif /* DEVELOPER */
+
+/* Account for the time since @start, and return now to start the next. */
+static struct timemono forward_stage_done(enum forward_stage stage,
+					  struct timemono start)
+{
+	struct timemono now = time_mono();
+#if DEVELOPER
+	u64 usec = time_to_usec(timemono_between(now, start));
+
+	forward_stats[stage].count++;
+	forward_stats[stage].total_usec += usec;
+	if (usec > forward_stats[stage].max_usec)
+		forward_stats[stage].max_usec = usec;
+#endif
+	return now;
+}
+
 static void forward_htlc(struct htlc_in *hin,
 			 u32 cltv_expiry,
 			 struct amount_msat amt_to_forward,
@@ -589,6 +630,7 @@ struct gossip_resolve {
 	u32 outgoing_cltv_value;
 	u8 *next_onion;
 	struct htlc_in *hin;
+	struct timemono stage_start;
 };
 
 /* We received a resolver reply, which gives us the node_ids of the
@@ -597,7 +639,10 @@ static void channel_resolve_reply(struct subd *gossip, const u8 *msg,
 				  const int *fds UNUSED, struct gossip_resolve *gr)
 {
 	struct node_id *peer_id;
+	struct timemono start;
 
+	start = forward_stage_done(FORWARD_STAGE_RESOLVE_GOSSIPD,
+				   gr->stage_start);
 	if (!fromwire_gossip_get_channel_peer_reply(msg, msg, &peer_id)) {
 		log_broken(gossip->log,
 			   "bad fromwire_gossip_get_channel_peer_reply %s",
@@ -618,6 +663,7 @@ static void channel_resolve_reply(struct subd *gossip, const u8 *msg,
 	forward_htlc(gr->hin, gr->hin->cltv_expiry,
 		     gr->amt_to_forward, gr->outgoing_cltv_value, peer_id,
 		     gr->next_onion);
+	forward_stage_done(FORWARD_STAGE_OFFER, start);
 	tal_free(gr);
 }
 
@@ -630,6 +676,7 @@ struct htlc_accepted_hook_payload {
 	struct channel *channel;
 	struct lightningd *ld;
 	u8 *next_onion;
+	struct timemono stage_start;
 };
 
 /* The possible return value types that a plugin may return for the
@@ -756,19 +803,42 @@ htlc_accepted_hook_callback(struct htlc_accepted_hook_payload *request,
 	enum onion_type failure_code;
 	u8 *channel_update;
 	struct hop_data *hop_data;
+	struct channel *next;
+	struct timemono start;
+
+	start = forward_stage_done(FORWARD_STAGE_HOOK, request->stage_start);
 	result = htlc_accepted_hook_deserialize(buffer, toks, &payment_preimage, &failure_code, &channel_update);
 
 	hop_data = &rs->payload.v0;
 	switch (result) {
 	case htlc_accepted_continue:
-		if (rs->nextcase == ONION_FORWARD) {
+		if (rs->nextcase != ONION_FORWARD) {
+			handle_localpay(hin, hin->cltv_expiry, &hin->payment_hash,
+					hop_data->amt_forward,
+					hop_data->outgoing_cltv);
+			break;
+		}
+
+		/* If it's one of our channels, we know who to forward to
+		 * without asking gossipd. */
+		next = channel_by_scid(ld, &hop_data->channel_id);
+		if (next) {
+			start = forward_stage_done(FORWARD_STAGE_RESOLVE_LOCAL,
+						   start);
+			forward_htlc(hin, hin->cltv_expiry,
+				     hop_data->amt_forward,
+				     hop_data->outgoing_cltv, &next->peer->id,
+				     request->next_onion);
+			forward_stage_done(FORWARD_STAGE_OFFER, start);
+		} else {
 			struct gossip_resolve *gr = tal(ld, struct gossip_resolve);
 
-			gr->next_onion = serialize_onionpacket(gr, rs->next);
+			gr->next_onion = tal_steal(gr, request->next_onion);
 			gr->next_channel = hop_data->channel_id;
 			gr->amt_to_forward = hop_data->amt_forward;
 			gr->outgoing_cltv_value = hop_data->outgoing_cltv;
 			gr->hin = hin;
+			gr->stage_start = start;
 
 			req = towire_gossip_get_channel_peer(tmpctx, &gr->next_channel);
 			log_debug(channel->log, "Asking gossip to resolve channel %s",
@@ -776,10 +846,7 @@ htlc_accepted_hook_callback(struct htlc_accepted_hook_payload *request,
 						 &gr->next_channel));
 			subd_req(hin, ld->gossip, req, -1, 0,
 				 channel_resolve_reply, gr);
-		} else
-			handle_localpay(hin, hin->cltv_expiry, &hin->payment_hash,
-					hop_data->amt_forward,
-					hop_data->outgoing_cltv);
+		}
 		break;
 	case htlc_accepted_fail:
 		log_debug(channel->log,
@@ -817,6 +884,7 @@ static bool peer_accepted_htlc(struct channel *channel, u64 id,
 	struct onionpacket *op;
 	struct lightningd *ld = channel->peer->ld;
 	struct htlc_accepted_hook_payload *hook_payload;
+	struct timemono start;
 
 	hin = find_htlc_in(&ld->htlcs_in, channel, id);
 	if (!hin) {
@@ -864,6 +932,7 @@ static bool peer_accepted_htlc(struct channel *channel, u64 id,
 	}
 
 	/* FIXME: Have channeld hand through just the route_step! */
+	start = time_mono();
 
 	/* channeld tests this, so it should pass. */
 	op = parse_onionpacket(tmpctx, hin->onion_routing_packet,
@@ -905,6 +974,8 @@ static bool peer_accepted_htlc(struct channel *channel, u64 id,
 	hook_payload->hin = hin;
 	hook_payload->channel = channel;
 	hook_payload->next_onion = serialize_onionpacket(hook_payload, rs->next);
+	hook_payload->stage_start = forward_stage_done(FORWARD_STAGE_ONION,
+						       start);
 
 	plugin_hook_call_htlc_accepted(ld, hook_payload, hook_payload);
 
@@ -1267,6 +1338,31 @@ static bool peer_save_commitsig_received(struct channel *channel, u64 commitnum,
 	return true;
 }
 
+/* Our reply tells channeld to go ahead and send commitment_signed or
+ * revoke_and_ack, so with --db-write-batch it waits until the db_write plugin
+ * has what we just saved. */
+struct commit_reply {
+	struct subd *owner;
+	const u8 *msg;
+};
+
+static void send_commit_reply(struct commit_reply *cr)
+{
+	subd_send_msg(cr->owner, take(cr->msg));
+	tal_free(cr);
+}
+
+static void reply_after_db_sync(struct channel *channel, const u8 *reply)
+{
+	/* If channeld goes away, so does this. */
+	struct commit_reply *cr = tal(channel->owner, struct commit_reply);
+
+	cr->owner = channel->owner;
+	cr->msg = tal_steal(cr, reply);
+	plugin_hook_db_sync_wait(cr, channel->peer->ld->wallet->db,
+				 send_commit_reply, cr);
+}
+
 static bool peer_save_commitsig_sent(struct channel *channel, u64 commitnum)
 {
 	struct lightningd *ld = channel->peer->ld;
@@ -1353,8 +1449,7 @@ void peer_sending_commitsig(struct channel *channel, const u8 *msg)
 	wallet_channel_save(ld->wallet, channel);
 
 	/* Tell it we've got it, and to go ahead with commitment_signed. */
-	subd_send_msg(channel->owner,
-		      take(towire_channel_sending_commitsig_reply(msg)));
+	reply_after_db_sync(channel, towire_channel_sending_commitsig_reply(msg));
 }
 
 static bool channel_added_their_htlc(struct channel *channel,
@@ -1401,7 +1496,7 @@ static bool channel_added_their_htlc(struct channel *channel,
 					     added->amount);
 
 	log_debug(channel->log, "Adding their HTLC %"PRIu64, added->id);
-	connect_htlc_in(&channel->peer->ld->htlcs_in, hin);
+	connect_htlc_in(&ld->htlcs_in, &ld->htlc_expiries, hin);
 	return true;
 }
 
@@ -1565,8 +1660,7 @@ void peer_got_commitsig(struct channel *channel, const u8 *msg)
 			      channel->last_htlc_sigs);
 
 	/* Tell it we've committed, and to go ahead with revoke. */
-	msg = towire_channel_got_commitsig_reply(msg);
-	subd_send_msg(channel->owner, take(msg));
+	reply_after_db_sync(channel, towire_channel_got_commitsig_reply(msg));
 }
 
 /* Shuffle them over, forgetting the ancient one. */
@@ -1659,8 +1753,7 @@ void peer_got_revoke(struct channel *channel, const u8 *msg)
 	update_per_commit_point(channel, &next_per_commitment_point);
 
 	/* Tell it we've committed, and to go ahead with revoke. */
-	msg = towire_channel_got_revoke_reply(msg);
-	subd_send_msg(channel->owner, take(msg));
+	reply_after_db_sync(channel, towire_channel_got_revoke_reply(msg));
 
 	/* Now, any HTLCs we need to immediately fail? */
 	for (i = 0; i < tal_count(changed); i++) {
@@ -1874,7 +1967,9 @@ static u32 htlc_in_deadline(const struct lightningd *ld,
 
 void htlcs_notify_new_block(struct lightningd *ld, u32 height)
 {
-	bool removed;
+	struct htlc_out *hout;
+	struct htlc_in *hin;
+	u64 idx;
 
 	/* BOLT #2:
 	 *
@@ -1882,39 +1977,31 @@ void htlcs_notify_new_block(struct lightningd *ld, u32 height)
 	 *   commitment transaction, AND is past this timeout deadline:
 	 *     - MUST fail the channel.
 	 */
-	/* FIXME: use db to look this up in one go (earliest deadline per-peer) */
-	do {
-		struct htlc_out *hout;
-		struct htlc_out_map_iter outi;
-
-		removed = false;
-
-		for (hout = htlc_out_map_first(&ld->htlcs_out, &outi);
-		     hout;
-		     hout = htlc_out_map_next(&ld->htlcs_out, &outi)) {
-			/* Not timed out yet? */
-			if (height < htlc_out_deadline(hout))
-				continue;
-
-			/* Peer on chain already? */
-			if (channel_on_chain(hout->key.channel))
-				continue;
-
-			/* Peer already failed, or we hit it? */
-			if (hout->key.channel->error)
-				continue;
+	/* These are in cltv_expiry order, so we only look at the overdue
+	 * ones.  We iterate by index, since failing a channel can free
+	 * HTLCs. */
+	for (hout = uintmap_first(&ld->htlc_expiries.out, &idx);
+	     hout && hout->cltv_expiry < height;
+	     hout = uintmap_after(&ld->htlc_expiries.out, &idx)) {
+		/* Not timed out yet? */
+		if (height < htlc_out_deadline(hout))
+			continue;
 
-			channel_fail_permanent(hout->key.channel,
-					    "Offered HTLC %"PRIu64
-					    " %s cltv %u hit deadline",
-					    hout->key.id,
-					    htlc_state_name(hout->hstate),
-					    hout->cltv_expiry);
-			removed = true;
+		/* Peer on chain already, or already failed?  Neither
+		 * changes back, so we needn't look at this again. */
+		if (channel_on_chain(hout->key.channel)
+		    || hout->key.channel->error) {
+			htlc_out_expiry_remove(hout);
+			continue;
 		}
-	/* Iteration while removing is safe, but can skip entries! */
-	} while (removed);
 
+		channel_fail_permanent(hout->key.channel,
+				       "Offered HTLC %"PRIu64
+				       " %s cltv %u hit deadline",
+				       hout->key.id,
+				       htlc_state_name(hout->hstate),
+				       hout->cltv_expiry);
+	}
 
 	/* BOLT #2:
 	 *
@@ -1925,43 +2012,34 @@ void htlcs_notify_new_block(struct lightningd *ld, u32 height)
 	 *   transaction, AND is past this fulfillment deadline:
 	 *     - MUST fail the channel.
 	 */
-	do {
-		struct htlc_in *hin;
-		struct htlc_in_map_iter ini;
-
-		removed = false;
-
-		for (hin = htlc_in_map_first(&ld->htlcs_in, &ini);
-		     hin;
-		     hin = htlc_in_map_next(&ld->htlcs_in, &ini)) {
-			struct channel *channel = hin->key.channel;
-
-			/* Not fulfilled?  If overdue, that's their problem... */
-			if (!hin->preimage)
-				continue;
-
-			/* Not timed out yet? */
-			if (height < htlc_in_deadline(ld, hin))
-				continue;
+	for (hin = uintmap_first(&ld->htlc_expiries.in, &idx);
+	     hin && hin->cltv_expiry <= height
+		     + (ld->config.cltv_expiry_delta + 1)/2;
+	     hin = uintmap_after(&ld->htlc_expiries.in, &idx)) {
+		struct channel *channel = hin->key.channel;
+
+		/* Not timed out yet? */
+		if (height < htlc_in_deadline(ld, hin))
+			continue;
 
-			/* Peer on chain already? */
-			if (channel_on_chain(channel))
-				continue;
+		/* Peer on chain already, or already failed? */
+		if (channel_on_chain(channel) || channel->error) {
+			htlc_in_expiry_remove(hin);
+			continue;
+		}
 
-			/* Peer already failed, or we hit it? */
-			if (channel->error)
-				continue;
+		/* Not fulfilled?  If overdue, that's their problem...
+		 * but we may yet fulfill it, so keep checking. */
+		if (!hin->preimage)
+			continue;
 
-			channel_fail_permanent(channel,
-					    "Fulfilled HTLC %"PRIu64
-					    " %s cltv %u hit deadline",
-					    hin->key.id,
-					    htlc_state_name(hin->hstate),
-					    hin->cltv_expiry);
-			removed = true;
-		}
-	/* Iteration while removing is safe, but can skip entries! */
-	} while (removed);
+		channel_fail_permanent(channel,
+				       "Fulfilled HTLC %"PRIu64
+				       " %s cltv %u hit deadline",
+				       hin->key.id,
+				       htlc_state_name(hin->hstate),
+				       hin->cltv_expiry);
+	}
 }
 
 #ifdef COMPAT_V061
@@ -2151,6 +2229,48 @@ static const struct json_command dev_ignore_htlcs = {
 	"Set/unset ignoring of all incoming HTLCs.  For testing only."
 };
 AUTODATA(json_command, &dev_ignore_htlcs);
+
+static struct command_result *json_dev_forward_latency(struct command *cmd,
+						       const char *buffer,
+						       const jsmntok_t *obj UNNEEDED,
+						       const jsmntok_t *params)
+{
+	struct json_stream *response;
+	bool *reset;
+
+	if (!param(cmd, buffer, params,
+		   p_opt_def("reset", param_bool, &reset, false),
+		   NULL))
+		return command_param_failed();
+
+	response = json_stream_success(cmd);
+	json_array_start(response, "stages");
+	for (size_t i = 0; i < FORWARD_NUM_STAGES; i++) {
+		const struct forward_stage_stats *st = &forward_stats[i];
+
+		json_object_start(response, NULL);
+		json_add_string(response, "stage", forward_stage_names[i]);
+		json_add_u64(response, "count", st->count);
+		json_add_u64(response, "total_usec", st->total_usec);
+		json_add_u64(response, "avg_usec",
+			     st->count ? st->total_usec / st->count : 0);
+		json_add_u64(response, "max_usec", st->max_usec);
+		json_object_end(response);
+	}
+	json_array_end(response);
+
+	if (*reset)
+		memset(forward_stats, 0, sizeof(forward_stats));
+	return command_success(cmd, response);
+}
+
+static const struct json_command dev_forward_latency = {
+	"dev-forward-latency",
+	"developer",
+	json_dev_forward_latency,
+	"Show how long each stage of forwarding HTLCs has taken, optionally {reset}ting the counters"
+};
+AUTODATA(json_command, &dev_forward_latency);
 #endif /* DEVELOPER */
 
 /* Warp this process to ensure the consistent json object structure
@@ -263,32 +263,24 @@ static void plugin_response_handle(struct plugin *plugin,
  */
 static bool plugin_read_json_one(struct plugin *plugin)
 {
-	bool valid;
-	const jsmntok_t *toks, *jrtok, *idtok;
-
-	/* FIXME: This could be done more efficiently by storing the
-	 * toks and doing an incremental parse, like lightning-cli
-	 * does. */
-	toks = json_parse_input(plugin->buffer, plugin->buffer, plugin->used,
-				&valid);
-	if (!toks) {
-		if (!valid) {
-			plugin_kill(plugin, "Failed to parse JSON response '%.*s'",
-				    (int)plugin->used, plugin->buffer);
-			return false;
-		}
-		/* We need more. */
+	bool complete;
+	const jsmntok_t *jrtok, *idtok;
+
+	/* We keep the parser state, so each byte is only parsed once however
+	 * many reads a (large) response takes to arrive. */
+	if (!json_parse_input_incr(&plugin->parser, &plugin->toks,
+				   plugin->buffer, plugin->used, &complete)) {
+		plugin_kill(plugin, "Failed to parse JSON response '%.*s'",
+			    (int)plugin->used, plugin->buffer);
 		return false;
 	}
 
-	/* Empty buffer? (eg. just whitespace). */
-	if (tal_count(toks) == 1) {
-		plugin->used = 0;
+	/* We need more. */
+	if (!complete)
 		return false;
-	}
 
-	jrtok = json_get_member(plugin->buffer, toks, "jsonrpc");
-	idtok = json_get_member(plugin->buffer, toks, "id");
+	jrtok = json_get_member(plugin->buffer, plugin->toks, "jsonrpc");
+	idtok = json_get_member(plugin->buffer, plugin->toks, "id");
 
 	if (!jrtok) {
 		plugin_kill(
@@ -309,7 +301,7 @@ static bool plugin_read_json_one(struct plugin *plugin)
 		 *
 		 * https://www.jsonrpc.org/specification#notification
 		 */
-		plugin_notification_handle(plugin, toks);
+		plugin_notification_handle(plugin, plugin->toks);
 
 	} else {
 		/* When a rpc call is made, the Server MUST reply with
@@ -339,14 +331,15 @@ static bool plugin_read_json_one(struct plugin *plugin)
 		 *
 		 * https://www.jsonrpc.org/specification#response_object
 		 */
-		plugin_response_handle(plugin, toks, idtok);
+		plugin_response_handle(plugin, plugin->toks, idtok);
 	}
 
-	/* Move this object out of the buffer */
-	memmove(plugin->buffer, plugin->buffer + toks[0].end,
-		tal_count(plugin->buffer) - toks[0].end);
-	plugin->used -= toks[0].end;
-	tal_free(toks);
+	/* Move this object out of the buffer, and start parsing afresh */
+	memmove(plugin->buffer, plugin->buffer + plugin->toks[0].end,
+		tal_count(plugin->buffer) - plugin->toks[0].end);
+	plugin->used -= plugin->toks[0].end;
+	jsmn_init(&plugin->parser);
+	toks_reset(plugin->toks);
 	return true;
 }
 
@@ -979,6 +972,8 @@ void plugins_start(struct plugins *plugins, const char *dev_plugin_debug)
 		else
 			log_debug(plugins->log, "started(%u) %s", p->pid, p->cmd);
 		p->buffer = tal_arr(p, char, 64);
+		jsmn_init(&p->parser);
+		p->toks = toks_alloc(p);
 		p->stop = false;
 
 		/* Create two connections, one read-only on top of p->stdin, and one
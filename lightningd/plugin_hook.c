@@ -1,8 +1,10 @@
 #include <ccan/io/io.h>
+#include <ccan/list/list.h>
 #include <common/memleak.h>
 #include <lightningd/jsonrpc.h>
 #include <lightningd/plugin_hook.h>
 #include <wallet/db.h>
+#include <wallet/db_common.h>
 
 /* Struct containing all the information needed to deserialize and
  * dispatch an eventual plugin_hook response. */
@@ -126,9 +128,43 @@ void plugin_hook_call_(struct lightningd *ld, const struct plugin_hook *hook,
 static struct plugin_hook db_write_hook = { "db_write", NULL, NULL, NULL };
 AUTODATA(hooks, &db_write_hook);
 
-static void db_hook_response(const char *buffer, const jsmntok_t *toks,
-			     const jsmntok_t *idtok,
-			     struct plugin_hook_request *ph_req)
+/* With --db-write-batch, we don't wait for the plugin on every commit:
+ * while one call is outstanding, we collect the writes of every transaction
+ * committed in the meantime, and send them all in the next call.  Anything
+ * the world can see (eg. telling channeld to send commitment_signed) waits
+ * for its transaction to be acknowledged, using plugin_hook_db_sync_wait(). */
+static struct db_write_batch {
+	/* How many transactions we've committed, and how many were acked. */
+	u64 committed, acked;
+	/* How many will be acked by the outstanding call (0 if none). */
+	u64 inflight;
+	/* Writes not sent yet. */
+	const char **writes;
+	/* Who is waiting for transactions to be acked. */
+	struct list_head waiters;
+	/* Are we shutting down, waiting for everything to be acked? */
+	bool flushing;
+} db_batch = { .waiters = LIST_HEAD_INIT(db_batch.waiters) };
+
+struct db_write_waiter {
+	struct list_node list;
+	/* Transaction we're waiting for. */
+	u64 committed;
+	void (*cb)(void *arg);
+	void *arg;
+};
+
+static void destroy_db_write_waiter(struct db_write_waiter *w)
+{
+	list_del(&w->list);
+}
+
+static bool db_write_batching(const struct plugin_hook *hook)
+{
+	return hook->plugin && hook->plugin->plugins->ld->db_write_batch;
+}
+
+static void db_hook_check_response(const char *buffer, const jsmntok_t *toks)
 {
 	const jsmntok_t *resulttok;
 	bool resp;
@@ -146,11 +182,83 @@ static void db_hook_response(const char *buffer, const jsmntok_t *toks,
 	/* If it fails, we must not commit to our db. */
 	if (!resp)
 		fatal("Plugin returned failed db_write: %s.", buffer);
+}
+
+static void db_hook_response(const char *buffer, const jsmntok_t *toks,
+			     const jsmntok_t *idtok,
+			     struct plugin_hook_request *ph_req)
+{
+	db_hook_check_response(buffer, toks);
 
 	/* We're done, exit exclusive loop. */
 	io_break(ph_req);
 }
 
+static void db_batch_inflight_gone(struct plugin_hook_request *ph_req UNUSED)
+{
+	/* We can't tell peers about anything now it might not be backed up. */
+	fatal("db_write plugin went away with writes outstanding");
+}
+
+static void db_batch_send(const struct plugin_hook *hook, struct db *db);
+
+static void db_batch_response(const char *buffer, const jsmntok_t *toks,
+			      const jsmntok_t *idtok,
+			      struct plugin_hook_request *ph_req)
+{
+	struct db_write_waiter *w;
+	struct db *db = ph_req->db;
+
+	db_hook_check_response(buffer, toks);
+
+	db_batch.acked = db_batch.inflight;
+	db_batch.inflight = 0;
+	tal_del_destructor(ph_req, db_batch_inflight_gone);
+	tal_free(ph_req);
+
+	/* Send whatever accumulated while we waited. */
+	db_batch_send(&db_write_hook, db);
+
+	/* Waiters are in order, so stop at the first still waiting. */
+	while ((w = list_top(&db_batch.waiters, struct db_write_waiter, list))
+	       && w->committed <= db_batch.acked) {
+		void (*cb)(void *arg) = w->cb;
+		void *arg = w->arg;
+
+		tal_free(w);
+		cb(arg);
+	}
+
+	if (db_batch.flushing && !db_batch.inflight)
+		io_break(&db_batch);
+}
+
+static void db_batch_send(const struct plugin_hook *hook, struct db *db)
+{
+	struct jsonrpc_request *req;
+	struct plugin_hook_request *ph_req;
+
+	if (db_batch.inflight || !db_batch.writes)
+		return;
+
+	ph_req = notleak(tal(hook->plugin, struct plugin_hook_request));
+	req = jsonrpc_request_start(NULL, hook->name, NULL, db_batch_response,
+				    ph_req);
+	ph_req->hook = hook;
+	ph_req->db = db;
+	tal_add_destructor(ph_req, db_batch_inflight_gone);
+
+	json_array_start(req->stream, "writes");
+	for (size_t i = 0; i < tal_count(db_batch.writes); i++)
+		json_add_string(req->stream, NULL, db_batch.writes[i]);
+	json_array_end(req->stream);
+	jsonrpc_request_end(req);
+
+	plugin_request_send(hook->plugin, req);
+	db_batch.writes = tal_free(db_batch.writes);
+	db_batch.inflight = db_batch.committed;
+}
+
 void plugin_hook_db_sync(struct db *db, const char **changes, const char *final)
 {
 	const struct plugin_hook *hook = &db_write_hook;
@@ -161,6 +269,20 @@ void plugin_hook_db_sync(struct db *db, const char **changes, const char *final)
 	if (!hook->plugin)
 		return;
 
+	if (db_write_batching(hook)) {
+		if (!db_batch.writes)
+			db_batch.writes = notleak(tal_arr(NULL, const char *, 0));
+		for (size_t i = 0; i < tal_count(changes); i++)
+			tal_arr_expand(&db_batch.writes,
+				       tal_strdup(db_batch.writes, changes[i]));
+		if (final)
+			tal_arr_expand(&db_batch.writes,
+				       tal_strdup(db_batch.writes, final));
+		db_batch.committed++;
+		db_batch_send(hook, db);
+		return;
+	}
+
 	ph_req = notleak(tal(hook->plugin, struct plugin_hook_request));
 	/* FIXME: do IO logging for this! */
 	req = jsonrpc_request_start(NULL, hook->name, NULL, db_hook_response,
@@ -189,3 +311,46 @@ void plugin_hook_db_sync(struct db *db, const char **changes, const char *final)
 		io_break(ret);
 	}
 }
+
+void plugin_hook_db_sync_wait_(const tal_t *ctx, struct db *db,
+			       void (*cb)(void *arg), void *arg)
+{
+	struct db_write_waiter *w;
+	u64 committed = db_batch.committed;
+
+	/* This transaction's writes will be reported when it commits. */
+	if (db_in_transaction(db) && tal_count(db->changes) != 0)
+		committed++;
+
+	if (!db_write_batching(&db_write_hook) || committed <= db_batch.acked) {
+		cb(arg);
+		return;
+	}
+
+	w = tal(ctx, struct db_write_waiter);
+	w->committed = committed;
+	w->cb = cb;
+	w->arg = arg;
+	list_add_tail(&db_batch.waiters, &w->list);
+	tal_add_destructor(w, destroy_db_write_waiter);
+}
+
+void plugin_hook_db_sync_flush(void)
+{
+	const struct plugin_hook *hook = &db_write_hook;
+
+	if (!db_write_batching(hook))
+		return;
+
+	db_batch.flushing = true;
+	while (db_batch.inflight) {
+		void *ret = plugin_exclusive_loop(hook->plugin);
+		/* As in plugin_hook_db_sync, we could be breaking already. */
+		if (ret != &db_batch) {
+			while (db_batch.inflight)
+				plugin_exclusive_loop(hook->plugin);
+			io_break(ret);
+		}
+	}
+	db_batch.flushing = false;
+}
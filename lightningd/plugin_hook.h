@@ -112,4 +112,19 @@ void plugin_hook_unregister_all(struct plugin *plugin);
  * final command appended. */
 void plugin_hook_db_sync(struct db *db, const char **changes, const char *final);
 
+/* With --db-write-batch, plugin_hook_db_sync() doesn't wait for the plugin.
+ * This calls @cb once it has acknowledged everything committed so far,
+ * including the current transaction (immediately, if not batching).
+ * Freeing @ctx cancels it. */
+#define plugin_hook_db_sync_wait(ctx, db, cb, arg)			\
+	plugin_hook_db_sync_wait_((ctx), (db),				\
+				  typesafe_cb(void, void *, (cb), (arg)), \
+				  (arg))
+
+void plugin_hook_db_sync_wait_(const tal_t *ctx, struct db *db,
+			       void (*cb)(void *arg), void *arg);
+
+/* Wait until the plugin has acknowledged all writes (for shutdown). */
+void plugin_hook_db_sync_flush(void);
+
 #endif /* LIGHTNING_LIGHTNINGD_PLUGIN_HOOK_H */
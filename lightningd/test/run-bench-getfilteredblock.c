@@ -0,0 +1,312 @@
+#include "../../common/json_helpers.c"
+#include "../bitcoind.c"
+#include <bitcoin/script.h>
+#include <ccan/err/err.h>
+#include <ccan/opt/opt.h>
+#include <common/test/bench.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <wallet/wallet.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for bigsize_get */
+size_t bigsize_get(const u8 *p UNNEEDED, size_t max UNNEEDED, bigsize_t *val UNNEEDED)
+{ fprintf(stderr, "bigsize_get called!\n"); abort(); }
+/* Generated stub for bigsize_put */
+size_t bigsize_put(u8 buf[BIGSIZE_MAX_LEN] UNNEEDED, bigsize_t v UNNEEDED)
+{ fprintf(stderr, "bigsize_put called!\n"); abort(); }
+/* Generated stub for fatal */
+void   fatal(const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "fatal called!\n"); abort(); }
+/* Generated stub for feerate_from_style */
+u32 feerate_from_style(u32 feerate UNNEEDED, enum feerate_style style UNNEEDED)
+{ fprintf(stderr, "feerate_from_style called!\n"); abort(); }
+/* Generated stub for get_chainparams */
+const struct chainparams *get_chainparams(const struct lightningd *ld UNNEEDED)
+{ fprintf(stderr, "get_chainparams called!\n"); abort(); }
+/* Generated stub for new_reltimer_ */
+struct oneshot *new_reltimer_(struct timers *timers UNNEEDED,
+			      const tal_t *ctx UNNEEDED,
+			      struct timerel expire UNNEEDED,
+			      void (*cb)(void *) UNNEEDED, void *arg UNNEEDED)
+{ fprintf(stderr, "new_reltimer_ called!\n"); abort(); }
+/* Generated stub for node_id_from_hexstr */
+bool node_id_from_hexstr(const char *str UNNEEDED, size_t slen UNNEEDED, struct node_id *id UNNEEDED)
+{ fprintf(stderr, "node_id_from_hexstr called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+/* We don't care about these. */
+void db_begin_transaction_(struct db *db UNNEEDED, const char *location UNNEEDED)
+{
+}
+
+void db_commit_transaction(struct db *db UNNEEDED)
+{
+}
+
+void log_(struct log *log UNNEEDED, enum log_level level UNNEEDED,
+	  bool call_notifier UNNEEDED, const char *fmt UNNEEDED, ...)
+{
+}
+
+/* Blocks we replay, by height. */
+static char **blockhex;
+static struct bitcoin_blkid *blkids;
+static unsigned int stub_delay_usec;
+
+/* A regtest-style block: a coinbase, then txs full of P2WSH outputs. */
+static char *make_block(const tal_t *ctx, const struct chainparams *chainparams,
+			u32 height, size_t num_txs, size_t num_outputs)
+{
+	u8 *block = tal_arr(tmpctx, u8, 0);
+	u8 hdr[80];
+	u8 *witnessscript = tal_arr(tmpctx, u8, 1);
+
+	memset(hdr, 0, sizeof(hdr));
+	memcpy(hdr + 68, &height, sizeof(height));
+	towire(&block, hdr, sizeof(hdr));
+	towire_u8(&block, num_txs);
+
+	for (size_t i = 0; i < num_txs; i++) {
+		struct bitcoin_tx *tx = bitcoin_tx(tmpctx, chainparams, 1,
+						   num_outputs);
+		struct bitcoin_txid prev;
+
+		memset(&prev, 0, sizeof(prev));
+		memcpy(&prev, &height, sizeof(height));
+		memcpy((u8 *)&prev + sizeof(height), &i, sizeof(i));
+		bitcoin_tx_add_input(tx, &prev, 0, 0xFFFFFFFF,
+				     AMOUNT_SAT(100000000), NULL);
+		for (size_t j = 0; j < num_outputs; j++) {
+			/* OP_1 .. OP_16 */
+			witnessscript[0] = 0x51 + j % 16;
+			bitcoin_tx_add_output(tx,
+					      scriptpubkey_p2wsh(tx,
+								 witnessscript),
+					      AMOUNT_SAT(100000));
+		}
+		towire(&block, linearize_tx(tmpctx, tx),
+		       tal_count(linearize_tx(tmpctx, tx)));
+	}
+	return tal_hex(ctx, block);
+}
+
+static const char *param(const tal_t *ctx, const char *body, size_t n)
+{
+	const char *p = strstr(body, "\"params\":[");
+
+	p += strlen("\"params\":[");
+	while (n--)
+		p = strchr(p, ',') + 1;
+	return tal_strndup(ctx, p, strcspn(p, ",]"));
+}
+
+static char *stub_reply(const tal_t *ctx, const char *body)
+{
+	if (strstr(body, "\"getblockhash\"")) {
+		u32 height = atoi(param(tmpctx, body, 0));
+		if (height >= tal_count(blkids))
+			return "{\"result\":null,\"error\":{\"code\":-8,"
+				"\"message\":\"Block height out of range\"},"
+				"\"id\":0}";
+		return tal_fmt(ctx, "{\"result\":\"%s\",\"error\":null,\"id\":0}",
+			       type_to_string(tmpctx, struct bitcoin_blkid,
+					      &blkids[height]));
+	}
+	if (strstr(body, "\"getblock\"")) {
+		const char *hash = param(tmpctx, body, 0);
+		for (size_t i = 0; i < tal_count(blkids); i++) {
+			const char *h = tal_fmt(tmpctx, "\"%s\"",
+						type_to_string(tmpctx,
+							       struct bitcoin_blkid,
+							       &blkids[i]));
+			if (streq(h, hash))
+				return tal_fmt(ctx, "{\"result\":\"%s\","
+					       "\"error\":null,\"id\":0}",
+					       blockhex[i]);
+		}
+	}
+	if (strstr(body, "\"gettxout\"")) {
+		/* Every third output has been spent. */
+		if (atoi(param(tmpctx, body, 1)) % 3 == 0)
+			return "{\"result\":null,\"error\":null,\"id\":0}";
+		return "{\"result\":{\"value\":0.00100000,\"scriptPubKey\":"
+			"{\"hex\":\"00\"}},\"error\":null,\"id\":0}";
+	}
+	errx(1, "stub bitcoind: unexpected request %s", body);
+}
+
+static void stub_serve(int fd)
+{
+	char *buf = tal_arr(NULL, char, 4096);
+	size_t len = 0;
+
+	for (;;) {
+		const char *clen = NULL, *body;
+		char *end, *reply;
+		size_t reqlen;
+
+		while (!(end = memmem(buf, len, "\r\n\r\n", 4))
+		       || len < end + 4 - buf + strtoul(clen, NULL, 10)) {
+			ssize_t r;
+			if (len + 1 == tal_count(buf))
+				tal_resize(&buf, len * 2);
+			r = read(fd, buf + len, tal_count(buf) - len - 1);
+			if (r <= 0)
+				return;
+			len += r;
+			buf[len] = '\0';
+			clen = strstr(buf, "Content-Length: ");
+			assert(clen);
+			clen += strlen("Content-Length: ");
+		}
+
+		reqlen = end + 4 - buf + strtoul(clen, NULL, 10);
+		usleep(stub_delay_usec);
+		body = stub_reply(tmpctx, tal_strndup(tmpctx, end + 4,
+						      reqlen - (end + 4 - buf)));
+		reply = tal_fmt(tmpctx, "HTTP/1.1 200 OK\r\n"
+				"Content-Type: application/json\r\n"
+				"Content-Length: %zu\r\n\r\n%s",
+				strlen(body), body);
+		assert(write_all(fd, reply, strlen(reply)));
+		memmove(buf, buf + reqlen, len - reqlen);
+		len -= reqlen;
+		clean_tmpctx();
+	}
+}
+
+static pid_t stub_bitcoind(u16 *port)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	pid_t pid;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (fd < 0
+	    || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+	    || listen(fd, 16) != 0
+	    || getsockname(fd, (struct sockaddr *)&addr, &addrlen) != 0)
+		err(1, "stub bitcoind");
+	*port = ntohs(addr.sin_port);
+
+	pid = fork();
+	if (pid < 0)
+		err(1, "fork");
+	if (pid == 0) {
+		/* Like bitcoind, serve connections in parallel. */
+		signal(SIGCHLD, SIG_IGN);
+		for (;;) {
+			int conn = accept(fd, NULL, NULL);
+			if (conn < 0)
+				err(1, "accept");
+			if (fork() == 0) {
+				stub_serve(conn);
+				exit(0);
+			}
+			close(conn);
+		}
+	}
+	close(fd);
+	return pid;
+}
+
+static size_t num_pending, num_unspent;
+
+static void got_filteredblock(struct bitcoind *bitcoind UNUSED,
+			      const struct filteredblock *fb,
+			      u32 *height)
+{
+	assert(fb->height == *height);
+	assert(bitcoin_blkid_eq(&fb->id, &blkids[*height]));
+	num_unspent += tal_count(fb->outpoints);
+	if (--num_pending == 0)
+		io_break(&num_pending);
+}
+
+static void replay(struct bitcoind *bitcoind, u32 *heights,
+		   const char *what)
+{
+	struct timemono start = time_mono();
+	u64 usec;
+
+	num_unspent = 0;
+	for (size_t i = 0; i < tal_count(heights); i++) {
+		bitcoind_getfilteredblock(bitcoind, heights[i],
+					  got_filteredblock, &heights[i]);
+		num_pending++;
+	}
+	io_loop(NULL, NULL);
+	assert(num_pending == 0);
+
+	usec = bench_usec_since(start);
+	printf("%s: %zu blocks (%zu unspent P2WSH outputs) in %"PRIu64
+	       " msec (%.1f blocks/sec)\n",
+	       what, tal_count(heights), num_unspent, usec / 1000,
+	       bench_per_sec(tal_count(heights), usec));
+}
+
+int main(int argc, char *argv[])
+{
+	struct lightningd *ld;
+	struct bitcoind *bitcoind;
+	size_t num_blocks = FILTEREDBLOCK_CACHE_SIZE, num_txs = 10;
+	size_t num_outputs = 10;
+	u32 *heights;
+	u16 port;
+	pid_t pid;
+
+	setup_locale();
+	setup_tmpctx();
+
+	opt_register_arg("--stub-delay", opt_set_uintval, opt_show_uintval,
+			 &stub_delay_usec,
+			 "Microseconds the stub bitcoind takes per request");
+	opt_parse(&argc, argv, opt_log_stderr_exit);
+	bench_sizes(argc, argv, "[num_blocks [num_outputs]]",
+		    &num_blocks, &num_outputs);
+
+	/* Not off tmpctx: the stub bitcoind cleans that after each reply. */
+	ld = tal(NULL, struct lightningd);
+	ld->wallet = NULL;
+	bitcoind = new_bitcoind(ld, ld, NULL);
+	ld->wallet = tal(ld, struct wallet);
+	ld->wallet->db = NULL;
+	ld->topology = tal(ld, struct chain_topology);
+	ld->topology->poll_seconds = 30;
+	bitcoind->chainparams = chainparams_for_network("regtest");
+	bitcoind->rpcuser = tal_strdup(bitcoind, "user");
+	bitcoind->rpcpass = tal_strdup(bitcoind, "pass");
+
+	blockhex = tal_arr(ld, char *, num_blocks);
+	blkids = tal_arr(ld, struct bitcoin_blkid, num_blocks);
+	heights = tal_arr(ld, u32, num_blocks);
+	for (size_t i = 0; i < num_blocks; i++) {
+		blockhex[i] = make_block(blockhex, bitcoind->chainparams,
+					 i, num_txs, num_outputs);
+		sha256_double(&blkids[i].shad, &i, sizeof(i));
+		heights[i] = i;
+	}
+
+	pid = stub_bitcoind(&port);
+	bitcoind->rpcport = tal_fmt(bitcoind, "%u", port);
+	assert(rpc_setup(bitcoind));
+
+	replay(bitcoind, heights, "Fetching");
+	assert(num_unspent == num_blocks * num_txs
+	       * (num_outputs - (num_outputs + 2) / 3));
+	replay(bitcoind, heights, "Cached");
+
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+
+	tal_free(ld);
+	tal_free(tmpctx);
+	opt_free_table();
+	return 0;
+}
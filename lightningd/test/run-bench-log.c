@@ -0,0 +1,177 @@
+/* How long does the main thread spend logging to a file, with and without
+ * the writer thread?
+ *
+ * Usage: run-bench-log [lines]
+ *
+ * Try 1000000: the default is kept small so check-units stays quick. */
+#include "../log.c"
+#include <ccan/err/err.h>
+#include <ccan/tal/grab_file/grab_file.h>
+#include <ccan/tal/str/str.h>
+#include <common/test/bench.h>
+#include <stdio.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for bigsize_get */
+size_t bigsize_get(const u8 *p UNNEEDED, size_t max UNNEEDED, bigsize_t *val UNNEEDED)
+{ fprintf(stderr, "bigsize_get called!\n"); abort(); }
+/* Generated stub for bigsize_put */
+size_t bigsize_put(u8 buf[BIGSIZE_MAX_LEN] UNNEEDED, bigsize_t v UNNEEDED)
+{ fprintf(stderr, "bigsize_put called!\n"); abort(); }
+/* Generated stub for command_fail */
+struct command_result *command_fail(struct command *cmd UNNEEDED, int code UNNEEDED,
+				    const char *fmt UNNEEDED, ...)
+
+{ fprintf(stderr, "command_fail called!\n"); abort(); }
+/* Generated stub for command_param_failed */
+struct command_result *command_param_failed(void)
+
+{ fprintf(stderr, "command_param_failed called!\n"); abort(); }
+/* Generated stub for command_success */
+struct command_result *command_success(struct command *cmd UNNEEDED,
+				       struct json_stream *response)
+
+{ fprintf(stderr, "command_success called!\n"); abort(); }
+/* Generated stub for json_add_hex */
+void json_add_hex(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		  const void *data UNNEEDED, size_t len UNNEEDED)
+{ fprintf(stderr, "json_add_hex called!\n"); abort(); }
+/* Generated stub for json_add_num */
+void json_add_num(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		  unsigned int value UNNEEDED)
+{ fprintf(stderr, "json_add_num called!\n"); abort(); }
+/* Generated stub for json_add_string */
+void json_add_string(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED, const char *value UNNEEDED)
+{ fprintf(stderr, "json_add_string called!\n"); abort(); }
+/* Generated stub for json_add_time */
+void json_add_time(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+			  struct timespec ts UNNEEDED)
+{ fprintf(stderr, "json_add_time called!\n"); abort(); }
+/* Generated stub for json_array_end */
+void json_array_end(struct json_stream *js UNNEEDED)
+{ fprintf(stderr, "json_array_end called!\n"); abort(); }
+/* Generated stub for json_array_start */
+void json_array_start(struct json_stream *js UNNEEDED, const char *fieldname UNNEEDED)
+{ fprintf(stderr, "json_array_start called!\n"); abort(); }
+/* Generated stub for json_object_end */
+void json_object_end(struct json_stream *js UNNEEDED)
+{ fprintf(stderr, "json_object_end called!\n"); abort(); }
+/* Generated stub for json_object_start */
+void json_object_start(struct json_stream *ks UNNEEDED, const char *fieldname UNNEEDED)
+{ fprintf(stderr, "json_object_start called!\n"); abort(); }
+/* Generated stub for json_stream_log_suppress_for_cmd */
+void json_stream_log_suppress_for_cmd(struct json_stream *js UNNEEDED,
+					    const struct command *cmd UNNEEDED)
+{ fprintf(stderr, "json_stream_log_suppress_for_cmd called!\n"); abort(); }
+/* Generated stub for json_stream_success */
+struct json_stream *json_stream_success(struct command *cmd UNNEEDED)
+{ fprintf(stderr, "json_stream_success called!\n"); abort(); }
+/* Generated stub for notify_warning */
+void notify_warning(struct lightningd *ld UNNEEDED, struct log_entry *l UNNEEDED)
+{ fprintf(stderr, "notify_warning called!\n"); abort(); }
+/* Generated stub for param */
+bool param(struct command *cmd UNNEEDED, const char *buffer UNNEEDED,
+	   const jsmntok_t params[] UNNEEDED, ...)
+{ fprintf(stderr, "param called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+/* Returns number of lines which were ours, and the first one. */
+static size_t count_lines(const tal_t *ctx, const char *filename,
+			  const char **first)
+{
+	char *contents = grab_file(ctx, filename);
+	char **lines;
+	size_t ours = 0;
+
+	if (!contents)
+		err(1, "Reading %s", filename);
+	lines = tal_strsplit(ctx, contents, "\n", STR_NO_EMPTY);
+	for (size_t i = 0; lines[i]; i++) {
+		if (!strstr(lines[i], "Sending update_add_htlc"))
+			continue;
+		if (ours++ == 0)
+			*first = lines[i];
+	}
+	return ours;
+}
+
+static void bench(const char *name, struct log *log, size_t num_lines,
+		  struct log_writer *w)
+{
+	struct timemono start;
+	struct timespec cpu_start;
+	u64 cpu_usec, logged_usec;
+
+	start = time_mono();
+	cpu_start = bench_cpu_now();
+	for (size_t i = 0; i < num_lines; i++)
+		log_debug(log, "Sending update_add_htlc id %zu amount_msat=%zu"
+			  " cltv=%zu", i, i * 1000, 600000 + i % 144);
+	cpu_usec = bench_cpu_usec_since(cpu_start);
+	logged_usec = bench_usec_since(start);
+	if (w)
+		log_writer_flush(w);
+
+	printf("%s: %zu lines: main thread %"PRIu64" usec cpu"
+	       " (%.2f usec/line), %"PRIu64" usec wall,"
+	       " %"PRIu64" usec until written\n",
+	       name, num_lines, cpu_usec, (double)cpu_usec / num_lines,
+	       logged_usec, bench_usec_since(start));
+}
+
+int main(int argc, char *argv[])
+{
+	char direct_file[] = "/tmp/run-bench-log.XXXXXX";
+	char writer_file[] = "/tmp/run-bench-log.XXXXXX";
+	const char *direct_line, *writer_line;
+	size_t num_lines = 50;
+	u64 dropped;
+	struct log_book *lr;
+	struct log_writer *w;
+	struct log *log;
+	FILE *logf;
+	int fd;
+
+	bench_sizes(argc, argv, "[num_lines]", &num_lines);
+
+	setup_locale();
+	setup_tmpctx();
+
+	lr = new_log_book(NULL, 20*1024*1024, LOG_DBG);
+	log = new_log(NULL, lr, "lightningd(%u):", 1234);
+
+	/* The old way: format and fflush every line. */
+	fd = mkstemp(direct_file);
+	if (fd < 0)
+		err(1, "mkstemp");
+	logf = fdopen(fd, "w");
+	set_log_outfn(lr, log_to_file, logf);
+	bench("direct", log, num_lines, NULL);
+	fclose(logf);
+
+	fd = mkstemp(writer_file);
+	if (fd < 0)
+		err(1, "mkstemp");
+	w = new_log_writer(NULL, fd);
+	set_log_outfn(lr, log_to_writer, w);
+	bench("writer", log, num_lines, w);
+
+	/* Every line is either written or counted as dropped. */
+	dropped = atomic_load(&w->dropped);
+	printf("writer: %"PRIu64" lines dropped\n", dropped);
+	tal_free(w);
+	assert(count_lines(tmpctx, writer_file, &writer_line) + dropped
+	       == num_lines);
+
+	/* And we write exactly what we used to, apart from the timestamp. */
+	assert(count_lines(tmpctx, direct_file, &direct_line) == num_lines);
+	if (dropped == 0)
+		assert(streq(direct_line + strlen("YYYY-mm-ddTHH:MM:SS.nnnZ"),
+			     writer_line + strlen("YYYY-mm-ddTHH:MM:SS.nnnZ")));
+
+	unlink(direct_file);
+	unlink(writer_file);
+	tal_free(log);
+	tal_free(tmpctx);
+	return 0;
+}
@@ -0,0 +1,600 @@
+#include "../../common/node_id.c"
+#include "../channel.c"
+#include "../peer_control.c"
+#include <common/pseudorand.h>
+#include <common/test/bench.h>
+#include <stdio.h>
+
+bool deprecated_apis = false;
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for bigsize_get */
+size_t bigsize_get(const u8 *p UNNEEDED, size_t max UNNEEDED, bigsize_t *val UNNEEDED)
+{ fprintf(stderr, "bigsize_get called!\n"); abort(); }
+/* Generated stub for bigsize_put */
+size_t bigsize_put(u8 buf[BIGSIZE_MAX_LEN] UNNEEDED, bigsize_t v UNNEEDED)
+{ fprintf(stderr, "bigsize_put called!\n"); abort(); }
+/* Generated stub for bitcoind_gettxout */
+void bitcoind_gettxout(struct bitcoind *bitcoind UNNEEDED,
+		       const struct bitcoin_txid *txid UNNEEDED, const u32 outnum UNNEEDED,
+		       void (*cb)(struct bitcoind *bitcoind UNNEEDED,
+				  const struct bitcoin_tx_output *txout UNNEEDED,
+				  void *arg) UNNEEDED,
+		       void *arg UNNEEDED)
+{ fprintf(stderr, "bitcoind_gettxout called!\n"); abort(); }
+/* Generated stub for broadcast_tx */
+void broadcast_tx(struct chain_topology *topo UNNEEDED,
+		  struct channel *channel UNNEEDED, const struct bitcoin_tx *tx UNNEEDED,
+		  void (*failed)(struct channel *channel UNNEEDED,
+				 int exitstatus UNNEEDED,
+				 const char *err))
+{ fprintf(stderr, "broadcast_tx called!\n"); abort(); }
+/* Generated stub for channel_tell_depth */
+bool channel_tell_depth(struct lightningd *ld UNNEEDED,
+				 struct channel *channel UNNEEDED,
+				 const struct bitcoin_txid *txid UNNEEDED,
+				 u32 depth UNNEEDED)
+{ fprintf(stderr, "channel_tell_depth called!\n"); abort(); }
+/* Generated stub for command_fail */
+struct command_result *command_fail(struct command *cmd UNNEEDED, int code UNNEEDED,
+				    const char *fmt UNNEEDED, ...)
+
+{ fprintf(stderr, "command_fail called!\n"); abort(); }
+/* Generated stub for command_param_failed */
+struct command_result *command_param_failed(void)
+
+{ fprintf(stderr, "command_param_failed called!\n"); abort(); }
+/* Generated stub for command_still_pending */
+struct command_result *command_still_pending(struct command *cmd)
+
+{ fprintf(stderr, "command_still_pending called!\n"); abort(); }
+/* Generated stub for command_success */
+struct command_result *command_success(struct command *cmd UNNEEDED,
+				       struct json_stream *response)
+
+{ fprintf(stderr, "command_success called!\n"); abort(); }
+/* Generated stub for connect_succeeded */
+void connect_succeeded(struct lightningd *ld UNNEEDED, const struct node_id *id UNNEEDED)
+{ fprintf(stderr, "connect_succeeded called!\n"); abort(); }
+/* Generated stub for delay_then_reconnect */
+void delay_then_reconnect(struct channel *channel UNNEEDED, u32 seconds_delay UNNEEDED,
+			  const struct wireaddr_internal *addrhint TAKES UNNEEDED)
+{ fprintf(stderr, "delay_then_reconnect called!\n"); abort(); }
+/* Generated stub for fatal */
+void   fatal(const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "fatal called!\n"); abort(); }
+/* Generated stub for fromwire_channel_dev_memleak_reply */
+bool fromwire_channel_dev_memleak_reply(const void *p UNNEEDED, bool *leak UNNEEDED)
+{ fprintf(stderr, "fromwire_channel_dev_memleak_reply called!\n"); abort(); }
+/* Generated stub for fromwire_connect_peer_connected */
+bool fromwire_connect_peer_connected(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct node_id *id UNNEEDED, struct wireaddr_internal *addr UNNEEDED, struct per_peer_state **pps UNNEEDED, u8 **globalfeatures UNNEEDED, u8 **localfeatures UNNEEDED)
+{ fprintf(stderr, "fromwire_connect_peer_connected called!\n"); abort(); }
+/* Generated stub for fromwire_hsm_get_channel_basepoints_reply */
+bool fromwire_hsm_get_channel_basepoints_reply(const void *p UNNEEDED, struct basepoints *basepoints UNNEEDED, struct pubkey *funding_pubkey UNNEEDED)
+{ fprintf(stderr, "fromwire_hsm_get_channel_basepoints_reply called!\n"); abort(); }
+/* Generated stub for fromwire_hsm_sign_commitment_tx_reply */
+bool fromwire_hsm_sign_commitment_tx_reply(const void *p UNNEEDED, struct bitcoin_signature *sig UNNEEDED)
+{ fprintf(stderr, "fromwire_hsm_sign_commitment_tx_reply called!\n"); abort(); }
+/* Generated stub for fromwire_onchain_dev_memleak_reply */
+bool fromwire_onchain_dev_memleak_reply(const void *p UNNEEDED, bool *leak UNNEEDED)
+{ fprintf(stderr, "fromwire_onchain_dev_memleak_reply called!\n"); abort(); }
+/* Generated stub for get_block_height */
+u32 get_block_height(const struct chain_topology *topo UNNEEDED)
+{ fprintf(stderr, "get_block_height called!\n"); abort(); }
+/* Generated stub for get_chainparams */
+const struct chainparams *get_chainparams(const struct lightningd *ld UNNEEDED)
+{ fprintf(stderr, "get_chainparams called!\n"); abort(); }
+/* Generated stub for htlc_is_trimmed */
+bool htlc_is_trimmed(enum side htlc_owner UNNEEDED,
+		     struct amount_msat htlc_amount UNNEEDED,
+		     u32 feerate_per_kw UNNEEDED,
+		     struct amount_sat dust_limit UNNEEDED,
+		     enum side side UNNEEDED)
+{ fprintf(stderr, "htlc_is_trimmed called!\n"); abort(); }
+/* Generated stub for htlcs_reconnect */
+struct htlc_in_map *htlcs_reconnect(struct lightningd *ld UNNEEDED,
+				    struct htlc_in_map *htlcs_in UNNEEDED,
+				    struct htlc_out_map *htlcs_out UNNEEDED)
+{ fprintf(stderr, "htlcs_reconnect called!\n"); abort(); }
+/* Generated stub for json_add_address */
+void json_add_address(struct json_stream *response UNNEEDED, const char *fieldname UNNEEDED,
+		      const struct wireaddr *addr UNNEEDED)
+{ fprintf(stderr, "json_add_address called!\n"); abort(); }
+/* Generated stub for json_add_address_internal */
+void json_add_address_internal(struct json_stream *response UNNEEDED,
+			       const char *fieldname UNNEEDED,
+			       const struct wireaddr_internal *addr UNNEEDED)
+{ fprintf(stderr, "json_add_address_internal called!\n"); abort(); }
+/* Generated stub for json_add_amount_msat_compat */
+void json_add_amount_msat_compat(struct json_stream *result UNNEEDED,
+				 struct amount_msat msat UNNEEDED,
+				 const char *rawfieldname UNNEEDED,
+				 const char *msatfieldname)
+
+{ fprintf(stderr, "json_add_amount_msat_compat called!\n"); abort(); }
+/* Generated stub for json_add_amount_sat_compat */
+void json_add_amount_sat_compat(struct json_stream *result UNNEEDED,
+				struct amount_sat sat UNNEEDED,
+				const char *rawfieldname UNNEEDED,
+				const char *msatfieldname)
+
+{ fprintf(stderr, "json_add_amount_sat_compat called!\n"); abort(); }
+/* Generated stub for json_add_bool */
+void json_add_bool(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		   bool value UNNEEDED)
+{ fprintf(stderr, "json_add_bool called!\n"); abort(); }
+/* Generated stub for json_add_hex_talarr */
+void json_add_hex_talarr(struct json_stream *result UNNEEDED,
+			 const char *fieldname UNNEEDED,
+			 const tal_t *data UNNEEDED)
+{ fprintf(stderr, "json_add_hex_talarr called!\n"); abort(); }
+/* Generated stub for json_add_log */
+void json_add_log(struct json_stream *result UNNEEDED,
+		  const struct log_book *lr UNNEEDED, enum log_level minlevel UNNEEDED)
+{ fprintf(stderr, "json_add_log called!\n"); abort(); }
+/* Generated stub for json_add_node_id */
+void json_add_node_id(struct json_stream *response UNNEEDED,
+				const char *fieldname UNNEEDED,
+				const struct node_id *id UNNEEDED)
+{ fprintf(stderr, "json_add_node_id called!\n"); abort(); }
+/* Generated stub for json_add_num */
+void json_add_num(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		  unsigned int value UNNEEDED)
+{ fprintf(stderr, "json_add_num called!\n"); abort(); }
+/* Generated stub for json_add_sha256 */
+void json_add_sha256(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		     const struct sha256 *hash UNNEEDED)
+{ fprintf(stderr, "json_add_sha256 called!\n"); abort(); }
+/* Generated stub for json_add_short_channel_id */
+void json_add_short_channel_id(struct json_stream *response UNNEEDED,
+			       const char *fieldname UNNEEDED,
+			       const struct short_channel_id *id UNNEEDED)
+{ fprintf(stderr, "json_add_short_channel_id called!\n"); abort(); }
+/* Generated stub for json_add_string */
+void json_add_string(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED, const char *value UNNEEDED)
+{ fprintf(stderr, "json_add_string called!\n"); abort(); }
+/* Generated stub for json_add_tx */
+void json_add_tx(struct json_stream *result UNNEEDED,
+		 const char *fieldname UNNEEDED,
+		 const struct bitcoin_tx *tx UNNEEDED)
+{ fprintf(stderr, "json_add_tx called!\n"); abort(); }
+/* Generated stub for json_add_txid */
+void json_add_txid(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		   const struct bitcoin_txid *txid UNNEEDED)
+{ fprintf(stderr, "json_add_txid called!\n"); abort(); }
+/* Generated stub for json_add_u64 */
+void json_add_u64(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		  uint64_t value UNNEEDED)
+{ fprintf(stderr, "json_add_u64 called!\n"); abort(); }
+/* Generated stub for json_add_uncommitted_channel */
+void json_add_uncommitted_channel(struct json_stream *response UNNEEDED,
+				  const struct uncommitted_channel *uc UNNEEDED)
+{ fprintf(stderr, "json_add_uncommitted_channel called!\n"); abort(); }
+/* Generated stub for json_array_end */
+void json_array_end(struct json_stream *js UNNEEDED)
+{ fprintf(stderr, "json_array_end called!\n"); abort(); }
+/* Generated stub for json_array_start */
+void json_array_start(struct json_stream *js UNNEEDED, const char *fieldname UNNEEDED)
+{ fprintf(stderr, "json_array_start called!\n"); abort(); }
+/* Generated stub for json_object_end */
+void json_object_end(struct json_stream *js UNNEEDED)
+{ fprintf(stderr, "json_object_end called!\n"); abort(); }
+/* Generated stub for json_object_start */
+void json_object_start(struct json_stream *ks UNNEEDED, const char *fieldname UNNEEDED)
+{ fprintf(stderr, "json_object_start called!\n"); abort(); }
+/* Generated stub for json_stream_success */
+struct json_stream *json_stream_success(struct command *cmd UNNEEDED)
+{ fprintf(stderr, "json_stream_success called!\n"); abort(); }
+/* Generated stub for json_to_node_id */
+bool json_to_node_id(const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+			       struct node_id *id UNNEEDED)
+{ fprintf(stderr, "json_to_node_id called!\n"); abort(); }
+/* Generated stub for json_to_short_channel_id */
+bool json_to_short_channel_id(const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+			      struct short_channel_id *scid UNNEEDED)
+{ fprintf(stderr, "json_to_short_channel_id called!\n"); abort(); }
+/* Generated stub for json_tok_channel_id */
+bool json_tok_channel_id(const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+			 struct channel_id *cid UNNEEDED)
+{ fprintf(stderr, "json_tok_channel_id called!\n"); abort(); }
+/* Generated stub for kill_uncommitted_channel */
+void kill_uncommitted_channel(struct uncommitted_channel *uc UNNEEDED,
+			      const char *why UNNEEDED)
+{ fprintf(stderr, "kill_uncommitted_channel called!\n"); abort(); }
+/* Generated stub for log_ */
+void log_(struct log *log UNNEEDED, enum log_level level UNNEEDED, bool call_notifier UNNEEDED, const char *fmt UNNEEDED, ...)
+
+{ fprintf(stderr, "log_ called!\n"); abort(); }
+/* Generated stub for log_add */
+void log_add(struct log *log UNNEEDED, const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "log_add called!\n"); abort(); }
+/* Generated stub for log_io */
+void log_io(struct log *log UNNEEDED, enum log_level dir UNNEEDED, const char *comment UNNEEDED,
+	    const void *data UNNEEDED, size_t len UNNEEDED)
+{ fprintf(stderr, "log_io called!\n"); abort(); }
+/* Generated stub for new_log */
+struct log *new_log(const tal_t *ctx UNNEEDED, struct log_book *record UNNEEDED, const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "new_log called!\n"); abort(); }
+/* Generated stub for new_reltimer_ */
+struct oneshot *new_reltimer_(struct timers *timers UNNEEDED,
+			      const tal_t *ctx UNNEEDED,
+			      struct timerel expire UNNEEDED,
+			      void (*cb)(void *) UNNEEDED, void *arg UNNEEDED)
+{ fprintf(stderr, "new_reltimer_ called!\n"); abort(); }
+/* Generated stub for notify_connect */
+void notify_connect(struct lightningd *ld UNNEEDED, struct node_id *nodeid UNNEEDED,
+		    struct wireaddr_internal *addr UNNEEDED)
+{ fprintf(stderr, "notify_connect called!\n"); abort(); }
+/* Generated stub for notify_disconnect */
+void notify_disconnect(struct lightningd *ld UNNEEDED, struct node_id *nodeid UNNEEDED)
+{ fprintf(stderr, "notify_disconnect called!\n"); abort(); }
+/* Generated stub for onchaind_funding_spent */
+enum watch_result onchaind_funding_spent(struct channel *channel UNNEEDED,
+					 const struct bitcoin_tx *tx UNNEEDED,
+					 u32 blockheight UNNEEDED)
+{ fprintf(stderr, "onchaind_funding_spent called!\n"); abort(); }
+/* Generated stub for param */
+bool param(struct command *cmd UNNEEDED, const char *buffer UNNEEDED,
+	   const jsmntok_t params[] UNNEEDED, ...)
+{ fprintf(stderr, "param called!\n"); abort(); }
+/* Generated stub for param_bool */
+struct command_result *param_bool(struct command *cmd UNNEEDED, const char *name UNNEEDED,
+				  const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+				  bool **b UNNEEDED)
+{ fprintf(stderr, "param_bool called!\n"); abort(); }
+/* Generated stub for param_loglevel */
+struct command_result *param_loglevel(struct command *cmd UNNEEDED,
+				      const char *name UNNEEDED,
+				      const char *buffer UNNEEDED,
+				      const jsmntok_t *tok UNNEEDED,
+				      enum log_level **level UNNEEDED)
+{ fprintf(stderr, "param_loglevel called!\n"); abort(); }
+/* Generated stub for param_msat */
+struct command_result *param_msat(struct command *cmd UNNEEDED, const char *name UNNEEDED,
+				  const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+				  struct amount_msat **msat UNNEEDED)
+{ fprintf(stderr, "param_msat called!\n"); abort(); }
+/* Generated stub for param_node_id */
+struct command_result *param_node_id(struct command *cmd UNNEEDED,
+					       const char *name UNNEEDED,
+					       const char *buffer UNNEEDED,
+					       const jsmntok_t *tok UNNEEDED,
+					       struct node_id **id UNNEEDED)
+{ fprintf(stderr, "param_node_id called!\n"); abort(); }
+/* Generated stub for param_number */
+struct command_result *param_number(struct command *cmd UNNEEDED, const char *name UNNEEDED,
+				    const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+				    unsigned int **num UNNEEDED)
+{ fprintf(stderr, "param_number called!\n"); abort(); }
+/* Generated stub for param_short_channel_id */
+struct command_result *param_short_channel_id(struct command *cmd UNNEEDED,
+					      const char *name UNNEEDED,
+					      const char *buffer UNNEEDED,
+					      const jsmntok_t *tok UNNEEDED,
+					      struct short_channel_id **scid UNNEEDED)
+{ fprintf(stderr, "param_short_channel_id called!\n"); abort(); }
+/* Generated stub for param_tok */
+struct command_result *param_tok(struct command *cmd UNNEEDED, const char *name UNNEEDED,
+				 const char *buffer UNNEEDED, const jsmntok_t * tok UNNEEDED,
+				 const jsmntok_t **out UNNEEDED)
+{ fprintf(stderr, "param_tok called!\n"); abort(); }
+/* Generated stub for peer_memleak_done */
+void peer_memleak_done(struct command *cmd UNNEEDED, struct subd *leaker UNNEEDED)
+{ fprintf(stderr, "peer_memleak_done called!\n"); abort(); }
+/* Generated stub for peer_start_channeld */
+void peer_start_channeld(struct channel *channel UNNEEDED,
+			 struct per_peer_state *pps UNNEEDED,
+			 const u8 *funding_signed UNNEEDED,
+			 bool reconnected UNNEEDED)
+{ fprintf(stderr, "peer_start_channeld called!\n"); abort(); }
+/* Generated stub for peer_start_closingd */
+void peer_start_closingd(struct channel *channel UNNEEDED,
+			 struct per_peer_state *pps UNNEEDED,
+			 bool reconnected UNNEEDED,
+			 const u8 *channel_reestablish UNNEEDED)
+{ fprintf(stderr, "peer_start_closingd called!\n"); abort(); }
+/* Generated stub for peer_start_openingd */
+void peer_start_openingd(struct peer *peer UNNEEDED,
+			 struct per_peer_state *pps UNNEEDED,
+			 const u8 *msg UNNEEDED)
+{ fprintf(stderr, "peer_start_openingd called!\n"); abort(); }
+/* Generated stub for per_peer_state_set_fds */
+void per_peer_state_set_fds(struct per_peer_state *pps UNNEEDED,
+			    int peer_fd UNNEEDED, int gossip_fd UNNEEDED, int gossip_store_fd UNNEEDED)
+{ fprintf(stderr, "per_peer_state_set_fds called!\n"); abort(); }
+/* Generated stub for plugin_hook_call_ */
+void plugin_hook_call_(struct lightningd *ld UNNEEDED, const struct plugin_hook *hook UNNEEDED,
+		       void *payload UNNEEDED, void *cb_arg UNNEEDED)
+{ fprintf(stderr, "plugin_hook_call_ called!\n"); abort(); }
+/* Generated stub for subd_release_channel */
+void subd_release_channel(struct subd *owner UNNEEDED, void *channel UNNEEDED)
+{ fprintf(stderr, "subd_release_channel called!\n"); abort(); }
+/* Generated stub for subd_req_ */
+void subd_req_(const tal_t *ctx UNNEEDED,
+	       struct subd *sd UNNEEDED,
+	       const u8 *msg_out UNNEEDED,
+	       int fd_out UNNEEDED, size_t num_fds_in UNNEEDED,
+	       void (*replycb)(struct subd * UNNEEDED, const u8 * UNNEEDED, const int * UNNEEDED, void *) UNNEEDED,
+	       void *replycb_data UNNEEDED)
+{ fprintf(stderr, "subd_req_ called!\n"); abort(); }
+/* Generated stub for subd_send_msg */
+void subd_send_msg(struct subd *sd UNNEEDED, const u8 *msg_out UNNEEDED)
+{ fprintf(stderr, "subd_send_msg called!\n"); abort(); }
+/* Generated stub for towire_channel_dev_memleak */
+u8 *towire_channel_dev_memleak(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_channel_dev_memleak called!\n"); abort(); }
+/* Generated stub for towire_channel_dev_reenable_commit */
+u8 *towire_channel_dev_reenable_commit(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_channel_dev_reenable_commit called!\n"); abort(); }
+/* Generated stub for towire_channel_send_shutdown */
+u8 *towire_channel_send_shutdown(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_channel_send_shutdown called!\n"); abort(); }
+/* Generated stub for towire_channel_specific_feerates */
+u8 *towire_channel_specific_feerates(const tal_t *ctx UNNEEDED, u32 feerate_base UNNEEDED, u32 feerate_ppm UNNEEDED)
+{ fprintf(stderr, "towire_channel_specific_feerates called!\n"); abort(); }
+/* Generated stub for towire_connectctl_connect_to_peer */
+u8 *towire_connectctl_connect_to_peer(const tal_t *ctx UNNEEDED, const struct node_id *id UNNEEDED, u32 seconds_waited UNNEEDED, const struct wireaddr_internal *addrhint UNNEEDED)
+{ fprintf(stderr, "towire_connectctl_connect_to_peer called!\n"); abort(); }
+/* Generated stub for towire_connectctl_peer_disconnected */
+u8 *towire_connectctl_peer_disconnected(const tal_t *ctx UNNEEDED, const struct node_id *id UNNEEDED)
+{ fprintf(stderr, "towire_connectctl_peer_disconnected called!\n"); abort(); }
+/* Generated stub for towire_errorfmt */
+u8 *towire_errorfmt(const tal_t *ctx UNNEEDED,
+		    const struct channel_id *channel UNNEEDED,
+		    const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "towire_errorfmt called!\n"); abort(); }
+/* Generated stub for towire_hsm_get_channel_basepoints */
+u8 *towire_hsm_get_channel_basepoints(const tal_t *ctx UNNEEDED, const struct node_id *peerid UNNEEDED, u64 dbid UNNEEDED)
+{ fprintf(stderr, "towire_hsm_get_channel_basepoints called!\n"); abort(); }
+/* Generated stub for towire_hsm_sign_commitment_tx */
+u8 *towire_hsm_sign_commitment_tx(const tal_t *ctx UNNEEDED, const struct node_id *peer_id UNNEEDED, u64 channel_dbid UNNEEDED, const struct bitcoin_tx *tx UNNEEDED, const struct pubkey *remote_funding_key UNNEEDED, struct amount_sat funding_amount UNNEEDED)
+{ fprintf(stderr, "towire_hsm_sign_commitment_tx called!\n"); abort(); }
+/* Generated stub for towire_onchain_dev_memleak */
+u8 *towire_onchain_dev_memleak(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "towire_onchain_dev_memleak called!\n"); abort(); }
+/* Generated stub for txfilter_add_scriptpubkey */
+void txfilter_add_scriptpubkey(struct txfilter *filter UNNEEDED, const u8 *script TAKES UNNEEDED)
+{ fprintf(stderr, "txfilter_add_scriptpubkey called!\n"); abort(); }
+/* Generated stub for version */
+const char *version(void)
+{ fprintf(stderr, "version called!\n"); abort(); }
+/* Generated stub for wallet_channel_close */
+void wallet_channel_close(struct wallet *w UNNEEDED, u64 wallet_id UNNEEDED)
+{ fprintf(stderr, "wallet_channel_close called!\n"); abort(); }
+/* Generated stub for wallet_channel_save */
+void wallet_channel_save(struct wallet *w UNNEEDED, struct channel *chan UNNEEDED)
+{ fprintf(stderr, "wallet_channel_save called!\n"); abort(); }
+/* Generated stub for wallet_channel_stats_load */
+void wallet_channel_stats_load(struct wallet *w UNNEEDED, u64 cdbid UNNEEDED, struct channel_stats *stats UNNEEDED)
+{ fprintf(stderr, "wallet_channel_stats_load called!\n"); abort(); }
+/* Generated stub for wallet_channeltxs_add */
+void wallet_channeltxs_add(struct wallet *w UNNEEDED, struct channel *chan UNNEEDED,
+			    const int type UNNEEDED, const struct bitcoin_txid *txid UNNEEDED,
+			   const u32 input_num UNNEEDED, const u32 blockheight UNNEEDED)
+{ fprintf(stderr, "wallet_channeltxs_add called!\n"); abort(); }
+/* Generated stub for wallet_htlcs_load_for_channel */
+bool wallet_htlcs_load_for_channel(struct wallet *wallet UNNEEDED,
+				   struct channel *chan UNNEEDED,
+				   struct htlc_in_map *htlcs_in UNNEEDED,
+				   struct htlc_out_map *htlcs_out UNNEEDED,
+				   struct htlc_expiries *htlc_expiries UNNEEDED)
+{ fprintf(stderr, "wallet_htlcs_load_for_channel called!\n"); abort(); }
+/* Generated stub for wallet_init_channels */
+bool wallet_init_channels(struct wallet *w UNNEEDED)
+{ fprintf(stderr, "wallet_init_channels called!\n"); abort(); }
+/* Generated stub for wallet_peer_delete */
+void wallet_peer_delete(struct wallet *w UNNEEDED, u64 peer_dbid UNNEEDED)
+{ fprintf(stderr, "wallet_peer_delete called!\n"); abort(); }
+/* Generated stub for wallet_total_forward_fees */
+struct amount_msat wallet_total_forward_fees(struct wallet *w UNNEEDED)
+{ fprintf(stderr, "wallet_total_forward_fees called!\n"); abort(); }
+/* Generated stub for wallet_transaction_add */
+void wallet_transaction_add(struct wallet *w UNNEEDED, const struct bitcoin_tx *tx UNNEEDED,
+			    const u32 blockheight UNNEEDED, const u32 txindex UNNEEDED)
+{ fprintf(stderr, "wallet_transaction_add called!\n"); abort(); }
+/* Generated stub for wallet_transaction_annotate */
+void wallet_transaction_annotate(struct wallet *w UNNEEDED,
+				 const struct bitcoin_txid *txid UNNEEDED,
+				 enum wallet_tx_type type UNNEEDED, u64 channel_id UNNEEDED)
+{ fprintf(stderr, "wallet_transaction_annotate called!\n"); abort(); }
+/* Generated stub for wallet_transaction_locate */
+struct txlocator *wallet_transaction_locate(const tal_t *ctx UNNEEDED, struct wallet *w UNNEEDED,
+					    const struct bitcoin_txid *txid UNNEEDED)
+{ fprintf(stderr, "wallet_transaction_locate called!\n"); abort(); }
+/* Generated stub for watch_txid */
+struct txwatch *watch_txid(const tal_t *ctx UNNEEDED,
+			   struct chain_topology *topo UNNEEDED,
+			   struct channel *channel UNNEEDED,
+			   const struct bitcoin_txid *txid UNNEEDED,
+			   enum watch_result (*cb)(struct lightningd *ld UNNEEDED,
+						   struct channel *channel UNNEEDED,
+						   const struct bitcoin_txid * UNNEEDED,
+						   const struct bitcoin_tx * UNNEEDED,
+						   unsigned int depth))
+{ fprintf(stderr, "watch_txid called!\n"); abort(); }
+/* Generated stub for watch_txo */
+struct txowatch *watch_txo(const tal_t *ctx UNNEEDED,
+			   struct chain_topology *topo UNNEEDED,
+			   struct channel *channel UNNEEDED,
+			   const struct bitcoin_txid *txid UNNEEDED,
+			   unsigned int output UNNEEDED,
+			   enum watch_result (*cb)(struct channel *channel UNNEEDED,
+						   const struct bitcoin_tx *tx UNNEEDED,
+						   size_t input_num UNNEEDED,
+						   const struct block *block))
+{ fprintf(stderr, "watch_txo called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+#if DEVELOPER
+/* Generated stub for dev_disconnect_permanent */
+bool dev_disconnect_permanent(struct lightningd *ld UNNEEDED)
+{ fprintf(stderr, "dev_disconnect_permanent called!\n"); abort(); }
+#endif
+
+/* We don't care about these. */
+struct log_book *new_log_book(struct lightningd *ld UNNEEDED,
+			      size_t max_mem UNNEEDED,
+			      enum log_level printlevel UNNEEDED)
+{
+	return NULL;
+}
+
+void set_log_outfn_(struct log_book *lr UNNEEDED,
+		    void (*print)(const char *prefix UNNEEDED,
+				  enum log_level level UNNEEDED,
+				  bool continued UNNEEDED,
+				  const struct timeabs *time UNNEEDED,
+				  const char *str UNNEEDED,
+				  const u8 *io UNNEEDED, size_t io_len UNNEEDED,
+				  void *arg) UNNEEDED,
+		    void *arg UNNEEDED)
+{
+}
+
+enum log_level get_log_level(struct log_book *lr UNNEEDED)
+{
+	return LOG_BROKEN;
+}
+
+/* This is what peer_by_id() did before we indexed peers. */
+static struct peer *peer_by_id_walk(struct lightningd *ld,
+				    const struct node_id *id)
+{
+	struct peer *p;
+
+	list_for_each(&ld->peers, p, list)
+		if (node_id_eq(&p->id, id))
+			return p;
+	return NULL;
+}
+
+/* Every peer has one old, closed channel and one normal one. */
+static void add_peer(struct lightningd *ld, size_t n,
+		     struct node_id *id, struct short_channel_id *scid)
+{
+	struct wireaddr_internal addr;
+	struct peer *peer;
+
+	memset(&addr, 0, sizeof(addr));
+	memset(id, 0, sizeof(*id));
+	id->k[0] = 0x02;
+	memcpy(id->k + 1, &n, sizeof(n));
+	peer = new_peer(ld, n + 1, id, &addr);
+
+	for (size_t i = 0; i < 2; i++) {
+		struct channel *c = talz(peer, struct channel);
+
+		c->peer = peer;
+		c->dbid = n * 2 + i + 1;
+		c->state = i == 0 ? ONCHAIN : CHANNELD_NORMAL;
+		list_add_tail(&peer->channels, &c->list);
+		if (!mk_short_channel_id(scid, 500000 + n, i, 0))
+			abort();
+		channel_set_scid(c, scid);
+	}
+}
+
+static void bench(const char *what, size_t num_lookups,
+		  struct channel *(*lookup)(struct lightningd *ld, size_t i),
+		  struct lightningd *ld)
+{
+	struct timemono start = time_mono();
+	u64 usec;
+
+	for (size_t i = 0; i < num_lookups; i++)
+		assert(lookup(ld, i));
+
+	usec = bench_usec_since(start);
+	printf("%s: %zu lookups in %"PRIu64" usec (%.0f nsec each)\n",
+	       what, num_lookups, usec, usec * 1000.0 / num_lookups);
+}
+
+static struct node_id *ids;
+static struct short_channel_id *scids;
+static size_t *order;
+
+/* forward_htlc() asks for the next hop's active channel. */
+static struct channel *lookup_forward(struct lightningd *ld, size_t i)
+{
+	return active_channel_by_id(ld, &ids[order[i]], NULL);
+}
+
+static struct channel *lookup_forward_walk(struct lightningd *ld, size_t i)
+{
+	struct peer *peer = peer_by_id_walk(ld, &ids[order[i]]);
+	return peer ? peer_active_channel(peer) : NULL;
+}
+
+static struct channel *lookup_scid(struct lightningd *ld, size_t i)
+{
+	return channel_by_scid(ld, &scids[order[i]]);
+}
+
+static struct channel *lookup_dbid(struct lightningd *ld, size_t i)
+{
+	struct peer *peer = find_peer_by_dbid(ld, order[i] + 1);
+	return peer ? peer_active_channel(peer) : NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct lightningd *ld;
+	struct peer *p;
+	size_t num_peers = 50, num_lookups = 50;
+
+	setup_locale();
+	setup_tmpctx();
+
+	bench_sizes(argc, argv, "[num_peers [num_lookups]]",
+		    &num_peers, &num_lookups);
+
+	ld = tal(tmpctx, struct lightningd);
+	memset(&ld->id, 0, sizeof(ld->id));
+	ld->log_book = NULL;
+	list_head_init(&ld->peers);
+	ld->peers_by_id = tal(ld, struct peer_id_map);
+	peer_id_map_init(ld->peers_by_id);
+	ld->peers_by_dbid = tal(ld, struct peer_dbid_map);
+	peer_dbid_map_init(ld->peers_by_dbid);
+	ld->channels_by_scid = tal(ld, struct channel_scid_map);
+	channel_scid_map_init(ld->channels_by_scid);
+
+	ids = tal_arr(ld, struct node_id, num_peers);
+	scids = tal_arr(ld, struct short_channel_id, num_peers);
+	for (size_t i = 0; i < num_peers; i++)
+		add_peer(ld, i, &ids[i], &scids[i]);
+
+	order = tal_arr(ld, size_t, num_lookups);
+	for (size_t i = 0; i < num_lookups; i++)
+		order[i] = pseudorand(num_peers);
+
+	printf("%zu peers, %zu channels\n", num_peers, num_peers * 2);
+	bench("Forward by node_id", num_lookups, lookup_forward, ld);
+	bench("Forward by node_id (list walk)", num_lookups / 100 + 1,
+	      lookup_forward_walk, ld);
+	bench("Channel by scid", num_lookups, lookup_scid, ld);
+	bench("Peer by dbid", num_lookups, lookup_dbid, ld);
+
+	/* Closed channels are still found by scid, but aren't active. */
+	if (!mk_short_channel_id(&scids[0], 500000, 0, 0))
+		abort();
+	assert(channel_by_scid(ld, &scids[0])->state == ONCHAIN);
+	assert(active_channel_by_id(ld, &ids[0], NULL)->state
+	       == CHANNELD_NORMAL);
+
+	/* Peers remove themselves from the indexes when freed. */
+	while ((p = list_top(&ld->peers, struct peer, list)) != NULL) {
+		struct channel *c;
+		while ((c = list_pop(&p->channels, struct channel, list))
+		       != NULL)
+			channel_scid_map_del(ld->channels_by_scid, c);
+		tal_free(p);
+	}
+	assert(!find_peer_by_dbid(ld, 1));
+
+	peer_id_map_clear(ld->peers_by_id);
+	peer_dbid_map_clear(ld->peers_by_dbid);
+	channel_scid_map_clear(ld->channels_by_scid);
+	tal_free(tmpctx);
+	return 0;
+}
@@ -0,0 +1,240 @@
+#include "../plugin.c"
+#include <ccan/err/err.h>
+#include <ccan/opt/opt.h>
+#include <ccan/read_write_all/read_write_all.h>
+#include <common/test/bench.h>
+#include <stdio.h>
+#include <sys/wait.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for bigsize_get */
+size_t bigsize_get(const u8 *p UNNEEDED, size_t max UNNEEDED, bigsize_t *val UNNEEDED)
+{ fprintf(stderr, "bigsize_get called!\n"); abort(); }
+/* Generated stub for bigsize_put */
+size_t bigsize_put(u8 buf[BIGSIZE_MAX_LEN] UNNEEDED, bigsize_t v UNNEEDED)
+{ fprintf(stderr, "bigsize_put called!\n"); abort(); }
+/* Generated stub for command_param_failed */
+struct command_result *command_param_failed(void)
+
+{ fprintf(stderr, "command_param_failed called!\n"); abort(); }
+/* Generated stub for command_raw_complete */
+struct command_result *command_raw_complete(struct command *cmd UNNEEDED,
+					    struct json_stream *result UNNEEDED)
+{ fprintf(stderr, "command_raw_complete called!\n"); abort(); }
+/* Generated stub for command_still_pending */
+struct command_result *command_still_pending(struct command *cmd)
+
+{ fprintf(stderr, "command_still_pending called!\n"); abort(); }
+/* Could not find declaration for deprecated_apis */
+/* Generated stub for fatal */
+void   fatal(const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "fatal called!\n"); abort(); }
+/* Generated stub for io_loop_with_timers */
+void *io_loop_with_timers(struct lightningd *ld UNNEEDED)
+{ fprintf(stderr, "io_loop_with_timers called!\n"); abort(); }
+/* Generated stub for json_add_bool */
+void json_add_bool(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		   bool value UNNEEDED)
+{ fprintf(stderr, "json_add_bool called!\n"); abort(); }
+/* Generated stub for json_add_string */
+void json_add_string(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED, const char *value UNNEEDED)
+{ fprintf(stderr, "json_add_string called!\n"); abort(); }
+/* Generated stub for json_object_end */
+void json_object_end(struct json_stream *js UNNEEDED)
+{ fprintf(stderr, "json_object_end called!\n"); abort(); }
+/* Generated stub for json_object_start */
+void json_object_start(struct json_stream *ks UNNEEDED, const char *fieldname UNNEEDED)
+{ fprintf(stderr, "json_object_start called!\n"); abort(); }
+/* Generated stub for json_stream_append */
+void json_stream_append(struct json_stream *js UNNEEDED, const char *str UNNEEDED, size_t len UNNEEDED)
+{ fprintf(stderr, "json_stream_append called!\n"); abort(); }
+/* Generated stub for json_stream_dup */
+struct json_stream *json_stream_dup(const tal_t *ctx UNNEEDED,
+				    struct json_stream *original UNNEEDED,
+				    struct log *log UNNEEDED)
+{ fprintf(stderr, "json_stream_dup called!\n"); abort(); }
+/* Generated stub for json_stream_output_ */
+struct io_plan *json_stream_output_(struct json_stream *js UNNEEDED,
+				    struct io_conn *conn UNNEEDED,
+				    struct io_plan *(*cb)(struct io_conn *conn UNNEEDED,
+							  struct json_stream *js UNNEEDED,
+							  void *arg) UNNEEDED,
+				    void *arg UNNEEDED)
+{ fprintf(stderr, "json_stream_output_ called!\n"); abort(); }
+/* Generated stub for json_stream_raw_for_cmd */
+struct json_stream *json_stream_raw_for_cmd(struct command *cmd UNNEEDED)
+{ fprintf(stderr, "json_stream_raw_for_cmd called!\n"); abort(); }
+/* Generated stub for jsonrpc_command_add */
+bool jsonrpc_command_add(struct jsonrpc *rpc UNNEEDED, struct json_command *command UNNEEDED,
+			 const char *usage TAKES UNNEEDED)
+{ fprintf(stderr, "jsonrpc_command_add called!\n"); abort(); }
+/* Generated stub for jsonrpc_request_end */
+void jsonrpc_request_end(struct jsonrpc_request *request UNNEEDED)
+{ fprintf(stderr, "jsonrpc_request_end called!\n"); abort(); }
+/* Generated stub for jsonrpc_request_start_ */
+struct jsonrpc_request *jsonrpc_request_start_(
+    const tal_t *ctx UNNEEDED, const char *method UNNEEDED, struct log *log UNNEEDED,
+    void (*response_cb)(const char *buffer UNNEEDED, const jsmntok_t *toks UNNEEDED,
+			const jsmntok_t *idtok UNNEEDED, void *) UNNEEDED,
+    void *response_cb_arg UNNEEDED)
+{ fprintf(stderr, "jsonrpc_request_start_ called!\n"); abort(); }
+/* Generated stub for log_ */
+void log_(struct log *log UNNEEDED, enum log_level level UNNEEDED, bool call_notifier UNNEEDED, const char *fmt UNNEEDED, ...)
+
+{ fprintf(stderr, "log_ called!\n"); abort(); }
+/* Generated stub for new_log */
+struct log *new_log(const tal_t *ctx UNNEEDED, struct log_book *record UNNEEDED, const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "new_log called!\n"); abort(); }
+/* Generated stub for new_reltimer_ */
+struct oneshot *new_reltimer_(struct timers *timers UNNEEDED,
+			      const tal_t *ctx UNNEEDED,
+			      struct timerel expire UNNEEDED,
+			      void (*cb)(void *) UNNEEDED, void *arg UNNEEDED)
+{ fprintf(stderr, "new_reltimer_ called!\n"); abort(); }
+/* Generated stub for notifications_have_topic */
+bool notifications_have_topic(const char *topic UNNEEDED)
+{ fprintf(stderr, "notifications_have_topic called!\n"); abort(); }
+/* Generated stub for plugin_hook_register */
+bool plugin_hook_register(struct plugin *plugin UNNEEDED, const char *method UNNEEDED)
+{ fprintf(stderr, "plugin_hook_register called!\n"); abort(); }
+/* Generated stub for version */
+const char *version(void)
+{ fprintf(stderr, "version called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+bool deprecated_apis;
+
+/* We don't care about these. */
+void log_io(struct log *log UNNEEDED, enum log_level dir UNNEEDED,
+	    const char *comment UNNEEDED,
+	    const void *data UNNEEDED, size_t len UNNEEDED)
+{
+}
+
+/* Something like a big listchannels, proxied through a plugin. */
+static char *make_response(const tal_t *ctx, u64 id, size_t num_channels)
+{
+	char *resp = tal_fmt(ctx, "{\"jsonrpc\":\"2.0\",\"id\":%"PRIu64","
+			     "\"result\":{\"channels\":[", id);
+	size_t len = strlen(resp);
+
+	/* (tal_append_fmt would strlen() each time, which gets slow) */
+	for (size_t i = 0; i < num_channels; i++) {
+		char *chan = tal_fmt(tmpctx, "%s{\"source\":\"02%064zx\","
+				     "\"destination\":\"03%064zx\","
+				     "\"short_channel_id\":\"%zux%zux%zu\","
+				     "\"public\":true,\"satoshis\":%zu,"
+				     "\"amount_msat\":\"%zu000msat\","
+				     "\"message_flags\":0,\"channel_flags\":%zu,"
+				     "\"active\":true,\"last_update\":%zu,"
+				     "\"base_fee_millisatoshi\":1000,"
+				     "\"fee_per_millionth\":10,\"delay\":6,"
+				     "\"htlc_minimum_msat\":\"0msat\"}",
+				     i ? "," : "", i, i + 1,
+				     100000 + i, i % 1000, i % 2,
+				     1000000 + i, 1000000 + i, i % 2,
+				     1500000000 + i);
+		tal_resize(&resp, len + strlen(chan) + 1);
+		strcpy(resp + len, chan);
+		len += strlen(chan);
+		tal_free(chan);
+	}
+	tal_resize(&resp, len + strlen("]}}\n\n") + 1);
+	strcpy(resp + len, "]}}\n\n");
+	return resp;
+}
+
+static size_t num_received, bytes_received;
+
+static void got_response(const char *buffer, const jsmntok_t *toks,
+			 const jsmntok_t *idtok UNUSED, void *arg UNUSED)
+{
+	const jsmntok_t *channels;
+
+	channels = json_get_member(buffer, json_get_member(buffer, toks,
+							   "result"),
+				   "channels");
+	assert(channels && channels->type == JSMN_ARRAY);
+	num_received++;
+	bytes_received += toks[0].end - toks[0].start;
+}
+
+int main(int argc, char *argv[])
+{
+	struct plugins *plugins;
+	struct plugin *plugin;
+	struct timemono start;
+	size_t num_responses = 4, num_channels = 20;
+	char **resps;
+	int fds[2];
+	pid_t pid;
+	u64 usec;
+
+	setup_locale();
+	setup_tmpctx();
+
+	opt_register_noarg("-h|--help", opt_usage_and_exit,
+			   "[num_responses [channels_per_response]]",
+			   "Show this message");
+	opt_parse(&argc, argv, opt_log_stderr_exit);
+	/* Try 4 4000, about 7MB in all. */
+	bench_sizes(argc, argv, "[num_responses [channels_per_response]]",
+		    &num_responses, &num_channels);
+
+	plugins = tal(tmpctx, struct plugins);
+	uintmap_init(&plugins->pending_requests);
+	for (size_t i = 0; i < num_responses; i++) {
+		struct jsonrpc_request *req = tal(plugins,
+						  struct jsonrpc_request);
+		req->id = i;
+		req->response_cb = got_response;
+		req->response_cb_arg = NULL;
+		uintmap_add(&plugins->pending_requests, req->id, req);
+	}
+
+	resps = tal_arr(tmpctx, char *, num_responses);
+	for (size_t i = 0; i < num_responses; i++)
+		resps[i] = make_response(resps, i, num_channels);
+
+	/* The plugin writes its responses into a pipe, as fast as we read. */
+	if (pipe(fds) != 0)
+		err(1, "pipe");
+	pid = fork();
+	if (pid < 0)
+		err(1, "fork");
+	if (pid == 0) {
+		close(fds[0]);
+		for (size_t i = 0; i < num_responses; i++) {
+			if (!write_all(fds[1], resps[i], strlen(resps[i])))
+				err(1, "write");
+		}
+		exit(0);
+	}
+	close(fds[1]);
+
+	/* Freed by plugin_conn_finish once the plugin hangs up. */
+	plugin = tal(NULL, struct plugin);
+	plugin->plugins = plugins;
+	plugin->log = NULL;
+	plugin->stop = false;
+	plugin->stdin_conn = NULL;
+	plugin->used = 0;
+	plugin->buffer = tal_arr(plugin, char, 64);
+	jsmn_init(&plugin->parser);
+	plugin->toks = toks_alloc(plugin);
+
+	start = time_mono();
+	io_new_conn(plugin, fds[0], plugin_stdout_conn_init, plugin);
+	io_loop(NULL, NULL);
+	usec = bench_usec_since(start);
+	waitpid(pid, NULL, 0);
+
+	assert(num_received == num_responses);
+	printf("%zu responses (%.1f MB) in %"PRIu64" msec (%.1f MB/sec)\n",
+	       num_received, bytes_received / 1000000.0, usec / 1000,
+	       bench_per_sec(bytes_received, usec) / 1000000.0);
+
+	tal_free(tmpctx);
+	opt_free_table();
+	return 0;
+}
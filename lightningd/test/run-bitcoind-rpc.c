@@ -0,0 +1,241 @@
+#include "../bitcoind.c"
+#include <ccan/err/err.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <wallet/wallet.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for bigsize_get */
+size_t bigsize_get(const u8 *p UNNEEDED, size_t max UNNEEDED, bigsize_t *val UNNEEDED)
+{ fprintf(stderr, "bigsize_get called!\n"); abort(); }
+/* Generated stub for bigsize_put */
+size_t bigsize_put(u8 buf[BIGSIZE_MAX_LEN] UNNEEDED, bigsize_t v UNNEEDED)
+{ fprintf(stderr, "bigsize_put called!\n"); abort(); }
+/* Generated stub for fatal */
+void   fatal(const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "fatal called!\n"); abort(); }
+/* Generated stub for feerate_from_style */
+u32 feerate_from_style(u32 feerate UNNEEDED, enum feerate_style style UNNEEDED)
+{ fprintf(stderr, "feerate_from_style called!\n"); abort(); }
+/* Generated stub for get_chainparams */
+const struct chainparams *get_chainparams(const struct lightningd *ld UNNEEDED)
+{ fprintf(stderr, "get_chainparams called!\n"); abort(); }
+/* Generated stub for json_to_bitcoin_amount */
+bool json_to_bitcoin_amount(const char *buffer UNNEEDED, const jsmntok_t *tok UNNEEDED,
+			    uint64_t *satoshi UNNEEDED)
+{ fprintf(stderr, "json_to_bitcoin_amount called!\n"); abort(); }
+/* Generated stub for new_reltimer_ */
+struct oneshot *new_reltimer_(struct timers *timers UNNEEDED,
+			      const tal_t *ctx UNNEEDED,
+			      struct timerel expire UNNEEDED,
+			      void (*cb)(void *) UNNEEDED, void *arg UNNEEDED)
+{ fprintf(stderr, "new_reltimer_ called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+/* We don't care about these. */
+void db_begin_transaction_(struct db *db UNNEEDED, const char *location UNNEEDED)
+{
+}
+
+void db_commit_transaction(struct db *db UNNEEDED)
+{
+}
+
+void log_(struct log *log UNNEEDED, enum log_level level UNNEEDED,
+	  bool call_notifier UNNEEDED, const char *fmt UNNEEDED, ...)
+{
+}
+
+#define BLOCKHASH_0 \
+	"06226e46111a0b59caaf126043eb5bbf28c34f3a5e332a1fc7b2b73cf188910f"
+
+/* A minimal bitcoind: answers a few calls, and hangs up after every
+ * second request to make sure we reconnect. */
+static const char *stub_reply(const char *req)
+{
+	const char *body = strstr(req, "\r\n\r\n");
+
+	if (!strstr(req, "Authorization: Basic dXNlcjpwYXNz\r\n"))
+		return NULL;
+
+	if (strstr(body, "\"getblockchaininfo\""))
+		return "{\"result\":{\"chain\":\"regtest\",\"blocks\":105,"
+			"\"headers\":105,\"initialblockdownload\":false},"
+			"\"error\":null,\"id\":0}";
+	if (strstr(body, "\"getblockcount\""))
+		return "{\"result\":105,\"error\":null,\"id\":1}";
+	if (strstr(body, "\"getblockhash\",\"params\":[0]"))
+		return "{\"result\":\"" BLOCKHASH_0 "\",\"error\":null,\"id\":2}";
+	if (strstr(body, "\"getblockhash\""))
+		return "{\"result\":null,\"error\":{\"code\":-8,"
+			"\"message\":\"Block height out of range\"},\"id\":3}";
+	if (strstr(body, "\"gettxout\",\"params\":[\""))
+		return "{\"result\":null,\"error\":null,\"id\":4}";
+	return "{\"result\":null,\"error\":{\"code\":-32601,"
+		"\"message\":\"Method not found\"},\"id\":5}";
+}
+
+static void stub_serve(int fd)
+{
+	char buf[4096];
+	size_t len = 0;
+
+	for (int n = 0; n < 2; n++) {
+		const char *body, *clen = NULL;
+		char *req, *end;
+		size_t reqlen;
+
+		while (!(end = memmem(buf, len, "\r\n\r\n", 4))
+		       || len < end + 4 - buf + strtoul(clen, NULL, 10)) {
+			ssize_t r = read(fd, buf + len, sizeof(buf) - len - 1);
+			if (r <= 0)
+				return;
+			len += r;
+			buf[len] = '\0';
+			clen = strstr(buf, "Content-Length: ");
+			assert(clen);
+			clen += strlen("Content-Length: ");
+		}
+
+		reqlen = end + 4 - buf + strtoul(clen, NULL, 10);
+		req = tal_strndup(tmpctx, buf, reqlen);
+		assert(strstarts(req, "POST / HTTP/1.1\r\n"));
+		body = stub_reply(req);
+		if (!body)
+			req = tal_fmt(req, "HTTP/1.1 401 Unauthorized\r\n"
+				      "Content-Length: 0\r\n\r\n");
+		else
+			req = tal_fmt(req, "HTTP/1.1 200 OK\r\n"
+				      "Content-Type: application/json\r\n"
+				      "Content-Length: %zu\r\n\r\n%s",
+				      strlen(body), body);
+		assert(write_all(fd, req, strlen(req)));
+		memmove(buf, buf + reqlen, len - reqlen);
+		len -= reqlen;
+		clean_tmpctx();
+	}
+}
+
+static pid_t stub_bitcoind(u16 *port)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	pid_t pid;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (fd < 0
+	    || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+	    || listen(fd, 16) != 0
+	    || getsockname(fd, (struct sockaddr *)&addr, &addrlen) != 0)
+		err(1, "stub bitcoind");
+	*port = ntohs(addr.sin_port);
+
+	pid = fork();
+	if (pid < 0)
+		err(1, "fork");
+	if (pid == 0) {
+		/* Like bitcoind, serve connections in parallel. */
+		signal(SIGCHLD, SIG_IGN);
+		for (;;) {
+			int conn = accept(fd, NULL, NULL);
+			if (conn < 0)
+				err(1, "accept");
+			if (fork() == 0) {
+				stub_serve(conn);
+				exit(0);
+			}
+			close(conn);
+		}
+	}
+	close(fd);
+	return pid;
+}
+
+static size_t num_pending;
+
+static void got_blockcount(struct bitcoind *bitcoind UNUSED,
+			   u32 blockcount, void *arg UNUSED)
+{
+	assert(blockcount == 105);
+	if (--num_pending == 0)
+		io_break(&num_pending);
+}
+
+static void got_blockhash(struct bitcoind *bitcoind UNUSED,
+			  const struct bitcoin_blkid *blkid, u32 *height)
+{
+	if (*height == 0) {
+		struct bitcoin_blkid expect;
+		assert(bitcoin_blkid_from_hex(BLOCKHASH_0, strlen(BLOCKHASH_0),
+					      &expect));
+		assert(bitcoin_blkid_eq(blkid, &expect));
+	} else
+		assert(!blkid);
+	if (--num_pending == 0)
+		io_break(&num_pending);
+}
+
+static void got_txout(struct bitcoind *bitcoind UNUSED,
+		      const struct bitcoin_tx_output *txout,
+		      void *arg UNUSED)
+{
+	assert(!txout);
+	if (--num_pending == 0)
+		io_break(&num_pending);
+}
+
+int main(void)
+{
+	struct lightningd *ld;
+	struct bitcoind *bitcoind;
+	struct bitcoin_txid txid;
+	u32 heights[] = { 0, 1000 };
+	u16 port;
+	pid_t pid;
+
+	setup_locale();
+	setup_tmpctx();
+
+	pid = stub_bitcoind(&port);
+
+	ld = tal(tmpctx, struct lightningd);
+	ld->wallet = NULL;
+	bitcoind = new_bitcoind(ld, ld, NULL);
+	ld->wallet = tal(ld, struct wallet);
+	ld->wallet->db = NULL;
+	bitcoind->chainparams = chainparams_for_network("regtest");
+	bitcoind->rpcuser = tal_strdup(bitcoind, "user");
+	bitcoind->rpcpass = tal_strdup(bitcoind, "pass");
+	bitcoind->rpcport = tal_fmt(bitcoind, "%u", port);
+
+	wait_for_bitcoind(bitcoind);
+	assert(bitcoind->rpc);
+	assert(bitcoind->synced);
+
+	/* More than BITCOIND_MAX_PARALLEL, to exercise queueing and reuse */
+	for (size_t i = 0; i < 10; i++) {
+		bitcoind_getblockcount(bitcoind, got_blockcount, NULL);
+		num_pending++;
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(heights); i++) {
+		bitcoind_getblockhash(bitcoind, heights[i], got_blockhash,
+				      &heights[i]);
+		num_pending++;
+	}
+	memset(&txid, 1, sizeof(txid));
+	bitcoind_gettxout(bitcoind, &txid, 0, got_txout, NULL);
+	num_pending++;
+
+	io_loop(NULL, NULL);
+	assert(num_pending == 0);
+
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+
+	tal_free(tmpctx);
+	return 0;
+}
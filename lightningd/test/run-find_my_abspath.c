@@ -93,6 +93,12 @@ size_t hash_htlc_key(const struct htlc_key *htlc_key UNNEEDED)
 /* Generated stub for hsm_init */
 void hsm_init(struct lightningd *ld UNNEEDED)
 { fprintf(stderr, "hsm_init called!\n"); abort(); }
+/* Generated stub for htlc_expiries_clear */
+void htlc_expiries_clear(struct htlc_expiries *expiries UNNEEDED)
+{ fprintf(stderr, "htlc_expiries_clear called!\n"); abort(); }
+/* Generated stub for htlc_expiries_init */
+void htlc_expiries_init(struct htlc_expiries *expiries UNNEEDED)
+{ fprintf(stderr, "htlc_expiries_init called!\n"); abort(); }
 /* Generated stub for htlcs_notify_new_block */
 void htlcs_notify_new_block(struct lightningd *ld UNNEEDED, u32 height UNNEEDED)
 { fprintf(stderr, "htlcs_notify_new_block called!\n"); abort(); }
@@ -140,6 +146,9 @@ void onchaind_replay_channels(struct lightningd *ld UNNEEDED)
 /* Generated stub for per_peer_state_set_fds_arr */
 void per_peer_state_set_fds_arr(struct per_peer_state *pps UNNEEDED, const int *fds UNNEEDED)
 { fprintf(stderr, "per_peer_state_set_fds_arr called!\n"); abort(); }
+/* Generated stub for plugin_hook_db_sync_flush */
+void plugin_hook_db_sync_flush(void)
+{ fprintf(stderr, "plugin_hook_db_sync_flush called!\n"); abort(); }
 /* Generated stub for plugins_config */
 void plugins_config(struct plugins *plugins UNNEEDED)
 { fprintf(stderr, "plugins_config called!\n"); abort(); }
@@ -492,7 +492,8 @@ void wallet_channeltxs_add(struct wallet *w UNNEEDED, struct channel *chan UNNEE
 bool wallet_htlcs_load_for_channel(struct wallet *wallet UNNEEDED,
 				   struct channel *chan UNNEEDED,
 				   struct htlc_in_map *htlcs_in UNNEEDED,
-				   struct htlc_out_map *htlcs_out UNNEEDED)
+				   struct htlc_out_map *htlcs_out UNNEEDED,
+				   struct htlc_expiries *htlc_expiries UNNEEDED)
 { fprintf(stderr, "wallet_htlcs_load_for_channel called!\n"); abort(); }
 /* Generated stub for wallet_init_channels */
 bool wallet_init_channels(struct wallet *w UNNEEDED)
@@ -632,6 +633,7 @@ static void add_peer(struct lightningd *ld, int n, enum channel_state state,
 	memset(&peer->id, n, sizeof(peer->id));
 	list_head_init(&peer->channels);
 	list_add_tail(&ld->peers, &peer->list);
+	peer_id_map_add(ld->peers_by_id, peer);
 
 	c->state = state;
 	c->owner = connected ? (void *)peer : NULL;
@@ -667,6 +669,8 @@ int main(void)
 	ld = tal(tmpctx, struct lightningd);
 
 	list_head_init(&ld->peers);
+	ld->peers_by_id = tal(ld, struct peer_id_map);
+	peer_id_map_init(ld->peers_by_id);
 
 	inchans = tal_arr(tmpctx, struct route_info, 0);
 	/* 1. Nothing to choose from -> NULL result. */
@@ -689,6 +693,7 @@ int main(void)
 	assert(any_offline == false);
 
 	/* 5. inchan but its peer (replaced with one) offline -> NULL result. */
+	peer_id_map_del(ld->peers_by_id, list_tail(&ld->peers, struct peer, list));
 	list_del_from(&ld->peers, &list_tail(&ld->peers, struct peer, list)->list);
 	add_peer(ld, 1, CHANNELD_NORMAL, false);
 	add_inchan(&inchans, 1);
@@ -761,6 +766,7 @@ int main(void)
 	assert(n > 250 - 50 && n < 250 + 50);
 
 	/* No memory leaks please */
+	peer_id_map_clear(ld->peers_by_id);
 	secp256k1_context_destroy(secp256k1_ctx);
 	tal_free(tmpctx);
 
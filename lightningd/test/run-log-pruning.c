@@ -0,0 +1,242 @@
+#include "../log.c"
+#include <ccan/err/err.h>
+#include <ccan/tal/grab_file/grab_file.h>
+#include <stdio.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for bigsize_get */
+size_t bigsize_get(const u8 *p UNNEEDED, size_t max UNNEEDED, bigsize_t *val UNNEEDED)
+{ fprintf(stderr, "bigsize_get called!\n"); abort(); }
+/* Generated stub for bigsize_put */
+size_t bigsize_put(u8 buf[BIGSIZE_MAX_LEN] UNNEEDED, bigsize_t v UNNEEDED)
+{ fprintf(stderr, "bigsize_put called!\n"); abort(); }
+/* Generated stub for command_fail */
+struct command_result *command_fail(struct command *cmd UNNEEDED, int code UNNEEDED,
+				    const char *fmt UNNEEDED, ...)
+
+{ fprintf(stderr, "command_fail called!\n"); abort(); }
+/* Generated stub for command_param_failed */
+struct command_result *command_param_failed(void)
+
+{ fprintf(stderr, "command_param_failed called!\n"); abort(); }
+/* Generated stub for command_success */
+struct command_result *command_success(struct command *cmd UNNEEDED,
+				       struct json_stream *response)
+
+{ fprintf(stderr, "command_success called!\n"); abort(); }
+/* Generated stub for json_add_hex */
+void json_add_hex(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		  const void *data UNNEEDED, size_t len UNNEEDED)
+{ fprintf(stderr, "json_add_hex called!\n"); abort(); }
+/* Generated stub for json_add_num */
+void json_add_num(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		  unsigned int value UNNEEDED)
+{ fprintf(stderr, "json_add_num called!\n"); abort(); }
+/* Generated stub for json_add_string */
+void json_add_string(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED, const char *value UNNEEDED)
+{ fprintf(stderr, "json_add_string called!\n"); abort(); }
+/* Generated stub for json_add_time */
+void json_add_time(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+			  struct timespec ts UNNEEDED)
+{ fprintf(stderr, "json_add_time called!\n"); abort(); }
+/* Generated stub for json_array_end */
+void json_array_end(struct json_stream *js UNNEEDED)
+{ fprintf(stderr, "json_array_end called!\n"); abort(); }
+/* Generated stub for json_array_start */
+void json_array_start(struct json_stream *js UNNEEDED, const char *fieldname UNNEEDED)
+{ fprintf(stderr, "json_array_start called!\n"); abort(); }
+/* Generated stub for json_object_end */
+void json_object_end(struct json_stream *js UNNEEDED)
+{ fprintf(stderr, "json_object_end called!\n"); abort(); }
+/* Generated stub for json_object_start */
+void json_object_start(struct json_stream *ks UNNEEDED, const char *fieldname UNNEEDED)
+{ fprintf(stderr, "json_object_start called!\n"); abort(); }
+/* Generated stub for json_stream_log_suppress_for_cmd */
+void json_stream_log_suppress_for_cmd(struct json_stream *js UNNEEDED,
+					    const struct command *cmd UNNEEDED)
+{ fprintf(stderr, "json_stream_log_suppress_for_cmd called!\n"); abort(); }
+/* Generated stub for json_stream_success */
+struct json_stream *json_stream_success(struct command *cmd UNNEEDED)
+{ fprintf(stderr, "json_stream_success called!\n"); abort(); }
+/* Generated stub for notify_warning */
+void notify_warning(struct lightningd *ld UNNEEDED, struct log_entry *l UNNEEDED)
+{ fprintf(stderr, "notify_warning called!\n"); abort(); }
+/* Generated stub for param */
+bool param(struct command *cmd UNNEEDED, const char *buffer UNNEEDED,
+	   const jsmntok_t params[] UNNEEDED, ...)
+{ fprintf(stderr, "param called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+static void print_nothing(const char *prefix UNUSED,
+			  enum log_level level UNUSED,
+			  bool continued UNUSED,
+			  const struct timeabs *time UNUSED,
+			  const char *str UNUSED,
+			  const u8 *io UNUSED, size_t io_len UNUSED,
+			  void *arg UNUSED)
+{
+}
+
+struct seen {
+	size_t lines, skipped;
+	size_t broken, io, io_bytes;
+	size_t longest;
+	int last_num;
+	const char *last_log;
+};
+
+static void check_line(unsigned int skipped,
+		       struct timerel time UNUSED,
+		       enum log_level level,
+		       const char *prefix,
+		       const char *log,
+		       const u8 *io, size_t io_len,
+		       struct seen *seen)
+{
+	int num;
+
+	assert(streq(prefix, "test:"));
+	/* Every line is numbered, and they must come out in order. */
+	num = atoi(log);
+	assert(num > seen->last_num);
+	seen->last_num = num;
+	seen->last_log = log;
+	if (strlen(log) > seen->longest)
+		seen->longest = strlen(log);
+
+	seen->lines++;
+	seen->skipped += skipped;
+	if (level == LOG_BROKEN)
+		seen->broken++;
+	if (level == LOG_IO_IN || level == LOG_IO_OUT) {
+		assert(io);
+		seen->io++;
+		seen->io_bytes += io_len;
+		for (size_t i = 0; i < io_len; i++)
+			assert(io[i] == (u8)num);
+	} else
+		assert(!io);
+}
+
+static struct seen check_log(const struct log_book *lr)
+{
+	struct seen seen;
+
+	memset(&seen, 0, sizeof(seen));
+	seen.last_num = -1;
+	log_each_line(lr, check_line, &seen);
+	return seen;
+}
+
+int main(void)
+{
+	struct log_book *lr;
+	struct log *log;
+	struct seen seen;
+	u8 io[100];
+	char *dumpname, *dump, *giant;
+	int n = 0, fd;
+
+	setup_locale();
+	setup_tmpctx();
+
+	lr = new_log_book(NULL, 16 * 1024, LOG_DBG);
+	set_log_outfn(lr, print_nothing, NULL);
+	log = new_log(NULL, lr, "test:");
+
+	seen = check_log(lr);
+	assert(seen.lines == 0);
+
+	/* One of each. */
+	log_io(log, LOG_IO_IN, tal_fmt(tmpctx, "%i", n),
+	       memset(io, n, sizeof(io)), sizeof(io));
+	n++;
+	log_debug(log, "%i debug", n++);
+	log_info(log, "%i info", n++);
+	log_(log, LOG_UNUSUAL, false, "%i unusual", n++);
+	log_(log, LOG_BROKEN, false, "%i broken", n++);
+	log_io(log, LOG_IO_OUT, tal_fmt(tmpctx, "%i", n),
+	       memset(io, n, sizeof(io)), sizeof(io));
+	n++;
+	seen = check_log(lr);
+	assert(seen.lines == n);
+	assert(seen.skipped == 0);
+	assert(seen.broken == 1);
+	assert(seen.io == 2);
+	assert(seen.io_bytes == 2 * sizeof(io));
+
+	/* log_add extends the last entry, even if it's IO. */
+	log_add(log, " more");
+	seen = check_log(lr);
+	assert(seen.lines == n);
+	assert(strends(seen.last_log, " more"));
+	assert(seen.io_bytes == 2 * sizeof(io));
+	log_debug(log, "%i debug", n++);
+	log_add(log, " and %s", "more\n");
+	seen = check_log(lr);
+	assert(seen.lines == n);
+	/* Sanitized, like any other entry. */
+	assert(strends(seen.last_log, " and more?"));
+
+	/* A flood of IO and debug only pushes out older IO and debug. */
+	for (size_t i = 0; i < 10000; i++) {
+		log_io(log, LOG_IO_IN, tal_fmt(tmpctx, "%i", n),
+		       memset(io, n, sizeof(io)), sizeof(io));
+		n++;
+		log_debug(log, "%i debug", n++);
+	}
+	seen = check_log(lr);
+	assert(seen.lines < n);
+	assert(seen.lines + seen.skipped == n);
+	assert(seen.broken == 1);
+	assert(log_used(lr) <= log_max_mem(lr));
+
+	/* Giant IOs get truncated, which counts as a skip. */
+	log_io(log, LOG_IO_OUT, tal_fmt(tmpctx, "%i", n),
+	       memset(tal_arr(tmpctx, u8, 100000), n, 100000), 100000);
+	n++;
+	seen = check_log(lr);
+	assert(seen.last_num == n - 1);
+	assert(seen.lines + seen.skipped == n + 1);
+	assert(log_used(lr) <= log_max_mem(lr));
+
+	/* But messages don't, even if they're bigger than their ring. */
+	giant = tal_arr(tmpctx, char, 20000);
+	memset(giant, 'x', tal_count(giant) - 1);
+	giant[tal_count(giant) - 1] = '\0';
+	log_(log, LOG_BROKEN, false, "%i %s", n++, giant);
+	seen = check_log(lr);
+	assert(seen.last_num == n - 1);
+	assert(strends(seen.last_log, giant));
+	assert(seen.broken == 2);
+	assert(seen.lines + seen.skipped == n + 1);
+
+	/* Crash dump has everything, in order. */
+	dumpname = tal_fmt(tmpctx, "/tmp/run-log-pruning.%u", getpid());
+	fd = open(dumpname, O_RDWR|O_CREAT|O_TRUNC, 0600);
+	if (fd < 0)
+		err(1, "Opening %s", dumpname);
+	log_dump_to_file(fd, lr);
+	close(fd);
+	dump = grab_file(tmpctx, dumpname);
+	assert(strstr(dump, "skipped..."));
+	assert(strstr(dump, "test:BROKEN: 4 broken"));
+	assert(strstr(dump, tal_fmt(tmpctx, "test:DEBUG: %i debug", n - 3)));
+	unlink(dumpname);
+
+	/* The giant message's ring goes back to its share once a share's worth
+	 * of later messages would have pushed it out. */
+	assert(lr->rings[LOG_BROKEN].size > lr->rings[LOG_BROKEN].share);
+	for (size_t i = 0; i < 100; i++)
+		log_(log, LOG_BROKEN, false, "%i broken", n++);
+	assert(lr->rings[LOG_BROKEN].size == lr->rings[LOG_BROKEN].share);
+	seen = check_log(lr);
+	assert(seen.last_num == n - 1);
+	assert(seen.longest < strlen(giant));
+	assert(seen.lines + seen.skipped == n + 1);
+	assert(log_used(lr) <= log_max_mem(lr));
+
+	tal_free(log);
+	tal_free(tmpctx);
+	return 0;
+}
@@ -4,12 +4,15 @@ from time import time
 from tqdm import tqdm
 
 
+import os
 import pytest
 import random
 
 
 num_workers = 480
 num_payments = 10000
+# The python backup plugin makes these slow: set this higher for real numbers.
+num_db_write_payments = int(os.getenv("DB_WRITE_PAYMENTS", "50"))
 
 
 @pytest.fixture
@@ -19,10 +22,7 @@ def executor():
     ex.shutdown(wait=False)
 
 
-def test_single_hop(node_factory, executor):
-    l1 = node_factory.get_node()
-    l2 = node_factory.get_node()
-
+def single_hop(l1, l2, executor, num_payments=num_payments):
     l1.rpc.connect(l2.rpc.getinfo()['id'], 'localhost:%d' % l2.port)
     l1.openchannel(l2, 4000000)
 
@@ -51,6 +51,26 @@ def test_single_hop(node_factory, executor):
     print("Done. %d payments performed in %f seconds (%f payments per second)" % (num_payments, diff, num_payments / diff))
 
 
+def test_single_hop(node_factory, executor):
+    l1 = node_factory.get_node()
+    l2 = node_factory.get_node()
+    single_hop(l1, l2, executor)
+
+
+@pytest.mark.parametrize("batch", [False, True])
+def test_single_hop_db_write(node_factory, executor, batch):
+    """Both sides backing up through the db_write hook"""
+    nodes = []
+    for i in range(2):
+        opts = {'plugin': os.path.join(os.getcwd(), 'tests/plugins/dblog.py'),
+                'dblog-file': os.path.join(node_factory.directory,
+                                           "dblog-{}.sqlite3".format(i))}
+        if batch:
+            opts['db-write-batch'] = None
+        nodes.append(node_factory.get_node(options=opts))
+    single_hop(nodes[0], nodes[1], executor, num_db_write_payments)
+
+
 def test_single_payment(node_factory, benchmark):
     l1, l2 = node_factory.line_graph(2)
 
@@ -1130,6 +1130,38 @@ def test_getroute_exclude(node_factory, bitcoind):
         l1.rpc.getroute(l4.info['id'], 1, 1, exclude=[chan_l2l3, chan_l2l4])
 
 
+@unittest.skipIf(not DEVELOPER, "gossip propagation is slow without DEVELOPER=1")
+def test_getroutes(node_factory):
+    """Test getroutes gives the same routes as getroute"""
+    l1, l2, l3, l4 = node_factory.line_graph(4, wait_for_announce=True)
+    dests = [{'id': l2.info['id'], 'msatoshi': 1000},
+             {'id': l3.info['id'], 'msatoshi': 1000},
+             {'id': l4.info['id'], 'msatoshi': 1000},
+             {'id': l4.info['id'], 'msatoshi': 300000}]
+
+    routes = l1.rpc.getroutes(dests, 1, fuzzpercent=0)['routes']
+    assert [(r['id'], r['msatoshi']) for r in routes] == [(d['id'], d['msatoshi']) for d in dests]
+    for r in routes:
+        assert r['route'] == l1.rpc.getroute(r['id'], r['msatoshi'], 1,
+                                             fuzzpercent=0)['route']
+
+    # Routes from another node are the same as getroute's with fromid.
+    routes = l1.rpc.getroutes(dests[1:], 1, fromid=l2.info['id'],
+                              fuzzpercent=0)['routes']
+    for r in routes:
+        assert r['route'] == l1.rpc.getroute(r['id'], r['msatoshi'], 1,
+                                             fromid=l2.info['id'],
+                                             fuzzpercent=0)['route']
+
+    # Routes which are too long are simply omitted.
+    routes = l1.rpc.getroutes(dests, 1, maxhops=2)['routes']
+    assert [r['id'] for r in routes] == [l2.info['id'], l3.info['id']]
+
+    # Unless that's all of them.
+    with pytest.raises(RpcError, match=r'Could not find a route'):
+        l1.rpc.getroutes(dests[2:], 1, maxhops=2)
+
+
 @unittest.skipIf(not DEVELOPER, "need dev-compact-gossip-store")
 def test_gossip_store_local_channels(node_factory, bitcoind):
     l1, l2 = node_factory.line_graph(2, wait_for_announce=False)
@@ -904,6 +904,12 @@ def test_forward(node_factory, bitcoind):
     l1.rpc.sendpay(route, rhash)
     l1.rpc.waitsendpay(rhash)
 
+    # l2 knows chanid2 is its own, so never needs to ask gossipd.
+    stages = {s['stage']: s for s in l2.rpc.dev_forward_latency()['stages']}
+    assert stages['resolve_local']['count'] == 4
+    assert stages['resolve_gossipd']['count'] == 0
+    assert stages['offer']['count'] == 4
+
 
 @unittest.skipIf(not DEVELOPER, "needs DEVELOPER=1 for --dev-broadcast-interval")
 def test_forward_different_fees_and_cltv(node_factory, bitcoind):
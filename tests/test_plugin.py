@@ -314,6 +314,27 @@ def test_db_hook(node_factory, executor):
     assert [x for x in db1.iterdump()] == [x for x in db2.iterdump()]
 
 
+def test_db_hook_batch(node_factory):
+    """With --db-write-batch, the plugin still ends up with everything."""
+    dbfile = os.path.join(node_factory.directory, "dblog.sqlite3")
+    l1, l2 = node_factory.line_graph(2, opts=[{'plugin': os.path.join(os.getcwd(), 'tests/plugins/dblog.py'),
+                                               'dblog-file': dbfile,
+                                               'db-write-batch': None},
+                                              {}])
+
+    for i in range(5):
+        inv = l2.rpc.invoice(1000, 'inv{}'.format(i), 'desc')['bolt11']
+        l1.rpc.pay(inv)
+
+    l1.stop()
+
+    # Databases should be identical.
+    db1 = sqlite3.connect(os.path.join(l1.daemon.lightning_dir, 'lightningd.sqlite3'))
+    db2 = sqlite3.connect(dbfile)
+
+    assert [x for x in db1.iterdump()] == [x for x in db2.iterdump()]
+
+
 def test_utf8_passthrough(node_factory, executor):
     l1 = node_factory.get_node(options={'plugin': os.path.join(os.getcwd(), 'tests/plugins/utf8.py'),
                                         'log-level': 'io'})
@@ -5,7 +5,7 @@ set -e
 
 DIR=""
 TARGETS=""
-DEFAULT_TARGETS=" store_load_msec vsz_kb store_rewrite_sec listnodes_sec listchannels_sec routing_sec peer_write_all_sec peer_read_all_sec "
+DEFAULT_TARGETS=" store_load_msec vsz_kb store_rewrite_sec listnodes_sec listchannels_sec routing_sec routing_during_rewrite_sec peer_write_all_sec peer_read_all_sec "
 MCP_DIR=../million-channels-project/data/1M/gossip/
 CSV=false
 
@@ -148,6 +148,20 @@ if [ -z "${TARGETS##* routing_sec *}" ]; then
     done
 fi
 
+# Same again, while gossipd is rewriting the store.
+if [ -z "${TARGETS##* routing_during_rewrite_sec *}" ] && [ "$DEVELOPER" = 1 ]; then
+    # shellcheck disable=SC2086
+    $LCLI1 dev-compact-gossip-store > /dev/null &
+    COMPACT_PID=$!
+    # shellcheck disable=SC2046
+    # shellcheck disable=SC2005
+    echo $(tr '{}' '\n' < "$DIR"/listnodes.json | grep nodeid | cut -d'"' -f4 | sort | head -n2) | while read -r from to; do
+	# shellcheck disable=SC2086
+	/usr/bin/time --quiet --append -f %e $LCLI1 getroute $from 10000 1 6 $to 2>&1 > /dev/null | print_stat routing_during_rewrite_sec
+    done
+    wait $COMPACT_PID
+fi
+
 # Try getting all from the peer.
 if [ -z "${TARGETS##* peer_write_all_sec *}" ]; then
     ENTRIES=$(grep 'Read .* cannounce/cupdate/nannounce/cdelete' "$DIR"/log | cut -d\  -f5 | tr / + | bc)
@@ -1,8 +1,11 @@
 #include "db.h"
 
 #include <ccan/array_size/array_size.h>
+#include <ccan/crypto/siphash24/siphash24.h>
+#include <ccan/htable/htable_type.h>
 #include <ccan/tal/str/str.h>
 #include <common/node_id.h>
+#include <common/pseudorand.h>
 #include <common/version.h>
 #include <inttypes.h>
 #include <lightningd/lightningd.h>
@@ -475,6 +478,40 @@ static void db_assert_no_outstanding_statements(struct db *db)
 }
 #endif
 
+static const char *db_query_id(const struct db_query *query)
+{
+	return query->query;
+}
+
+static size_t hash_query_id(const char *query_id)
+{
+	return siphash24(siphash_seed(), query_id, strlen(query_id));
+}
+
+static bool db_query_eq(const struct db_query *query, const char *query_id)
+{
+	return streq(query->query, query_id);
+}
+HTABLE_DEFINE_TYPE(struct db_query,
+		   db_query_id, hash_query_id, db_query_eq, db_query_map);
+
+static void destroy_query_map(struct db_query_map *query_map)
+{
+	db_query_map_clear(query_map);
+}
+
+static struct db_query_map *new_query_map(const tal_t *ctx,
+					  const struct db_config *config)
+{
+	struct db_query_map *query_map = tal(ctx, struct db_query_map);
+
+	db_query_map_init_sized(query_map, config->num_queries);
+	tal_add_destructor(query_map, destroy_query_map);
+	for (size_t i = 0; i < config->num_queries; i++)
+		db_query_map_add(query_map, &config->queries[i]);
+	return query_map;
+}
+
 static void db_stmt_free(struct db_stmt *stmt)
 {
 	if (stmt->inner_stmt)
@@ -499,12 +536,7 @@ struct db_stmt *db_prepare_v2_(const char *location, struct db *db,
 			 "transaction: %s", location);
 
 	/* Look up the query by its ID */
-	for (size_t i = 0; i < db->config->num_queries; i++) {
-		if (streq(query_id, db->config->queries[i].query)) {
-			stmt->query = &db->config->queries[i];
-			break;
-		}
-	}
+	stmt->query = db_query_map_get(db->query_map, query_id);
 	if (stmt->query == NULL)
 		fatal("Could not resolve query %s", query_id);
 
@@ -695,6 +727,9 @@ static struct db *db_open(const tal_t *ctx, char *filename)
 	// instantiated correctly.
 	db->conn = sql;
 
+	db->query_map = new_query_map(db, db->config);
+	db->stmt_cache = tal_arrz(db, void *, db->config->num_queries);
+
 	tal_add_destructor(db, destroy_db);
 	db->in_transaction = NULL;
 	db->changes = NULL;
@@ -24,6 +24,14 @@ struct db {
 	 * instance. */
 	const struct db_config *config;
 
+	/* Index of config->queries by query id. */
+	struct db_query_map *query_map;
+
+	/* Idle DB-specific statements, indexed like config->queries, which
+	 * the driver can keep to reuse instead of preparing the query every
+	 * time. */
+	void **stmt_cache;
+
 	const char **changes;
 
 	/* List of statements that have been created but not executed yet. */
@@ -108,10 +116,10 @@ struct db_config {
 	bool (*commit_tx_fn)(struct db *db);
 
 	/* The free function must make sure that any associated state stored
-	 * in `stmt->inner_stmt` is freed correctly, setting the pointer to
-	 * NULL after cleaning up. It will ultmately be called by the
-	 * destructor of `struct db_stmt`, before clearing the db_stmt
-	 * itself. */
+	 * in `stmt->inner_stmt` is freed (or stashed in `db->stmt_cache`)
+	 * correctly, setting the pointer to NULL after cleaning up. It will
+	 * ultmately be called by the destructor of `struct db_stmt`, before
+	 * clearing the db_stmt itself. */
 	void (*stmt_free_fn)(struct db_stmt *db_stmt);
 
 	/* Column access in a row. Only covers the primitives, others need to
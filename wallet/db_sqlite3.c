@@ -36,9 +36,19 @@ static bool db_sqlite3_query(struct db_stmt *stmt)
 {
 	sqlite3_stmt *s;
 	sqlite3 *conn = (sqlite3*)stmt->db->conn;
+	void **cache = stmt->db->stmt_cache;
+	size_t idx = stmt->query - stmt->db->config->queries;
 	int err;
 
-	err = sqlite3_prepare_v2(conn, stmt->query->query, -1, &s, NULL);
+	/* Reuse the statement from last time if we have it (it was reset
+	 * when put back, and we rebind every placeholder below). */
+	if (cache[idx]) {
+		s = cache[idx];
+		cache[idx] = NULL;
+		err = SQLITE_OK;
+	} else
+		err = sqlite3_prepare_v2(conn, stmt->query->query, -1, &s,
+					 NULL);
 
 	for (size_t i=0; i<stmt->query->placeholders; i++) {
 		struct db_binding *b = &stmt->bindings[i];
@@ -184,7 +194,18 @@ static const unsigned char *db_sqlite3_column_text(struct db_stmt *stmt, int col
 
 static void db_sqlite3_stmt_free(struct db_stmt *stmt)
 {
-	if (stmt->inner_stmt)
+	void **cache = stmt->db->stmt_cache;
+	size_t idx = stmt->query - stmt->db->config->queries;
+
+	if (!stmt->inner_stmt)
+		return;
+
+	/* Keep one of each for next time: resetting also releases any locks
+	 * it holds, as finalizing would.  No cache means we're closing. */
+	if (cache && !cache[idx]) {
+		sqlite3_reset(stmt->inner_stmt);
+		cache[idx] = stmt->inner_stmt;
+	} else
 		sqlite3_finalize(stmt->inner_stmt);
 	stmt->inner_stmt = NULL;
 }
@@ -197,6 +218,11 @@ static size_t db_sqlite3_count_changes(struct db_stmt *stmt)
 
 static void db_sqlite3_close(struct db *db)
 {
+	for (size_t i = 0; i < db->config->num_queries; i++) {
+		if (db->stmt_cache[i])
+			sqlite3_finalize(db->stmt_cache[i]);
+	}
+	db->stmt_cache = NULL;
 	sqlite3_close(db->sql);
 }
 
@@ -0,0 +1,117 @@
+#include <lightningd/log.h>
+
+static void db_test_fatal(const char *fmt, ...);
+#define db_fatal db_test_fatal
+
+static void db_log_(struct log *log UNUSED, enum log_level level UNUSED, bool call_notifier UNUSED, const char *fmt UNUSED, ...)
+{
+}
+#define log_ db_log_
+
+#include "wallet/db.c"
+
+#include "test_utils.h"
+
+#include <ccan/err/err.h>
+#include <common/amount.h>
+#include <common/test/bench.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for bigsize_get */
+size_t bigsize_get(const u8 *p UNNEEDED, size_t max UNNEEDED, bigsize_t *val UNNEEDED)
+{ fprintf(stderr, "bigsize_get called!\n"); abort(); }
+/* Generated stub for bigsize_put */
+size_t bigsize_put(u8 buf[BIGSIZE_MAX_LEN] UNNEEDED, bigsize_t v UNNEEDED)
+{ fprintf(stderr, "bigsize_put called!\n"); abort(); }
+/* Generated stub for fatal */
+void   fatal(const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "fatal called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+static void db_test_fatal(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	verrx(1, fmt, ap);
+	va_end(ap);
+}
+
+void plugin_hook_db_sync(struct db *db UNNEEDED, const char **changes UNNEEDED, const char *final UNNEEDED)
+{
+}
+
+static struct db *create_test_db(void)
+{
+	struct db *db;
+	char filename[] = "/tmp/ldb-XXXXXX";
+
+	int fd = mkstemp(filename);
+	if (fd == -1)
+		return NULL;
+	close(fd);
+
+	db = db_open(NULL, filename);
+	return db;
+}
+
+/* Each "update" is a read and a write of a var, much like the small
+ * statements we run for every HTLC.  Try 10000 of them. */
+static void bench_updates(struct db *db, size_t num_updates, size_t per_tx)
+{
+	struct timemono start = time_mono();
+	u64 usec;
+
+	for (size_t i = 0; i < num_updates; i += per_tx) {
+		db_begin_transaction(db);
+		for (size_t j = i; j < i + per_tx && j < num_updates; j++) {
+			s64 v = db_get_intvar(db, "bench_var", 0);
+			assert(v == (s64)j);
+			db_set_intvar(db, "bench_var", v + 1);
+		}
+		db_commit_transaction(db);
+	}
+
+	usec = bench_usec_since(start);
+	printf("%zu updates, %zu per transaction, in %"PRIu64" msec"
+	       " (%.0f updates/sec)\n",
+	       num_updates, per_tx, usec / 1000,
+	       bench_per_sec(num_updates, usec));
+}
+
+int main(int argc, char *argv[])
+{
+	struct lightningd *ld;
+	struct db *db;
+	size_t num_updates = 50;
+
+	setup_locale();
+	setup_tmpctx();
+
+	bench_sizes(argc, argv, "[num_updates]", &num_updates);
+
+	/* Dummy for migration hooks */
+	ld = tal(NULL, struct lightningd);
+	ld->config = test_config;
+
+	db = create_test_db();
+	assert(db);
+	db_migrate(ld, db, NULL);
+	/* We don't want to measure the disk. */
+	sqlite3_exec(db->sql, "PRAGMA synchronous = OFF;", NULL, NULL, NULL);
+
+	bench_updates(db, num_updates, num_updates);
+	/* Start again, committing each one. */
+	db_begin_transaction(db);
+	db_set_intvar(db, "bench_var", 0);
+	db_commit_transaction(db);
+	bench_updates(db, num_updates, 1);
+
+	unlink(db->filename);
+	tal_free(db);
+	tal_free(ld);
+	tal_free(tmpctx);
+	return 0;
+}
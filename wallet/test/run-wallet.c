@@ -12,7 +12,13 @@ static void db_log_(struct log *log UNUSED, enum log_level level UNUSED, bool ca
 #include "wallet/wallet.c"
 #include "lightningd/htlc_end.c"
 #include "lightningd/peer_control.c"
+
+/* We want to see which channels htlcs_notify_new_block() fails. */
+static void PRINTF_FMT(2,3)
+	record_fail_permanent(struct channel *channel, const char *fmt, ...);
+#define channel_fail_permanent record_fail_permanent
 #include "lightningd/peer_htlcs.c"
+#undef channel_fail_permanent
 #include "lightningd/channel.c"
 
 #include "wallet/db.c"
@@ -498,6 +504,10 @@ void per_peer_state_set_fds(struct per_peer_state *pps UNNEEDED,
 void plugin_hook_call_(struct lightningd *ld UNNEEDED, const struct plugin_hook *hook UNNEEDED,
 		       void *payload UNNEEDED, void *cb_arg UNNEEDED)
 { fprintf(stderr, "plugin_hook_call_ called!\n"); abort(); }
+/* Generated stub for plugin_hook_db_sync_wait_ */
+void plugin_hook_db_sync_wait_(const tal_t *ctx UNNEEDED, struct db *db UNNEEDED,
+			       void (*cb)(void *arg) UNNEEDED, void *arg UNNEEDED)
+{ fprintf(stderr, "plugin_hook_db_sync_wait_ called!\n"); abort(); }
 /* Generated stub for process_onionpacket */
 struct route_step *process_onionpacket(
 	const tal_t * ctx UNNEEDED,
@@ -1037,7 +1047,11 @@ static bool test_channel_crud(struct lightningd *ld, const tal_t *ctx)
 	CHECK_MSG(!wallet_err,
 		  tal_fmt(w, "Load from DB: %s", wallet_err));
 	CHECK_MSG(channelseq(&c1, c2), "Compare loaded with saved (v2)");
+	/* Loading indexes it by scid (and its peer by dbid) */
+	CHECK(channel_by_scid(ld, c1.scid) == c2);
+	CHECK(find_peer_by_dbid(ld, c1.peer->dbid) == c2->peer);
 	tal_free(c2);
+	CHECK(!channel_by_scid(ld, c1.scid));
 
 	/* Updates should not result in new ids */
 	CHECK(c1.dbid == 1);
@@ -1134,6 +1148,7 @@ static bool test_htlc_crud(struct lightningd *ld, const tal_t *ctx)
 	struct wallet *w = create_test_wallet(ld, ctx);
 	struct htlc_in_map *htlcs_in = tal(ctx, struct htlc_in_map);
 	struct htlc_out_map *htlcs_out = tal(ctx, struct htlc_out_map);
+	struct htlc_expiries *htlc_expiries = tal(ctx, struct htlc_expiries);
 
 	/* Make sure we have our references correct */
 	db_begin_transaction(w->db);
@@ -1192,11 +1207,13 @@ static bool test_htlc_crud(struct lightningd *ld, const tal_t *ctx)
 	/* Attempt to load them from the DB again */
 	htlc_in_map_init(htlcs_in);
 	htlc_out_map_init(htlcs_out);
+	htlc_expiries_init(htlc_expiries);
 
 	db_begin_transaction(w->db);
 	CHECK(!wallet_err);
 
-	CHECK_MSG(wallet_htlcs_load_for_channel(w, chan, htlcs_in, htlcs_out),
+	CHECK_MSG(wallet_htlcs_load_for_channel(w, chan, htlcs_in, htlcs_out,
+						htlc_expiries),
 		  "Failed loading HTLCs");
 	db_commit_transaction(w->db);
 
@@ -1208,14 +1225,176 @@ static bool test_htlc_crud(struct lightningd *ld, const tal_t *ctx)
 
 	CHECK(hin != NULL);
 	CHECK(hout != NULL);
+	CHECK(uintmap_get(&htlc_expiries->in, hin->expiry_index) == hin);
+	CHECK(uintmap_get(&htlc_expiries->out, hout->expiry_index) == hout);
 
 	/* Have to free manually, otherwise we get our dependencies
 	 * twisted */
 	tal_free(hin);
 	tal_free(hout);
+	CHECK(uintmap_empty(&htlc_expiries->in));
+	CHECK(uintmap_empty(&htlc_expiries->out));
 	htlc_in_map_clear(htlcs_in);
 	htlc_out_map_clear(htlcs_out);
+	htlc_expiries_clear(htlc_expiries);
+
+	return true;
+}
+
+static struct channel **failed_channels;
+
+static void record_fail_permanent(struct channel *channel,
+				  const char *fmt UNUSED, ...)
+{
+	/* Like the real one, which htlcs_notify_new_block() relies on. */
+	channel->error = tal_arr(channel, u8, 0);
+	tal_arr_expand(&failed_channels, channel);
+}
+
+static bool channel_was_failed(const struct channel *channel)
+{
+	for (size_t i = 0; i < tal_count(failed_channels); i++)
+		if (failed_channels[i] == channel)
+			return true;
+	return false;
+}
+
+static struct channel *new_expiry_channel(const tal_t *ctx,
+					  enum channel_state state)
+{
+	struct channel *channel = talz(ctx, struct channel);
+	channel->state = state;
+	return channel;
+}
+
+/* Each HTLC gets its own channel, so we can tell which were failed. */
+static struct htlc_in *add_expiry_htlc_in(struct lightningd *ld,
+					  const tal_t *ctx,
+					  u32 cltv_expiry, bool fulfilled)
+{
+	struct htlc_in *hin = talz(ctx, struct htlc_in);
+	static u64 id;
+
+	hin->key.channel = new_expiry_channel(ctx, CHANNELD_NORMAL);
+	hin->key.id = id++;
+	hin->cltv_expiry = cltv_expiry;
+	if (fulfilled)
+		hin->preimage = talz(hin, struct preimage);
+	connect_htlc_in(&ld->htlcs_in, &ld->htlc_expiries, hin);
+	return hin;
+}
+
+static struct htlc_out *add_expiry_htlc_out(struct lightningd *ld,
+					    const tal_t *ctx,
+					    u32 cltv_expiry,
+					    enum channel_state state)
+{
+	struct htlc_out *hout = talz(ctx, struct htlc_out);
+	static u64 id;
+
+	hout->key.channel = new_expiry_channel(ctx, state);
+	hout->key.id = id++;
+	hout->cltv_expiry = cltv_expiry;
+	connect_htlc_out(&ld->htlcs_out, &ld->htlc_expiries, hout);
+	return hout;
+}
+
+static bool test_htlc_expiries(struct lightningd *ld, const tal_t *ctx)
+{
+	struct htlc_out *out98, *out99, *out100, *out101, *onchain;
+	struct htlc_in *in104, *in105, *in106, *in107;
+	struct htlc_out *hout;
+	u32 last_cltv;
+	u64 idx;
+
+	failed_channels = tal_arr(ctx, struct channel *, 0);
+	/* Incoming deadlines are (12 + 1) / 2 = 6 blocks before expiry. */
+	ld->config.cltv_expiry_delta = 12;
+
+	/* Added out of order: the map sorts them. */
+	out101 = add_expiry_htlc_out(ld, ctx, 101, CHANNELD_NORMAL);
+	out99 = add_expiry_htlc_out(ld, ctx, 99, CHANNELD_NORMAL);
+	onchain = add_expiry_htlc_out(ld, ctx, 90, ONCHAIN);
+	out100 = add_expiry_htlc_out(ld, ctx, 100, CHANNELD_NORMAL);
+	out98 = add_expiry_htlc_out(ld, ctx, 98, CHANNELD_NORMAL);
+
+	last_cltv = 0;
+	for (hout = uintmap_first(&ld->htlc_expiries.out, &idx);
+	     hout;
+	     hout = uintmap_after(&ld->htlc_expiries.out, &idx)) {
+		CHECK(hout->cltv_expiry >= last_cltv);
+		CHECK(hout->expiry_index == idx);
+		last_cltv = hout->cltv_expiry;
+	}
 
+	/* Fulfilled ones fail the channel, unfulfilled ones don't. */
+	in107 = add_expiry_htlc_in(ld, ctx, 107, true);
+	in106 = add_expiry_htlc_in(ld, ctx, 106, true);
+	in105 = add_expiry_htlc_in(ld, ctx, 105, true);
+	in104 = add_expiry_htlc_in(ld, ctx, 104, false);
+
+	/* Offered HTLCs time out the block after cltv_expiry: 98 and 99.
+	 * Received ones 6 blocks before it: 104, 105 and 106. */
+	htlcs_notify_new_block(ld, 100);
+	CHECK(tal_count(failed_channels) == 4);
+	CHECK(channel_was_failed(out98->key.channel));
+	CHECK(channel_was_failed(out99->key.channel));
+	CHECK(!channel_was_failed(out100->key.channel));
+	CHECK(!channel_was_failed(out101->key.channel));
+	CHECK(channel_was_failed(in105->key.channel));
+	CHECK(channel_was_failed(in106->key.channel));
+	CHECK(!channel_was_failed(in107->key.channel));
+	CHECK(!channel_was_failed(in104->key.channel));
+
+	/* Already onchain: no longer watched. */
+	CHECK(!channel_was_failed(onchain->key.channel));
+	CHECK(!onchain->expiries);
+
+	/* Failed channels are dropped next time, not failed again; the
+	 * unfulfilled one is still watched, in case we fulfill it. */
+	htlcs_notify_new_block(ld, 100);
+	CHECK(tal_count(failed_channels) == 4);
+	CHECK(!out98->expiries);
+	CHECK(!out99->expiries);
+	CHECK(!in105->expiries);
+	CHECK(!in106->expiries);
+	CHECK(uintmap_get(&ld->htlc_expiries.out, out100->expiry_index)
+	      == out100);
+	CHECK(uintmap_get(&ld->htlc_expiries.out, out101->expiry_index)
+	      == out101);
+	CHECK(uintmap_get(&ld->htlc_expiries.in, in104->expiry_index)
+	      == in104);
+	CHECK(uintmap_get(&ld->htlc_expiries.in, in107->expiry_index)
+	      == in107);
+
+	/* One more block reaches out100 and in107. */
+	htlcs_notify_new_block(ld, 101);
+	CHECK(tal_count(failed_channels) == 6);
+	CHECK(channel_was_failed(out100->key.channel));
+	CHECK(channel_was_failed(in107->key.channel));
+	CHECK(!channel_was_failed(out101->key.channel));
+
+	/* Resolved HTLCs are freed, which drops them from the map. */
+	idx = out101->expiry_index;
+	tal_free(out101);
+	CHECK(!uintmap_get(&ld->htlc_expiries.out, idx));
+	idx = in104->expiry_index;
+	tal_free(in104);
+	CHECK(!uintmap_get(&ld->htlc_expiries.in, idx));
+	htlcs_notify_new_block(ld, 101);
+	CHECK(tal_count(failed_channels) == 6);
+	CHECK(uintmap_empty(&ld->htlc_expiries.in));
+	CHECK(uintmap_empty(&ld->htlc_expiries.out));
+
+	tal_free(out98);
+	tal_free(out99);
+	tal_free(out100);
+	tal_free(onchain);
+	tal_free(in105);
+	tal_free(in106);
+	tal_free(in107);
+	CHECK(htlc_in_map_count(&ld->htlcs_in) == 0);
+	CHECK(htlc_out_map_count(&ld->htlcs_out) == 0);
 	return true;
 }
 
@@ -1285,16 +1464,24 @@ int main(void)
 
 	/* Only elements in ld we should access */
 	list_head_init(&ld->peers);
+	ld->peers_by_id = tal(ld, struct peer_id_map);
+	peer_id_map_init(ld->peers_by_id);
+	ld->peers_by_dbid = tal(ld, struct peer_dbid_map);
+	peer_dbid_map_init(ld->peers_by_dbid);
+	ld->channels_by_scid = tal(ld, struct channel_scid_map);
+	channel_scid_map_init(ld->channels_by_scid);
 	node_id_from_hexstr("02a1633cafcc01ebfb6d78e39f687a1f0995c62fc95f51ead10a02ee0be551b5dc", 66, &ld->id);
 	/* Accessed in peer destructor sanity check */
 	htlc_in_map_init(&ld->htlcs_in);
 	htlc_out_map_init(&ld->htlcs_out);
+	htlc_expiries_init(&ld->htlc_expiries);
 
 	ok &= test_wallet_outputs(ld, tmpctx);
 	ok &= test_shachain_crud(ld, tmpctx);
 	ok &= test_channel_crud(ld, tmpctx);
 	ok &= test_channel_config_crud(ld, tmpctx);
 	ok &= test_htlc_crud(ld, tmpctx);
+	ok &= test_htlc_expiries(ld, tmpctx);
 	ok &= test_payment_crud(ld, tmpctx);
 	ok &= test_wallet_payment_status_enum();
 
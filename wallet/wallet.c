@@ -1354,7 +1354,7 @@ void wallet_channel_insert(struct wallet *w, struct channel *chan)
 			     type_to_string(tmpctx, struct wireaddr_internal,
 					    &chan->peer->addr));
 		db_exec_prepared_v2(stmt);
-		chan->peer->dbid = db_last_insert_id_v2(take(stmt));
+		peer_set_dbid(chan->peer, db_last_insert_id_v2(take(stmt)));
 	}
 
 	/* Insert a stub, that we update, unifies INSERT and UPDATE paths */
@@ -1779,7 +1779,8 @@ static void fixup_hin(struct wallet *wallet, struct htlc_in *hin)
 bool wallet_htlcs_load_for_channel(struct wallet *wallet,
 				   struct channel *chan,
 				   struct htlc_in_map *htlcs_in,
-				   struct htlc_out_map *htlcs_out)
+				   struct htlc_out_map *htlcs_out,
+				   struct htlc_expiries *htlc_expiries)
 {
 	struct db_stmt *stmt;
 	bool ok = true;
@@ -1812,7 +1813,7 @@ bool wallet_htlcs_load_for_channel(struct wallet *wallet,
 	while (db_step(stmt)) {
 		struct htlc_in *in = tal(chan, struct htlc_in);
 		ok &= wallet_stmt2htlc_in(chan, stmt, in);
-		connect_htlc_in(htlcs_in, in);
+		connect_htlc_in(htlcs_in, htlc_expiries, in);
 		fixup_hin(wallet, in);
 		ok &= htlc_in_check(in, NULL) != NULL;
 		incount++;
@@ -1845,7 +1846,7 @@ bool wallet_htlcs_load_for_channel(struct wallet *wallet,
 	while (db_step(stmt)) {
 		struct htlc_out *out = tal(chan, struct htlc_out);
 		ok &= wallet_stmt2htlc_out(chan, stmt, out);
-		connect_htlc_out(htlcs_out, out);
+		connect_htlc_out(htlcs_out, htlc_expiries, out);
 		/* Cannot htlc_out_check because we haven't wired the
 		 * dependencies in yet */
 		outcount++;
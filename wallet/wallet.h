@@ -576,6 +576,7 @@ void wallet_htlc_update(struct wallet *wallet, const u64 htlc_dbid,
  * @chan: load HTLCs associated with this channel
  * @htlcs_in: htlc_in_map to store loaded htlc_in in
  * @htlcs_out: htlc_out_map to store loaded htlc_out in
+ * @htlc_expiries: index to add all loaded HTLCs to
  *
  * This function looks for HTLCs that are associated with the given
  * channel and loads them into the provided maps. One caveat is that
@@ -592,7 +593,8 @@ void wallet_htlc_update(struct wallet *wallet, const u64 htlc_dbid,
 bool wallet_htlcs_load_for_channel(struct wallet *wallet,
 				   struct channel *chan,
 				   struct htlc_in_map *htlcs_in,
-				   struct htlc_out_map *htlcs_out);
+				   struct htlc_out_map *htlcs_out,
+				   struct htlc_expiries *htlc_expiries);
 
 /**
  * wallet_announcement_save - Save remote announcement information with channel.